@@ -5,11 +5,12 @@
  */
 
 #include <string.h>
-#include "esp_cpu.h"
 #include "esp_log.h"
 #include "esp_app_trace.h"
 #include "esp_app_trace_port.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "esp_private/startup_internal.h"
+#endif
 
 #ifdef CONFIG_APPTRACE_DEST_UART0
 #define ESP_APPTRACE_DEST_UART_NUM 0
@@ -48,17 +49,24 @@ esp_err_t esp_apptrace_init(void)
     // 'esp_apptrace_init()' is called on every core, so ensure to do main initialization only once
     if (esp_cpu_get_core_id() == 0) {
         memset(&s_trace_channels, 0, sizeof(s_trace_channels));
+#if CONFIG_APPTRACE_DEST_HOST_SOCKET
+        // host socket takes place of JTAG on Linux, so users of ESP_APPTRACE_DEST_JTAG work without changes
+        hw = esp_apptrace_host_socket_hw_get(&hw_data);
+#else
         hw = esp_apptrace_jtag_hw_get(&hw_data);
+#endif
         ESP_APPTRACE_LOGD("HW interface %p", hw);
         if (hw != NULL) {
             s_trace_channels[ESP_APPTRACE_DEST_JTAG].hw = hw;
             s_trace_channels[ESP_APPTRACE_DEST_JTAG].hw_data = hw_data;
         }
+#if !CONFIG_IDF_TARGET_LINUX
         hw = esp_apptrace_uart_hw_get(ESP_APPTRACE_DEST_UART_NUM, &hw_data);
         if (hw != NULL) {
             s_trace_channels[ESP_APPTRACE_DEST_UART].hw = hw;
             s_trace_channels[ESP_APPTRACE_DEST_UART].hw_data = hw_data;
         }
+#endif
         s_inited = true;
     }
 
@@ -77,10 +85,18 @@ esp_err_t esp_apptrace_init(void)
     return ESP_OK;
 }
 
+#if CONFIG_IDF_TARGET_LINUX
+// there are no system init functions on Linux, so initialize before the application starts
+static __attribute__((constructor)) void esp_apptrace_init_linux(void)
+{
+    esp_apptrace_init();
+}
+#else
 ESP_SYSTEM_INIT_FN(esp_apptrace_init, ESP_SYSTEM_INIT_ALL_CORES, 115)
 {
     return esp_apptrace_init();
 }
+#endif
 
 void esp_apptrace_down_buffer_config(uint8_t *buf, uint32_t size)
 {
@@ -12,7 +12,11 @@ extern "C" {
 
 #include "freertos/FreeRTOS.h"
 #include "esp_err.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
 #include "esp_timer.h"
+#endif
 
 /** Infinite waiting timeout */
 #define ESP_APPTRACE_TMO_INFINITE               ((uint32_t)-1)
@@ -28,6 +32,22 @@ typedef struct {
     int64_t   elapsed; ///< elapsed time (in us)
 } esp_apptrace_tmo_t;
 
+/**
+ * @brief Gets current time used to measure time intervals.
+ *
+ * @return time (in us)
+ */
+static inline int64_t esp_apptrace_time_get_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
 /**
  * @brief Initializes timeout structure.
  *
@@ -36,7 +56,7 @@ typedef struct {
 */
 static inline void esp_apptrace_tmo_init(esp_apptrace_tmo_t *tmo, uint32_t user_tmo)
 {
-    tmo->start = esp_timer_get_time();
+    tmo->start = esp_apptrace_time_get_us();
     tmo->tmo = user_tmo == ESP_APPTRACE_TMO_INFINITE ? (int64_t)-1 : (int64_t)user_tmo;
     tmo->elapsed = 0;
 }
@@ -8,6 +8,12 @@
 #define ESP_APP_TRACE_PORT_H_
 
 #include "esp_app_trace_util.h"
+#if CONFIG_IDF_TARGET_LINUX
+// there is no esp_cpu on Linux, all tasks of FreeRTOS POSIX port run on a single core
+#define esp_cpu_get_core_id()   xPortGetCoreID()
+#else
+#include "esp_cpu.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,6 +34,7 @@ typedef struct {
 
 esp_apptrace_hw_t *esp_apptrace_jtag_hw_get(void **data);
 esp_apptrace_hw_t *esp_apptrace_uart_hw_get(int num, void **data);
+esp_apptrace_hw_t *esp_apptrace_host_socket_hw_get(void **data);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,534 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host socket transport for the Linux target.
+ *
+ * It works in the same way as the JTAG transport, with a dedicated thread taking the role of the debugger:
+ * when the application swaps the membufs blocks, the thread copies the user data of the filled block (without
+ * the headers), acknowledges the block and streams the data to the host consumer over a UNIX socket.
+ * Data received from the host are written to the free block, from where the membufs protocol moves them to
+ * the down buffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "esp_log.h"
+#include "esp_app_trace_membufs_proto.h"
+#include "esp_app_trace_port.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL    0
+#endif
+
+/** Linux host socket HW transport data */
+typedef struct {
+    uint8_t                             inited;
+#if CONFIG_APPTRACE_LOCK_ENABLE
+    esp_apptrace_lock_t                 lock;   // sync lock
+#endif
+    esp_apptrace_membufs_proto_data_t   membufs;
+} esp_apptrace_host_socket_data_t;
+
+/** Linux host socket control block */
+typedef struct {
+    // - Control word, has the same layout as the control register used by the JTAG transport.
+    //   It is written by the application on block swap and by the streaming thread on block ack.
+    atomic_uint_least32_t       ctrl;
+    // - Held by the application while it swaps blocks and by the streaming thread while it accesses the free block
+    pthread_mutex_t             swap_lock;
+    int                         sock;       // connection to the host consumer, -1 if not connected
+    int                         wakeup[2];  // pipe to wake up the streaming thread after block swap
+    bool                        host_data_blocked; // data from host wait for the free block
+    esp_apptrace_mem_block_t *  mem_blocks;
+    uint8_t *                   tx_buf;     // user data of the last acknowledged block
+    pthread_t                   thread;
+} esp_apptrace_host_socket_ctrl_t;
+
+#define ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_MSK         0x7FFFUL
+#define ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN(_l_)        ((_l_) & ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_MSK)
+#define ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_GET(_v_)    ((_v_) & ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_MSK)
+#define ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_MSK          0x7FUL
+#define ESP_APPTRACE_HOST_SOCKET_BLOCK_ID(_id_)        (((_id_) & ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_MSK) << 15)
+#define ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_GET(_v_)     (((_v_) >> 15) & ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_MSK)
+#define ESP_APPTRACE_HOST_SOCKET_HOST_DATA             (1 << 22)
+#define ESP_APPTRACE_HOST_SOCKET_HOST_CONNECT          (1 << 23)
+
+#define ESP_APPTRACE_HOST_SOCKET_INITED(_hw_)          ((_hw_)->inited & (1 << 0))
+
+// interval of connection attempts while the host consumer is not listening
+#define ESP_APPTRACE_HOST_SOCKET_RECONNECT_MS          100
+// environment variable which overrides the socket path set in menuconfig
+#define ESP_APPTRACE_HOST_SOCKET_PATH_ENV              "ESP_APPTRACE_SOCKET"
+
+static esp_err_t esp_apptrace_host_socket_init(esp_apptrace_host_socket_data_t *hw_data);
+static esp_err_t esp_apptrace_host_socket_flush(esp_apptrace_host_socket_data_t *hw_data, esp_apptrace_tmo_t *tmo);
+static esp_err_t esp_apptrace_host_socket_flush_nolock(esp_apptrace_host_socket_data_t *hw_data, uint32_t min_sz, esp_apptrace_tmo_t *tmo);
+static uint8_t *esp_apptrace_host_socket_up_buffer_get(esp_apptrace_host_socket_data_t *hw_data, uint32_t size, esp_apptrace_tmo_t *tmo);
+static esp_err_t esp_apptrace_host_socket_up_buffer_put(esp_apptrace_host_socket_data_t *hw_data, uint8_t *ptr, esp_apptrace_tmo_t *tmo);
+static void esp_apptrace_host_socket_down_buffer_config(esp_apptrace_host_socket_data_t *hw_data, uint8_t *buf, uint32_t size);
+static uint8_t *esp_apptrace_host_socket_down_buffer_get(esp_apptrace_host_socket_data_t *hw_data, uint32_t *size, esp_apptrace_tmo_t *tmo);
+static esp_err_t esp_apptrace_host_socket_down_buffer_put(esp_apptrace_host_socket_data_t *hw_data, uint8_t *ptr, esp_apptrace_tmo_t *tmo);
+static bool esp_apptrace_host_socket_host_is_connected(esp_apptrace_host_socket_data_t *hw_data);
+static esp_err_t esp_apptrace_host_socket_buffer_swap_start(uint32_t curr_block_id);
+static esp_err_t esp_apptrace_host_socket_buffer_swap(uint32_t new_block_id);
+static esp_err_t esp_apptrace_host_socket_buffer_swap_end(uint32_t new_block_id, uint32_t prev_block_len);
+static bool esp_apptrace_host_socket_host_data_pending(void);
+static void *esp_apptrace_host_socket_thread(void *arg);
+
+
+const static char *TAG = "esp_apptrace";
+
+static esp_apptrace_host_socket_ctrl_t s_tracing_ctrl = {
+    .swap_lock = PTHREAD_MUTEX_INITIALIZER,
+    .sock = -1,
+    .wakeup = {-1, -1},
+};
+
+esp_apptrace_hw_t *esp_apptrace_host_socket_hw_get(void **data)
+{
+#if CONFIG_APPTRACE_DEST_HOST_SOCKET
+    static esp_apptrace_membufs_proto_hw_t s_trace_proto_hw = {
+        .swap_start = esp_apptrace_host_socket_buffer_swap_start,
+        .swap = esp_apptrace_host_socket_buffer_swap,
+        .swap_end = esp_apptrace_host_socket_buffer_swap_end,
+        .host_data_pending = esp_apptrace_host_socket_host_data_pending,
+    };
+    static esp_apptrace_host_socket_data_t s_trace_hw_data = {
+        .membufs = {
+            .hw = &s_trace_proto_hw,
+        },
+    };
+    static esp_apptrace_hw_t s_trace_hw = {
+        .init = (esp_err_t (*)(void *))esp_apptrace_host_socket_init,
+        .get_up_buffer = (uint8_t *(*)(void *, uint32_t, esp_apptrace_tmo_t *))esp_apptrace_host_socket_up_buffer_get,
+        .put_up_buffer = (esp_err_t (*)(void *, uint8_t *, esp_apptrace_tmo_t *))esp_apptrace_host_socket_up_buffer_put,
+        .flush_up_buffer_nolock = (esp_err_t (*)(void *, uint32_t, esp_apptrace_tmo_t *))esp_apptrace_host_socket_flush_nolock,
+        .flush_up_buffer = (esp_err_t (*)(void *, esp_apptrace_tmo_t *))esp_apptrace_host_socket_flush,
+        .down_buffer_config = (void (*)(void *, uint8_t *, uint32_t ))esp_apptrace_host_socket_down_buffer_config,
+        .get_down_buffer = (uint8_t *(*)(void *, uint32_t *, esp_apptrace_tmo_t *))esp_apptrace_host_socket_down_buffer_get,
+        .put_down_buffer = (esp_err_t (*)(void *, uint8_t *, esp_apptrace_tmo_t *))esp_apptrace_host_socket_down_buffer_put,
+        .host_is_connected = (bool (*)(void *))esp_apptrace_host_socket_host_is_connected,
+    };
+    *data = &s_trace_hw_data;
+    return &s_trace_hw;
+#else
+    return NULL;
+#endif
+}
+
+/* Returns up buffers config.
+   This function can be overriden with custom implementation. */
+__attribute__((weak)) void esp_apptrace_get_up_buffers(esp_apptrace_mem_block_t mem_blocks_cfg[2])
+{
+    static uint8_t s_mem_blocks[2][CONFIG_APPTRACE_BUF_SIZE];
+
+    mem_blocks_cfg[0].start = s_mem_blocks[0];
+    mem_blocks_cfg[0].sz = CONFIG_APPTRACE_BUF_SIZE;
+    mem_blocks_cfg[1].start = s_mem_blocks[1];
+    mem_blocks_cfg[1].sz = CONFIG_APPTRACE_BUF_SIZE;
+}
+
+static esp_err_t esp_apptrace_host_socket_lock(esp_apptrace_host_socket_data_t *hw_data, esp_apptrace_tmo_t *tmo)
+{
+#if CONFIG_APPTRACE_LOCK_ENABLE
+    esp_err_t ret = esp_apptrace_lock_take(&hw_data->lock, tmo);
+    if (ret != ESP_OK) {
+        return ESP_FAIL;
+    }
+#endif
+    return ESP_OK;
+}
+
+static esp_err_t esp_apptrace_host_socket_unlock(esp_apptrace_host_socket_data_t *hw_data)
+{
+    esp_err_t ret = ESP_OK;
+#if CONFIG_APPTRACE_LOCK_ENABLE
+    ret = esp_apptrace_lock_give(&hw_data->lock);
+#endif
+    return ret;
+}
+
+/*****************************************************************************************/
+/***************************** Apptrace HW iface *****************************************/
+/*****************************************************************************************/
+
+static esp_err_t esp_apptrace_host_socket_init(esp_apptrace_host_socket_data_t *hw_data)
+{
+    if (hw_data->inited != 0) {
+        return ESP_OK;
+    }
+    esp_apptrace_mem_block_t mem_blocks_cfg[2];
+    esp_apptrace_get_up_buffers(mem_blocks_cfg);
+    for (int i = 0; i < 2; i++) {
+        if (mem_blocks_cfg[i].sz > ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_MSK) {
+            ESP_APPTRACE_LOGE("Too large trace buffer of %d bytes!", mem_blocks_cfg[i].sz);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    esp_err_t res = esp_apptrace_membufs_init(&hw_data->membufs, mem_blocks_cfg);
+    if (res != ESP_OK) {
+        ESP_APPTRACE_LOGE("Failed to init membufs proto (%d)!", res);
+        return res;
+    }
+#if CONFIG_APPTRACE_LOCK_ENABLE
+    esp_apptrace_lock_init(&hw_data->lock);
+#endif
+    s_tracing_ctrl.mem_blocks = hw_data->membufs.blocks;
+    s_tracing_ctrl.tx_buf = malloc(MAX(mem_blocks_cfg[0].sz, mem_blocks_cfg[1].sz));
+    if (s_tracing_ctrl.tx_buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (pipe(s_tracing_ctrl.wakeup) != 0) {
+        ESP_APPTRACE_LOGE("Failed to create wakeup pipe (%d)!", errno);
+        free(s_tracing_ctrl.tx_buf);
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(s_tracing_ctrl.wakeup[i], F_SETFL, fcntl(s_tracing_ctrl.wakeup[i], F_GETFL) | O_NONBLOCK);
+    }
+    // The streaming thread is not a FreeRTOS task, so it must not receive the signals used by the POSIX port scheduler.
+    // Signal mask is inherited by the new thread.
+    sigset_t all_signals, prev_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &prev_signals);
+    int ret = pthread_create(&s_tracing_ctrl.thread, NULL, esp_apptrace_host_socket_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &prev_signals, NULL);
+    if (ret != 0) {
+        ESP_APPTRACE_LOGE("Failed to create streaming thread (%d)!", ret);
+        close(s_tracing_ctrl.wakeup[0]);
+        close(s_tracing_ctrl.wakeup[1]);
+        free(s_tracing_ctrl.tx_buf);
+        return ESP_FAIL;
+    }
+    hw_data->inited = 1;
+    ESP_APPTRACE_LOGI("Apptrace initialized. Streaming to host socket.");
+    return ESP_OK;
+}
+
+static uint8_t *esp_apptrace_host_socket_up_buffer_get(esp_apptrace_host_socket_data_t *hw_data, uint32_t size, esp_apptrace_tmo_t *tmo)
+{
+    uint8_t *ptr;
+
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return NULL;
+    }
+    esp_err_t res = esp_apptrace_host_socket_lock(hw_data, tmo);
+    if (res != ESP_OK) {
+        return NULL;
+    }
+
+    ptr = esp_apptrace_membufs_up_buffer_get(&hw_data->membufs, size, tmo);
+
+    // now we can safely unlock apptrace to allow other tasks to get other buffers and write their data
+    if (esp_apptrace_host_socket_unlock(hw_data) != ESP_OK) {
+        assert(false && "Failed to unlock apptrace data!");
+    }
+    return ptr;
+}
+
+static esp_err_t esp_apptrace_host_socket_up_buffer_put(esp_apptrace_host_socket_data_t *hw_data, uint8_t *ptr, esp_apptrace_tmo_t *tmo)
+{
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Can avoid locking because esp_apptrace_membufs_up_buffer_put() just modifies buffer's header
+    return esp_apptrace_membufs_up_buffer_put(&hw_data->membufs, ptr, tmo);
+}
+
+static void esp_apptrace_host_socket_down_buffer_config(esp_apptrace_host_socket_data_t *hw_data, uint8_t *buf, uint32_t size)
+{
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return;
+    }
+    esp_apptrace_membufs_down_buffer_config(&hw_data->membufs, buf, size);
+}
+
+static uint8_t *esp_apptrace_host_socket_down_buffer_get(esp_apptrace_host_socket_data_t *hw_data, uint32_t *size, esp_apptrace_tmo_t *tmo)
+{
+    uint8_t *ptr;
+
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return NULL;
+    }
+    esp_err_t res = esp_apptrace_host_socket_lock(hw_data, tmo);
+    if (res != ESP_OK) {
+        return NULL;
+    }
+
+    ptr = esp_apptrace_membufs_down_buffer_get(&hw_data->membufs, size, tmo);
+
+    // now we can safely unlock apptrace to allow other tasks to get other buffers and write their data
+    if (esp_apptrace_host_socket_unlock(hw_data) != ESP_OK) {
+        assert(false && "Failed to unlock apptrace data!");
+    }
+    return ptr;
+}
+
+static esp_err_t esp_apptrace_host_socket_down_buffer_put(esp_apptrace_host_socket_data_t *hw_data, uint8_t *ptr, esp_apptrace_tmo_t *tmo)
+{
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Can avoid locking because esp_apptrace_membufs_down_buffer_put() does nothing
+    return esp_apptrace_membufs_down_buffer_put(&hw_data->membufs, ptr, tmo);
+}
+
+static bool esp_apptrace_host_socket_host_is_connected(esp_apptrace_host_socket_data_t *hw_data)
+{
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return false;
+    }
+    return atomic_load(&s_tracing_ctrl.ctrl) & ESP_APPTRACE_HOST_SOCKET_HOST_CONNECT ? true : false;
+}
+
+static esp_err_t esp_apptrace_host_socket_flush_nolock(esp_apptrace_host_socket_data_t *hw_data, uint32_t min_sz, esp_apptrace_tmo_t *tmo)
+{
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_apptrace_membufs_flush_nolock(&hw_data->membufs, min_sz, tmo);
+}
+
+static esp_err_t esp_apptrace_host_socket_flush(esp_apptrace_host_socket_data_t *hw_data, esp_apptrace_tmo_t *tmo)
+{
+    if (!ESP_APPTRACE_HOST_SOCKET_INITED(hw_data)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t res = esp_apptrace_host_socket_lock(hw_data, tmo);
+    if (res != ESP_OK) {
+        return res;
+    }
+
+    res = esp_apptrace_membufs_flush_nolock(&hw_data->membufs, 0, tmo);
+
+    // now we can safely unlock apptrace to allow other tasks to get other buffers and write their data
+    if (esp_apptrace_host_socket_unlock(hw_data) != ESP_OK) {
+        assert(false && "Failed to unlock apptrace data!");
+    }
+    return res;
+}
+
+/*****************************************************************************************/
+/************************** Membufs proto HW iface ***************************************/
+/*****************************************************************************************/
+
+static esp_err_t esp_apptrace_host_socket_buffer_swap_start(uint32_t curr_block_id)
+{
+    // the streaming thread writes data from host to the free block, do not switch to it in the meantime
+    if (pthread_mutex_trylock(&s_tracing_ctrl.swap_lock) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t ctrl_reg = atomic_load(&s_tracing_ctrl.ctrl);
+    uint32_t host_connected = ESP_APPTRACE_HOST_SOCKET_HOST_CONNECT & ctrl_reg;
+    if (host_connected) {
+        uint32_t acked_block = ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_GET(ctrl_reg);
+        uint32_t host_to_read = ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_GET(ctrl_reg);
+        if (host_to_read != 0 || acked_block != (curr_block_id & ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_MSK)) {
+            pthread_mutex_unlock(&s_tracing_ctrl.swap_lock);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t esp_apptrace_host_socket_buffer_swap_end(uint32_t new_block_id, uint32_t prev_block_len)
+{
+    uint32_t ctrl_reg = atomic_load(&s_tracing_ctrl.ctrl);
+    uint32_t host_connected = ESP_APPTRACE_HOST_SOCKET_HOST_CONNECT & ctrl_reg;
+    atomic_store(&s_tracing_ctrl.ctrl, ESP_APPTRACE_HOST_SOCKET_BLOCK_ID(new_block_id) |
+                 host_connected | ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN(prev_block_len));
+    pthread_mutex_unlock(&s_tracing_ctrl.swap_lock);
+    if (host_connected) {
+        // if the pipe is full, the thread is going to wake up anyway
+        (void)!write(s_tracing_ctrl.wakeup[1], "", 1);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t esp_apptrace_host_socket_buffer_swap(uint32_t new_block_id)
+{
+    /* do nothing */
+    return ESP_OK;
+}
+
+static bool esp_apptrace_host_socket_host_data_pending(void)
+{
+    return (atomic_load(&s_tracing_ctrl.ctrl) & ESP_APPTRACE_HOST_SOCKET_HOST_DATA) ? true : false;
+}
+
+/*****************************************************************************************/
+/******************************* Streaming thread ****************************************/
+/*****************************************************************************************/
+
+static const char *esp_apptrace_host_socket_path(void)
+{
+    const char *path = getenv(ESP_APPTRACE_HOST_SOCKET_PATH_ENV);
+    return path ? path : CONFIG_APPTRACE_HOST_SOCKET_PATH;
+}
+
+static bool esp_apptrace_host_socket_connect(void)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, esp_apptrace_host_socket_path(), sizeof(addr.sun_path) - 1);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return false;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return false;
+    }
+    pthread_mutex_lock(&s_tracing_ctrl.swap_lock);
+    // data written before connection are dropped, acknowledge the current block
+    uint32_t ctrl_reg = atomic_load(&s_tracing_ctrl.ctrl);
+    atomic_store(&s_tracing_ctrl.ctrl, (ctrl_reg & ESP_APPTRACE_HOST_SOCKET_BLOCK_ID(ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_MSK)) |
+                 ESP_APPTRACE_HOST_SOCKET_HOST_CONNECT);
+    s_tracing_ctrl.sock = sock;
+    s_tracing_ctrl.host_data_blocked = false;
+    pthread_mutex_unlock(&s_tracing_ctrl.swap_lock);
+    ESP_APPTRACE_LOGI("Connected to host socket %s", addr.sun_path);
+    return true;
+}
+
+static void esp_apptrace_host_socket_disconnect(void)
+{
+    pthread_mutex_lock(&s_tracing_ctrl.swap_lock);
+    uint32_t ctrl_reg = atomic_load(&s_tracing_ctrl.ctrl);
+    atomic_store(&s_tracing_ctrl.ctrl, ctrl_reg & ESP_APPTRACE_HOST_SOCKET_BLOCK_ID(ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_MSK));
+    close(s_tracing_ctrl.sock);
+    s_tracing_ctrl.sock = -1;
+    pthread_mutex_unlock(&s_tracing_ctrl.swap_lock);
+    ESP_APPTRACE_LOGI("Disconnected from host socket");
+}
+
+/* Copies user data of the block waiting for the host to the TX buffer and acknowledges the block.
+   Returns the number of bytes to send. */
+static uint32_t esp_apptrace_host_socket_block_read(void)
+{
+    uint32_t tx_len = 0;
+
+    pthread_mutex_lock(&s_tracing_ctrl.swap_lock);
+    uint32_t ctrl_reg = atomic_load(&s_tracing_ctrl.ctrl);
+    uint32_t block_len = ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_GET(ctrl_reg);
+    if (block_len != 0) {
+        // block ID is the ID of the block in use, the filled one is the previous one
+        esp_apptrace_mem_block_t *block = &s_tracing_ctrl.mem_blocks[(ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_GET(ctrl_reg) + 1) % 2];
+        uint32_t offset = 0;
+        while (offset + sizeof(esp_tracedata_hdr_t) <= block_len) {
+            esp_tracedata_hdr_t *hdr = (esp_tracedata_hdr_t *)(block->start + offset);
+            uint32_t sz = ESP_APPTRACE_USR_BLOCK_LEN(hdr->block_sz);
+            uint32_t wr_sz = MIN(hdr->wr_sz, sz);
+            if (wr_sz != sz) {
+                ESP_APPTRACE_LOGE("Incomplete user block: %d of %d bytes written!", wr_sz, sz);
+            }
+            offset += ESP_APPTRACE_USR_BLOCK_RAW_SZ(sz);
+            if (offset > block_len) {
+                ESP_APPTRACE_LOGE("User block exceeds trace block length %d!", block_len);
+                break;
+            }
+            memcpy(s_tracing_ctrl.tx_buf + tx_len, hdr + 1, wr_sz);
+            tx_len += wr_sz;
+        }
+        atomic_store(&s_tracing_ctrl.ctrl, ctrl_reg & ~ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_MSK);
+        s_tracing_ctrl.host_data_blocked = false;
+    }
+    pthread_mutex_unlock(&s_tracing_ctrl.swap_lock);
+    return tx_len;
+}
+
+static bool esp_apptrace_host_socket_send(const uint8_t *data, uint32_t len)
+{
+    while (len > 0) {
+        ssize_t ret = send(s_tracing_ctrl.sock, data, len, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+/* Writes data from host to the free block, the application receives them on the next block swap.
+   Returns false if the host has closed the connection. */
+static bool esp_apptrace_host_socket_host_data_write(void)
+{
+    bool connected = true;
+
+    pthread_mutex_lock(&s_tracing_ctrl.swap_lock);
+    uint32_t ctrl_reg = atomic_load(&s_tracing_ctrl.ctrl);
+    if (ESP_APPTRACE_HOST_SOCKET_BLOCK_LEN_GET(ctrl_reg) != 0 || (ctrl_reg & ESP_APPTRACE_HOST_SOCKET_HOST_DATA)) {
+        // free block is not sent yet or the previous data from host are not received, wait for the next swap
+        s_tracing_ctrl.host_data_blocked = true;
+    } else {
+        esp_apptrace_mem_block_t *block = &s_tracing_ctrl.mem_blocks[(ESP_APPTRACE_HOST_SOCKET_BLOCK_ID_GET(ctrl_reg) + 1) % 2];
+        esp_hostdata_hdr_t *hdr = (esp_hostdata_hdr_t *)block->start;
+        ssize_t ret = recv(s_tracing_ctrl.sock, hdr + 1, MIN(block->sz - sizeof(*hdr), UINT16_MAX), MSG_DONTWAIT);
+        if (ret > 0) {
+            hdr->block_sz = ret;
+            atomic_store(&s_tracing_ctrl.ctrl, ctrl_reg | ESP_APPTRACE_HOST_SOCKET_HOST_DATA);
+        } else if (ret == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            connected = false;
+        }
+    }
+    pthread_mutex_unlock(&s_tracing_ctrl.swap_lock);
+    return connected;
+}
+
+static void *esp_apptrace_host_socket_thread(void *arg)
+{
+    uint8_t wakeup_buf[16];
+
+    while (1) {
+        if (s_tracing_ctrl.sock < 0 && !esp_apptrace_host_socket_connect()) {
+            // host consumer is not listening yet, blocks are just overwritten in the meantime
+            poll(NULL, 0, ESP_APPTRACE_HOST_SOCKET_RECONNECT_MS);
+            while (read(s_tracing_ctrl.wakeup[0], wakeup_buf, sizeof(wakeup_buf)) > 0) {
+            }
+            continue;
+        }
+        struct pollfd fds[2] = {
+            { .fd = s_tracing_ctrl.wakeup[0], .events = POLLIN },
+            { .fd = s_tracing_ctrl.sock, .events = s_tracing_ctrl.host_data_blocked ? 0 : POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            while (read(s_tracing_ctrl.wakeup[0], wakeup_buf, sizeof(wakeup_buf)) > 0) {
+            }
+            uint32_t tx_len = esp_apptrace_host_socket_block_read();
+            if (tx_len > 0 && !esp_apptrace_host_socket_send(s_tracing_ctrl.tx_buf, tx_len)) {
+                esp_apptrace_host_socket_disconnect();
+                continue;
+            }
+        }
+        if (s_tracing_ctrl.host_data_blocked && (fds[1].revents & (POLLHUP | POLLERR))) {
+            // the rest of data from host can not be received before the next swap, do not wait for it
+            esp_apptrace_host_socket_disconnect();
+        } else if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (!esp_apptrace_host_socket_host_data_write()) {
+                esp_apptrace_host_socket_disconnect();
+            }
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_app_trace.h"
+#include "unity.h"
+
+/* Spans several trace blocks, so the test goes through block swaps and acknowledgements */
+#define TEST_DATA_LEN       (3 * CONFIG_APPTRACE_BUF_SIZE + 100)
+#define TEST_CHUNK_LEN      100
+#define TEST_TMO_US         (5 * 1000 * 1000)
+#define TEST_TMO_TICKS      pdMS_TO_TICKS(5000)
+
+static const char s_host_data[] = "data from host";
+
+/* The test task plays the role of the host consumer. The POSIX port interrupts system calls with its tick signal. */
+
+static int host_listen(struct sockaddr_un *addr)
+{
+    const char *path = getenv("ESP_APPTRACE_SOCKET");
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path ? path : CONFIG_APPTRACE_HOST_SOCKET_PATH, sizeof(addr->sun_path) - 1);
+    unlink(addr->sun_path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    TEST_ASSERT_EQUAL(0, bind(sock, (struct sockaddr *)addr, sizeof(*addr)));
+    TEST_ASSERT_EQUAL(0, listen(sock, 1));
+    return sock;
+}
+
+static int host_accept(int listen_sock)
+{
+    int sock;
+    while ((sock = accept(listen_sock, NULL, NULL)) < 0 && errno == EINTR) {
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    const struct timeval tv = { .tv_sec = TEST_TMO_US / 1000000 };
+    TEST_ASSERT_EQUAL(0, setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)));
+    return sock;
+}
+
+static void host_recv_all(int sock, uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t ret = recv(sock, data, len, 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        TEST_ASSERT_GREATER_THAN_MESSAGE(0, ret, "host has not received all trace data");
+        data += ret;
+        len -= ret;
+    }
+}
+
+static void wait_host_connected(bool connected)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (esp_apptrace_host_is_connected(ESP_APPTRACE_DEST_JTAG) != connected) {
+        TEST_ASSERT_LESS_THAN(TEST_TMO_TICKS, xTaskGetTickCount() - start);
+        vTaskDelay(1);
+    }
+}
+
+TEST_CASE("apptrace data round trip over host socket", "[app_trace]")
+{
+    static uint8_t down_buf[64];
+    esp_apptrace_down_buffer_config(down_buf, sizeof(down_buf));
+
+    uint8_t *sent = malloc(TEST_DATA_LEN);
+    uint8_t *received = malloc(TEST_DATA_LEN);
+    TEST_ASSERT_NOT_NULL(sent);
+    TEST_ASSERT_NOT_NULL(received);
+    for (int i = 0; i < TEST_DATA_LEN; i++) {
+        sent[i] = i * 7 + (i >> 8);
+    }
+
+    struct sockaddr_un addr;
+    int listen_sock = host_listen(&addr);
+    int sock = host_accept(listen_sock);
+    wait_host_connected(true);
+
+    // application to host: the headers of the membufs protocol are stripped, the host receives the written data only
+    for (int pos = 0; pos < TEST_DATA_LEN; pos += TEST_CHUNK_LEN) {
+        uint32_t len = TEST_DATA_LEN - pos < TEST_CHUNK_LEN ? TEST_DATA_LEN - pos : TEST_CHUNK_LEN;
+        TEST_ESP_OK(esp_apptrace_write(ESP_APPTRACE_DEST_JTAG, sent + pos, len, TEST_TMO_US));
+    }
+    TEST_ESP_OK(esp_apptrace_flush(ESP_APPTRACE_DEST_JTAG, TEST_TMO_US));
+    host_recv_all(sock, received, TEST_DATA_LEN);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sent, received, TEST_DATA_LEN);
+
+    // host to application
+    TEST_ASSERT_EQUAL(sizeof(s_host_data), send(sock, s_host_data, sizeof(s_host_data), 0));
+    char read_data[sizeof(s_host_data)];
+    uint32_t read_len = 0;
+    while (read_len < sizeof(s_host_data)) {
+        uint32_t len = sizeof(read_data) - read_len;
+        TEST_ESP_OK(esp_apptrace_read(ESP_APPTRACE_DEST_JTAG, read_data + read_len, &len, TEST_TMO_US));
+        read_len += len;
+    }
+    TEST_ASSERT_EQUAL_STRING(s_host_data, read_data);
+
+    // the application notices that the host has closed the connection, stop listening so that it does not reconnect
+    close(listen_sock);
+    unlink(addr.sun_path);
+    close(sock);
+    wait_host_connected(false);
+
+    free(received);
+    free(sent);
+}
+
+void app_main(void)
+{
+    printf("Running app_trace linux host test app");
+    unity_run_menu();
+}
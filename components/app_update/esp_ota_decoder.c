@@ -0,0 +1,453 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sys/param.h"
+#include "esp_log.h"
+
+#include "esp_ota_decoder.h"
+
+/* First byte of a plain app image, see ESP_IMAGE_HEADER_MAGIC */
+#define DECODER_PLAIN_IMAGE_MAGIC   0xE9
+#define DECODER_SRC_BUF_SIZE        256
+#define DECODER_LZ_MATCH_FLAG       0x80
+#define DECODER_LZ_MIN_MATCH        3
+#define DECODER_DELTA_MAX_ARGS      2
+
+typedef enum {
+    DECODER_STATE_HEADER,       /* collecting esp_ota_patch_header_t */
+    DECODER_STATE_PLAIN,        /* plain app image, passed through */
+    DECODER_STATE_PAYLOAD,      /* compressed and/or delta payload */
+} decoder_state_t;
+
+typedef enum {
+    LZ_STATE_TOKEN,
+    LZ_STATE_LITERAL,
+    LZ_STATE_DIST_LO,
+    LZ_STATE_DIST_HI,
+} lz_state_t;
+
+typedef enum {
+    DELTA_STATE_OP,
+    DELTA_STATE_VARINT,
+    DELTA_STATE_ADD_DATA,
+    DELTA_STATE_INSERT_DATA,
+} delta_state_t;
+
+struct esp_ota_decoder {
+    esp_ota_decoder_cfg_t cfg;
+    decoder_state_t state;
+    esp_err_t err;
+    esp_ota_patch_header_t header;
+    size_t header_len;
+    size_t written;
+
+    /* LZ stage, output goes through the window ring buffer */
+    lz_state_t lz_state;
+    uint8_t *window;
+    uint32_t window_size;
+    uint32_t wpos;
+    uint32_t flushed;
+    uint32_t lz_total;
+    uint32_t lz_len;
+    uint32_t lz_dist;
+
+    /* Delta stage */
+    delta_state_t delta_state;
+    uint8_t op;
+    uint8_t arg_count;
+    uint8_t arg_idx;
+    uint8_t varint_shift;
+    uint32_t varint_val;
+    uint32_t args[DECODER_DELTA_MAX_ARGS];
+    uint32_t src_off;
+    uint32_t remaining;
+    uint8_t src_buf[DECODER_SRC_BUF_SIZE];
+};
+
+static const char *TAG = "esp_ota_decoder";
+
+static esp_err_t decoder_emit(esp_ota_decoder_handle_t dec, const uint8_t *data, size_t size)
+{
+    if (dec->state == DECODER_STATE_PAYLOAD && dec->written + size > dec->header.image_size) {
+        ESP_LOGE(TAG, "decoded image exceeds announced size %u", (unsigned)dec->header.image_size);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    esp_err_t ret = dec->cfg.write_cb(dec->cfg.write_cb_arg, data, size);
+    if (ret == ESP_OK) {
+        dec->written += size;
+    }
+    return ret;
+}
+
+static esp_err_t delta_read_src(esp_ota_decoder_handle_t dec, size_t size)
+{
+    esp_err_t ret = esp_partition_read(dec->cfg.src_partition, dec->src_off, dec->src_buf, size);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "reading source at 0x%x failed (0x%x)", (unsigned)dec->src_off, ret);
+    }
+    return ret;
+}
+
+static esp_err_t delta_start_op(esp_ota_decoder_handle_t dec)
+{
+    if (dec->op == ESP_OTA_PATCH_OP_INSERT) {
+        dec->remaining = dec->args[0];
+        dec->delta_state = dec->remaining ? DELTA_STATE_INSERT_DATA : DELTA_STATE_OP;
+        return ESP_OK;
+    }
+
+    dec->src_off = dec->args[0];
+    dec->remaining = dec->args[1];
+    if ((uint64_t)dec->src_off + dec->remaining > dec->header.src_size) {
+        ESP_LOGE(TAG, "source range 0x%x+0x%x out of bounds", (unsigned)dec->src_off, (unsigned)dec->remaining);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (dec->op == ESP_OTA_PATCH_OP_ADD) {
+        dec->delta_state = dec->remaining ? DELTA_STATE_ADD_DATA : DELTA_STATE_OP;
+        return ESP_OK;
+    }
+
+    while (dec->remaining > 0) {
+        size_t n = MIN(dec->remaining, DECODER_SRC_BUF_SIZE);
+        esp_err_t ret = delta_read_src(dec, n);
+        if (ret == ESP_OK) {
+            ret = decoder_emit(dec, dec->src_buf, n);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        dec->src_off += n;
+        dec->remaining -= n;
+    }
+    dec->delta_state = DELTA_STATE_OP;
+    return ESP_OK;
+}
+
+static esp_err_t delta_feed(esp_ota_decoder_handle_t dec, const uint8_t *data, size_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    while (size > 0 && ret == ESP_OK) {
+        switch (dec->delta_state) {
+        case DELTA_STATE_OP:
+            dec->op = *data++;
+            size--;
+            if (dec->op == ESP_OTA_PATCH_OP_COPY || dec->op == ESP_OTA_PATCH_OP_ADD) {
+                dec->arg_count = 2;
+            } else if (dec->op == ESP_OTA_PATCH_OP_INSERT) {
+                dec->arg_count = 1;
+            } else {
+                ESP_LOGE(TAG, "unknown delta opcode 0x%02x", dec->op);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            dec->arg_idx = 0;
+            dec->varint_val = 0;
+            dec->varint_shift = 0;
+            dec->delta_state = DELTA_STATE_VARINT;
+            break;
+        case DELTA_STATE_VARINT: {
+            uint8_t b = *data++;
+            size--;
+            if (dec->varint_shift > 28) {
+                ESP_LOGE(TAG, "delta argument too long");
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            dec->varint_val |= (uint32_t)(b & 0x7F) << dec->varint_shift;
+            dec->varint_shift += 7;
+            if (b & 0x80) {
+                break;
+            }
+            dec->args[dec->arg_idx++] = dec->varint_val;
+            dec->varint_val = 0;
+            dec->varint_shift = 0;
+            if (dec->arg_idx == dec->arg_count) {
+                ret = delta_start_op(dec);
+            }
+            break;
+        }
+        case DELTA_STATE_INSERT_DATA: {
+            size_t n = MIN(size, dec->remaining);
+            ret = decoder_emit(dec, data, n);
+            data += n;
+            size -= n;
+            dec->remaining -= n;
+            if (dec->remaining == 0) {
+                dec->delta_state = DELTA_STATE_OP;
+            }
+            break;
+        }
+        case DELTA_STATE_ADD_DATA: {
+            size_t n = MIN(MIN(size, dec->remaining), DECODER_SRC_BUF_SIZE);
+            ret = delta_read_src(dec, n);
+            if (ret != ESP_OK) {
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                dec->src_buf[i] += data[i];
+            }
+            ret = decoder_emit(dec, dec->src_buf, n);
+            data += n;
+            size -= n;
+            dec->src_off += n;
+            dec->remaining -= n;
+            if (dec->remaining == 0) {
+                dec->delta_state = DELTA_STATE_OP;
+            }
+            break;
+        }
+        }
+    }
+    return ret;
+}
+
+/* Output of the LZ stage (or the raw payload) goes either to the delta stage or straight to the sink */
+static esp_err_t payload_out(esp_ota_decoder_handle_t dec, const uint8_t *data, size_t size)
+{
+    if (dec->header.flags & ESP_OTA_PATCH_FLAG_DELTA) {
+        return delta_feed(dec, data, size);
+    }
+    return decoder_emit(dec, data, size);
+}
+
+static esp_err_t lz_flush(esp_ota_decoder_handle_t dec)
+{
+    esp_err_t ret = ESP_OK;
+    if (dec->wpos > dec->flushed) {
+        ret = payload_out(dec, dec->window + dec->flushed, dec->wpos - dec->flushed);
+        dec->flushed = dec->wpos;
+    }
+    if (dec->wpos == dec->window_size) {
+        dec->wpos = 0;
+        dec->flushed = 0;
+    }
+    return ret;
+}
+
+static esp_err_t lz_match(esp_ota_decoder_handle_t dec)
+{
+    if (dec->lz_dist == 0 || dec->lz_dist > dec->window_size || dec->lz_dist > dec->lz_total) {
+        ESP_LOGE(TAG, "invalid match distance %u", (unsigned)dec->lz_dist);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    const uint32_t mask = dec->window_size - 1;
+    uint32_t from = (dec->wpos - dec->lz_dist) & mask;
+    for (uint32_t i = 0; i < dec->lz_len; i++) {
+        dec->window[dec->wpos++] = dec->window[from];
+        from = (from + 1) & mask;
+        if (dec->wpos == dec->window_size) {
+            esp_err_t ret = lz_flush(dec);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+    }
+    dec->lz_total += dec->lz_len;
+    return ESP_OK;
+}
+
+static esp_err_t lz_feed(esp_ota_decoder_handle_t dec, const uint8_t *data, size_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    while (size > 0 && ret == ESP_OK) {
+        switch (dec->lz_state) {
+        case LZ_STATE_TOKEN: {
+            uint8_t token = *data++;
+            size--;
+            if (token & DECODER_LZ_MATCH_FLAG) {
+                dec->lz_len = (token & ~DECODER_LZ_MATCH_FLAG) + DECODER_LZ_MIN_MATCH;
+                dec->lz_state = LZ_STATE_DIST_LO;
+            } else {
+                dec->lz_len = token + 1;
+                dec->lz_state = LZ_STATE_LITERAL;
+            }
+            break;
+        }
+        case LZ_STATE_LITERAL: {
+            size_t n = MIN(MIN(size, dec->lz_len), dec->window_size - dec->wpos);
+            memcpy(dec->window + dec->wpos, data, n);
+            dec->wpos += n;
+            dec->lz_total += n;
+            dec->lz_len -= n;
+            data += n;
+            size -= n;
+            if (dec->wpos == dec->window_size) {
+                ret = lz_flush(dec);
+            }
+            if (dec->lz_len == 0) {
+                dec->lz_state = LZ_STATE_TOKEN;
+            }
+            break;
+        }
+        case LZ_STATE_DIST_LO:
+            dec->lz_dist = *data++;
+            size--;
+            dec->lz_state = LZ_STATE_DIST_HI;
+            break;
+        case LZ_STATE_DIST_HI:
+            dec->lz_dist |= (uint32_t)(*data++) << 8;
+            size--;
+            dec->lz_state = LZ_STATE_TOKEN;
+            ret = lz_match(dec);
+            break;
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = lz_flush(dec);
+    }
+    return ret;
+}
+
+static esp_err_t decoder_check_header(esp_ota_decoder_handle_t dec)
+{
+    const esp_ota_patch_header_t *hdr = &dec->header;
+
+    if (hdr->magic != ESP_OTA_PATCH_MAGIC || hdr->version != ESP_OTA_PATCH_VERSION ||
+            (hdr->flags & ~(ESP_OTA_PATCH_FLAG_COMPRESSED | ESP_OTA_PATCH_FLAG_DELTA)) != 0) {
+        ESP_LOGE(TAG, "unsupported patch format (magic 0x%08x, version %d)", (unsigned)hdr->magic, hdr->version);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (hdr->image_size == 0) {
+        ESP_LOGE(TAG, "empty image");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (hdr->flags & ESP_OTA_PATCH_FLAG_DELTA) {
+        if (dec->cfg.src_partition == NULL) {
+            ESP_LOGE(TAG, "delta patch received but no source partition configured");
+            return ESP_ERR_INVALID_VERSION;
+        }
+        if (hdr->src_size > dec->cfg.src_partition->size) {
+            ESP_LOGE(TAG, "source image does not fit into partition %s", dec->cfg.src_partition->label);
+            return ESP_ERR_INVALID_VERSION;
+        }
+        uint8_t sha256[sizeof(hdr->src_sha256)];
+        if (esp_partition_get_sha256(dec->cfg.src_partition, sha256) != ESP_OK ||
+                memcmp(sha256, hdr->src_sha256, sizeof(sha256)) != 0) {
+            ESP_LOGE(TAG, "delta patch was made for a different source image");
+            return ESP_ERR_INVALID_VERSION;
+        }
+    }
+
+    if (hdr->flags & ESP_OTA_PATCH_FLAG_COMPRESSED) {
+        if (hdr->window_bits < ESP_OTA_PATCH_WINDOW_BITS_MIN || hdr->window_bits > ESP_OTA_PATCH_WINDOW_BITS_MAX) {
+            ESP_LOGE(TAG, "unsupported window size 2^%d", hdr->window_bits);
+            return ESP_ERR_INVALID_VERSION;
+        }
+        dec->window_size = 1 << hdr->window_bits;
+        dec->window = malloc(dec->window_size);
+        if (dec->window == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ESP_LOGD(TAG, "patch: flags 0x%x, image size %u, window %u", hdr->flags, (unsigned)hdr->image_size, (unsigned)dec->window_size);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_decoder_new(const esp_ota_decoder_cfg_t *cfg, esp_ota_decoder_handle_t *out_handle)
+{
+    if (cfg == NULL || cfg->write_cb == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_ota_decoder_handle_t dec = calloc(1, sizeof(struct esp_ota_decoder));
+    if (dec == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dec->cfg = *cfg;
+    *out_handle = dec;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_decoder_write(esp_ota_decoder_handle_t dec, const void *data, size_t size)
+{
+    const uint8_t *data_bytes = (const uint8_t *)data;
+
+    if (dec == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dec->err != ESP_OK) {
+        return dec->err;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (dec->state == DECODER_STATE_HEADER && size > 0) {
+        if (dec->header_len == 0 && data_bytes[0] == DECODER_PLAIN_IMAGE_MAGIC) {
+            dec->state = DECODER_STATE_PLAIN;
+        } else {
+            size_t n = MIN(size, sizeof(esp_ota_patch_header_t) - dec->header_len);
+            memcpy((uint8_t *)&dec->header + dec->header_len, data_bytes, n);
+            dec->header_len += n;
+            data_bytes += n;
+            size -= n;
+            if (dec->header_len == sizeof(esp_ota_patch_header_t)) {
+                ret = decoder_check_header(dec);
+                dec->state = DECODER_STATE_PAYLOAD;
+            }
+        }
+    }
+
+    if (ret == ESP_OK && size > 0) {
+        if (dec->state == DECODER_STATE_PLAIN) {
+            ret = decoder_emit(dec, data_bytes, size);
+        } else if (dec->header.flags & ESP_OTA_PATCH_FLAG_COMPRESSED) {
+            ret = lz_feed(dec, data_bytes, size);
+        } else {
+            ret = payload_out(dec, data_bytes, size);
+        }
+    }
+    dec->err = ret;
+    return ret;
+}
+
+esp_err_t esp_ota_decoder_finish(esp_ota_decoder_handle_t dec)
+{
+    if (dec == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dec->err != ESP_OK) {
+        return dec->err;
+    }
+    if (dec->state == DECODER_STATE_PLAIN) {
+        return ESP_OK;
+    }
+    if (dec->state == DECODER_STATE_HEADER ||
+            ((dec->header.flags & ESP_OTA_PATCH_FLAG_COMPRESSED) && dec->lz_state != LZ_STATE_TOKEN) ||
+            ((dec->header.flags & ESP_OTA_PATCH_FLAG_DELTA) && dec->delta_state != DELTA_STATE_OP)) {
+        ESP_LOGE(TAG, "input is truncated");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (dec->written != dec->header.image_size) {
+        ESP_LOGE(TAG, "decoded %u bytes, expected %u", (unsigned)dec->written, (unsigned)dec->header.image_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+size_t esp_ota_decoder_get_image_size(esp_ota_decoder_handle_t dec)
+{
+    if (dec == NULL || dec->state != DECODER_STATE_PAYLOAD) {
+        return 0;
+    }
+    return dec->header.image_size;
+}
+
+size_t esp_ota_decoder_get_written_size(esp_ota_decoder_handle_t dec)
+{
+    return dec ? dec->written : 0;
+}
+
+void esp_ota_decoder_delete(esp_ota_decoder_handle_t dec)
+{
+    if (dec == NULL) {
+        return;
+    }
+    free(dec->window);
+    free(dec);
+}
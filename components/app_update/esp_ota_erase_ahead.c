@@ -0,0 +1,229 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_flash_encrypt.h"
+#include "spi_flash_mmap.h"
+#include "sys/param.h"
+#include "sdkconfig.h"
+
+#include "esp_ota_erase_ahead.h"
+
+#define OTA_ERASE_AHEAD_BUF_NUM     2
+#define OTA_ERASE_AHEAD_BUF_SIZE    SPI_FLASH_SEC_SIZE
+#define OTA_ERASE_AHEAD_NO_BUF      0xFF
+
+/* Block handed over from esp_ota_write() to the worker task; len == 0 stops the worker */
+typedef struct {
+    uint8_t buf_idx;
+    uint32_t offset;
+    uint32_t len;
+} ota_erase_ahead_block_t;
+
+struct ota_erase_ahead {
+    const esp_partition_t *part;
+    uint8_t *buf[OTA_ERASE_AHEAD_BUF_NUM];
+    QueueHandle_t ready_queue;      /* ota_erase_ahead_block_t, filled by the writer */
+    QueueHandle_t free_queue;       /* indexes of buffers which can be filled */
+    SemaphoreHandle_t done_sem;
+    TaskHandle_t task;
+    /* Writer side */
+    uint8_t fill_idx;
+    uint32_t fill_len;
+    uint32_t queued_size;
+    /* Worker side */
+    uint32_t erased_end;
+    uint32_t written_end;
+    volatile bool discard;
+    volatile esp_err_t err;
+};
+
+static const char *TAG = "esp_ota_erase_ahead";
+
+static void ota_erase_ahead_task(void *arg)
+{
+    ota_erase_ahead_t *ctx = (ota_erase_ahead_t *)arg;
+    const uint32_t part_size = ctx->part->size & ~(SPI_FLASH_SEC_SIZE - 1);
+    ota_erase_ahead_block_t block;
+
+    for (;;) {
+        /* While no data is pending, keep a few sectors erased ahead of the write pointer */
+        const uint32_t erase_limit = MIN(part_size, ctx->written_end + CONFIG_APP_UPDATE_ERASE_AHEAD_SECTORS * SPI_FLASH_SEC_SIZE);
+        const bool can_erase = (ctx->err == ESP_OK && !ctx->discard && ctx->erased_end < erase_limit);
+
+        if (xQueueReceive(ctx->ready_queue, &block, can_erase ? 0 : portMAX_DELAY) != pdTRUE) {
+            esp_err_t err = esp_partition_erase_range(ctx->part, ctx->erased_end, SPI_FLASH_SEC_SIZE);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "erase at 0x%x failed (0x%x)", (unsigned)ctx->erased_end, err);
+                ctx->err = err;
+            } else {
+                ctx->erased_end += SPI_FLASH_SEC_SIZE;
+            }
+            continue;
+        }
+
+        if (block.len == 0) {
+            break;
+        }
+
+        if (ctx->err == ESP_OK && !ctx->discard) {
+            esp_err_t err = ESP_OK;
+            const uint32_t end = block.offset + block.len;
+            if (ctx->erased_end < end) {
+                const uint32_t aligned_end = (end + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+                err = esp_partition_erase_range(ctx->part, ctx->erased_end, aligned_end - ctx->erased_end);
+                if (err == ESP_OK) {
+                    ctx->erased_end = aligned_end;
+                }
+            }
+            if (err == ESP_OK) {
+                err = esp_partition_write(ctx->part, block.offset, ctx->buf[block.buf_idx], block.len);
+            }
+            if (err == ESP_OK) {
+                ctx->written_end = end;
+            } else {
+                ESP_LOGE(TAG, "writing block at 0x%x failed (0x%x)", (unsigned)block.offset, err);
+                ctx->err = err;
+            }
+        }
+        xQueueSend(ctx->free_queue, &block.buf_idx, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(ctx->done_sem);
+    vTaskDelete(NULL);
+}
+
+static void ota_erase_ahead_free(ota_erase_ahead_t *ctx)
+{
+    if (ctx->ready_queue) {
+        vQueueDelete(ctx->ready_queue);
+    }
+    if (ctx->free_queue) {
+        vQueueDelete(ctx->free_queue);
+    }
+    if (ctx->done_sem) {
+        vSemaphoreDelete(ctx->done_sem);
+    }
+    for (int i = 0; i < OTA_ERASE_AHEAD_BUF_NUM; i++) {
+        free(ctx->buf[i]);
+    }
+    free(ctx);
+}
+
+esp_err_t ota_erase_ahead_start(const esp_partition_t *partition, ota_erase_ahead_t **out_ctx)
+{
+    ota_erase_ahead_t *ctx = calloc(1, sizeof(ota_erase_ahead_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->part = partition;
+    ctx->fill_idx = OTA_ERASE_AHEAD_NO_BUF;
+    ctx->err = ESP_OK;
+
+    ctx->ready_queue = xQueueCreate(OTA_ERASE_AHEAD_BUF_NUM + 1, sizeof(ota_erase_ahead_block_t));
+    ctx->free_queue = xQueueCreate(OTA_ERASE_AHEAD_BUF_NUM, sizeof(uint8_t));
+    ctx->done_sem = xSemaphoreCreateBinary();
+    if (ctx->ready_queue == NULL || ctx->free_queue == NULL || ctx->done_sem == NULL) {
+        goto err_no_mem;
+    }
+    for (uint8_t i = 0; i < OTA_ERASE_AHEAD_BUF_NUM; i++) {
+        /* Word aligned allocation so that the buffers can be written directly with flash encryption */
+        ctx->buf[i] = heap_caps_malloc(OTA_ERASE_AHEAD_BUF_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (ctx->buf[i] == NULL) {
+            goto err_no_mem;
+        }
+        xQueueSend(ctx->free_queue, &i, 0);
+    }
+
+    if (xTaskCreate(ota_erase_ahead_task, "ota_erase", CONFIG_APP_UPDATE_ERASE_AHEAD_TASK_STACK_SIZE,
+                    ctx, CONFIG_APP_UPDATE_ERASE_AHEAD_TASK_PRIORITY, &ctx->task) != pdPASS) {
+        goto err_no_mem;
+    }
+    *out_ctx = ctx;
+    return ESP_OK;
+
+err_no_mem:
+    ota_erase_ahead_free(ctx);
+    return ESP_ERR_NO_MEM;
+}
+
+static void ota_erase_ahead_submit(ota_erase_ahead_t *ctx)
+{
+    ota_erase_ahead_block_t block = {
+        .buf_idx = ctx->fill_idx,
+        .offset = ctx->queued_size,
+        .len = ctx->fill_len,
+    };
+    xQueueSend(ctx->ready_queue, &block, portMAX_DELAY);
+    ctx->queued_size += ctx->fill_len;
+    ctx->fill_idx = OTA_ERASE_AHEAD_NO_BUF;
+    ctx->fill_len = 0;
+}
+
+esp_err_t ota_erase_ahead_write(ota_erase_ahead_t *ctx, const void *data, size_t size)
+{
+    const uint8_t *data_bytes = (const uint8_t *)data;
+
+    if (ctx->err != ESP_OK) {
+        return ctx->err;
+    }
+    if (ctx->queued_size + ctx->fill_len + size > ctx->part->size) {
+        ESP_LOGE(TAG, "image does not fit into the partition");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    while (size > 0) {
+        if (ctx->fill_idx == OTA_ERASE_AHEAD_NO_BUF) {
+            /* Blocks only if the worker still holds all buffers */
+            xQueueReceive(ctx->free_queue, &ctx->fill_idx, portMAX_DELAY);
+            ctx->fill_len = 0;
+        }
+        size_t copy_len = MIN(OTA_ERASE_AHEAD_BUF_SIZE - ctx->fill_len, size);
+        memcpy(ctx->buf[ctx->fill_idx] + ctx->fill_len, data_bytes, copy_len);
+        ctx->fill_len += copy_len;
+        data_bytes += copy_len;
+        size -= copy_len;
+        if (ctx->fill_len == OTA_ERASE_AHEAD_BUF_SIZE) {
+            ota_erase_ahead_submit(ctx);
+        }
+    }
+    return ctx->err;
+}
+
+esp_err_t ota_erase_ahead_stop(ota_erase_ahead_t *ctx, bool flush, uint32_t *out_written)
+{
+    if (flush && ctx->fill_len > 0 && ctx->err == ESP_OK) {
+        if (esp_flash_encryption_enabled()) {
+            /* Can only write 16 byte blocks to flash, pad the tail the same way esp_ota_end() does */
+            uint32_t padded_len = (ctx->fill_len + 15) & ~15;
+            memset(ctx->buf[ctx->fill_idx] + ctx->fill_len, 0xFF, padded_len - ctx->fill_len);
+            ctx->fill_len = padded_len;
+        }
+        ota_erase_ahead_submit(ctx);
+    }
+    ctx->discard = !flush;
+
+    const ota_erase_ahead_block_t stop = { 0 };
+    xQueueSend(ctx->ready_queue, &stop, portMAX_DELAY);
+    xSemaphoreTake(ctx->done_sem, portMAX_DELAY);
+
+    esp_err_t ret = ctx->err;
+    if (out_written) {
+        *out_written = ctx->written_end;
+    }
+    ota_erase_ahead_free(ctx);
+    return ret;
+}
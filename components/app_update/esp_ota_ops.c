@@ -30,6 +30,9 @@
 #include "esp_attr.h"
 #include "esp_bootloader_desc.h"
 #include "esp_flash.h"
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+#include "esp_ota_erase_ahead.h"
+#endif
 
 #if CONFIG_IDF_TARGET_ESP32
 #include "esp32/rom/secure_boot.h"
@@ -57,6 +60,12 @@ typedef struct ota_ops_entry_ {
     uint32_t wrote_size;
     uint8_t partial_bytes;
     WORD_ALIGNED_ATTR uint8_t partial_data[16];
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+    ota_erase_ahead_t *erase_ahead;
+#endif
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+    esp_image_verify_stream_handle_t verify_stream;
+#endif
     LIST_ENTRY(ota_ops_entry_) entries;
 } ota_ops_entry_t;
 
@@ -177,6 +186,31 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
         return ESP_ERR_NO_MEM;
     }
 
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+    const esp_partition_pos_t part_pos = {
+        .offset = partition->address,
+        .size = partition->size,
+    };
+    ret = esp_image_verify_stream_begin(ESP_IMAGE_VERIFY, &part_pos, &new_entry->verify_stream);
+    if (ret != ESP_OK) {
+        free(new_entry);
+        return ret;
+    }
+#endif
+
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+    if (image_size == OTA_WITH_SEQUENTIAL_WRITES) {
+        ret = ota_erase_ahead_start(partition, &new_entry->erase_ahead);
+        if (ret != ESP_OK) {
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+            esp_image_verify_stream_abort(new_entry->verify_stream);
+#endif
+            free(new_entry);
+            return ret;
+        }
+    }
+#endif
+
     LIST_INSERT_HEAD(&s_ota_ops_entries_head, new_entry, entries);
 
     new_entry->part = partition;
@@ -186,9 +220,22 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
     return ESP_OK;
 }
 
+/* Feeds the streaming verification with a chunk once it has been accepted, so that a chunk written again after an
+ * error is hashed only once */
+static void ota_verify_stream_write(ota_ops_entry_t *it, const void *data, size_t size)
+{
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+    if (it->verify_stream != NULL) {
+        /* An invalid image is reported by esp_ota_end(), like without streaming verification */
+        esp_image_verify_stream_write(it->verify_stream, data, size);
+    }
+#endif
+}
+
 esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
 {
     const uint8_t *data_bytes = (const uint8_t *)data;
+    const size_t data_size = size;
     esp_err_t ret;
     ota_ops_entry_t *it;
 
@@ -200,6 +247,21 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
     // find ota handle in linked list
     for (it = LIST_FIRST(&s_ota_ops_entries_head); it != NULL; it = LIST_NEXT(it, entries)) {
         if (it->handle == handle) {
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+            if (it->erase_ahead != NULL) {
+                if (it->wrote_size == 0 && size > 0 && data_bytes[0] != ESP_IMAGE_HEADER_MAGIC) {
+                    ESP_LOGE(TAG, "OTA image has invalid magic byte (expected 0xE9, saw 0x%02x)", data_bytes[0]);
+                    return ESP_ERR_OTA_VALIDATE_FAILED;
+                }
+                /* Erasing and writing is done by the background task, data is only copied here */
+                ret = ota_erase_ahead_write(it->erase_ahead, data_bytes, size);
+                if (ret == ESP_OK) {
+                    it->wrote_size += size;
+                    ota_verify_stream_write(it, data, data_size);
+                }
+                return ret;
+            }
+#endif
             if (it->need_erase) {
                 // must erase the partition before writing to it
                 uint32_t first_sector = it->wrote_size / SPI_FLASH_SEC_SIZE;
@@ -231,6 +293,7 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
                     memcpy(it->partial_data + it->partial_bytes, data_bytes, copy_len);
                     it->partial_bytes += copy_len;
                     if (it->partial_bytes != 16) {
+                        ota_verify_stream_write(it, data, data_size);
                         return ESP_OK; /* nothing to write yet, just filling buffer */
                     }
                     /* write 16 byte to partition */
@@ -256,6 +319,7 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
             ret = esp_partition_write(it->part, it->wrote_size, data_bytes, size);
             if(ret == ESP_OK){
                 it->wrote_size += size;
+                ota_verify_stream_write(it, data, data_size);
             }
             return ret;
         }
@@ -290,6 +354,11 @@ esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void *data, s
                 ESP_LOGE(TAG, "Size should be 16byte aligned for flash encryption case");
                 return ESP_ERR_INVALID_ARG;
             }
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+            /* Data may arrive out of order, esp_ota_end() has to read the image back */
+            esp_image_verify_stream_abort(it->verify_stream);
+            it->verify_stream = NULL;
+#endif
             ret = esp_partition_write(it->part, offset, data_bytes, size);
             if (ret == ESP_OK) {
                 it->wrote_size += size;
@@ -321,6 +390,14 @@ esp_err_t esp_ota_abort(esp_ota_handle_t handle)
     if (it == NULL) {
         return ESP_ERR_NOT_FOUND;
     }
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+    if (it->erase_ahead != NULL) {
+        ota_erase_ahead_stop(it->erase_ahead, false, NULL);
+    }
+#endif
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+    esp_image_verify_stream_abort(it->verify_stream);
+#endif
     LIST_REMOVE(it, entries);
     free(it);
     return ESP_OK;
@@ -343,6 +420,17 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
         goto cleanup;
     }
 
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+    if (it->erase_ahead != NULL) {
+        /* Wait until the background task has written all queued data */
+        ret = ota_erase_ahead_stop(it->erase_ahead, true, NULL);
+        it->erase_ahead = NULL;
+        if (ret != ESP_OK) {
+            goto cleanup;
+        }
+    }
+#endif
+
     if (it->partial_bytes > 0) {
         /* Write out last 16 bytes, if necessary */
         ret = esp_partition_write(it->part, it->wrote_size, it->partial_data, 16);
@@ -355,6 +443,17 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
     }
 
     esp_image_metadata_t data;
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+    if (it->verify_stream != NULL) {
+        /* Checksum and digest were calculated by esp_ota_write(), only the digest and signature are left to check */
+        esp_err_t verify_err = esp_image_verify_stream_end(it->verify_stream, &data);
+        it->verify_stream = NULL;
+        if (verify_err != ESP_OK) {
+            ret = ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+        goto cleanup;
+    }
+#endif
     const esp_partition_pos_t part_pos = {
       .offset = it->part->address,
       .size = it->part->size,
@@ -366,6 +465,14 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
     }
 
  cleanup:
+#if CONFIG_APP_UPDATE_ERASE_AHEAD
+    if (it->erase_ahead != NULL) {
+        ota_erase_ahead_stop(it->erase_ahead, false, NULL);
+    }
+#endif
+#if CONFIG_APP_UPDATE_STREAMING_VERIFY
+    esp_image_verify_stream_abort(it->verify_stream);
+#endif
     LIST_REMOVE(it, entries);
     free(it);
     return ret;
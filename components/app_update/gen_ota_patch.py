@@ -0,0 +1,369 @@
+#!/usr/bin/env python
+#
+# gen_ota_patch is used to generate compressed OTA images and delta patches
+# which are applied on the device by the esp_ota_decoder API
+#
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+from __future__ import division, print_function
+
+import argparse
+import hashlib
+import struct
+import sys
+from typing import Dict, List, Optional, Tuple
+
+__version__ = '1.0'
+
+PATCH_MAGIC = 0x50544F45
+PATCH_VERSION = 1
+PATCH_HEADER_FMT = '<IBBBBII32s'
+
+FLAG_COMPRESSED = 1 << 0
+FLAG_DELTA = 1 << 1
+
+WINDOW_BITS_MIN = 8
+WINDOW_BITS_MAX = 15
+
+OP_COPY = 1
+OP_ADD = 2
+OP_INSERT = 3
+
+LZ_MATCH_FLAG = 0x80
+LZ_MIN_MATCH = 3
+LZ_MAX_MATCH = 0x7F + LZ_MIN_MATCH
+LZ_MAX_LITERALS = 0x80
+LZ_MAX_CHAIN = 16
+
+DELTA_KEY_LEN = 8
+DELTA_MIN_COPY = 16
+
+IMAGE_HEADER_MAGIC = 0xE9
+IMAGE_HEADER_LEN = 24
+SEGMENT_HEADER_LEN = 8
+HASH_LEN = 32
+
+quiet = False
+
+
+def status(msg: str) -> None:
+    if not quiet:
+        print(msg)
+
+
+class InputError(RuntimeError):
+    def __init__(self, e: str) -> None:
+        super(InputError, self).__init__(e)
+
+
+def image_sha256(image: bytes) -> bytes:
+    """ SHA-256 of an app image, the same value esp_partition_get_sha256() returns for the partition holding it """
+    try:
+        if image[0] != IMAGE_HEADER_MAGIC:
+            raise ValueError()
+        segments = image[1]
+        hash_appended = image[23] == 1
+        pos = IMAGE_HEADER_LEN
+        for _ in range(segments):
+            _, seg_len = struct.unpack_from('<II', image, pos)
+            pos += SEGMENT_HEADER_LEN + seg_len
+        pos += 16 - (pos % 16)  # checksum byte and padding
+        if hash_appended:
+            pos += HASH_LEN
+        if pos > len(image):
+            raise ValueError()
+    except (ValueError, IndexError, struct.error):
+        status('Warning: source is not an app image, hashing the whole file')
+        return hashlib.sha256(image).digest()
+    if hash_appended:
+        return image[pos - HASH_LEN:pos]
+    return hashlib.sha256(image[:pos]).digest()
+
+
+def encode_varint(value: int) -> bytearray:
+    out = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return out
+
+
+def match_length(a: bytes, a_pos: int, b: bytes, b_pos: int, limit: int) -> int:
+    length = 0
+    while length + 64 <= limit and a[a_pos + length:a_pos + length + 64] == b[b_pos + length:b_pos + length + 64]:
+        length += 64
+    while length < limit and a[a_pos + length] == b[b_pos + length]:
+        length += 1
+    return length
+
+
+def lz_compress(data: bytes, window_bits: int) -> bytes:
+    """ Greedy LZ77 with hash chains, see the format description in esp_ota_decoder.h """
+    window = 1 << window_bits
+    out = bytearray()
+    literals = bytearray()
+    heads = {}  # type: Dict[bytes, int]
+    chain = [0] * len(data)  # type: List[int]
+
+    def flush_literals() -> None:
+        for i in range(0, len(literals), LZ_MAX_LITERALS):
+            run = literals[i:i + LZ_MAX_LITERALS]
+            out.append(len(run) - 1)
+            out.extend(run)
+        del literals[:]
+
+    def insert(p: int) -> None:
+        key = bytes(data[p:p + LZ_MIN_MATCH])
+        chain[p] = heads.get(key, -1)
+        heads[key] = p
+
+    pos = 0
+    n = len(data)
+    while pos < n:
+        best_len = 0
+        best_dist = 0
+        if pos + LZ_MIN_MATCH <= n:
+            cand = heads.get(bytes(data[pos:pos + LZ_MIN_MATCH]), -1)
+            depth = 0
+            while cand >= 0 and pos - cand <= window and depth < LZ_MAX_CHAIN:
+                length = match_length(data, cand, data, pos, min(LZ_MAX_MATCH, n - pos))
+                if length > best_len:
+                    best_len, best_dist = length, pos - cand
+                    if length == LZ_MAX_MATCH:
+                        break
+                cand = chain[cand]
+                depth += 1
+        if best_len >= LZ_MIN_MATCH:
+            flush_literals()
+            out.append(LZ_MATCH_FLAG | (best_len - LZ_MIN_MATCH))
+            out.extend(struct.pack('<H', best_dist))
+            for p in range(pos, pos + best_len):
+                if p + LZ_MIN_MATCH <= n:
+                    insert(p)
+            pos += best_len
+        else:
+            literals.append(data[pos])
+            if pos + LZ_MIN_MATCH <= n:
+                insert(pos)
+            pos += 1
+    flush_literals()
+    return bytes(out)
+
+
+def lz_decompress(data: bytes, window_bits: int) -> bytes:
+    out = bytearray()
+    window = 1 << window_bits
+    pos = 0
+    while pos < len(data):
+        token = data[pos]
+        pos += 1
+        if token & LZ_MATCH_FLAG:
+            length = (token & ~LZ_MATCH_FLAG) + LZ_MIN_MATCH
+            dist, = struct.unpack_from('<H', data, pos)
+            pos += 2
+            if dist == 0 or dist > window or dist > len(out):
+                raise InputError('Invalid match distance %d' % dist)
+            for _ in range(length):
+                out.append(out[-dist])
+        else:
+            out.extend(data[pos:pos + token + 1])
+            pos += token + 1
+    return bytes(out)
+
+
+def delta_encode(base: bytes, new: bytes) -> bytes:
+    """ Greedy delta: exact matches become COPY, gaps become ADD against the source at the last match offset, or INSERT """
+    index = {}  # type: Dict[bytes, int]
+    for p in range(len(base) - DELTA_KEY_LEN + 1):
+        index.setdefault(base[p:p + DELTA_KEY_LEN], p)
+
+    out = bytearray()
+    last_shift = 0
+    gap_start = 0
+
+    def emit_gap(start: int, end: int) -> None:
+        if start >= end:
+            return
+        src = start + last_shift
+        if 0 <= src and src + (end - start) <= len(base):
+            diff = bytes((new[start + i] - base[src + i]) & 0xFF for i in range(end - start))
+            if diff.count(0) * 2 >= len(diff):
+                out.append(OP_ADD)
+                out.extend(encode_varint(src))
+                out.extend(encode_varint(end - start))
+                out.extend(diff)
+                return
+        out.append(OP_INSERT)
+        out.extend(encode_varint(end - start))
+        out.extend(new[start:end])
+
+    pos = 0
+    n = len(new)
+    while pos + DELTA_KEY_LEN <= n:
+        # Prefer continuing at the offset of the previous match, code shifted by the same amount is common
+        src = pos + last_shift
+        if not (0 <= src and src + DELTA_KEY_LEN <= len(base) and base[src:src + DELTA_KEY_LEN] == new[pos:pos + DELTA_KEY_LEN]):
+            src = index.get(new[pos:pos + DELTA_KEY_LEN], -1)
+        if src >= 0:
+            length = match_length(base, src, new, pos, min(len(base) - src, n - pos))
+            if length >= DELTA_MIN_COPY:
+                emit_gap(gap_start, pos)
+                out.append(OP_COPY)
+                out.extend(encode_varint(src))
+                out.extend(encode_varint(length))
+                last_shift = src - pos
+                pos += length
+                gap_start = pos
+                continue
+        pos += 1
+    emit_gap(gap_start, n)
+    return bytes(out)
+
+
+def decode_varint(data: bytes, pos: int) -> Tuple[int, int]:
+    value = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def delta_decode(base: bytes, delta: bytes) -> bytes:
+    out = bytearray()
+    pos = 0
+    while pos < len(delta):
+        op = delta[pos]
+        pos += 1
+        if op == OP_INSERT:
+            length, pos = decode_varint(delta, pos)
+            out.extend(delta[pos:pos + length])
+            pos += length
+        elif op in (OP_COPY, OP_ADD):
+            src, pos = decode_varint(delta, pos)
+            length, pos = decode_varint(delta, pos)
+            if src + length > len(base):
+                raise InputError('Source range out of bounds')
+            if op == OP_COPY:
+                out.extend(base[src:src + length])
+            else:
+                out.extend((base[src + i] + delta[pos + i]) & 0xFF for i in range(length))
+                pos += length
+        else:
+            raise InputError('Unknown opcode 0x%02x' % op)
+    return bytes(out)
+
+
+def generate_patch(new: bytes, base: Optional[bytes] = None, window_bits: int = 12) -> bytes:
+    flags = 0
+    payload = new
+    src_size = 0
+    src_sha256 = bytes(HASH_LEN)
+    if base is not None:
+        flags |= FLAG_DELTA
+        payload = delta_encode(base, new)
+        src_size = len(base)
+        src_sha256 = image_sha256(base)
+    if window_bits:
+        if not WINDOW_BITS_MIN <= window_bits <= WINDOW_BITS_MAX:
+            raise InputError('Window bits must be in range %d..%d' % (WINDOW_BITS_MIN, WINDOW_BITS_MAX))
+        flags |= FLAG_COMPRESSED
+        payload = lz_compress(payload, window_bits)
+    header = struct.pack(PATCH_HEADER_FMT, PATCH_MAGIC, PATCH_VERSION, flags, window_bits if window_bits else 0, 0,
+                         len(new), src_size, src_sha256)
+    return header + payload
+
+
+def apply_patch(patch: bytes, base: Optional[bytes] = None) -> bytes:
+    header_len = struct.calcsize(PATCH_HEADER_FMT)
+    magic, version, flags, window_bits, _, image_size, src_size, src_sha256 = struct.unpack_from(PATCH_HEADER_FMT, patch)
+    if magic != PATCH_MAGIC or version != PATCH_VERSION:
+        raise InputError('Not an OTA patch')
+    payload = patch[header_len:]
+    if flags & FLAG_COMPRESSED:
+        payload = lz_decompress(payload, window_bits)
+    if flags & FLAG_DELTA:
+        if base is None:
+            raise InputError('Patch is a delta, --base is required')
+        if len(base) != src_size or image_sha256(base) != src_sha256:
+            raise InputError('Patch was made for a different source image')
+        payload = delta_decode(base, payload)
+    if len(payload) != image_size:
+        raise InputError('Decoded %d bytes, expected %d' % (len(payload), image_size))
+    return payload
+
+
+def read_file(path: str) -> bytes:
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write_file(path: str, data: bytes) -> None:
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def main() -> int:
+    global quiet
+
+    parser = argparse.ArgumentParser(description='ESP-IDF compressed OTA image and delta patch generator')
+    parser.add_argument('--quiet', '-q', help='suppress stderr messages', action='store_true')
+
+    subparsers = parser.add_subparsers(dest='operation', help='run gen_ota_patch -h for additional help')
+
+    window_help = 'LZ window size as power of two (%d..%d), 0 disables compression' % (WINDOW_BITS_MIN, WINDOW_BITS_MAX)
+
+    compress_parser = subparsers.add_parser('compress', help='compress an app image')
+    compress_parser.add_argument('image', help='new app image (.bin)')
+    compress_parser.add_argument('--window-bits', '-w', help=window_help, type=int, default=12)
+    compress_parser.add_argument('--output', '-o', help='output file', required=True)
+
+    delta_parser = subparsers.add_parser('delta', help='generate a delta patch against the image currently on the device')
+    delta_parser.add_argument('base', help='app image (.bin) running on the device')
+    delta_parser.add_argument('image', help='new app image (.bin)')
+    delta_parser.add_argument('--window-bits', '-w', help=window_help, type=int, default=12)
+    delta_parser.add_argument('--output', '-o', help='output file', required=True)
+
+    apply_parser = subparsers.add_parser('apply', help='reconstruct the image from a compressed image or delta patch')
+    apply_parser.add_argument('patch', help='compressed image or delta patch')
+    apply_parser.add_argument('--base', help='app image the delta patch was generated against')
+    apply_parser.add_argument('--output', '-o', help='output file', required=True)
+
+    args = parser.parse_args()
+    quiet = args.quiet
+
+    if args.operation is None:
+        parser.print_help()
+        return 1
+
+    if args.operation == 'apply':
+        base = read_file(args.base) if args.base else None
+        image = apply_patch(read_file(args.patch), base)
+        write_file(args.output, image)
+        status('Reconstructed image: %d bytes' % len(image))
+        return 0
+
+    new = read_file(args.image)
+    base = read_file(args.base) if args.operation == 'delta' else None
+    patch = generate_patch(new, base, args.window_bits)
+    if apply_patch(patch, base) != new:
+        raise InputError('Internal error: patch does not reproduce the image')
+    write_file(args.output, patch)
+    status('Image: %d bytes, patch: %d bytes (%.1f%%)' % (len(new), len(patch), 100.0 * len(patch) / len(new)))
+    return 0
+
+
+if __name__ == '__main__':
+    try:
+        r = main()
+        sys.exit(r)
+    except InputError as e:
+        print(e, file=sys.stderr)
+        sys.exit(2)
@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+#
+# Generates a source and a new app image for the OTA decoder host test. The new image is derived
+# from the source the way a rebuilt firmware typically differs: inserted and removed code,
+# and scattered small changes (e.g. shifted addresses). Both are laid out like the app images
+# produced by esptool (segments, checksum and appended SHA-256), so that they can be verified.
+#
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+import argparse
+import hashlib
+import os
+import random
+import struct
+from typing import List, Tuple
+
+IMAGE_HEADER_MAGIC = 0xE9
+CHECKSUM_SEED = 0xEF
+
+
+def make_image(segments: List[Tuple[int, bytes]]) -> bytes:
+    # esp_image_header_t with hash_appended set, see esp_app_format.h
+    image = bytearray(struct.pack('<BBBBIB3sHBHH4sB', IMAGE_HEADER_MAGIC, len(segments), 2, 0x20, 0x40080000,
+                                  0xEE, bytes(3), 0, 0, 0, 0, bytes(4), 1))
+    checksum = CHECKSUM_SEED
+    for load_addr, data in segments:
+        image += struct.pack('<II', load_addr, len(data))
+        image += data
+        for b in data:
+            checksum ^= b
+    # The checksum byte ends a 16 byte block
+    image += bytes(15 - len(image) % 16)
+    image.append(checksum)
+    image += hashlib.sha256(image).digest()
+    return bytes(image)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Generates images for the OTA decoder host test')
+    parser.add_argument('output_dir', help='Directory for base.bin and new.bin')
+    args = parser.parse_args()
+
+    rnd = random.Random(0x0EA)
+    # Compressible but non-trivial content: random "instructions" drawn from a small vocabulary
+    words = [bytes(rnd.randrange(256) for _ in range(4)) for _ in range(512)]
+
+    def code(size: int) -> bytearray:
+        return bytearray(b''.join(rnd.choice(words) for _ in range(size // 4)))
+
+    base = [(0x3F400020, code(40 * 1024)), (0x3FFB0000, code(8 * 1024)), (0x400D0020, code(152 * 1024))]
+
+    new = [(addr, bytearray(data)) for addr, data in base]
+    new[0][1][4000:4000] = bytes(rnd.randrange(256) for _ in range(1500))
+    del new[2][1][80000:82000]
+    for _ in range(300):
+        data = rnd.choice(new)[1]
+        pos = rnd.randrange(len(data))
+        data[pos] = (data[pos] + 4) & 0xFF
+
+    with open(os.path.join(args.output_dir, 'base.bin'), 'wb') as f:
+        f.write(make_image(base))
+    with open(os.path.join(args.output_dir, 'new.bin'), 'wb') as f:
+        f.write(make_image(new))
+
+
+if __name__ == '__main__':
+    main()
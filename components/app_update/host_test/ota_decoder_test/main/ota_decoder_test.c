@@ -0,0 +1,238 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Linux host OTA decoder test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_private/partition_linux.h"
+#include "esp_ota_decoder.h"
+#include "esp_image_format.h"
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define TEST_DATA_DIR BUILD_DIR "/ota_decoder_test_data/"
+#define TEST_CHUNK_SIZE 1000
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} test_file_t;
+
+static const esp_partition_t *s_factory;
+static const esp_partition_t *s_ota_0;
+static test_file_t s_base;
+static test_file_t s_new;
+
+static void load_file(const char *name, test_file_t *file)
+{
+    char path[256];
+    snprintf(path, sizeof(path), TEST_DATA_DIR "%s", name);
+    FILE *f = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL_MESSAGE(f, path);
+    fseek(f, 0, SEEK_END);
+    file->size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    file->data = malloc(file->size);
+    TEST_ASSERT_NOT_NULL(file->data);
+    TEST_ASSERT_EQUAL(file->size, fread(file->data, 1, file->size, f));
+    fclose(f);
+}
+
+static void free_file(test_file_t *file)
+{
+    free(file->data);
+    file->data = NULL;
+}
+
+static esp_err_t write_to_ota_0(void *arg, const void *data, size_t size)
+{
+    size_t *offset = (size_t *)arg;
+    esp_err_t ret = esp_partition_write(s_ota_0, *offset, data, size);
+    *offset += size;
+    return ret;
+}
+
+/* Feeds the file in fixed size chunks like a download would and returns the result of esp_ota_decoder_finish() */
+static esp_err_t decode_file(const test_file_t *file, size_t file_size, const esp_partition_t *src, size_t *out_written)
+{
+    size_t offset = 0;
+    esp_ota_decoder_cfg_t cfg = {
+        .write_cb = write_to_ota_0,
+        .write_cb_arg = &offset,
+        .src_partition = src,
+    };
+    esp_ota_decoder_handle_t decoder;
+    TEST_ESP_OK(esp_ota_decoder_new(&cfg, &decoder));
+    TEST_ESP_OK(esp_partition_erase_range(s_ota_0, 0, s_ota_0->size));
+
+    esp_err_t ret = ESP_OK;
+    for (size_t pos = 0; pos < file_size && ret == ESP_OK; pos += TEST_CHUNK_SIZE) {
+        size_t len = file_size - pos < TEST_CHUNK_SIZE ? file_size - pos : TEST_CHUNK_SIZE;
+        ret = esp_ota_decoder_write(decoder, file->data + pos, len);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_ota_decoder_finish(decoder);
+    }
+    *out_written = esp_ota_decoder_get_written_size(decoder);
+    esp_ota_decoder_delete(decoder);
+    return ret;
+}
+
+static void check_ota_0_holds_new_image(void)
+{
+    uint8_t *buf = malloc(s_new.size);
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ESP_OK(esp_partition_read(s_ota_0, 0, buf, s_new.size));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(s_new.data, buf, s_new.size);
+    free(buf);
+
+    /* The reconstructed image passes the same checks as with esp_ota_end() */
+    uint8_t sha256[ESP_IMAGE_HASH_LEN];
+    TEST_ESP_OK(esp_partition_get_sha256(s_ota_0, sha256));
+}
+
+static void apply_and_report(const char *name, const esp_partition_t *src)
+{
+    test_file_t patch;
+    size_t written;
+    load_file(name, &patch);
+
+    esp_partition_clear_stats();
+    TEST_ESP_OK(decode_file(&patch, patch.size, src, &written));
+    printf("%s: %u -> %u bytes, flash: %u reads (%u bytes), %u writes, est. %u ms\n", name,
+           (unsigned)patch.size, (unsigned)written,
+           (unsigned)esp_partition_get_read_ops(), (unsigned)esp_partition_get_read_bytes(),
+           (unsigned)esp_partition_get_write_ops(), (unsigned)esp_partition_get_total_time());
+
+    TEST_ASSERT_EQUAL(s_new.size, written);
+    check_ota_0_holds_new_image();
+    free_file(&patch);
+}
+
+TEST_GROUP(ota_decoder);
+
+TEST_SETUP(ota_decoder)
+{
+    s_factory = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
+    s_ota_0 = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, NULL);
+    TEST_ASSERT_NOT_NULL(s_factory);
+    TEST_ASSERT_NOT_NULL(s_ota_0);
+
+    load_file("base.bin", &s_base);
+    load_file("new.bin", &s_new);
+
+    /* The source image plays the role of the running app */
+    TEST_ESP_OK(esp_partition_erase_range(s_factory, 0, s_factory->size));
+    TEST_ESP_OK(esp_partition_write(s_factory, 0, s_base.data, s_base.size));
+}
+
+TEST_TEAR_DOWN(ota_decoder)
+{
+    free_file(&s_base);
+    free_file(&s_new);
+}
+
+TEST(ota_decoder, test_plain_image_passthrough)
+{
+    size_t written;
+    TEST_ESP_OK(decode_file(&s_new, s_new.size, NULL, &written));
+    TEST_ASSERT_EQUAL(s_new.size, written);
+    check_ota_0_holds_new_image();
+}
+
+TEST(ota_decoder, test_compressed_image)
+{
+    apply_and_report("compressed.bin", NULL);
+}
+
+TEST(ota_decoder, test_delta)
+{
+    apply_and_report("delta.bin", s_factory);
+}
+
+TEST(ota_decoder, test_delta_uncompressed)
+{
+    apply_and_report("delta_uncompressed.bin", s_factory);
+}
+
+TEST(ota_decoder, test_delta_without_source)
+{
+    test_file_t patch;
+    size_t written;
+    load_file("delta.bin", &patch);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, decode_file(&patch, patch.size, NULL, &written));
+    TEST_ASSERT_EQUAL(0, written);
+    free_file(&patch);
+}
+
+TEST(ota_decoder, test_delta_wrong_source)
+{
+    test_file_t patch;
+    size_t written;
+    load_file("delta.bin", &patch);
+
+    /* The patch does not apply to a valid image it was not made for, e.g. another build of the app */
+    TEST_ESP_OK(esp_partition_erase_range(s_factory, 0, s_factory->size));
+    TEST_ESP_OK(esp_partition_write(s_factory, 0, s_new.data, s_new.size));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, decode_file(&patch, patch.size, s_factory, &written));
+    TEST_ASSERT_EQUAL(0, written);
+
+    /* Nor to a corrupted source image */
+    s_base.data[s_base.size / 2] ^= 0x01;
+    TEST_ESP_OK(esp_partition_erase_range(s_factory, 0, s_factory->size));
+    TEST_ESP_OK(esp_partition_write(s_factory, 0, s_base.data, s_base.size));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, decode_file(&patch, patch.size, s_factory, &written));
+    TEST_ASSERT_EQUAL(0, written);
+    free_file(&patch);
+}
+
+TEST(ota_decoder, test_truncated_input)
+{
+    test_file_t patch;
+    size_t written;
+    load_file("compressed.bin", &patch);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, decode_file(&patch, patch.size / 2, NULL, &written));
+    TEST_ASSERT_LESS_THAN(s_new.size, written);
+    free_file(&patch);
+}
+
+TEST(ota_decoder, test_corrupted_input)
+{
+    test_file_t patch;
+    size_t written;
+    load_file("delta_uncompressed.bin", &patch);
+    /* First opcode after the header */
+    patch.data[sizeof(esp_ota_patch_header_t)] = 0x7F;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, decode_file(&patch, patch.size, s_factory, &written));
+    free_file(&patch);
+}
+
+TEST_GROUP_RUNNER(ota_decoder)
+{
+    RUN_TEST_CASE(ota_decoder, test_plain_image_passthrough);
+    RUN_TEST_CASE(ota_decoder, test_compressed_image);
+    RUN_TEST_CASE(ota_decoder, test_delta);
+    RUN_TEST_CASE(ota_decoder, test_delta_uncompressed);
+    RUN_TEST_CASE(ota_decoder, test_delta_without_source);
+    RUN_TEST_CASE(ota_decoder, test_delta_wrong_source);
+    RUN_TEST_CASE(ota_decoder, test_truncated_input);
+    RUN_TEST_CASE(ota_decoder, test_corrupted_input);
+}
+
+static void run_all_tests(void)
+{
+    RUN_TEST_GROUP(ota_decoder);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_MAIN_FUNC(run_all_tests);
+    return 0;
+}
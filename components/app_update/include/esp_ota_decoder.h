@@ -0,0 +1,170 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file esp_ota_decoder.h
+ *
+ * @brief Streaming decoder for compressed and delta OTA images
+ *
+ * The decoder sits in front of esp_ota_write(). It accepts the downloaded file chunk by chunk
+ * and passes the reconstructed app image to a write callback. Supported inputs:
+ *  - plain app images, passed through unchanged
+ *  - LZ-compressed images
+ *  - delta patches against the image in a source partition (usually the running app),
+ *    optionally LZ-compressed
+ *
+ * Compressed images and patches are produced by components/app_update/gen_ota_patch.py.
+ * RAM usage is bounded by the LZ window size chosen when the patch was generated
+ * (at most 32 KB) plus a small source read buffer.
+ *
+ * The reconstructed image still has to be validated by esp_ota_end().
+ */
+
+#define ESP_OTA_PATCH_MAGIC            0x50544F45  /*!< "EOTP", magic word of a compressed image or delta patch */
+#define ESP_OTA_PATCH_VERSION          1           /*!< Supported version of the patch format */
+
+#define ESP_OTA_PATCH_FLAG_COMPRESSED  (1 << 0)    /*!< Payload is LZ-compressed */
+#define ESP_OTA_PATCH_FLAG_DELTA       (1 << 1)    /*!< (Decompressed) payload is a delta against the source image */
+
+#define ESP_OTA_PATCH_WINDOW_BITS_MIN  8           /*!< Smallest supported LZ window, 256 bytes */
+#define ESP_OTA_PATCH_WINDOW_BITS_MAX  15          /*!< Largest supported LZ window, 32 KB */
+
+/**
+ * @brief Header at the start of a compressed image or delta patch (little endian)
+ */
+typedef struct {
+    uint32_t magic;             /*!< ESP_OTA_PATCH_MAGIC */
+    uint8_t version;            /*!< ESP_OTA_PATCH_VERSION */
+    uint8_t flags;              /*!< ESP_OTA_PATCH_FLAG_x */
+    uint8_t window_bits;        /*!< LZ window size is (1 << window_bits) bytes, only if ESP_OTA_PATCH_FLAG_COMPRESSED */
+    uint8_t reserved;           /*!< Reserved, 0 */
+    uint32_t image_size;        /*!< Size of the reconstructed app image */
+    uint32_t src_size;          /*!< Size of the source image, only if ESP_OTA_PATCH_FLAG_DELTA */
+    uint8_t src_sha256[32];     /*!< SHA-256 of the source image as returned by esp_partition_get_sha256(), only if ESP_OTA_PATCH_FLAG_DELTA */
+} __attribute__((packed)) esp_ota_patch_header_t;
+
+_Static_assert(sizeof(esp_ota_patch_header_t) == 48, "esp_ota_patch_header_t should be 48 bytes");
+
+/**
+ * @brief Delta payload opcodes
+ *
+ * Numbers are encoded as unsigned LEB128 varints.
+ */
+typedef enum {
+    ESP_OTA_PATCH_OP_COPY = 1,      /*!< COPY src_offset len: output len bytes of the source image */
+    ESP_OTA_PATCH_OP_ADD = 2,       /*!< ADD src_offset len diff[len]: output src[i] + diff[i] (modulo 256) */
+    ESP_OTA_PATCH_OP_INSERT = 3,    /*!< INSERT len data[len]: output data */
+} esp_ota_patch_op_t;
+
+/**
+ * @brief Callback receiving the reconstructed image, in order
+ *
+ * @param arg   User argument from esp_ota_decoder_cfg_t
+ * @param data  Image data
+ * @param size  Size of data in bytes
+ *
+ * @return ESP_OK to continue, any other value aborts decoding and is returned by esp_ota_decoder_write()
+ */
+typedef esp_err_t (*esp_ota_decoder_write_cb_t)(void *arg, const void *data, size_t size);
+
+/**
+ * @brief Decoder configuration
+ */
+typedef struct {
+    esp_ota_decoder_write_cb_t write_cb;    /*!< Receives the reconstructed image, e.g. a wrapper around esp_ota_write(). Required. */
+    void *write_cb_arg;                     /*!< Argument passed to write_cb */
+    const esp_partition_t *src_partition;   /*!< Partition holding the base image of delta patches, usually esp_ota_get_running_partition().
+                                                 If NULL, delta patches are rejected. */
+} esp_ota_decoder_cfg_t;
+
+/**
+ * @brief Opaque decoder handle
+ */
+typedef struct esp_ota_decoder *esp_ota_decoder_handle_t;
+
+/**
+ * @brief Create a decoder
+ *
+ * @param cfg Decoder configuration
+ * @param[out] out_handle Created decoder
+ *
+ * @return
+ *    - ESP_OK: Decoder created
+ *    - ESP_ERR_INVALID_ARG: cfg, write_cb or out_handle is NULL
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t esp_ota_decoder_new(const esp_ota_decoder_cfg_t *cfg, esp_ota_decoder_handle_t *out_handle);
+
+/**
+ * @brief Feed the next chunk of the downloaded file
+ *
+ * Chunks may be split at any byte. The decoded output is passed to write_cb before this function returns.
+ * Buffers for the LZ window are allocated when the header has been received.
+ *
+ * @param handle Decoder handle
+ * @param data Input data
+ * @param size Size of input data
+ *
+ * @return
+ *    - ESP_OK: Data consumed
+ *    - ESP_ERR_INVALID_ARG: handle or data is NULL
+ *    - ESP_ERR_INVALID_RESPONSE: Malformed input
+ *    - ESP_ERR_INVALID_VERSION: Unsupported patch format, or the delta patch was made for a different source image
+ *    - ESP_ERR_NO_MEM: Not enough memory for the LZ window
+ *    - Errors returned by write_cb or by esp_partition_read() of the source partition
+ */
+esp_err_t esp_ota_decoder_write(esp_ota_decoder_handle_t handle, const void *data, size_t size);
+
+/**
+ * @brief Check that the complete input was received
+ *
+ * @param handle Decoder handle
+ *
+ * @return
+ *    - ESP_OK: Input ended at a valid position and the image size matches the header
+ *    - ESP_ERR_INVALID_ARG: handle is NULL
+ *    - ESP_ERR_INVALID_SIZE: Input is truncated or the image size does not match the header
+ */
+esp_err_t esp_ota_decoder_finish(esp_ota_decoder_handle_t handle);
+
+/**
+ * @brief Get size of the reconstructed image announced by the header
+ *
+ * @param handle Decoder handle
+ *
+ * @return Image size, or 0 if the header was not received yet or the input is a plain app image
+ */
+size_t esp_ota_decoder_get_image_size(esp_ota_decoder_handle_t handle);
+
+/**
+ * @brief Get number of image bytes passed to write_cb so far
+ *
+ * @param handle Decoder handle
+ *
+ * @return Number of bytes written
+ */
+size_t esp_ota_decoder_get_written_size(esp_ota_decoder_handle_t handle);
+
+/**
+ * @brief Free the decoder
+ *
+ * @param handle Decoder handle, may be NULL
+ */
+void esp_ota_decoder_delete(esp_ota_decoder_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
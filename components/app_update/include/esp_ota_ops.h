@@ -75,6 +75,10 @@ int esp_ota_get_app_elf_sha256(char* dst, size_t size) __attribute__((deprecated
  * If image size is not yet known, pass OTA_SIZE_UNKNOWN which will
  * cause the entire partition to be erased.
  *
+ * If OTA_WITH_SEQUENTIAL_WRITES is passed, sectors are erased as data is written.
+ * With CONFIG_APP_UPDATE_ERASE_AHEAD enabled, erasing and writing is then done by a
+ * background task which is started here.
+ *
  * On success, this function allocates memory that remains in use
  * until esp_ota_end() is called with the returned handle.
  *
@@ -149,12 +153,16 @@ esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void *data, s
  *
  * @note After calling esp_ota_end(), the handle is no longer valid and any memory associated with it is freed (regardless of result).
  *
+ * @note With CONFIG_APP_UPDATE_STREAMING_VERIFY, the checksum and SHA-256 digest are calculated by esp_ota_write()
+ *       and the image is not read back from flash, unless esp_ota_write_with_offset() was used.
+ *
  * @return
  *    - ESP_OK: Newly written OTA app image is valid.
  *    - ESP_ERR_NOT_FOUND: OTA handle was not found.
  *    - ESP_ERR_INVALID_ARG: Handle was never written to.
  *    - ESP_ERR_OTA_VALIDATE_FAILED: OTA image is invalid (either not a valid app image, or - if secure boot is enabled - signature failed to verify.)
  *    - ESP_ERR_INVALID_STATE: If flash encryption is enabled, this result indicates an internal error writing the final encrypted bytes to flash.
+ *    - ESP_ERR_FLASH_OP_TIMEOUT or ESP_ERR_FLASH_OP_FAIL: With CONFIG_APP_UPDATE_ERASE_AHEAD, writing the buffered data to flash failed.
  */
 esp_err_t esp_ota_end(esp_ota_handle_t handle);
 
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Context of the background erase-ahead writer used by esp_ota_write()
+ *
+ * Incoming data is collected into sector-sized buffers. Full buffers are handed over
+ * to a worker task which erases the target sectors (staying a few sectors ahead of the
+ * write pointer while idle) and writes them, so the caller does not wait for flash
+ * erase operations unless all buffers are in flight.
+ */
+typedef struct ota_erase_ahead ota_erase_ahead_t;
+
+/**
+ * @brief Create the erase-ahead writer for the given partition and start its worker task
+ *
+ * @param partition Partition which receives the image, writing starts at offset 0
+ * @param[out] out_ctx Created context
+ *
+ * @return
+ *    - ESP_OK: Worker started
+ *    - ESP_ERR_NO_MEM: Not enough memory for buffers, queues or the worker task
+ */
+esp_err_t ota_erase_ahead_start(const esp_partition_t *partition, ota_erase_ahead_t **out_ctx);
+
+/**
+ * @brief Queue data to be written sequentially after the previously queued data
+ *
+ * Blocks only if all sector buffers are waiting to be written.
+ *
+ * @return
+ *    - ESP_OK: Data was accepted
+ *    - ESP_ERR_INVALID_SIZE: Data does not fit into the partition
+ *    - Error returned by esp_partition_erase_range() or esp_partition_write() of an earlier block
+ */
+esp_err_t ota_erase_ahead_write(ota_erase_ahead_t *ctx, const void *data, size_t size);
+
+/**
+ * @brief Stop the worker task and free the context
+ *
+ * @param ctx Context created by ota_erase_ahead_start()
+ * @param flush If true, the remaining buffered data is written (padded with 0xFF to 16 bytes
+ *              if flash encryption is enabled) before the worker stops. If false, buffered data is discarded.
+ * @param[out] out_written Optional, number of bytes written to the partition
+ *
+ * @return
+ *    - ESP_OK: All queued data was written
+ *    - Error returned by esp_partition_erase_range() or esp_partition_write()
+ */
+esp_err_t ota_erase_ahead_stop(ota_erase_ahead_t *ctx, bool flush, uint32_t *out_written);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,185 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <unity.h>
+#include <esp_ota_ops.h>
+#include <esp_ota_decoder.h>
+#include <esp_image_format.h>
+
+/* Delta patches are made at run time against the running app, so that the reconstructed
+   image is verified by esp_ota_end() like the image of a real update */
+
+#define TEST_PATCH_MAX_SIZE     512
+#define TEST_CHUNK_SIZE         100
+#define TEST_INSERT_LEN         64
+#define TEST_ADD_LEN            16
+#define TEST_LZ_WINDOW_BITS     8
+#define TEST_LZ_MAX_LITERALS    128
+
+typedef struct {
+    uint8_t data[TEST_PATCH_MAX_SIZE];
+    size_t len;
+} test_patch_t;
+
+static void patch_put(test_patch_t *patch, const void *data, size_t len)
+{
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(patch->data), patch->len + len);
+    memcpy(patch->data + patch->len, data, len);
+    patch->len += len;
+}
+
+static void patch_put_op(test_patch_t *patch, esp_ota_patch_op_t op)
+{
+    const uint8_t b = op;
+    patch_put(patch, &b, 1);
+}
+
+static void patch_put_varint(test_patch_t *patch, uint32_t value)
+{
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        if (value) {
+            b |= 0x80;
+        }
+        patch_put(patch, &b, 1);
+    } while (value);
+}
+
+/* Rebuilds the running app from COPY, INSERT and ADD ops. If 'corrupt' is set, the ADD op changes one byte. */
+static void make_patch(test_patch_t *patch, bool compressed, bool corrupt)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_image_metadata_t metadata;
+    const esp_partition_pos_t running_pos = {
+            .offset = running->address,
+            .size = running->size
+    };
+    TEST_ESP_OK(esp_image_get_metadata(&running_pos, &metadata));
+    /* The inserted and added bytes are part of the first segment */
+    const uint32_t split = metadata.segment_data[0] - running->address + 100;
+
+    esp_ota_patch_header_t header = {
+        .magic = ESP_OTA_PATCH_MAGIC,
+        .version = ESP_OTA_PATCH_VERSION,
+        .flags = ESP_OTA_PATCH_FLAG_DELTA,
+        .image_size = metadata.image_len,
+        .src_size = metadata.image_len,
+    };
+    TEST_ESP_OK(esp_partition_get_sha256(running, header.src_sha256));
+
+    test_patch_t ops = { 0 };
+    uint8_t data[TEST_INSERT_LEN] = { 0 };
+    patch_put_op(&ops, ESP_OTA_PATCH_OP_COPY);
+    patch_put_varint(&ops, 0);
+    patch_put_varint(&ops, split);
+    patch_put_op(&ops, ESP_OTA_PATCH_OP_INSERT);
+    patch_put_varint(&ops, TEST_INSERT_LEN);
+    TEST_ESP_OK(esp_partition_read(running, split, data, TEST_INSERT_LEN));
+    patch_put(&ops, data, TEST_INSERT_LEN);
+    patch_put_op(&ops, ESP_OTA_PATCH_OP_ADD);
+    patch_put_varint(&ops, split + TEST_INSERT_LEN);
+    patch_put_varint(&ops, TEST_ADD_LEN);
+    memset(data, 0, TEST_ADD_LEN);
+    data[TEST_ADD_LEN / 2] = corrupt ? 1 : 0;
+    patch_put(&ops, data, TEST_ADD_LEN);
+    patch_put_op(&ops, ESP_OTA_PATCH_OP_COPY);
+    patch_put_varint(&ops, split + TEST_INSERT_LEN + TEST_ADD_LEN);
+    patch_put_varint(&ops, metadata.image_len - split - TEST_INSERT_LEN - TEST_ADD_LEN);
+
+    patch->len = 0;
+    if (!compressed) {
+        patch_put(patch, &header, sizeof(header));
+        patch_put(patch, ops.data, ops.len);
+        return;
+    }
+    /* LZ stream made of literal runs only */
+    header.flags |= ESP_OTA_PATCH_FLAG_COMPRESSED;
+    header.window_bits = TEST_LZ_WINDOW_BITS;
+    patch_put(patch, &header, sizeof(header));
+    for (size_t pos = 0; pos < ops.len; pos += TEST_LZ_MAX_LITERALS) {
+        const uint8_t run = MIN(TEST_LZ_MAX_LITERALS, ops.len - pos);
+        const uint8_t token = run - 1;
+        patch_put(patch, &token, 1);
+        patch_put(patch, ops.data + pos, run);
+    }
+}
+
+static esp_err_t ota_write_cb(void *arg, const void *data, size_t size)
+{
+    return esp_ota_write(*(esp_ota_handle_t *)arg, data, size);
+}
+
+/* Applies the patch to the next OTA slot and returns the first error of the decoder, or the result of esp_ota_end() */
+static esp_err_t apply_patch(const test_patch_t *patch)
+{
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(update);
+
+    esp_ota_handle_t handle;
+    TEST_ESP_OK(esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle));
+    esp_ota_decoder_cfg_t cfg = {
+        .write_cb = ota_write_cb,
+        .write_cb_arg = &handle,
+        .src_partition = esp_ota_get_running_partition(),
+    };
+    esp_ota_decoder_handle_t decoder;
+    TEST_ESP_OK(esp_ota_decoder_new(&cfg, &decoder));
+
+    esp_err_t ret = ESP_OK;
+    for (size_t pos = 0; pos < patch->len && ret == ESP_OK; pos += TEST_CHUNK_SIZE) {
+        ret = esp_ota_decoder_write(decoder, patch->data + pos, MIN(TEST_CHUNK_SIZE, patch->len - pos));
+    }
+    if (ret == ESP_OK) {
+        ret = esp_ota_decoder_finish(decoder);
+    }
+    esp_ota_decoder_delete(decoder);
+    if (ret != ESP_OK) {
+        esp_ota_abort(handle);
+        return ret;
+    }
+    return esp_ota_end(handle);
+}
+
+TEST_CASE("esp_ota_end() accepts the image reconstructed from a delta patch", "[ota][decoder]")
+{
+    test_patch_t *patch = calloc(1, sizeof(test_patch_t));
+    TEST_ASSERT_NOT_NULL(patch);
+
+    make_patch(patch, false, false);
+    TEST_ESP_OK(apply_patch(patch));
+    TEST_ASSERT_TRUE(esp_partition_check_identity(esp_ota_get_running_partition(), esp_ota_get_next_update_partition(NULL)));
+
+    make_patch(patch, true, false);
+    TEST_ESP_OK(apply_patch(patch));
+    TEST_ASSERT_TRUE(esp_partition_check_identity(esp_ota_get_running_partition(), esp_ota_get_next_update_partition(NULL)));
+    free(patch);
+}
+
+TEST_CASE("esp_ota_end() rejects the image reconstructed from a wrong delta patch", "[ota][decoder]")
+{
+    test_patch_t *patch = calloc(1, sizeof(test_patch_t));
+    TEST_ASSERT_NOT_NULL(patch);
+
+    make_patch(patch, true, true);
+    TEST_ESP_ERR(ESP_ERR_OTA_VALIDATE_FAILED, apply_patch(patch));
+    free(patch);
+}
+
+TEST_CASE("esp_ota_decoder rejects a delta patch made for another source image", "[ota][decoder]")
+{
+    test_patch_t *patch = calloc(1, sizeof(test_patch_t));
+    TEST_ASSERT_NOT_NULL(patch);
+
+    make_patch(patch, false, false);
+    patch->data[offsetof(esp_ota_patch_header_t, src_sha256)] ^= 0x01;
+    TEST_ESP_ERR(ESP_ERR_INVALID_VERSION, apply_patch(patch));
+    free(patch);
+}
@@ -5,7 +5,10 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
@@ -13,6 +16,9 @@
 #include <unity.h>
 #include <test_utils.h>
 #include <esp_ota_ops.h>
+#include <esp_image_format.h>
+#include <esp_timer.h>
+#include <spi_flash_mmap.h>
 
 /* These OTA tests currently don't assume an OTA partition exists
    on the device, so they're a bit limited
@@ -113,3 +119,117 @@ TEST_CASE("esp_ota_get_partition_description", "[ota]")
     };
     TEST_ESP_ERR(ESP_ERR_NOT_FOUND, bootloader_common_get_partition_description(&not_app_pos, &app_desc1));
 }
+
+/* Writes the running app to the next OTA slot in chunks of a typical HTTP read size
+   and reports how long the writer was blocked by esp_ota_write() (flash erase/write).
+   With CONFIG_APP_UPDATE_ERASE_AHEAD the maximum stall should stay well below one sector erase time.
+*/
+TEST_CASE("esp_ota_write() with OTA_WITH_SEQUENTIAL_WRITES", "[ota]")
+{
+    const size_t chunk_size = 1024;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(running);
+    TEST_ASSERT_NOT_NULL(update);
+
+    esp_image_metadata_t metadata;
+    const esp_partition_pos_t running_pos = {
+            .offset = running->address,
+            .size = running->size
+    };
+    TEST_ESP_OK(esp_image_get_metadata(&running_pos, &metadata));
+
+    const uint8_t *image = NULL;
+    esp_partition_mmap_handle_t data_map;
+    TEST_ESP_OK(esp_partition_mmap(running, 0, metadata.image_len, ESP_PARTITION_MMAP_DATA, (const void **)&image, &data_map));
+
+    esp_ota_handle_t handle;
+    int64_t max_stall = 0;
+    int64_t start = esp_timer_get_time();
+    TEST_ESP_OK(esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle));
+    for (size_t offset = 0; offset < metadata.image_len; offset += chunk_size) {
+        size_t len = MIN(chunk_size, metadata.image_len - offset);
+        int64_t t = esp_timer_get_time();
+        TEST_ESP_OK(esp_ota_write(handle, image + offset, len));
+        t = esp_timer_get_time() - t;
+        max_stall = MAX(max_stall, t);
+    }
+    int64_t end_start = esp_timer_get_time();
+    TEST_ESP_OK(esp_ota_end(handle));
+    int64_t end = esp_timer_get_time() - end_start;
+    int64_t total = esp_timer_get_time() - start;
+    esp_partition_munmap(data_map);
+
+    printf("OTA write of %"PRIu32" bytes: total %lld us, max esp_ota_write() stall %lld us, esp_ota_end() %lld us\n",
+           metadata.image_len, total, max_stall, end);
+    TEST_ASSERT_TRUE(esp_partition_check_identity(running, update));
+}
+
+TEST_CASE("esp_ota_abort() after OTA_WITH_SEQUENTIAL_WRITES", "[ota]")
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(update);
+
+    const void *image = NULL;
+    esp_partition_mmap_handle_t data_map;
+    TEST_ESP_OK(esp_partition_mmap(running, 0, 3 * SPI_FLASH_SEC_SIZE, ESP_PARTITION_MMAP_DATA, &image, &data_map));
+
+    esp_ota_handle_t handle;
+    TEST_ESP_OK(esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle));
+    TEST_ESP_OK(esp_ota_write(handle, image, 2 * SPI_FLASH_SEC_SIZE + 100));
+    TEST_ESP_OK(esp_ota_abort(handle));
+    TEST_ESP_ERR(ESP_ERR_INVALID_ARG, esp_ota_write(handle, image, 16));
+    esp_partition_munmap(data_map);
+}
+
+/* Writes the running app to the next OTA slot, with 'corrupt_offset' flipped and cut off after 'len' bytes */
+static esp_err_t write_modified_image(size_t len, size_t corrupt_offset)
+{
+    const size_t chunk_size = 1024;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(update);
+
+    const uint8_t *image = NULL;
+    esp_partition_mmap_handle_t data_map;
+    TEST_ESP_OK(esp_partition_mmap(running, 0, len, ESP_PARTITION_MMAP_DATA, (const void **)&image, &data_map));
+    uint8_t *chunk = malloc(chunk_size);
+    TEST_ASSERT_NOT_NULL(chunk);
+
+    esp_ota_handle_t handle;
+    TEST_ESP_OK(esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle));
+    for (size_t offset = 0; offset < len; offset += chunk_size) {
+        size_t chunk_len = MIN(chunk_size, len - offset);
+        memcpy(chunk, image + offset, chunk_len);
+        if (corrupt_offset >= offset && corrupt_offset < offset + chunk_len) {
+            chunk[corrupt_offset - offset] ^= 0x01;
+        }
+        TEST_ESP_OK(esp_ota_write(handle, chunk, chunk_len));
+    }
+    free(chunk);
+    esp_partition_munmap(data_map);
+    return esp_ota_end(handle);
+}
+
+TEST_CASE("esp_ota_end() rejects corrupted and truncated images", "[ota]")
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    TEST_ASSERT_NOT_NULL(running);
+
+    esp_image_metadata_t metadata;
+    const esp_partition_pos_t running_pos = {
+            .offset = running->address,
+            .size = running->size
+    };
+    TEST_ESP_OK(esp_image_get_metadata(&running_pos, &metadata));
+    const size_t segment_data = metadata.segment_data[0] - running->address;
+
+    TEST_ESP_ERR(ESP_ERR_OTA_VALIDATE_FAILED, write_modified_image(metadata.image_len, segment_data + 100));
+    TEST_ESP_ERR(ESP_ERR_OTA_VALIDATE_FAILED, write_modified_image(metadata.image_len - ESP_IMAGE_HASH_LEN, SIZE_MAX));
+    /* Length of the first segment is not a multiple of 4 */
+    TEST_ESP_ERR(ESP_ERR_OTA_VALIDATE_FAILED,
+                 write_modified_image(metadata.image_len, sizeof(esp_image_header_t) + offsetof(esp_image_segment_header_t, data_len)));
+    /* Unmodified image passes */
+    TEST_ESP_OK(write_modified_image(metadata.image_len, SIZE_MAX));
+}
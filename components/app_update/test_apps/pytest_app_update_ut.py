@@ -21,6 +21,15 @@ def run_multiple_stages(dut: Dut, test_case_num: int, stages: int) -> None:
 @pytest.mark.supported_targets
 @pytest.mark.temp_skip_ci(targets=['esp32c6', 'esp32h2'], reason='c6/h2 support TBD')
 @pytest.mark.generic
+@pytest.mark.parametrize(
+    'config',
+    [
+        'default',
+        'erase_ahead',
+        'streaming_verify',
+    ],
+    indirect=True,
+)
 def test_app_update(dut: Dut) -> None:
     extra_data = dut.parse_test_menu()
     for test_case in extra_data:
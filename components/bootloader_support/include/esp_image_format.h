@@ -125,6 +125,75 @@ esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t
  */
 esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata);
 
+/**
+ * @brief Opaque handle of an incremental image verification
+ */
+typedef struct esp_image_verify_stream *esp_image_verify_stream_handle_t;
+
+/**
+ * @brief Start verifying an app image while it is being written (not available in bootloader)
+ *
+ * The image data is passed to esp_image_verify_stream_write() in order, as it is written to flash.
+ * Headers are checked and the checksum and SHA-256 are calculated on the fly, so
+ * esp_image_verify_stream_end() only has to check the appended digest and the signature.
+ * This performs the same checks as esp_image_verify() without reading the image back from flash.
+ *
+ * Data written to flash is not read back, so a write which silently stored wrong data is
+ * not detected unless CONFIG_SPI_FLASH_VERIFY_WRITE is enabled.
+ *
+ * @param mode ESP_IMAGE_VERIFY or ESP_IMAGE_VERIFY_SILENT.
+ * @param part Partition the image is written to.
+ * @param[out] out_handle Verification handle.
+ *
+ * @return
+ * - ESP_OK if the verification was started
+ * - ESP_ERR_INVALID_ARG if an argument is invalid or the partition is larger than 16MB
+ * - ESP_ERR_NO_MEM if there is not enough memory
+ */
+esp_err_t esp_image_verify_stream_begin(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_verify_stream_handle_t *out_handle);
+
+/**
+ * @brief Pass the next part of the image to the verification
+ *
+ * Data may be split at any byte. Data after the end of the image (signature block, padding) is ignored.
+ * The first error is latched, the following data is ignored and esp_image_verify_stream_end() returns the error.
+ *
+ * @param handle Verification handle.
+ * @param data Image data.
+ * @param size Size of data in bytes.
+ *
+ * @return
+ * - ESP_OK if the data seen so far is valid
+ * - ESP_ERR_IMAGE_INVALID if the image appears invalid
+ * - ESP_ERR_INVALID_ARG if handle or data is NULL
+ */
+esp_err_t esp_image_verify_stream_write(esp_image_verify_stream_handle_t handle, const void *data, size_t size);
+
+/**
+ * @brief Finish the verification and free the handle
+ *
+ * Checks that the complete image was received, compares the appended SHA-256 digest and
+ * verifies the signature if signature verification is enabled.
+ * The signature block is read from flash, so it must have been written already.
+ *
+ * @param handle Verification handle, freed by this function.
+ * @param[out] data Image metadata, may be NULL. Only valid if result is ESP_OK.
+ *
+ * @return
+ * - ESP_OK if the image is valid
+ * - ESP_ERR_IMAGE_INVALID if the image appears invalid or is incomplete
+ * - ESP_ERR_IMAGE_FLASH_FAIL if a SPI flash error occurs
+ * - ESP_ERR_INVALID_ARG if handle is NULL
+ */
+esp_err_t esp_image_verify_stream_end(esp_image_verify_stream_handle_t handle, esp_image_metadata_t *data);
+
+/**
+ * @brief Free the handle without finishing the verification
+ *
+ * @param handle Verification handle, may be NULL.
+ */
+void esp_image_verify_stream_abort(esp_image_verify_stream_handle_t handle);
+
 /**
  * @brief Verify and load an app image (available only in space of bootloader).
  *
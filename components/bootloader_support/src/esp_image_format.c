@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <string.h>
+#include <stdlib.h>
 #include <sys/param.h>
 #include <esp_cpu.h>
 #include <bootloader_utility.h>
@@ -118,6 +119,7 @@ static esp_err_t process_checksum(bootloader_sha256_handle_t sha_handle, uint32_
 
 static esp_err_t __attribute__((unused)) verify_secure_boot_signature(bootloader_sha256_handle_t sha_handle, esp_image_metadata_t *data, uint8_t *image_digest, uint8_t *verified_digest);
 static esp_err_t __attribute__((unused)) verify_simple_hash(bootloader_sha256_handle_t sha_handle, esp_image_metadata_t *data);
+static esp_err_t __attribute__((unused)) verify_signature_block(bootloader_sha256_handle_t sha_handle, esp_image_metadata_t *data, uint32_t end, uint8_t *image_digest, uint8_t *verified_digest);
 
 static esp_err_t image_load(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data)
 {
@@ -854,8 +856,6 @@ static esp_err_t verify_secure_boot_signature(bootloader_sha256_handle_t sha_han
 #if (SECURE_BOOT_CHECK_SIGNATURE == 1)
     uint32_t end = data->start_addr + data->image_len;
 
-    ESP_LOGI(TAG, "Verifying image signature...");
-
     // For secure boot, we calculate the signature hash over the whole file, which includes any "simple" hash
     // appended to the image for corruption detection
     if (data->image.hash_appended) {
@@ -876,6 +876,18 @@ static esp_err_t verify_secure_boot_signature(bootloader_sha256_handle_t sha_han
     }
 #endif
 
+    return verify_signature_block(sha_handle, data, end, image_digest, verified_digest);
+#else
+    return ESP_OK;
+#endif // SECURE_BOOT_CHECK_SIGNATURE
+}
+
+/* Finish the secure boot hash of the image which ends at 'end' (including any padding) and check it against the signature block */
+static esp_err_t verify_signature_block(bootloader_sha256_handle_t sha_handle, esp_image_metadata_t *data, uint32_t end, uint8_t *image_digest, uint8_t *verified_digest)
+{
+#if (SECURE_BOOT_CHECK_SIGNATURE == 1)
+    ESP_LOGI(TAG, "Verifying image signature...");
+
     bootloader_sha256_finish(sha_handle, image_digest);
 
     // Log the hash for debugging
@@ -968,3 +980,265 @@ int esp_image_get_flash_size(esp_image_flash_size_t app_flash_size)
         return 0;
     }
 }
+
+#ifndef BOOTLOADER_BUILD
+
+/* Parts of the image, in the order they are received by esp_image_verify_stream_write() */
+typedef enum {
+    STREAM_IMAGE_HEADER,
+    STREAM_SEGMENT_HEADER,
+    STREAM_SEGMENT_DATA,
+    STREAM_CHECKSUM,        /* Padding to the next 16 byte boundary, the last byte is the checksum */
+    STREAM_HASH,            /* Appended SHA-256 digest */
+    STREAM_SIG_PADDING,     /* Secure boot v2 padding to the next flash sector boundary */
+    STREAM_DONE,            /* Signature block and anything after it is ignored */
+} stream_state_t;
+
+struct esp_image_verify_stream {
+    esp_image_metadata_t data;
+    uint32_t part_size;
+    bool silent;
+    stream_state_t state;
+    uint32_t pos;           /* Offset of the next byte, relative to the image start */
+    uint8_t *field_dst;     /* Where the current part is stored, NULL if it is not stored */
+    uint32_t field_len;     /* Length of the current part */
+    uint32_t field_pos;     /* Bytes of the current part received so far */
+    int segment;
+    uint32_t checksum_word;
+    WORD_ALIGNED_ATTR uint8_t checksum_block[16];
+    bootloader_sha256_handle_t sha_handle;
+    esp_err_t err;          /* First error, latched */
+};
+
+static void stream_set_field(struct esp_image_verify_stream *s, stream_state_t state, uint32_t len, void *dst)
+{
+    s->state = state;
+    s->field_dst = dst;
+    s->field_len = len;
+    s->field_pos = 0;
+}
+
+/* Same as the checksum loop of process_segment_data(), for data which may start and end at any byte */
+static void stream_checksum(uint32_t *checksum, uint32_t pos, const uint8_t *src, uint32_t len)
+{
+    for (; len > 0 && (pos & 3) != 0; pos++, src++, len--) {
+        *checksum ^= (uint32_t)*src << (8 * (pos & 3));
+    }
+    for (; len >= 4; src += 4, len -= 4) {
+        uint32_t w;
+        memcpy(&w, src, sizeof(w));
+        *checksum ^= w;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        *checksum ^= (uint32_t)src[i] << (8 * i);
+    }
+}
+
+static void stream_sig_padding(struct esp_image_verify_stream *s)
+{
+#if (SECURE_BOOT_CHECK_SIGNATURE == 1) && CONFIG_SECURE_BOOT_V2_ENABLED
+    // Padding to a 4KB boundary after the simple hash is part of the secure boot hash
+    uint32_t end = s->data.start_addr + s->data.image_len + (s->data.image.hash_appended ? HASH_LEN : 0);
+    stream_set_field(s, STREAM_SIG_PADDING, ALIGN_UP(end, FLASH_SECTOR_SIZE) - end, NULL);
+#else
+    stream_set_field(s, STREAM_DONE, 0, NULL);
+#endif
+}
+
+static void stream_next_segment(struct esp_image_verify_stream *s)
+{
+    if (s->segment < s->data.image.segment_count) {
+        stream_set_field(s, STREAM_SEGMENT_HEADER, sizeof(esp_image_segment_header_t), &s->data.segments[s->segment]);
+        return;
+    }
+    s->data.image_len = s->pos;
+    uint32_t length = s->data.image_len + 1; // Add a byte for the checksum
+    length = (length + 15) & ~15; // Pad to next full 16 byte block
+    stream_set_field(s, STREAM_CHECKSUM, length - s->data.image_len, s->checksum_block);
+}
+
+/* Check the part which has just been received completely and set up the next one */
+static esp_err_t stream_field_done(struct esp_image_verify_stream *s)
+{
+    esp_err_t err;
+
+    switch (s->state) {
+    case STREAM_IMAGE_HEADER:
+        err = verify_image_header(s->data.start_addr, &s->data.image, s->silent);
+        if (err != ESP_OK) {
+            return err;
+        }
+        // Calculate SHA-256 of image if secure boot is on, or if image has a hash appended
+        if (SECURE_BOOT_CHECK_SIGNATURE || s->data.image.hash_appended) {
+            s->sha_handle = bootloader_sha256_start();
+            if (s->sha_handle == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+            bootloader_sha256_data(s->sha_handle, &s->data.image, sizeof(esp_image_header_t));
+        }
+        s->segment = 0;
+        stream_next_segment(s);
+        break;
+    case STREAM_SEGMENT_HEADER: {
+        const esp_image_segment_header_t *header = &s->data.segments[s->segment];
+        uint32_t data_addr = s->data.start_addr + s->pos;
+        err = verify_segment_header(s->segment, header, data_addr, s->silent);
+        if (err != ESP_OK) {
+            return err;
+        }
+        // Same check as process_segment(), the checksum is calculated over words
+        if (header->data_len % 4 != 0) {
+            if (!s->silent) {
+                ESP_LOGE(TAG, "unaligned segment length 0x%"PRIx32, header->data_len);
+            }
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        if (!s->silent) {
+            ESP_LOGI(TAG, "segment %d: paddr=%08"PRIx32" vaddr=%08"PRIx32" size=%05"PRIx32"h (%6"PRIu32") %s",
+                     s->segment, data_addr, header->load_addr, header->data_len, header->data_len,
+                     should_map(header->load_addr) ? "map" : "");
+        }
+        s->data.segment_data[s->segment] = data_addr;
+        stream_set_field(s, STREAM_SEGMENT_DATA, header->data_len, NULL);
+        break;
+    }
+    case STREAM_SEGMENT_DATA:
+        s->segment++;
+        stream_next_segment(s);
+        break;
+    case STREAM_CHECKSUM: {
+        uint8_t read_checksum = s->checksum_block[s->field_len - 1];
+        uint8_t calc_checksum = (s->checksum_word >> 24) ^ (s->checksum_word >> 16) ^ (s->checksum_word >> 8) ^ (s->checksum_word >> 0);
+        if (!esp_cpu_dbgr_is_attached() && calc_checksum != read_checksum) {
+            if (!s->silent) {
+                ESP_LOGE(TAG, "Checksum failed. Calculated 0x%x read 0x%x", calc_checksum, read_checksum);
+            }
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        s->data.image_len += s->field_len;
+        if (s->data.image.hash_appended) {
+            // Accounted for in image_len by process_appended_hash_and_sig()
+            stream_set_field(s, STREAM_HASH, HASH_LEN, s->data.image_digest);
+        } else {
+            stream_sig_padding(s);
+        }
+        break;
+    }
+    case STREAM_HASH:
+        stream_sig_padding(s);
+        break;
+    default:
+        stream_set_field(s, STREAM_DONE, 0, NULL);
+        break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_image_verify_stream_begin(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_verify_stream_handle_t *out_handle)
+{
+    if (part == NULL || out_handle == NULL || part->size > SIXTEEN_MB
+            || (mode != ESP_IMAGE_VERIFY && mode != ESP_IMAGE_VERIFY_SILENT)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_image_verify_stream *s = calloc(1, sizeof(struct esp_image_verify_stream));
+    if (s == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s->data.start_addr = part->offset;
+    s->part_size = part->size;
+    s->silent = (mode == ESP_IMAGE_VERIFY_SILENT);
+    s->checksum_word = ESP_ROM_CHECKSUM_INITIAL;
+    stream_set_field(s, STREAM_IMAGE_HEADER, sizeof(esp_image_header_t), &s->data.image);
+    *out_handle = s;
+    return ESP_OK;
+}
+
+esp_err_t esp_image_verify_stream_write(esp_image_verify_stream_handle_t s, const void *data, size_t size)
+{
+    if (s == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *src = (const uint8_t *)data;
+
+    while (size > 0 && s->err == ESP_OK && s->state != STREAM_DONE) {
+        uint32_t len = MIN(size, s->field_len - s->field_pos);
+        if (s->field_dst != NULL) {
+            memcpy(s->field_dst + s->field_pos, src, len);
+        }
+        if (s->state == STREAM_SEGMENT_DATA) {
+            stream_checksum(&s->checksum_word, s->pos, src, len);
+        }
+        // The appended digest and the padding after it are only part of the secure boot hash.
+        // The image header is hashed once it has been verified.
+        if (s->sha_handle != NULL && (s->state <= STREAM_CHECKSUM || SECURE_BOOT_CHECK_SIGNATURE)) {
+            bootloader_sha256_data(s->sha_handle, src, len);
+        }
+        s->pos += len;
+        s->field_pos += len;
+        src += len;
+        size -= len;
+
+        // Zero-length segments and padding are done immediately
+        while (s->err == ESP_OK && s->state != STREAM_DONE && s->field_pos == s->field_len) {
+            s->err = stream_field_done(s);
+        }
+    }
+    return s->err;
+}
+
+esp_err_t esp_image_verify_stream_end(esp_image_verify_stream_handle_t s, esp_image_metadata_t *data)
+{
+    if (s == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = s->err;
+
+    if (err == ESP_OK && s->state != STREAM_DONE) {
+        if (!s->silent) {
+            ESP_LOGE(TAG, "image is incomplete, only %"PRIu32" bytes received", s->pos);
+        }
+        err = ESP_ERR_IMAGE_INVALID;
+    }
+    if (err == ESP_OK) {
+        // The digest has been received already, only account for it and check that the image fits
+        err = process_appended_hash_and_sig(&s->data, s->data.start_addr, s->part_size, false, s->silent);
+    }
+    if (err == ESP_OK && s->sha_handle != NULL) {
+#if (SECURE_BOOT_CHECK_SIGNATURE == 1)
+        /* used for anti-FI checks */
+        uint8_t image_digest[HASH_LEN] = { [ 0 ... 31] = 0xEE };
+        uint8_t verified_digest[HASH_LEN] = { [ 0 ... 31 ] = 0x01 };
+        uint32_t end = s->data.start_addr + s->data.image_len;
+#if CONFIG_SECURE_BOOT_V2_ENABLED
+        end = ALIGN_UP(end, FLASH_SECTOR_SIZE);
+#endif
+        err = verify_signature_block(s->sha_handle, &s->data, end, image_digest, verified_digest);
+        s->sha_handle = NULL; // verify_signature_block finishes sha_handle
+#else
+        // No secure boot, but SHA-256 can be appended for basic corruption detection
+        if (!esp_cpu_dbgr_is_attached()) {
+            err = verify_simple_hash(s->sha_handle, &s->data);
+            s->sha_handle = NULL; // calling verify_simple_hash finishes sha_handle
+        }
+#endif
+    }
+    if (err == ESP_OK && data != NULL) {
+        memcpy(data, &s->data, sizeof(esp_image_metadata_t));
+    }
+    esp_image_verify_stream_abort(s);
+    return err;
+}
+
+void esp_image_verify_stream_abort(esp_image_verify_stream_handle_t s)
+{
+    if (s == NULL) {
+        return;
+    }
+    if (s->sha_handle != NULL) {
+        // Need to finish the hash process to free the handle
+        bootloader_sha256_finish(s->sha_handle, NULL);
+    }
+    free(s);
+}
+
+#endif // BOOTLOADER_BUILD
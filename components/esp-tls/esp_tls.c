@@ -19,6 +19,8 @@
 #include "esp_tls_error_capture_internal.h"
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 
 #if CONFIG_IDF_TARGET_LINUX && !ESP_TLS_WITH_LWIP
 #include <arpa/inet.h>
@@ -63,12 +65,15 @@ static const char *TAG = "esp-tls";
 #define _esp_tls_net_init                   esp_mbedtls_net_init
 #define _esp_tls_get_client_session         esp_mbedtls_get_client_session
 #define _esp_tls_free_client_session        esp_mbedtls_free_client_session
+#define _esp_tls_client_session_cache_flush esp_mbedtls_client_session_cache_flush
 #define _esp_tls_get_ssl_context            esp_mbedtls_get_ssl_context
 #ifdef CONFIG_ESP_TLS_SERVER
 #define _esp_tls_server_session_create      esp_mbedtls_server_session_create
 #define _esp_tls_server_session_delete      esp_mbedtls_server_session_delete
 #define _esp_tls_server_session_ticket_ctx_init    esp_mbedtls_server_session_ticket_ctx_init
 #define _esp_tls_server_session_ticket_ctx_free    esp_mbedtls_server_session_ticket_ctx_free
+#define _esp_tls_server_session_cache_ctx_init     esp_mbedtls_server_session_cache_ctx_init
+#define _esp_tls_server_session_cache_ctx_free     esp_mbedtls_server_session_cache_ctx_free
 #endif  /* CONFIG_ESP_TLS_SERVER */
 #define _esp_tls_get_bytes_avail            esp_mbedtls_get_bytes_avail
 #define _esp_tls_init_global_ca_store       esp_mbedtls_init_global_ca_store
@@ -105,10 +110,13 @@ static const char *TAG = "esp-tls";
 #endif  // !CONFIG_IDF_TARGET_LINUX
 
 #define ESP_TLS_DEFAULT_CONN_TIMEOUT  (10)  /*!< Default connection timeout in seconds */
+#define ESP_TLS_MAX_ADDRESSES         CONFIG_ESP_TLS_CONNECT_MAX_ADDRESSES  /*!< Maximum number of addresses tried for a host */
 
-static esp_err_t create_ssl_handle(const char *hostname, size_t hostlen, const void *cfg, esp_tls_t *tls)
+static void esp_tls_connect_ctx_destroy(esp_tls_connect_ctx_t *ctx);
+
+static esp_err_t create_ssl_handle(const char *hostname, size_t hostlen, int port, const void *cfg, esp_tls_t *tls)
 {
-    return _esp_create_ssl_handle(hostname, hostlen, cfg, tls);
+    return _esp_create_ssl_handle(hostname, hostlen, port, cfg, tls);
 }
 
 static esp_err_t esp_tls_handshake(esp_tls_t *tls, const esp_tls_cfg_t *cfg)
@@ -146,6 +154,11 @@ int esp_tls_conn_destroy(esp_tls_t *tls)
     if (tls != NULL) {
         int ret = 0;
         _esp_tls_conn_delete(tls);
+        if (tls->connect_ctx) {
+            /* The socket of the connection in progress is closed with the attempts */
+            esp_tls_connect_ctx_destroy(tls->connect_ctx);
+            tls->sockfd = -1;
+        }
         if (tls->sockfd >= 0) {
             ret = close(tls->sockfd);
         }
@@ -172,80 +185,6 @@ esp_tls_t *esp_tls_init(void)
     return tls;
 }
 
-static esp_err_t esp_tls_hostname_to_fd(const char *host, size_t hostlen, int port, esp_tls_addr_family_t addr_family, struct sockaddr_storage *address, int* fd)
-{
-    struct addrinfo *address_info;
-    struct addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-
-    switch (addr_family) {
-        case ESP_TLS_AF_INET:
-            hints.ai_family = AF_INET;
-            break;
-        case ESP_TLS_AF_INET6:
-            hints.ai_family = AF_INET6;
-            break;
-        default:
-            hints.ai_family = AF_UNSPEC;
-            break;
-    }
-
-    hints.ai_socktype = SOCK_STREAM;
-
-    char *use_host = strndup(host, hostlen);
-    if (!use_host) {
-        return ESP_ERR_NO_MEM;
-    }
-
-    ESP_LOGD(TAG, "host:%s: strlen %lu", use_host, (unsigned long)hostlen);
-    int res = getaddrinfo(use_host, NULL, &hints, &address_info);
-    if (res != 0 || address_info == NULL) {
-        ESP_LOGE(TAG, "couldn't get hostname for :%s: "
-                      "getaddrinfo() returns %d, addrinfo=%p", use_host, res, address_info);
-        free(use_host);
-        return ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME;
-    }
-    free(use_host);
-    *fd = socket(address_info->ai_family, address_info->ai_socktype, address_info->ai_protocol);
-    if (*fd < 0) {
-        ESP_LOGE(TAG, "Failed to create socket (family %d socktype %d protocol %d)", address_info->ai_family, address_info->ai_socktype, address_info->ai_protocol);
-        freeaddrinfo(address_info);
-        return ESP_ERR_ESP_TLS_CANNOT_CREATE_SOCKET;
-    }
-
-#if IPV4_ENABLED
-    if (address_info->ai_family == AF_INET) {
-        struct sockaddr_in *p = (struct sockaddr_in *)address_info->ai_addr;
-        p->sin_port = htons(port);
-        ESP_LOGD(TAG, "[sock=%d] Resolved IPv4 address: %s", *fd, ipaddr_ntoa((const ip_addr_t*)&p->sin_addr.s_addr));
-        memcpy(address, p, sizeof(struct sockaddr ));
-    }
-#endif
-
-#if IPV4_ENABLED && IPV6_ENABLED
-    else
-#endif
-
-#if IPV6_ENABLED
-    if (address_info->ai_family == AF_INET6) {
-        struct sockaddr_in6 *p = (struct sockaddr_in6 *)address_info->ai_addr;
-        p->sin6_port = htons(port);
-        p->sin6_family = AF_INET6;
-        ESP_LOGD(TAG, "[sock=%d] Resolved IPv6 address: %s", *fd, ip6addr_ntoa((const ip6_addr_t*)&p->sin6_addr));
-        memcpy(address, p, sizeof(struct sockaddr_in6 ));
-    }
-#endif
-    else {
-        ESP_LOGE(TAG, "Unsupported protocol family %d", address_info->ai_family);
-        close(*fd);
-        freeaddrinfo(address_info);
-        return ESP_ERR_ESP_TLS_UNSUPPORTED_PROTOCOL_FAMILY;
-    }
-
-    freeaddrinfo(address_info);
-    return ESP_OK;
-}
-
 static void ms_to_timeval(int timeout_ms, struct timeval *tv)
 {
     tv->tv_sec = timeout_ms / 1000;
@@ -329,93 +268,596 @@ static esp_err_t esp_tls_set_socket_non_blocking(int fd, bool non_blocking)
     return ESP_OK;
 }
 
-static inline esp_err_t tcp_connect(const char *host, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_error_handle_t error_handle, int *sockfd)
+static int64_t esp_tls_time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Addresses of a host, in the order the connection attempts are made
+ */
+typedef struct {
+    struct sockaddr_storage addr[ESP_TLS_MAX_ADDRESSES];
+    int num;
+} esp_tls_addr_list_t;
+
+static socklen_t esp_tls_addr_len(const struct sockaddr_storage *addr)
+{
+#if IPV6_ENABLED
+    if (addr->ss_family == AF_INET6) {
+        return sizeof(struct sockaddr_in6);
+    }
+#endif
+    return sizeof(struct sockaddr_in);
+}
+
+static esp_err_t esp_tls_resolve(const char *host, esp_tls_addr_family_t addr_family, esp_tls_addr_list_t *list)
+{
+    struct addrinfo *address_info;
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+
+    switch (addr_family) {
+        case ESP_TLS_AF_INET:
+            hints.ai_family = AF_INET;
+            break;
+        case ESP_TLS_AF_INET6:
+            hints.ai_family = AF_INET6;
+            break;
+        default:
+            hints.ai_family = AF_UNSPEC;
+            break;
+    }
+
+    hints.ai_socktype = SOCK_STREAM;
+
+    ESP_LOGD(TAG, "host:%s: strlen %lu", host, (unsigned long)strlen(host));
+    int res = getaddrinfo(host, NULL, &hints, &address_info);
+    if (res != 0 || address_info == NULL) {
+        ESP_LOGE(TAG, "couldn't get hostname for :%s: "
+                      "getaddrinfo() returns %d, addrinfo=%p", host, res, address_info);
+        return ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME;
+    }
+
+    /* Alternate the address families, starting with the preferred one (RFC 8305, section 4) */
+    const struct addrinfo *next[2] = { address_info, NULL };
+    for (const struct addrinfo *ai = address_info; ai; ai = ai->ai_next) {
+        if (ai->ai_family != address_info->ai_family) {
+            next[1] = ai;
+            break;
+        }
+    }
+    list->num = 0;
+    for (int family = 0; list->num < ESP_TLS_MAX_ADDRESSES && (next[0] || next[1]); family ^= 1) {
+        const struct addrinfo *ai = next[family];
+        if (ai == NULL) {
+            continue;
+        }
+        for (next[family] = ai->ai_next; next[family]; next[family] = next[family]->ai_next) {
+            if (next[family]->ai_family == ai->ai_family) {
+                break;
+            }
+        }
+#if IPV4_ENABLED
+        if (ai->ai_family == AF_INET) {
+            struct sockaddr_in *p = (struct sockaddr_in *)ai->ai_addr;
+            ESP_LOGD(TAG, "Resolved IPv4 address: %s", ipaddr_ntoa((const ip_addr_t*)&p->sin_addr.s_addr));
+            memcpy(&list->addr[list->num++], p, sizeof(struct sockaddr_in));
+            continue;
+        }
+#endif
+#if IPV6_ENABLED
+        if (ai->ai_family == AF_INET6) {
+            struct sockaddr_in6 *p = (struct sockaddr_in6 *)ai->ai_addr;
+            p->sin6_family = AF_INET6;
+            ESP_LOGD(TAG, "Resolved IPv6 address: %s", ip6addr_ntoa((const ip6_addr_t*)&p->sin6_addr));
+            memcpy(&list->addr[list->num++], p, sizeof(struct sockaddr_in6));
+            continue;
+        }
+#endif
+        ESP_LOGD(TAG, "Skipping unsupported protocol family %d", ai->ai_family);
+    }
+    freeaddrinfo(address_info);
+
+    if (list->num == 0) {
+        ESP_LOGE(TAG, "No address of a supported protocol family for %s", host);
+        return ESP_ERR_ESP_TLS_UNSUPPORTED_PROTOCOL_FAMILY;
+    }
+    return ESP_OK;
+}
+
+#if CONFIG_ESP_TLS_DNS_CACHE || CONFIG_ESP_TLS_ASYNC_DNS
+static pthread_mutex_t s_dns_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#if CONFIG_ESP_TLS_DNS_CACHE
+/**
+ * Addresses of a recently resolved host name, shared by all the connections
+ */
+typedef struct {
+    char *host;                         /*!< NULL if the entry is free */
+    esp_tls_addr_family_t addr_family;
+    esp_tls_addr_list_t addrs;
+    int64_t expires_at_ms;
+} esp_tls_dns_cache_entry_t;
+
+static esp_tls_dns_cache_entry_t s_dns_cache[CONFIG_ESP_TLS_DNS_CACHE_SIZE];
+
+/* Must be called with s_dns_lock held */
+static esp_tls_dns_cache_entry_t *esp_tls_dns_cache_find(const char *host, esp_tls_addr_family_t addr_family)
+{
+    const int64_t now = esp_tls_time_ms();
+    for (int i = 0; i < CONFIG_ESP_TLS_DNS_CACHE_SIZE; i++) {
+        esp_tls_dns_cache_entry_t *entry = &s_dns_cache[i];
+        if (entry->host && now >= entry->expires_at_ms) {
+            free(entry->host);
+            entry->host = NULL;
+        }
+        if (entry->host && entry->addr_family == addr_family && strcasecmp(entry->host, host) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool esp_tls_dns_cache_get(const char *host, esp_tls_addr_family_t addr_family, esp_tls_addr_list_t *list)
+{
+    pthread_mutex_lock(&s_dns_lock);
+    esp_tls_dns_cache_entry_t *entry = esp_tls_dns_cache_find(host, addr_family);
+    if (entry) {
+        *list = entry->addrs;
+    }
+    pthread_mutex_unlock(&s_dns_lock);
+    return entry != NULL;
+}
+
+static void esp_tls_dns_cache_put(const char *host, esp_tls_addr_family_t addr_family, const esp_tls_addr_list_t *list)
+{
+    char *entry_host = strdup(host);
+    if (entry_host == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&s_dns_lock);
+    esp_tls_dns_cache_entry_t *slot = esp_tls_dns_cache_find(host, addr_family);
+    if (slot == NULL) {
+        /* Take a free entry, or the one expiring first */
+        for (int i = 0; i < CONFIG_ESP_TLS_DNS_CACHE_SIZE; i++) {
+            esp_tls_dns_cache_entry_t *entry = &s_dns_cache[i];
+            if (entry->host == NULL) {
+                slot = entry;
+                break;
+            }
+            if (slot == NULL || entry->expires_at_ms < slot->expires_at_ms) {
+                slot = entry;
+            }
+        }
+    }
+    free(slot->host);
+    slot->host = entry_host;
+    slot->addr_family = addr_family;
+    slot->addrs = *list;
+    slot->expires_at_ms = esp_tls_time_ms() + CONFIG_ESP_TLS_DNS_CACHE_LIFETIME * 1000LL;
+    pthread_mutex_unlock(&s_dns_lock);
+}
+
+static void esp_tls_dns_cache_forget(const char *host, esp_tls_addr_family_t addr_family)
+{
+    pthread_mutex_lock(&s_dns_lock);
+    esp_tls_dns_cache_entry_t *entry = esp_tls_dns_cache_find(host, addr_family);
+    if (entry) {
+        free(entry->host);
+        entry->host = NULL;
+    }
+    pthread_mutex_unlock(&s_dns_lock);
+}
+#else
+#define esp_tls_dns_cache_get(host, addr_family, list)  (false)
+#define esp_tls_dns_cache_put(host, addr_family, list)
+#define esp_tls_dns_cache_forget(host, addr_family)
+#endif /* CONFIG_ESP_TLS_DNS_CACHE */
+
+void esp_tls_dns_cache_flush(void)
+{
+#if CONFIG_ESP_TLS_DNS_CACHE
+    pthread_mutex_lock(&s_dns_lock);
+    for (int i = 0; i < CONFIG_ESP_TLS_DNS_CACHE_SIZE; i++) {
+        free(s_dns_cache[i].host);
+        s_dns_cache[i].host = NULL;
+    }
+    pthread_mutex_unlock(&s_dns_lock);
+#endif
+}
+
+#if CONFIG_ESP_TLS_ASYNC_DNS
+/**
+ * Host name resolution running in its own thread, shared by the thread and the connection
+ * until both have released it
+ */
+typedef struct {
+    char *host;
+    esp_tls_addr_family_t addr_family;
+    esp_tls_addr_list_t addrs;
+    esp_err_t err;
+    bool done;
+    int refs;
+} esp_tls_dns_job_t;
+
+static pthread_cond_t s_dns_done = PTHREAD_COND_INITIALIZER;
+
+static void esp_tls_dns_job_release(esp_tls_dns_job_t *job)
+{
+    pthread_mutex_lock(&s_dns_lock);
+    bool last = --job->refs == 0;
+    pthread_mutex_unlock(&s_dns_lock);
+    if (last) {
+        free(job->host);
+        free(job);
+    }
+}
+
+static void *esp_tls_dns_job_run(void *arg)
+{
+    esp_tls_dns_job_t *job = arg;
+    esp_tls_addr_list_t addrs;
+    esp_err_t err = esp_tls_resolve(job->host, job->addr_family, &addrs);
+    if (err == ESP_OK) {
+        esp_tls_dns_cache_put(job->host, job->addr_family, &addrs);
+    }
+    pthread_mutex_lock(&s_dns_lock);
+    job->addrs = addrs;
+    job->err = err;
+    job->done = true;
+    pthread_cond_broadcast(&s_dns_done);
+    pthread_mutex_unlock(&s_dns_lock);
+    esp_tls_dns_job_release(job);
+    return NULL;
+}
+
+static esp_err_t esp_tls_dns_job_start(const char *host, esp_tls_addr_family_t addr_family, esp_tls_dns_job_t **out)
+{
+    esp_tls_dns_job_t *job = calloc(1, sizeof(esp_tls_dns_job_t));
+    if (job == NULL || (job->host = strdup(host)) == NULL) {
+        free(job);
+        return ESP_ERR_NO_MEM;
+    }
+    job->addr_family = addr_family;
+    job->refs = 2;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int ret = pthread_create(&thread, &attr, esp_tls_dns_job_run, job);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to start the resolution of %s: %d", host, ret);
+        free(job->host);
+        free(job);
+        return ESP_ERR_NO_MEM;
+    }
+    *out = job;
+    return ESP_OK;
+}
+
+/* Returns true once the resolution is done, waiting for at most wait_ms, or until it is done if wait_ms is negative */
+static bool esp_tls_dns_job_wait(esp_tls_dns_job_t *job, int wait_ms, esp_tls_addr_list_t *list, esp_err_t *err)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += wait_ms / 1000;
+    until.tv_nsec += (wait_ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&s_dns_lock);
+    while (!job->done && wait_ms < 0) {
+        pthread_cond_wait(&s_dns_done, &s_dns_lock);
+    }
+    while (!job->done && wait_ms > 0) {
+        if (pthread_cond_timedwait(&s_dns_done, &s_dns_lock, &until) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool done = job->done;
+    if (done) {
+        *list = job->addrs;
+        *err = job->err;
+    }
+    pthread_mutex_unlock(&s_dns_lock);
+    return done;
+}
+#endif /* CONFIG_ESP_TLS_ASYNC_DNS */
+
+/**
+ * Connection attempts to the addresses of a host, started one after the other
+ * and raced against each other (Happy Eyeballs, RFC 8305)
+ */
+struct esp_tls_connect_ctx {
+    char *host;
+    esp_tls_addr_family_t addr_family;
+    int port;
+    esp_tls_addr_list_t addrs;
+    int fds[ESP_TLS_MAX_ADDRESSES];     /*!< Sockets of the attempts in progress, -1 otherwise */
+    int next;                           /*!< Index of the next address to try */
+    int64_t next_attempt_ms;            /*!< Time when the next attempt is started if none has succeeded */
+#if CONFIG_ESP_TLS_ASYNC_DNS
+    esp_tls_dns_job_t *dns_job;         /*!< Resolution of the host name in progress */
+#endif
+};
+
+static void esp_tls_connect_ctx_destroy(esp_tls_connect_ctx_t *ctx)
 {
-    struct sockaddr_storage address;
-    int fd;
+    for (int i = 0; i < ESP_TLS_MAX_ADDRESSES; i++) {
+        if (ctx->fds[i] >= 0) {
+            close(ctx->fds[i]);
+        }
+    }
+#if CONFIG_ESP_TLS_ASYNC_DNS
+    if (ctx->dns_job) {
+        esp_tls_dns_job_release(ctx->dns_job);
+    }
+#endif
+    free(ctx->host);
+    free(ctx);
+}
 
-    esp_tls_addr_family_t addr_family = (cfg != NULL) ? cfg->addr_family : ESP_TLS_AF_UNSPEC;
-    esp_err_t ret = esp_tls_hostname_to_fd(host, hostlen, port, addr_family, &address, &fd);
+static esp_err_t esp_tls_connect_ctx_create(const char *host, int hostlen, int port, const esp_tls_cfg_t *cfg,
+                                            bool resolve_in_background, esp_tls_connect_ctx_t **out)
+{
+    esp_tls_connect_ctx_t *ctx = calloc(1, sizeof(esp_tls_connect_ctx_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < ESP_TLS_MAX_ADDRESSES; i++) {
+        ctx->fds[i] = -1;
+    }
+    ctx->host = strndup(host, hostlen);
+    if (ctx->host == NULL) {
+        free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->addr_family = (cfg != NULL) ? cfg->addr_family : ESP_TLS_AF_UNSPEC;
+    ctx->port = port;
+
+    esp_err_t ret = ESP_OK;
+    if (esp_tls_dns_cache_get(ctx->host, ctx->addr_family, &ctx->addrs)) {
+        ESP_LOGD(TAG, "Using the cached addresses of %s", ctx->host);
+#if CONFIG_ESP_TLS_ASYNC_DNS
+    } else if (resolve_in_background) {
+        ret = esp_tls_dns_job_start(ctx->host, ctx->addr_family, &ctx->dns_job);
+#endif
+    } else {
+        ret = esp_tls_resolve(ctx->host, ctx->addr_family, &ctx->addrs);
+        if (ret == ESP_OK) {
+            esp_tls_dns_cache_put(ctx->host, ctx->addr_family, &ctx->addrs);
+        }
+    }
     if (ret != ESP_OK) {
-        ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, errno);
+        esp_tls_connect_ctx_destroy(ctx);
         return ret;
     }
+    *out = ctx;
+    return ESP_OK;
+}
+
+/* Returns the socket of the oldest attempt in progress, -1 if there is none */
+static int esp_tls_connect_ctx_pending_fd(const esp_tls_connect_ctx_t *ctx)
+{
+    for (int i = 0; i < ctx->next; i++) {
+        if (ctx->fds[i] >= 0) {
+            return ctx->fds[i];
+        }
+    }
+    return -1;
+}
+
+/* Starts the connection attempt to the next address, returns ESP_OK if it is in progress or established */
+static esp_err_t esp_tls_connect_ctx_start_next(esp_tls_connect_ctx_t *ctx, const esp_tls_cfg_t *cfg, esp_tls_error_handle_t error_handle, int *connected_fd)
+{
+    const int index = ctx->next++;
+    struct sockaddr_storage *address = &ctx->addrs.addr[index];
+    ctx->next_attempt_ms = esp_tls_time_ms() + CONFIG_ESP_TLS_CONNECT_ATTEMPT_DELAY;
 
+    int fd = socket(address->ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to create socket (family %d)", address->ss_family);
+        return ESP_ERR_ESP_TLS_CANNOT_CREATE_SOCKET;
+    }
     // Set timeout options, keep-alive options and bind device options if configured
-    ret = esp_tls_set_socket_options(fd, cfg);
+    esp_err_t ret = esp_tls_set_socket_options(fd, cfg);
     if (ret != ESP_OK) {
         goto err;
     }
-
     // Set to non block before connecting to better control connection timeout
     ret = esp_tls_set_socket_non_blocking(fd, true);
     if (ret != ESP_OK) {
         goto err;
     }
 
-    ret = ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST;
-    ESP_LOGD(TAG, "[sock=%d] Connecting to server. HOST: %s, Port: %d", fd, host, port);
-    if (connect(fd, (struct sockaddr *)&address, sizeof(struct sockaddr)) < 0) {
-        if (errno == EINPROGRESS) {
-            fd_set fdset;
-            struct timeval tv = { .tv_usec = 0, .tv_sec = ESP_TLS_DEFAULT_CONN_TIMEOUT }; // Default connection timeout is 10 s
+#if IPV6_ENABLED
+    if (address->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)address)->sin6_port = htons(ctx->port);
+    } else
+#endif
+    {
+        ((struct sockaddr_in *)address)->sin_port = htons(ctx->port);
+    }
+    ESP_LOGD(TAG, "[sock=%d] Connecting to server. HOST: %s, Port: %d, address %d", fd, ctx->host, ctx->port, index);
+    if (connect(fd, (struct sockaddr *)address, esp_tls_addr_len(address)) == 0) {
+        *connected_fd = fd;
+        return ESP_OK;
+    }
+    if (errno != EINPROGRESS) {
+        ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, errno);
+        ESP_LOGE(TAG, "[sock=%d] connect() error: %s", fd, strerror(errno));
+        ret = ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST;
+        goto err;
+    }
+    ctx->fds[index] = fd;
+    return ESP_OK;
+
+err:
+    close(fd);
+    return ret;
+}
+
+/**
+ * Makes progress on the connection attempts for at most wait_ms, or until a connection is established or all the
+ * attempts have failed if wait_ms is negative.
+ * Returns ESP_OK and sets *sockfd once a connection is established, sets it to -1 while in progress.
+ */
+static esp_err_t esp_tls_connect_ctx_run(esp_tls_connect_ctx_t *ctx, const esp_tls_cfg_t *cfg, esp_tls_error_handle_t error_handle,
+                                         int wait_ms, int *sockfd)
+{
+    const int64_t end_ms = esp_tls_time_ms() + wait_ms;
+    int connected_fd = -1;
+    *sockfd = -1;
+
+#if CONFIG_ESP_TLS_ASYNC_DNS
+    if (ctx->dns_job) {
+        esp_err_t err;
+        if (!esp_tls_dns_job_wait(ctx->dns_job, wait_ms, &ctx->addrs, &err)) {
+            return ESP_OK;
+        }
+        esp_tls_dns_job_release(ctx->dns_job);
+        ctx->dns_job = NULL;
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+#endif
 
-            if (cfg && cfg->non_block) {
-                // Non-blocking mode -> just return successfully at this stage
-                *sockfd = fd;
-                return ESP_OK;
+    esp_err_t last_err = ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST;
+    bool polled = false;
+    while (connected_fd < 0) {
+        int64_t now = esp_tls_time_ms();
+        int pending = 0;
+        int max_fd = -1;
+        fd_set fdset;
+        FD_ZERO(&fdset);
+        for (int i = 0; i < ctx->next; i++) {
+            if (ctx->fds[i] >= 0) {
+                pending++;
+                FD_SET(ctx->fds[i], &fdset);
+                max_fd = ctx->fds[i] > max_fd ? ctx->fds[i] : max_fd;
             }
+        }
 
-            if ( cfg && cfg->timeout_ms > 0 ) {
-                ms_to_timeval(cfg->timeout_ms, &tv);
+        if (ctx->next < ctx->addrs.num && (pending == 0 || now >= ctx->next_attempt_ms)) {
+            esp_err_t err = esp_tls_connect_ctx_start_next(ctx, cfg, error_handle, &connected_fd);
+            if (err != ESP_OK) {
+                last_err = err;
+                /* Do not wait before trying the next address */
+                ctx->next_attempt_ms = now;
             }
-            FD_ZERO(&fdset);
-            FD_SET(fd, &fdset);
-
-            int res = select(fd+1, NULL, &fdset, NULL, &tv);
-            if (res < 0) {
-                ESP_LOGE(TAG, "[sock=%d] select() error: %s", fd, strerror(errno));
-                ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, errno);
-                goto err;
+            continue;
+        }
+        if (pending == 0) {
+            /* The addresses may have changed */
+            esp_tls_dns_cache_forget(ctx->host, ctx->addr_family);
+            return last_err;
+        }
+        if (wait_ms >= 0 && polled && now >= end_ms) {
+            return ESP_OK;
+        }
+
+        /* Without a time limit, only the start of the next attempt interrupts the wait */
+        int64_t timeout_ms = wait_ms >= 0 ? end_ms - now : -1;
+        if (ctx->next < ctx->addrs.num && (timeout_ms < 0 || ctx->next_attempt_ms - now < timeout_ms)) {
+            timeout_ms = ctx->next_attempt_ms > now ? ctx->next_attempt_ms - now : 0;
+        }
+        struct timeval tv;
+        ms_to_timeval(timeout_ms > 0 ? (int)timeout_ms : 0, &tv);
+        int res = select(max_fd + 1, NULL, &fdset, NULL, timeout_ms >= 0 ? &tv : NULL);
+        polled = true;
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "select() error: %s", strerror(errno));
+            ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, errno);
+            return ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST;
+        }
+        for (int i = 0; i < ctx->next && res > 0; i++) {
+            int fd = ctx->fds[i];
+            if (fd < 0 || !FD_ISSET(fd, &fdset)) {
+                continue;
             }
-            else if (res == 0) {
-                ESP_LOGE(TAG, "[sock=%d] select() timeout", fd);
-                ret = ESP_ERR_ESP_TLS_CONNECTION_TIMEOUT;
-                goto err;
+            ctx->fds[i] = -1;
+            int sockerr;
+            socklen_t len = (socklen_t)sizeof(int);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (void*)(&sockerr), &len) < 0) {
+                ESP_LOGE(TAG, "[sock=%d] getsockopt() error: %s", fd, strerror(errno));
+                last_err = ESP_ERR_ESP_TLS_SOCKET_SETOPT_FAILED;
+                close(fd);
+            } else if (sockerr) {
+                ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, sockerr);
+                ESP_LOGD(TAG, "[sock=%d] delayed connect error: %s", fd, strerror(sockerr));
+                last_err = ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST;
+                close(fd);
+                ctx->next_attempt_ms = esp_tls_time_ms();
+            } else if (connected_fd < 0) {
+                connected_fd = fd;
             } else {
-                int sockerr;
-                socklen_t len = (socklen_t)sizeof(int);
-
-                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (void*)(&sockerr), &len) < 0) {
-                    ESP_LOGE(TAG, "[sock=%d] getsockopt() error: %s", fd, strerror(errno));
-                    ret = ESP_ERR_ESP_TLS_SOCKET_SETOPT_FAILED;
-                    goto err;
-                }
-                else if (sockerr) {
-                    ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, sockerr);
-                    ESP_LOGE(TAG, "[sock=%d] delayed connect error: %s", fd, strerror(sockerr));
-                    goto err;
-                }
+                close(fd);
             }
-        } else {
-            ESP_LOGE(TAG, "[sock=%d] connect() error: %s", fd, strerror(errno));
-            goto err;
         }
     }
 
+    /* The first connection established wins, the other attempts are abandoned */
+    for (int i = 0; i < ESP_TLS_MAX_ADDRESSES; i++) {
+        if (ctx->fds[i] >= 0) {
+            close(ctx->fds[i]);
+            ctx->fds[i] = -1;
+        }
+    }
     if (cfg && cfg->non_block == false) {
         // reset back to blocking mode (unless non_block configured)
-        ret = esp_tls_set_socket_non_blocking(fd, false);
+        esp_err_t ret = esp_tls_set_socket_non_blocking(connected_fd, false);
         if (ret != ESP_OK) {
-            goto err;
+            close(connected_fd);
+            return ret;
         }
     }
-
-    *sockfd = fd;
+    ESP_LOGD(TAG, "[sock=%d] Connected to %s", connected_fd, ctx->host);
+    *sockfd = connected_fd;
     return ESP_OK;
+}
 
-err:
-    close(fd);
+static inline esp_err_t tcp_connect(const char *host, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_error_handle_t error_handle, int *sockfd)
+{
+    esp_tls_connect_ctx_t *ctx;
+    esp_err_t ret = esp_tls_connect_ctx_create(host, hostlen, port, cfg, false, &ctx);
+    if (ret != ESP_OK) {
+        ESP_INT_EVENT_TRACKER_CAPTURE(error_handle, ESP_TLS_ERR_TYPE_SYSTEM, errno);
+        return ret;
+    }
+
+    if (cfg && cfg->non_block) {
+        // Non-blocking mode -> return the socket of the first attempt in progress
+        ret = esp_tls_connect_ctx_run(ctx, cfg, error_handle, 0, sockfd);
+        if (ret == ESP_OK && *sockfd < 0) {
+            *sockfd = esp_tls_connect_ctx_pending_fd(ctx);
+            for (int i = 0; i < ESP_TLS_MAX_ADDRESSES; i++) {
+                if (ctx->fds[i] == *sockfd) {
+                    ctx->fds[i] = -1;
+                }
+            }
+        }
+        esp_tls_connect_ctx_destroy(ctx);
+        return ret;
+    }
+
+    int timeout_ms = (cfg && cfg->timeout_ms > 0) ? cfg->timeout_ms : ESP_TLS_DEFAULT_CONN_TIMEOUT * 1000;
+    ret = esp_tls_connect_ctx_run(ctx, cfg, error_handle, timeout_ms, sockfd);
+    if (ret == ESP_OK && *sockfd < 0) {
+        ESP_LOGE(TAG, "Connection to %s timed out", ctx->host);
+        ret = ESP_ERR_ESP_TLS_CONNECTION_TIMEOUT;
+    }
+    esp_tls_connect_ctx_destroy(ctx);
     return ret;
 }
 
@@ -435,51 +877,48 @@ static int esp_tls_low_level_conn(const char *hostname, int hostlen, int port, c
             _esp_tls_net_init(tls);
             tls->is_tls = true;
         }
-        if ((esp_ret = tcp_connect(hostname, hostlen, port, cfg, tls->error_handle, &tls->sockfd)) != ESP_OK) {
+        if (cfg && cfg->non_block) {
+            /* The host name is resolved and the connection attempts are made in the next calls */
+            if ((esp_ret = esp_tls_connect_ctx_create(hostname, hostlen, port, cfg, true, &tls->connect_ctx)) != ESP_OK) {
+                ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, esp_ret);
+                tls->conn_state = ESP_TLS_FAIL;
+                return -1;
+            }
+        } else if ((esp_ret = tcp_connect(hostname, hostlen, port, cfg, tls->error_handle, &tls->sockfd)) != ESP_OK) {
             ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, esp_ret);
             return -1;
         }
-        if (tls->is_tls == false) {
-            tls->read = tcp_read;
-            tls->write = tcp_write;
-            ESP_LOGD(TAG, "non-tls connection established");
-            return 1;
-        }
-        if (cfg && cfg->non_block) {
-            FD_ZERO(&tls->rset);
-            FD_SET(tls->sockfd, &tls->rset);
-            tls->wset = tls->rset;
-        }
         tls->conn_state = ESP_TLS_CONNECTING;
     /* falls through */
     case ESP_TLS_CONNECTING:
-        if (cfg && cfg->non_block) {
+        if (tls->connect_ctx) {
             ESP_LOGD(TAG, "connecting...");
-            struct timeval tv;
-            ms_to_timeval(cfg->timeout_ms, &tv);
-
-            /* In case of non-blocking I/O, we use the select() API to check whether
-               connection has been established or not*/
-            if (select(tls->sockfd + 1, &tls->rset, &tls->wset, NULL,
-                       cfg->timeout_ms>0 ? &tv : NULL) == 0) {
-                ESP_LOGD(TAG, "select() timed out");
-                return 0;
+            /* Without a timeout, block until the connection is established or has failed */
+            esp_ret = esp_tls_connect_ctx_run(tls->connect_ctx, cfg, tls->error_handle, cfg->timeout_ms > 0 ? cfg->timeout_ms : -1, &tls->sockfd);
+            if (esp_ret != ESP_OK) {
+                ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, esp_ret);
+                esp_tls_connect_ctx_destroy(tls->connect_ctx);
+                tls->connect_ctx = NULL;
+                tls->conn_state = ESP_TLS_FAIL;
+                return -1;
             }
-            if (FD_ISSET(tls->sockfd, &tls->rset) || FD_ISSET(tls->sockfd, &tls->wset)) {
-                int error;
-                socklen_t len = sizeof(error);
-                /* pending error check */
-                if (getsockopt(tls->sockfd, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
-                    ESP_LOGD(TAG, "Non blocking connect failed");
-                    ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_SYSTEM, errno);
-                    ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, ESP_ERR_ESP_TLS_SOCKET_SETOPT_FAILED);
-                    tls->conn_state = ESP_TLS_FAIL;
-                    return -1;
-                }
+            if (tls->sockfd < 0) {
+                /* The caller may wait for the socket of an attempt, it stays owned by the connection context */
+                tls->sockfd = esp_tls_connect_ctx_pending_fd(tls->connect_ctx);
+                ESP_LOGD(TAG, "connection in progress");
+                return 0;
             }
+            esp_tls_connect_ctx_destroy(tls->connect_ctx);
+            tls->connect_ctx = NULL;
+        }
+        if (tls->is_tls == false) {
+            tls->read = tcp_read;
+            tls->write = tcp_write;
+            ESP_LOGD(TAG, "non-tls connection established");
+            return 1;
         }
         /* By now, the connection has been established */
-        esp_ret = create_ssl_handle(hostname, hostlen, cfg, tls);
+        esp_ret = create_ssl_handle(hostname, hostlen, port, cfg, tls);
         if (esp_ret != ESP_OK) {
             ESP_LOGE(TAG, "create_ssl_handle failed");
             ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, esp_ret);
@@ -635,6 +1074,13 @@ void esp_tls_free_client_session(esp_tls_client_session_t *client_session)
 {
     _esp_tls_free_client_session(client_session);
 }
+
+void esp_tls_client_session_cache_flush(void)
+{
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_CACHE)
+    _esp_tls_client_session_cache_flush();
+#endif
+}
 #endif /* CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS */
 
 
@@ -668,6 +1114,38 @@ void esp_tls_cfg_server_session_tickets_free(esp_tls_cfg_server_t *cfg)
 #endif
 }
 
+esp_err_t esp_tls_cfg_server_session_cache_init(esp_tls_cfg_server_t *cfg)
+{
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+    if (!cfg || cfg->session_cache) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cfg->session_cache = calloc(1, sizeof(esp_tls_server_session_cache_ctx_t));
+    if (!cfg->session_cache) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = _esp_tls_server_session_cache_ctx_init(cfg->session_cache);
+    if (ret != ESP_OK) {
+        free(cfg->session_cache);
+        cfg->session_cache = NULL;
+    }
+    return ret;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void esp_tls_cfg_server_session_cache_free(esp_tls_cfg_server_t *cfg)
+{
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+    if (cfg && cfg->session_cache) {
+        _esp_tls_server_session_cache_ctx_free(cfg->session_cache);
+        free(cfg->session_cache);
+        cfg->session_cache = NULL;
+    }
+#endif
+}
+
 /**
  * @brief      Create a server side TLS/SSL connection
  */
@@ -17,6 +17,9 @@
 #include "mbedtls/entropy.h"
 #include "mbedtls/ctr_drbg.h"
 #endif
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+#include "mbedtls/ssl_cache.h"
+#endif
 #elif CONFIG_ESP_TLS_USING_WOLFSSL
 #include "wolfssl/wolfcrypt/settings.h"
 #include "wolfssl/ssl.h"
@@ -212,6 +215,15 @@ typedef struct esp_tls_server_session_ticket_ctx {
 } esp_tls_server_session_ticket_ctx_t;
 #endif
 
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+/**
+ * @brief Data structures necessary to resume TLS sessions by their session ID on the server side
+ */
+typedef struct esp_tls_server_session_cache_ctx {
+    mbedtls_ssl_cache_context cache;                                            /*!< Session ID cache */
+} esp_tls_server_session_cache_ctx_t;
+#endif
+
 
 /**
  * @brief tls handshake callback
@@ -287,6 +299,15 @@ typedef struct esp_tls_cfg_server {
                                                     to free the data associated with this context. */
 #endif
 
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+    esp_tls_server_session_cache_ctx_t *session_cache; /*!< Session ID cache, which can be shared by
+                                                    several server configurations.
+                                                    You have to call esp_tls_cfg_server_session_cache_init
+                                                    to use it.
+                                                    Call esp_tls_cfg_server_session_cache_free
+                                                    to free the data associated with this context. */
+#endif
+
     void *userdata;                             /*!< User data to be added to the ssl context.
                                                   Can be retrieved by callbacks */
 #if defined(CONFIG_ESP_TLS_SERVER_CERT_SELECT_HOOK)
@@ -321,6 +342,29 @@ esp_err_t esp_tls_cfg_server_session_tickets_init(esp_tls_cfg_server_t *cfg);
  * @param cfg server configuration as esp_tls_cfg_server_t
  */
 void esp_tls_cfg_server_session_tickets_free(esp_tls_cfg_server_t *cfg);
+
+/**
+ * @brief Initialize the server side TLS session cache
+ *
+ * This function initializes the cache of the sessions established by the server,
+ * which lets clients resume their session by its session ID, without session tickets.
+ * Use esp_tls_cfg_server_session_cache_free to free the data.
+ *
+ * @param[in]  cfg server configuration as esp_tls_cfg_server_t
+ * @return
+ *             ESP_OK if setup succeeded
+ *             ESP_ERR_INVALID_ARG if context is already initialized
+ *             ESP_ERR_NO_MEM if memory allocation failed
+ *             ESP_ERR_NOT_SUPPORTED if the session cache is not available due to build configuration
+ */
+esp_err_t esp_tls_cfg_server_session_cache_init(esp_tls_cfg_server_t *cfg);
+
+/**
+ * @brief Free the server side TLS session cache
+ *
+ * @param cfg server configuration as esp_tls_cfg_server_t
+ */
+void esp_tls_cfg_server_session_cache_free(esp_tls_cfg_server_t *cfg);
 #endif /* ! CONFIG_ESP_TLS_SERVER */
 
 typedef struct esp_tls esp_tls_t;
@@ -397,6 +441,13 @@ int esp_tls_conn_http_new_sync(const char *url, const esp_tls_cfg_t *cfg, esp_tl
  * This function initiates a non-blocking TLS/SSL connection with the specified host, but due to
  * its non-blocking nature, it doesn't wait for the connection to get established.
  *
+ * While the connection is in progress, esp_tls_get_conn_sockfd() gives the socket of a connection
+ * attempt, which may be replaced by the socket of another attempt on the next call when the host
+ * has several addresses.
+ *
+ * Each call waits for the progress of the connection for at most `timeout_ms` of cfg. If `timeout_ms`
+ * is 0, the call blocks until the TCP connection is established or has failed.
+ *
  * @param[in]  hostname  Hostname of the host.
  * @param[in]  hostlen   Length of hostname.
  * @param[in]  port      Port number of the host.
@@ -704,6 +755,15 @@ void esp_tls_server_session_delete(esp_tls_t *tls);
  */
 esp_err_t esp_tls_plain_tcp_connect(const char *host, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_error_handle_t error_handle, int *sockfd);
 
+/**
+ * @brief      Drop all the host addresses of the DNS cache
+ *
+ * The addresses of the host names resolved by esp-tls are kept for CONFIG_ESP_TLS_DNS_CACHE_LIFETIME
+ * seconds when CONFIG_ESP_TLS_DNS_CACHE is enabled. This function can be called when they may
+ * have changed, e.g. after the network interface has been reconnected.
+ */
+void esp_tls_dns_cache_flush(void);
+
 #ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
 /**
  * @brief Obtain the client session ticket
@@ -727,6 +787,15 @@ esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls);
  *
  */
 void esp_tls_free_client_session(esp_tls_client_session_t *client_session);
+
+/**
+ * @brief Drop all the sessions of the client session cache
+ *
+ * The sessions established by the client are kept and resumed automatically when
+ * CONFIG_ESP_TLS_CLIENT_SESSION_CACHE is enabled. This function can be called when they
+ * should not be resumed anymore, e.g. after the CA certificates have been changed.
+ */
+void esp_tls_client_session_cache_flush(void);
 #endif /* CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS */
 #ifdef __cplusplus
 }
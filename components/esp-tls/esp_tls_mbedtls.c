@@ -19,11 +19,17 @@
 #include <errno.h>
 #include "esp_log.h"
 #include "esp_check.h"
+#include "mbedtls/platform_util.h"
 
 #ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
 #include "esp_crt_bundle.h"
 #endif
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+#include <pthread.h>
+#include <time.h>
+#endif
+
 #ifdef CONFIG_ESP_TLS_USE_SECURE_ELEMENT
 /* cryptoauthlib includes */
 #include "mbedtls/atca_mbedtls_wrap.h"
@@ -66,7 +72,215 @@ typedef struct esp_tls_pki_t {
 #endif
 } esp_tls_pki_t;
 
-esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, const void *cfg, esp_tls_t *tls)
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/**
+ * Settings the server was verified with. The server is not verified again when
+ * a session is resumed, so a session is only resumed with the same settings.
+ */
+typedef struct {
+    const unsigned char *cacert_buf;
+    unsigned int cacert_bytes;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    const psk_hint_key_t *psk_hint_key;
+    const unsigned char *clientcert_buf;
+    const void *ds_data;
+    bool use_global_ca_store;
+    bool skip_common_name;
+    bool use_secure_element;
+} client_session_scope_t;
+
+typedef struct {
+    char *key;                          /*!< Key of the connection the session was established on, NULL if the entry is free */
+    size_t key_len;
+    mbedtls_ssl_session session;
+    time_t expires_at;
+    uint32_t last_used;
+} client_session_cache_entry_t;
+
+static client_session_cache_entry_t s_client_sessions[CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE];
+static uint32_t s_client_session_clock;
+static pthread_mutex_t s_client_session_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t client_session_cache_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+static esp_err_t client_session_cache_set_key(const char *hostname, size_t hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls)
+{
+    client_session_scope_t scope;
+    /* The key is compared byte by byte, including the padding */
+    memset(&scope, 0, sizeof(scope));
+    scope.cacert_buf = cfg->cacert_buf;
+    scope.cacert_bytes = cfg->cacert_bytes;
+    scope.crt_bundle_attach = cfg->crt_bundle_attach;
+    scope.psk_hint_key = cfg->psk_hint_key;
+    scope.clientcert_buf = cfg->clientcert_buf;
+    scope.ds_data = cfg->ds_data;
+    scope.use_global_ca_store = cfg->use_global_ca_store;
+    scope.skip_common_name = cfg->skip_common_name;
+    scope.use_secure_element = cfg->use_secure_element;
+
+    const char *common_name = cfg->common_name ? cfg->common_name : "";
+    int name_len = snprintf(NULL, 0, "%.*s:%d/%s", (int)hostlen, hostname, port, common_name);
+    char *key = malloc(sizeof(scope) + name_len + 1);
+    if (key == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(key, &scope, sizeof(scope));
+    snprintf(key + sizeof(scope), name_len + 1, "%.*s:%d/%s", (int)hostlen, hostname, port, common_name);
+    tls->session_cache_key = key;
+    tls->session_cache_key_len = sizeof(scope) + name_len;
+    return ESP_OK;
+}
+
+static void client_session_cache_drop(client_session_cache_entry_t *entry)
+{
+    mbedtls_ssl_session_free(&entry->session);
+    free(entry->key);
+    entry->key = NULL;
+}
+
+/* Must be called with the lock held */
+static client_session_cache_entry_t *client_session_cache_find(const esp_tls_t *tls)
+{
+    const time_t now = client_session_cache_now();
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        client_session_cache_entry_t *entry = &s_client_sessions[i];
+        if (entry->key && now >= entry->expires_at) {
+            client_session_cache_drop(entry);
+        }
+        if (entry->key && entry->key_len == tls->session_cache_key_len &&
+                memcmp(entry->key, tls->session_cache_key, entry->key_len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void client_session_cache_resume(esp_tls_t *tls)
+{
+    pthread_mutex_lock(&s_client_session_lock);
+    client_session_cache_entry_t *entry = client_session_cache_find(tls);
+    if (entry) {
+        int ret = mbedtls_ssl_set_session(&tls->ssl, &entry->session);
+        if (ret == 0) {
+            entry->last_used = ++s_client_session_clock;
+            tls->session_from_cache = true;
+        } else {
+            ESP_LOGD(TAG, "mbedtls_ssl_set_session returned -0x%04X", -ret);
+        }
+    }
+    pthread_mutex_unlock(&s_client_session_lock);
+    ESP_LOGD(TAG, "%s cached session for %s", tls->session_from_cache ? "Resuming" : "No",
+             tls->session_cache_key + sizeof(client_session_scope_t));
+}
+
+static void client_session_cache_store(esp_tls_t *tls)
+{
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    int ret = mbedtls_ssl_get_session(&tls->ssl, &session);
+    if (ret != 0) {
+        ESP_LOGD(TAG, "mbedtls_ssl_get_session returned -0x%04X", -ret);
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+    char *key = malloc(tls->session_cache_key_len);
+    if (key == NULL) {
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+    memcpy(key, tls->session_cache_key, tls->session_cache_key_len);
+
+    time_t lifetime = CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_LIFETIME;
+    const uint32_t ticket_lifetime = session.MBEDTLS_PRIVATE(ticket_lifetime);
+    if (ticket_lifetime != 0 && ticket_lifetime < lifetime) {
+        lifetime = ticket_lifetime;
+    }
+    time_t expires_at = client_session_cache_now() + lifetime;
+
+    pthread_mutex_lock(&s_client_session_lock);
+    client_session_cache_entry_t *slot = client_session_cache_find(tls);
+    if (slot) {
+        /* A resumed session does not live longer than the original one */
+        if (tls->session_from_cache && slot->expires_at < expires_at) {
+            expires_at = slot->expires_at;
+        }
+    } else {
+        for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+            client_session_cache_entry_t *entry = &s_client_sessions[i];
+            if (entry->key == NULL) {
+                slot = entry;
+                break;
+            }
+            if (slot == NULL || s_client_session_clock - entry->last_used > s_client_session_clock - slot->last_used) {
+                slot = entry;
+            }
+        }
+    }
+    if (slot->key) {
+        client_session_cache_drop(slot);
+    }
+    slot->key = key;
+    slot->key_len = tls->session_cache_key_len;
+    slot->session = session;
+    slot->expires_at = expires_at;
+    slot->last_used = ++s_client_session_clock;
+    pthread_mutex_unlock(&s_client_session_lock);
+    tls->session_cached = true;
+}
+
+/* mbedtls exports the session of a connection only once, so once it is in the cache, copies are made from there */
+static int client_session_cache_copy(esp_tls_t *tls, mbedtls_ssl_session *session)
+{
+    int ret = MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+    pthread_mutex_lock(&s_client_session_lock);
+    client_session_cache_entry_t *entry = client_session_cache_find(tls);
+    if (entry) {
+        size_t len = 0;
+        mbedtls_ssl_session_save(&entry->session, NULL, 0, &len);
+        unsigned char *buf = malloc(len);
+        if (buf == NULL) {
+            ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+        } else {
+            ret = mbedtls_ssl_session_save(&entry->session, buf, len, &len);
+            if (ret == 0) {
+                ret = mbedtls_ssl_session_load(session, buf, len);
+            }
+            mbedtls_platform_zeroize(buf, len);
+            free(buf);
+        }
+    }
+    pthread_mutex_unlock(&s_client_session_lock);
+    return ret;
+}
+
+static void client_session_cache_forget(esp_tls_t *tls)
+{
+    pthread_mutex_lock(&s_client_session_lock);
+    client_session_cache_entry_t *entry = client_session_cache_find(tls);
+    if (entry) {
+        client_session_cache_drop(entry);
+    }
+    pthread_mutex_unlock(&s_client_session_lock);
+}
+
+void esp_mbedtls_client_session_cache_flush(void)
+{
+    pthread_mutex_lock(&s_client_session_lock);
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (s_client_sessions[i].key) {
+            client_session_cache_drop(&s_client_sessions[i]);
+        }
+    }
+    pthread_mutex_unlock(&s_client_session_lock);
+}
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
+
+esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, int port, const void *cfg, esp_tls_t *tls)
 {
     assert(cfg != NULL);
     assert(tls != NULL);
@@ -93,6 +307,14 @@ esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, const
             ESP_LOGE(TAG, "Failed to set client configurations, returned [0x%04X] (%s)", esp_ret, esp_err_to_name(esp_ret));
             goto exit;
         }
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        if (((esp_tls_cfg_t *)cfg)->client_session == NULL) {
+            esp_ret = client_session_cache_set_key(hostname, hostlen, port, (esp_tls_cfg_t *)cfg, tls);
+            if (esp_ret != ESP_OK) {
+                goto exit;
+            }
+        }
+#endif
     } else if (tls->role == ESP_TLS_SERVER) {
 #ifdef CONFIG_ESP_TLS_SERVER
         esp_ret = set_server_config((esp_tls_cfg_server_t *) cfg, tls);
@@ -135,6 +357,11 @@ esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, const
     }
     mbedtls_ssl_set_bio(&tls->ssl, &tls->server_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    if (tls->session_cache_key) {
+        client_session_cache_resume(tls);
+    }
+#endif
     return ESP_OK;
 
 exit:
@@ -166,7 +393,16 @@ esp_tls_client_session_t *esp_mbedtls_get_client_session(esp_tls_t *tls)
         return NULL;
     }
 
-    int ret = mbedtls_ssl_get_session(&tls->ssl, &(client_session->saved_session));
+    int ret;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    if (tls->session_cached) {
+        ret = client_session_cache_copy(tls, &(client_session->saved_session));
+    } else {
+        ret = mbedtls_ssl_get_session(&tls->ssl, &(client_session->saved_session));
+    }
+#else
+    ret = mbedtls_ssl_get_session(&tls->ssl, &(client_session->saved_session));
+#endif
     if (ret != 0) {
         ESP_LOGE(TAG, "Error in obtaining the client ssl session");
         mbedtls_print_error_msg(ret);
@@ -201,6 +437,11 @@ int esp_mbedtls_handshake(esp_tls_t *tls, const esp_tls_cfg_t *cfg)
     ret = mbedtls_ssl_handshake(&tls->ssl);
     if (ret == 0) {
         tls->conn_state = ESP_TLS_DONE;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        if (tls->session_cache_key) {
+            client_session_cache_store(tls);
+        }
+#endif
 
 #ifdef CONFIG_ESP_TLS_USE_DS_PERIPHERAL
         esp_ds_release_ds_lock();
@@ -216,6 +457,12 @@ int esp_mbedtls_handshake(esp_tls_t *tls, const esp_tls_cfg_t *cfg)
                 /* This is to check whether handshake failed due to invalid certificate*/
                 esp_mbedtls_verify_certificate(tls);
             }
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+            if (tls->session_from_cache) {
+                /* The session may be the reason of the failure, do not resume it again */
+                client_session_cache_forget(tls);
+            }
+#endif
             tls->conn_state = ESP_TLS_FAIL;
             return -1;
         }
@@ -232,6 +479,11 @@ ssize_t esp_mbedtls_read(esp_tls_t *tls, char *data, size_t datalen)
 #if CONFIG_MBEDTLS_SSL_PROTO_TLS1_3 && CONFIG_MBEDTLS_CLIENT_SSL_SESSION_TICKETS
     while (ret == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) {
         ESP_LOGD(TAG, "got session ticket in TLS 1.3 connection, retry read");
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        if (tls->session_cache_key) {
+            client_session_cache_store(tls);
+        }
+#endif
         ret = mbedtls_ssl_read(&tls->ssl, (unsigned char *)data, datalen);
     }
 #endif // CONFIG_MBEDTLS_SSL_PROTO_TLS1_3 && CONFIG_MBEDTLS_CLIENT_SSL_SESSION_TICKETS
@@ -342,6 +594,12 @@ void esp_mbedtls_cleanup(esp_tls_t *tls)
     mbedtls_ssl_config_free(&tls->conf);
     mbedtls_ctr_drbg_free(&tls->ctr_drbg);
     mbedtls_ssl_free(&tls->ssl);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    free(tls->session_cache_key);
+    tls->session_cache_key = NULL;
+    tls->session_from_cache = false;
+    tls->session_cached = false;
+#endif
 #ifdef CONFIG_ESP_TLS_USE_SECURE_ELEMENT
     atcab_release();
 #endif
@@ -512,6 +770,28 @@ void esp_mbedtls_server_session_ticket_ctx_free(esp_tls_server_session_ticket_ct
 }
 #endif
 
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+esp_err_t esp_mbedtls_server_session_cache_ctx_init(esp_tls_server_session_cache_ctx_t *ctx)
+{
+    if (!ctx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mbedtls_ssl_cache_init(&ctx->cache);
+    mbedtls_ssl_cache_set_max_entries(&ctx->cache, CONFIG_ESP_TLS_SERVER_SESSION_CACHE_SIZE);
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE_TIMEOUT
+    mbedtls_ssl_cache_set_timeout(&ctx->cache, CONFIG_ESP_TLS_SERVER_SESSION_CACHE_TIMEOUT);
+#endif
+    return ESP_OK;
+}
+
+void esp_mbedtls_server_session_cache_ctx_free(esp_tls_server_session_cache_ctx_t *ctx)
+{
+    if (ctx) {
+        mbedtls_ssl_cache_free(&ctx->cache);
+    }
+}
+#endif
+
 esp_err_t set_server_config(esp_tls_cfg_server_t *cfg, esp_tls_t *tls)
 {
     assert(cfg != NULL);
@@ -619,6 +899,14 @@ esp_err_t set_server_config(esp_tls_cfg_server_t *cfg, esp_tls_t *tls)
     }
 #endif
 
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+    if (cfg->session_cache) {
+        ESP_LOGD(TAG, "Enabling server-side tls session cache");
+        mbedtls_ssl_conf_session_cache(&tls->conf, &cfg->session_cache->cache,
+                                       mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+    }
+#endif
+
     return ESP_OK;
 }
 #endif /* ! CONFIG_ESP_TLS_SERVER */
@@ -823,7 +1111,7 @@ int esp_mbedtls_server_session_create(esp_tls_cfg_server_t *cfg, int sockfd, esp
     }
     tls->role = ESP_TLS_SERVER;
     tls->sockfd = sockfd;
-    esp_err_t esp_ret = esp_create_mbedtls_handle(NULL, 0, cfg, tls);
+    esp_err_t esp_ret = esp_create_mbedtls_handle(NULL, 0, 0, cfg, tls);
     if (esp_ret != ESP_OK) {
         ESP_LOGE(TAG, "create_ssl_handle failed, returned [0x%04X] (%s)", esp_ret, esp_err_to_name(esp_ret));
         ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, esp_ret);
@@ -0,0 +1,431 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "esp_tls.h"
+
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define TEST_HOST_MAX_ADDRESSES     2
+#define TEST_TIMEOUT_MS             5000
+#define TEST_RESOLVE_DELAY_MS       300
+#define TEST_POLL_TIMEOUT_MS        20
+
+/* Host names resolved by the test, the other ones are resolved by the system */
+typedef struct {
+    const char *host;
+    const char *addresses[TEST_HOST_MAX_ADDRESSES];     /*!< The resolution fails if there is none */
+    int delay_ms;                                       /*!< Time taken by the resolution */
+} test_host_t;
+
+static const test_host_t s_test_hosts[] = {
+    { "cached.test", { "127.0.0.1" } },
+    /* Nothing answers on 127.0.0.2, see listen_slow() */
+    { "slow.test", { "127.0.0.2", "127.0.0.1" } },
+    /* Nothing listens on 127.0.0.3 */
+    { "refused.test", { "127.0.0.3", "127.0.0.1" } },
+    { "down.test", { "127.0.0.3" } },
+    { "delayed.test", { "127.0.0.1" }, TEST_RESOLVE_DELAY_MS },
+    { "unknown.test", { NULL }, TEST_RESOLVE_DELAY_MS },
+};
+
+static atomic_int s_resolve_count;
+static int s_listen_sock = -1;
+static int s_port;
+
+int __real_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res);
+
+int __wrap_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res)
+{
+    for (size_t i = 0; i < sizeof(s_test_hosts) / sizeof(s_test_hosts[0]); i++) {
+        if (strcmp(node, s_test_hosts[i].host) != 0) {
+            continue;
+        }
+        s_resolve_count++;
+        usleep(s_test_hosts[i].delay_ms * 1000);
+        if (s_test_hosts[i].addresses[0] == NULL) {
+            return EAI_NONAME;
+        }
+        struct addrinfo numeric_hints = { 0 };
+        if (hints) {
+            numeric_hints = *hints;
+        }
+        numeric_hints.ai_flags |= AI_NUMERICHOST;
+        struct addrinfo **tail = res;
+        *res = NULL;
+        for (int j = 0; j < TEST_HOST_MAX_ADDRESSES && s_test_hosts[i].addresses[j]; j++) {
+            int ret = __real_getaddrinfo(s_test_hosts[i].addresses[j], service, &numeric_hints, tail);
+            if (ret != 0) {
+                freeaddrinfo(*res);
+                *res = NULL;
+                return ret;
+            }
+            while (*tail) {
+                tail = &(*tail)->ai_next;
+            }
+        }
+        return 0;
+    }
+    return __real_getaddrinfo(node, service, hints, res);
+}
+
+static int64_t now_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int listen_on(const char *address, int port, int backlog)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    TEST_ASSERT_EQUAL(1, inet_pton(AF_INET, address, &addr.sin_addr));
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    TEST_ASSERT_EQUAL(0, bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(sock, backlog));
+    return sock;
+}
+
+/* Listens on 127.0.0.2 with a full accept queue: the next connection attempts stay in progress */
+static int listen_slow(int filler_socks[2])
+{
+    int sock = listen_on("127.0.0.2", s_port, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(s_port),
+    };
+    inet_pton(AF_INET, "127.0.0.2", &addr.sin_addr);
+    for (int i = 0; i < 2; i++) {
+        filler_socks[i] = socket(AF_INET, SOCK_STREAM, 0);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, filler_socks[i]);
+        fcntl(filler_socks[i], F_SETFL, O_NONBLOCK);
+        connect(filler_socks[i], (struct sockaddr *)&addr, sizeof(addr));
+    }
+    /* Let the handshake of the first one complete */
+    usleep(50 * 1000);
+    return sock;
+}
+
+static void close_slow(int sock, int filler_socks[2])
+{
+    close(filler_socks[0]);
+    close(filler_socks[1]);
+    close(sock);
+}
+
+static void get_peer(esp_tls_t *tls, char peer[INET_ADDRSTRLEN])
+{
+    int sockfd;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_get_conn_sockfd(tls, &sockfd));
+    TEST_ASSERT_EQUAL(0, getpeername(sockfd, (struct sockaddr *)&addr, &len));
+    TEST_ASSERT_NOT_NULL(inet_ntop(AF_INET, &addr.sin_addr, peer, INET_ADDRSTRLEN));
+    TEST_ASSERT_EQUAL(s_port, ntohs(addr.sin_port));
+}
+
+/* Opens a plain TCP connection, gets the address it is established to */
+static int connect_plain(const char *host, char peer[INET_ADDRSTRLEN])
+{
+    esp_tls_cfg_t cfg = {
+        .is_plain_tcp = true,
+        .timeout_ms = TEST_TIMEOUT_MS,
+    };
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    int ret = esp_tls_conn_new_sync(host, strlen(host), s_port, &cfg, tls);
+    if (ret == 1) {
+        get_peer(tls, peer);
+    }
+    esp_tls_conn_destroy(tls);
+    return ret;
+}
+
+TEST_GROUP(esp_tls_connect);
+
+TEST_SETUP(esp_tls_connect)
+{
+    s_listen_sock = listen_on("127.0.0.1", 0, 8);
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    TEST_ASSERT_EQUAL(0, getsockname(s_listen_sock, (struct sockaddr *)&addr, &len));
+    s_port = ntohs(addr.sin_port);
+    esp_tls_dns_cache_flush();
+    s_resolve_count = 0;
+}
+
+TEST_TEAR_DOWN(esp_tls_connect)
+{
+    close(s_listen_sock);
+    esp_tls_dns_cache_flush();
+}
+
+TEST(esp_tls_connect, dns_cache_answers_the_next_connections)
+{
+    char peer[INET_ADDRSTRLEN];
+    TEST_ASSERT_EQUAL(1, connect_plain("cached.test", peer));
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    TEST_ASSERT_EQUAL(1, connect_plain("cached.test", peer));
+    TEST_ASSERT_EQUAL(1, s_resolve_count);
+
+    esp_tls_dns_cache_flush();
+    TEST_ASSERT_EQUAL(1, connect_plain("cached.test", peer));
+    TEST_ASSERT_EQUAL(2, s_resolve_count);
+}
+
+TEST(esp_tls_connect, dns_cache_entries_expire)
+{
+    char peer[INET_ADDRSTRLEN];
+    TEST_ASSERT_EQUAL(1, connect_plain("cached.test", peer));
+    TEST_ASSERT_EQUAL(1, s_resolve_count);
+    usleep((CONFIG_ESP_TLS_DNS_CACHE_LIFETIME * 1000 + 100) * 1000);
+    TEST_ASSERT_EQUAL(1, connect_plain("cached.test", peer));
+    TEST_ASSERT_EQUAL(2, s_resolve_count);
+}
+
+TEST(esp_tls_connect, dns_cache_drops_the_addresses_which_cannot_be_connected_to)
+{
+    char peer[INET_ADDRSTRLEN];
+    TEST_ASSERT_EQUAL(-1, connect_plain("down.test", peer));
+    TEST_ASSERT_EQUAL(-1, connect_plain("down.test", peer));
+    TEST_ASSERT_EQUAL(2, s_resolve_count);
+}
+
+TEST(esp_tls_connect, next_address_is_tried_after_the_attempt_delay)
+{
+    int filler_socks[2];
+    int slow_sock = listen_slow(filler_socks);
+
+    char peer[INET_ADDRSTRLEN];
+    int64_t start = now_ms();
+    TEST_ASSERT_EQUAL(1, connect_plain("slow.test", peer));
+    int64_t elapsed = now_ms() - start;
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    TEST_ASSERT_GREATER_OR_EQUAL(CONFIG_ESP_TLS_CONNECT_ATTEMPT_DELAY, elapsed);
+    TEST_ASSERT_LESS_THAN(CONFIG_ESP_TLS_CONNECT_ATTEMPT_DELAY + 500, elapsed);
+
+    close_slow(slow_sock, filler_socks);
+}
+
+TEST(esp_tls_connect, next_address_is_tried_at_once_after_a_refusal)
+{
+    char peer[INET_ADDRSTRLEN];
+    int64_t start = now_ms();
+    TEST_ASSERT_EQUAL(1, connect_plain("refused.test", peer));
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    TEST_ASSERT_LESS_THAN(CONFIG_ESP_TLS_CONNECT_ATTEMPT_DELAY, now_ms() - start);
+}
+
+TEST(esp_tls_connect, non_blocking_connection_gives_the_socket_of_the_attempt_in_progress)
+{
+    int filler_socks[2];
+    int slow_sock = listen_slow(filler_socks);
+    esp_tls_cfg_t cfg = {
+        .is_plain_tcp = true,
+        .non_block = true,
+        .timeout_ms = TEST_POLL_TIMEOUT_MS,
+    };
+
+    /* The caller waits for the socket of the attempt to 127.0.0.2, then for the one of the attempt to 127.0.0.1 */
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    TEST_ASSERT_EQUAL(0, esp_tls_conn_new_async("slow.test", strlen("slow.test"), s_port, &cfg, tls));
+    int first_sockfd;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_get_conn_sockfd(tls, &first_sockfd));
+    TEST_ASSERT_GREATER_OR_EQUAL(0, first_sockfd);
+    int ret;
+    const int64_t end = now_ms() + TEST_TIMEOUT_MS;
+    while ((ret = esp_tls_conn_new_async("slow.test", strlen("slow.test"), s_port, &cfg, tls)) == 0) {
+        TEST_ASSERT_LESS_THAN(end, now_ms());
+        int sockfd;
+        TEST_ASSERT_EQUAL(ESP_OK, esp_tls_get_conn_sockfd(tls, &sockfd));
+        TEST_ASSERT_GREATER_OR_EQUAL(0, sockfd);
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(sockfd, &wfds);
+        struct timeval tv = { .tv_usec = 50 * 1000 };
+        select(sockfd + 1, NULL, &wfds, NULL, &tv);
+    }
+    TEST_ASSERT_EQUAL(1, ret);
+    char peer[INET_ADDRSTRLEN];
+    get_peer(tls, peer);
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    esp_tls_conn_destroy(tls);
+
+    /* The socket of the attempt in progress is closed with the connection */
+    tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    TEST_ASSERT_EQUAL(0, esp_tls_conn_new_async("slow.test", strlen("slow.test"), s_port, &cfg, tls));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_get_conn_sockfd(tls, &first_sockfd));
+    TEST_ASSERT_GREATER_OR_EQUAL(0, first_sockfd);
+    esp_tls_conn_destroy(tls);
+    TEST_ASSERT_EQUAL(-1, fcntl(first_sockfd, F_GETFD));
+    TEST_ASSERT_EQUAL(EBADF, errno);
+
+    close_slow(slow_sock, filler_socks);
+}
+
+TEST(esp_tls_connect, non_blocking_connection_without_timeout_blocks_until_established)
+{
+    int filler_socks[2];
+    int slow_sock = listen_slow(filler_socks);
+    esp_tls_cfg_t cfg = {
+        .is_plain_tcp = true,
+        .non_block = true,
+    };
+
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    int64_t start = now_ms();
+    TEST_ASSERT_EQUAL(1, esp_tls_conn_new_async("slow.test", strlen("slow.test"), s_port, &cfg, tls));
+    TEST_ASSERT_GREATER_OR_EQUAL(CONFIG_ESP_TLS_CONNECT_ATTEMPT_DELAY, now_ms() - start);
+    char peer[INET_ADDRSTRLEN];
+    get_peer(tls, peer);
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    esp_tls_conn_destroy(tls);
+
+    close_slow(slow_sock, filler_socks);
+}
+
+#if CONFIG_ESP_TLS_ASYNC_DNS
+/* Calls esp_tls_conn_new_async() until it is done, returns its result and the number of calls */
+static int poll_async(const char *host, const esp_tls_cfg_t *cfg, esp_tls_t *tls, int *calls)
+{
+    int ret;
+    const int64_t end = now_ms() + TEST_TIMEOUT_MS;
+    *calls = 0;
+    do {
+        TEST_ASSERT_LESS_THAN(end, now_ms());
+        ret = esp_tls_conn_new_async(host, strlen(host), s_port, cfg, tls);
+        (*calls)++;
+    } while (ret == 0);
+    return ret;
+}
+
+TEST(esp_tls_connect, async_dns_does_not_block_the_calls)
+{
+    esp_tls_cfg_t cfg = {
+        .is_plain_tcp = true,
+        .non_block = true,
+        .timeout_ms = TEST_POLL_TIMEOUT_MS,
+    };
+
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    int64_t start = now_ms();
+    TEST_ASSERT_EQUAL(0, esp_tls_conn_new_async("delayed.test", strlen("delayed.test"), s_port, &cfg, tls));
+    TEST_ASSERT_LESS_THAN(TEST_RESOLVE_DELAY_MS, now_ms() - start);
+    /* There is no socket to wait for while the host name is resolved */
+    int sockfd;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_get_conn_sockfd(tls, &sockfd));
+    TEST_ASSERT_EQUAL(-1, sockfd);
+
+    int calls;
+    TEST_ASSERT_EQUAL(1, poll_async("delayed.test", &cfg, tls, &calls));
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_RESOLVE_DELAY_MS, now_ms() - start);
+    TEST_ASSERT_GREATER_THAN(TEST_RESOLVE_DELAY_MS / TEST_POLL_TIMEOUT_MS / 2, calls);
+    char peer[INET_ADDRSTRLEN];
+    get_peer(tls, peer);
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    esp_tls_conn_destroy(tls);
+    TEST_ASSERT_EQUAL(1, s_resolve_count);
+}
+
+TEST(esp_tls_connect, async_dns_outlives_a_destroyed_connection)
+{
+    esp_tls_cfg_t cfg = {
+        .is_plain_tcp = true,
+        .non_block = true,
+        .timeout_ms = TEST_POLL_TIMEOUT_MS,
+    };
+
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    TEST_ASSERT_EQUAL(0, esp_tls_conn_new_async("delayed.test", strlen("delayed.test"), s_port, &cfg, tls));
+    esp_tls_conn_destroy(tls);
+
+    /* The resolution completes on its own and its result is cached for the next connection */
+    usleep((TEST_RESOLVE_DELAY_MS + 100) * 1000);
+    TEST_ASSERT_EQUAL(1, s_resolve_count);
+    char peer[INET_ADDRSTRLEN];
+    int64_t start = now_ms();
+    TEST_ASSERT_EQUAL(1, connect_plain("delayed.test", peer));
+    TEST_ASSERT_LESS_THAN(TEST_RESOLVE_DELAY_MS, now_ms() - start);
+    TEST_ASSERT_EQUAL_STRING("127.0.0.1", peer);
+    TEST_ASSERT_EQUAL(1, s_resolve_count);
+}
+
+TEST(esp_tls_connect, async_dns_failure_fails_the_connection)
+{
+    esp_tls_cfg_t cfg = {
+        .is_plain_tcp = true,
+        .non_block = true,
+        .timeout_ms = TEST_POLL_TIMEOUT_MS,
+    };
+
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    int calls;
+    TEST_ASSERT_EQUAL(-1, poll_async("unknown.test", &cfg, tls, &calls));
+    TEST_ASSERT_GREATER_THAN(1, calls);
+    esp_tls_error_handle_t error_handle;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_get_error_handle(tls, &error_handle));
+    TEST_ASSERT_EQUAL(ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME, esp_tls_get_and_clear_last_error(error_handle, NULL, NULL));
+    esp_tls_conn_destroy(tls);
+
+    /* Failures are not cached */
+    tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    TEST_ASSERT_EQUAL(-1, poll_async("unknown.test", &cfg, tls, &calls));
+    esp_tls_conn_destroy(tls);
+    TEST_ASSERT_EQUAL(2, s_resolve_count);
+}
+#endif /* CONFIG_ESP_TLS_ASYNC_DNS */
+
+TEST_GROUP_RUNNER(esp_tls_connect)
+{
+    RUN_TEST_CASE(esp_tls_connect, dns_cache_answers_the_next_connections);
+    RUN_TEST_CASE(esp_tls_connect, dns_cache_entries_expire);
+    RUN_TEST_CASE(esp_tls_connect, dns_cache_drops_the_addresses_which_cannot_be_connected_to);
+    RUN_TEST_CASE(esp_tls_connect, next_address_is_tried_after_the_attempt_delay);
+    RUN_TEST_CASE(esp_tls_connect, next_address_is_tried_at_once_after_a_refusal);
+    RUN_TEST_CASE(esp_tls_connect, non_blocking_connection_gives_the_socket_of_the_attempt_in_progress);
+    RUN_TEST_CASE(esp_tls_connect, non_blocking_connection_without_timeout_blocks_until_established);
+#if CONFIG_ESP_TLS_ASYNC_DNS
+    RUN_TEST_CASE(esp_tls_connect, async_dns_does_not_block_the_calls);
+    RUN_TEST_CASE(esp_tls_connect, async_dns_outlives_a_destroyed_connection);
+    RUN_TEST_CASE(esp_tls_connect, async_dns_failure_fails_the_connection);
+#endif
+}
+
+static void run_all_tests(void)
+{
+    RUN_TEST_GROUP(esp_tls_connect);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_MAIN_FUNC(run_all_tests);
+    return 0;
+}
@@ -46,7 +46,7 @@ ssize_t esp_mbedtls_get_bytes_avail(esp_tls_t *tls);
 /**
  * Internal Callback for creating ssl handle for mbedtls
  */
-esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, const void *cfg, esp_tls_t *tls);
+esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, int port, const void *cfg, esp_tls_t *tls);
 
 /**
  * mbedTLS function for Initializing socket wrappers
@@ -98,6 +98,22 @@ esp_err_t esp_mbedtls_server_session_ticket_ctx_init(esp_tls_server_session_tick
  */
 void esp_mbedtls_server_session_ticket_ctx_free(esp_tls_server_session_ticket_ctx_t *cfg);
 #endif
+
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+/**
+ * Internal function to setup server side session cache context
+ *
+ * /note :- The function can only be used with mbedtls ssl library
+ */
+esp_err_t esp_mbedtls_server_session_cache_ctx_init(esp_tls_server_session_cache_ctx_t *ctx);
+
+/**
+ * Internal function to free server side session cache context
+ *
+ * /note :- The function can only be used with mbedtls ssl library
+ */
+void esp_mbedtls_server_session_cache_ctx_free(esp_tls_server_session_cache_ctx_t *ctx);
+#endif
 #endif
 
 /**
@@ -115,6 +131,13 @@ esp_tls_client_session_t *esp_mbedtls_get_client_session(esp_tls_t *tls);
  * Internal Callback for mbedtls_free_client_session
  */
 void esp_mbedtls_free_client_session(esp_tls_client_session_t *client_session);
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/**
+ * Internal function to drop all the sessions of the client session cache
+ */
+void esp_mbedtls_client_session_cache_flush(void);
+#endif
 #endif
 
 /**
@@ -34,6 +34,8 @@
 #include "wolfssl/ssl.h"
 #endif
 
+typedef struct esp_tls_connect_ctx esp_tls_connect_ctx_t;
+
 struct esp_tls {
 #ifdef CONFIG_ESP_TLS_USING_MBEDTLS
     mbedtls_ssl_context ssl;                                                    /*!< TLS/SSL context */
@@ -58,6 +60,17 @@ struct esp_tls {
 
     mbedtls_pk_context clientkey;                                               /*!< Container for the private key of the client
                                                                                      certificate */
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    char *session_cache_key;                                                    /*!< Key of the connection in the client session cache:
+                                                                                     verification settings followed by host and port */
+
+    size_t session_cache_key_len;                                               /*!< Length of the key */
+
+    bool session_from_cache;                                                    /*!< A session of the client session cache is resumed */
+
+    bool session_cached;                                                        /*!< The session of the connection has been stored in
+                                                                                     the client session cache */
+#endif
 #ifdef CONFIG_ESP_TLS_SERVER
     mbedtls_x509_crt servercert;                                                /*!< Container for the X.509 server certificate */
 
@@ -78,10 +91,6 @@ struct esp_tls {
 
     esp_tls_conn_state_t  conn_state;                                           /*!< ESP-TLS Connection state */
 
-    fd_set rset;                                                                /*!< read file descriptors */
-
-    fd_set wset;                                                                /*!< write file descriptors */
-
     bool is_tls;                                                                /*!< indicates connection type (TLS or NON-TLS) */
 
     esp_tls_role_t role;                                                        /*!< esp-tls role
@@ -90,4 +99,7 @@ struct esp_tls {
 
     esp_tls_error_handle_t error_handle;                                        /*!< handle to error descriptor */
 
+    esp_tls_connect_ctx_t *connect_ctx;                                         /*!< Connection attempts in progress
+                                                                                     in case of non-blocking connect */
+
 };
@@ -11,7 +11,7 @@
 /**
  * Internal Callback for creating ssl handle for wolfssl
  */
-int esp_create_wolfssl_handle(const char *hostname, size_t hostlen, const void *cfg, esp_tls_t *tls);
+int esp_create_wolfssl_handle(const char *hostname, size_t hostlen, int port, const void *cfg, esp_tls_t *tls);
 
 /**
  * Internal Callback for wolfssl_handshake
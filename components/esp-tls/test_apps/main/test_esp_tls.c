@@ -4,13 +4,20 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <unistd.h>
+#include <sys/param.h>
 #include "memory_checks.h"
 #include "esp_tls.h"
 #include "unity.h"
+#include "test_utils.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "sys/socket.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mbedtls/ssl.h"
 
 const char *test_cert_pem =   "-----BEGIN CERTIFICATE-----\n"\
                               "MIICrDCCAZQCCQD88gCs5AFs/jANBgkqhkiG9w0BAQsFADAYMRYwFAYDVQQDDA1F\n"\
@@ -96,3 +103,260 @@ TEST_CASE("esp_tls_server session create delete", "[esp-tls]")
 
 }
 #endif
+
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+TEST_CASE("esp_tls_server session cache init free", "[esp-tls]")
+{
+    esp_tls_cfg_server_t cfg = {
+        .servercert_buf = (const unsigned char *)test_cert_pem,
+        .servercert_bytes = strlen(test_cert_pem) + 1,
+        .serverkey_buf = (const unsigned char *)test_key_pem,
+        .serverkey_bytes = strlen(test_key_pem) + 1,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_cfg_server_session_cache_init(&cfg));
+    TEST_ASSERT_NOT_NULL(cfg.session_cache);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_tls_cfg_server_session_cache_init(&cfg));
+
+    struct esp_tls *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    // The handshake fails (no socket), but the session cache is configured for the connection.
+    int ret = esp_tls_server_session_create(&cfg, -1, tls);
+    TEST_ASSERT_LESS_THAN_INT(0, ret);
+    esp_tls_server_session_delete(tls);
+
+    esp_tls_cfg_server_session_cache_free(&cfg);
+    TEST_ASSERT_NULL(cfg.session_cache);
+}
+#endif
+
+/* A resumed session is recognized by its TLS 1.2 master secret */
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_CACHE) && defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE) && !defined(CONFIG_MBEDTLS_SSL_PROTO_TLS1_3)
+#define SESSION_TEST_PORT           8090
+#define SESSION_TEST_NUM_PORTS      3
+#define SESSION_TEST_MASTER_LEN     48
+
+typedef struct {
+    int listen_socks[SESSION_TEST_NUM_PORTS];
+    esp_tls_cfg_server_t cfg;
+    volatile bool drop_next;    /* Close the next connection without answering the handshake */
+    volatile bool stop;
+    SemaphoreHandle_t done;
+} session_test_server_t;
+
+/* Performs the handshakes of the connections to any of the ports, the sessions are resumed from the session ID cache */
+static void session_test_server_task(void *arg)
+{
+    session_test_server_t *server = arg;
+    while (!server->stop) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        int max_fd = -1;
+        for (int i = 0; i < SESSION_TEST_NUM_PORTS; i++) {
+            FD_SET(server->listen_socks[i], &rfds);
+            max_fd = MAX(max_fd, server->listen_socks[i]);
+        }
+        struct timeval tv = { .tv_usec = 100000 };
+        if (select(max_fd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < SESSION_TEST_NUM_PORTS; i++) {
+            if (!FD_ISSET(server->listen_socks[i], &rfds)) {
+                continue;
+            }
+            int sock = accept(server->listen_socks[i], NULL, NULL);
+            if (sock < 0) {
+                continue;
+            }
+            if (server->drop_next) {
+                server->drop_next = false;
+            } else {
+                esp_tls_t *tls = esp_tls_init();
+                if (tls) {
+                    esp_tls_server_session_create(&server->cfg, sock, tls);
+                    esp_tls_server_session_delete(tls);
+                }
+            }
+            close(sock);
+        }
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+static void session_test_server_start(session_test_server_t *server)
+{
+    test_case_uses_tcpip();
+
+    server->done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(server->done);
+    server->cfg = (esp_tls_cfg_server_t) {
+        .servercert_buf = (const unsigned char *)test_cert_pem,
+        .servercert_bytes = strlen(test_cert_pem) + 1,
+        .serverkey_buf = (const unsigned char *)test_key_pem,
+        .serverkey_bytes = strlen(test_key_pem) + 1,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_cfg_server_session_cache_init(&server->cfg));
+    for (int i = 0; i < SESSION_TEST_NUM_PORTS; i++) {
+        struct sockaddr_in addr = {
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+            .sin_family = AF_INET,
+            .sin_port = htons(SESSION_TEST_PORT + i),
+        };
+        server->listen_socks[i] = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, server->listen_socks[i]);
+        TEST_ASSERT_EQUAL(0, bind(server->listen_socks[i], (struct sockaddr *)&addr, sizeof(addr)));
+        TEST_ASSERT_EQUAL(0, listen(server->listen_socks[i], 1));
+    }
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(session_test_server_task, "session_server", 8192, server, 5, NULL));
+}
+
+static void session_test_server_stop(session_test_server_t *server)
+{
+    server->stop = true;
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server->done, pdMS_TO_TICKS(1000)));
+    for (int i = 0; i < SESSION_TEST_NUM_PORTS; i++) {
+        close(server->listen_socks[i]);
+    }
+    esp_tls_cfg_server_session_cache_free(&server->cfg);
+    vSemaphoreDelete(server->done);
+    esp_tls_client_session_cache_flush();
+}
+
+/* Connects to the port 'SESSION_TEST_PORT + index', resuming the given session if any, and gets the master
+   secret of the session, which is the same as the one of the previous connection only if the session has been
+   resumed */
+static int session_test_connect_with(int index, esp_tls_client_session_t *client_session,
+                                     unsigned char master[SESSION_TEST_MASTER_LEN])
+{
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char *)test_cert_pem,
+        .cacert_bytes = strlen(test_cert_pem) + 1,
+        .common_name = "ESP-TLS Tests",
+        .client_session = client_session,
+    };
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    int ret = esp_tls_conn_new_sync("127.0.0.1", strlen("127.0.0.1"), SESSION_TEST_PORT + index, &cfg, tls);
+    if (ret == 1) {
+        /* The session of the connection has been stored in the client session cache, it can still be exported */
+        esp_tls_client_session_t *session = esp_tls_get_client_session(tls);
+        TEST_ASSERT_NOT_NULL(session);
+        memcpy(master, session->saved_session.MBEDTLS_PRIVATE(master), SESSION_TEST_MASTER_LEN);
+        esp_tls_free_client_session(session);
+    }
+    esp_tls_conn_destroy(tls);
+    return ret;
+}
+
+static int session_test_connect(int index, unsigned char master[SESSION_TEST_MASTER_LEN])
+{
+    return session_test_connect_with(index, NULL, master);
+}
+
+TEST_CASE("esp_tls client session cache resumes sessions until flushed", "[esp-tls]")
+{
+    session_test_server_t server = { 0 };
+    session_test_server_start(&server);
+
+    unsigned char first[SESSION_TEST_MASTER_LEN], master[SESSION_TEST_MASTER_LEN];
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, first));
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, master));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first, master, SESSION_TEST_MASTER_LEN);
+    /* Another port is another server */
+    TEST_ASSERT_EQUAL(1, session_test_connect(1, master));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first, master, SESSION_TEST_MASTER_LEN));
+
+    esp_tls_client_session_cache_flush();
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, master));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first, master, SESSION_TEST_MASTER_LEN));
+
+    session_test_server_stop(&server);
+}
+
+TEST_CASE("esp_tls client session cache drops the least recently used session", "[esp-tls]")
+{
+    /* The cache of the test app keeps two sessions */
+    TEST_ASSERT_EQUAL(2, CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE);
+    session_test_server_t server = { 0 };
+    session_test_server_start(&server);
+
+    unsigned char first[SESSION_TEST_NUM_PORTS][SESSION_TEST_MASTER_LEN], master[SESSION_TEST_MASTER_LEN];
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, first[0]));
+    TEST_ASSERT_EQUAL(1, session_test_connect(1, first[1]));
+    /* The session of port 1 becomes the least recently used one */
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, master));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first[0], master, SESSION_TEST_MASTER_LEN);
+    TEST_ASSERT_EQUAL(1, session_test_connect(2, first[2]));
+
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, master));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first[0], master, SESSION_TEST_MASTER_LEN);
+    TEST_ASSERT_EQUAL(1, session_test_connect(1, master));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first[1], master, SESSION_TEST_MASTER_LEN));
+
+    session_test_server_stop(&server);
+}
+
+TEST_CASE("esp_tls client session cache drops expired sessions", "[esp-tls]")
+{
+    session_test_server_t server = { 0 };
+    session_test_server_start(&server);
+
+    unsigned char first[SESSION_TEST_MASTER_LEN], master[SESSION_TEST_MASTER_LEN];
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, first));
+    /* The server would still resume the session */
+    vTaskDelay(pdMS_TO_TICKS((CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_LIFETIME + 1) * 1000));
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, master));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first, master, SESSION_TEST_MASTER_LEN));
+
+    session_test_server_stop(&server);
+}
+
+TEST_CASE("esp_tls client session cache drops a session after a failed handshake", "[esp-tls]")
+{
+    session_test_server_t server = { 0 };
+    session_test_server_start(&server);
+
+    unsigned char first[SESSION_TEST_MASTER_LEN], master[SESSION_TEST_MASTER_LEN];
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, first));
+    server.drop_next = true;
+    TEST_ASSERT_EQUAL(-1, session_test_connect(0, master));
+    /* The server would still resume the session */
+    TEST_ASSERT_EQUAL(1, session_test_connect(0, master));
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(first, master, SESSION_TEST_MASTER_LEN));
+
+    session_test_server_stop(&server);
+}
+TEST_CASE("esp_tls client sessions can be exported with the client session cache", "[esp-tls]")
+{
+    session_test_server_t server = { 0 };
+    session_test_server_start(&server);
+
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char *)test_cert_pem,
+        .cacert_bytes = strlen(test_cert_pem) + 1,
+        .common_name = "ESP-TLS Tests",
+    };
+    esp_tls_t *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    TEST_ASSERT_EQUAL(1, esp_tls_conn_new_sync("127.0.0.1", strlen("127.0.0.1"), SESSION_TEST_PORT, &cfg, tls));
+    /* Both copies are made from the session stored in the cache */
+    esp_tls_client_session_t *sessions[2];
+    for (int i = 0; i < 2; i++) {
+        sessions[i] = esp_tls_get_client_session(tls);
+        TEST_ASSERT_NOT_NULL(sessions[i]);
+    }
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sessions[0]->saved_session.MBEDTLS_PRIVATE(master),
+                                 sessions[1]->saved_session.MBEDTLS_PRIVATE(master), SESSION_TEST_MASTER_LEN);
+    esp_tls_conn_destroy(tls);
+
+    /* The exported session is resumed without the cache too */
+    unsigned char master[SESSION_TEST_MASTER_LEN];
+    esp_tls_client_session_cache_flush();
+    TEST_ASSERT_EQUAL(1, session_test_connect_with(0, sessions[0], master));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sessions[0]->saved_session.MBEDTLS_PRIVATE(master), master, SESSION_TEST_MASTER_LEN);
+
+    esp_tls_free_client_session(sessions[0]);
+    esp_tls_free_client_session(sessions[1]);
+    session_test_server_stop(&server);
+}
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE && CONFIG_ESP_TLS_SERVER_SESSION_CACHE && !CONFIG_MBEDTLS_SSL_PROTO_TLS1_3 */
@@ -7,6 +7,7 @@
 
 #include <string.h>
 #include <inttypes.h>
+#include <sys/param.h>
 
 #include "esp_log.h"
 #include "esp_check.h"
@@ -16,6 +17,7 @@
 #include "esp_transport_tcp.h"
 #include "http_utils.h"
 #include "http_auth.h"
+#include "http_conn_pool.h"
 #include "sdkconfig.h"
 #include "esp_http_client.h"
 #include "errno.h"
@@ -39,6 +41,12 @@ typedef struct {
     char *orig_raw_data;/*!< The Original pointer to HTTP data after decoding */
     int raw_len;        /*!< The HTTP data len after decoding */
     char *output_ptr;   /*!< The destination address of the data to be copied to after decoding */
+    const char *pending_data;   /*!< The HTTP data received but not parsed yet, when reading by borrowing */
+    int pending_len;            /*!< The length of the HTTP data not parsed yet */
+    const char *body_data;      /*!< The body fragment found by the parser, when reading by borrowing */
+    int body_len;               /*!< The length of the body fragment */
+    bool borrowing;             /*!< The parser is run by esp_http_client_read_borrow */
+    bool borrowed;              /*!< A body fragment is lent to the user */
 } esp_http_buffer_t;
 
 /**
@@ -83,6 +91,22 @@ typedef enum {
     HTTP_STATE_RES_COMPLETE_DATA,
     HTTP_STATE_CLOSE
 } esp_http_state_t;
+
+/**
+ * Settings which a pooled connection must have been opened with to be reused by a client
+ */
+typedef struct {
+    const char                  *cert_pem;
+    const char                  *client_cert_pem;
+    const char                  *client_key_pem;
+    const char                  *common_name;
+    esp_err_t                   (*crt_bundle_attach)(void *conf);
+    bool                        use_global_ca_store;
+    bool                        skip_cert_common_name_check;
+    bool                        use_secure_element;
+    char                        if_name[IFNAMSIZ];
+} esp_http_pool_security_t;
+
 /**
  * HTTP client class
  */
@@ -122,6 +146,14 @@ struct esp_http_client {
     esp_transport_keep_alive_t  keep_alive_cfg;
     struct ifreq                *if_name;
     unsigned                    cache_data_in_fetch_hdr: 1;
+    unsigned                    pipelining: 1;          /*!< The parser stops at the end of each response */
+    const char                  *request_path;          /*!< Path of the request to send instead of the path and query of the URL */
+    bool                        use_connection_pool;
+    bool                        conn_reused;            /*!< The connection was taken from the connection pool */
+    bool                        request_data_written;   /*!< Part of the request has been written to the connection */
+    bool                        conn_pool_bypass;       /*!< Open a new connection instead of taking one from the pool */
+    char                        *conn_origin;           /*!< "scheme://host:port" of the connection, kept as the URL may change before it is closed */
+    esp_http_pool_security_t    pool_security;
 };
 
 typedef struct esp_http_client esp_http_client_t;
@@ -282,7 +314,12 @@ static int http_on_body(http_parser *parser, const char *at, size_t length)
     esp_http_client_t *client = parser->data;
     ESP_LOGD(TAG, "http_on_body %zu", length);
 
-    if (client->response->buffer->output_ptr) {
+    if (client->response->buffer->borrowing) {
+        /* Stop the parser so that the fragment is handed over before the next one is parsed */
+        client->response->buffer->body_data = at;
+        client->response->buffer->body_len = length;
+        http_parser_pause(parser, 1);
+    } else if (client->response->buffer->output_ptr) {
         memcpy(client->response->buffer->output_ptr, (char *)at, length);
         client->response->buffer->output_ptr += length;
     } else {
@@ -302,7 +339,9 @@ static int http_on_body(http_parser *parser, const char *at, size_t length)
     }
 
     client->response->data_process += length;
-    client->response->buffer->raw_len += length;
+    if (!client->response->buffer->borrowing) {
+        client->response->buffer->raw_len += length;
+    }
     http_dispatch_event(client, HTTP_EVENT_ON_DATA, (void *)at, length);
     esp_http_client_on_data_t evt_data = {};
     evt_data.data_process = client->response->data_process;
@@ -316,6 +355,10 @@ static int http_on_message_complete(http_parser *parser)
     ESP_LOGD(TAG, "http_on_message_complete, parser=%p", parser);
     esp_http_client_handle_t client = parser->data;
     client->is_chunk_complete = true;
+    if (client->pipelining) {
+        /* The data following belongs to the response to the next request */
+        http_parser_pause(parser, 1);
+    }
     return 0;
 }
 
@@ -528,6 +571,33 @@ static esp_err_t _set_config(esp_http_client_handle_t client, const esp_http_cli
     if (config->is_async) {
         client->is_async = true;
     }
+    if (config->use_connection_pool) {
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        if (client->is_async) {
+            ESP_LOGW(TAG, "Connection pool is not supported in asynchronous mode");
+        } else {
+            client->use_connection_pool = true;
+        }
+#else
+        ESP_LOGW(TAG, "Connection pool requested but not enabled in menuconfig: Please enable ESP_HTTP_CLIENT_CONNECTION_POOL option");
+#endif
+    }
+    if (client->use_connection_pool) {
+        esp_http_pool_security_t *security = &client->pool_security;
+        security->cert_pem = config->cert_pem;
+        security->client_cert_pem = config->client_cert_pem;
+        security->client_key_pem = config->client_key_pem;
+        security->common_name = config->common_name;
+        security->crt_bundle_attach = config->crt_bundle_attach;
+        security->use_global_ca_store = config->use_global_ca_store;
+        security->skip_cert_common_name_check = config->skip_cert_common_name_check;
+#if CONFIG_ESP_TLS_USE_SECURE_ELEMENT
+        security->use_secure_element = config->use_secure_element;
+#endif
+        if (config->if_name) {
+            memcpy(security->if_name, config->if_name->ifr_name, sizeof(security->if_name));
+        }
+    }
 
     return ret;
 
@@ -588,6 +658,8 @@ static esp_err_t esp_http_client_prepare(esp_http_client_handle_t client)
         client->auth_header = NULL;
     }
     http_parser_init(client->parser, HTTP_RESPONSE);
+    client->response->buffer->pending_len = 0;
+    client->response->buffer->borrowed = false;
     if (client->connection_info.username) {
         char *auth_response = NULL;
 
@@ -883,6 +955,7 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
     _clear_auth_data(client);
     free(client->auth_data);
     free(client->current_header_key);
+    free(client->conn_origin);
     free(client->location);
     free(client->auth_header);
     free(client);
@@ -1117,6 +1190,11 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
 {
     esp_http_buffer_t *res_buffer = client->response->buffer;
 
+    if (res_buffer->pending_len || res_buffer->borrowed) {
+        ESP_LOGE(TAG, "The response is being read by esp_http_client_read_borrow");
+        return ESP_FAIL;
+    }
+
     int rlen = ESP_FAIL, ridx = 0;
     if (res_buffer->raw_len) {
         int remain_len = client->response->buffer->raw_len;
@@ -1197,9 +1275,133 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
     return ridx;
 }
 
+int esp_http_client_read_borrow(esp_http_client_handle_t client, const char **data)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+
+    if (data == NULL) {
+        return ESP_FAIL;
+    }
+    if (res_buffer->borrowed) {
+        ESP_LOGE(TAG, "The previous body fragment has not been released");
+        return ESP_FAIL;
+    }
+    /* Body received along with the headers and cached by esp_http_client_fetch_headers */
+    if (res_buffer->raw_len) {
+        *data = res_buffer->raw_data;
+        res_buffer->borrowed = true;
+        return res_buffer->raw_len;
+    }
+
+    while (true) {
+        if (res_buffer->pending_len) {
+            res_buffer->body_data = NULL;
+            res_buffer->borrowing = true;
+            http_parser_pause(client->parser, 0);
+            size_t parsed = http_parser_execute(client->parser, client->parser_settings, res_buffer->pending_data, res_buffer->pending_len);
+            res_buffer->borrowing = false;
+            enum http_errno parser_errno = HTTP_PARSER_ERRNO(client->parser);
+            if (parser_errno != HPE_OK && parser_errno != HPE_PAUSED) {
+                ESP_LOGE(TAG, "Failed to parse the response: %s", http_errno_description(parser_errno));
+                res_buffer->pending_len = 0;
+                return ESP_FAIL;
+            }
+            res_buffer->pending_data += parsed;
+            res_buffer->pending_len -= parsed;
+            if (res_buffer->body_data) {
+                *data = res_buffer->body_data;
+                res_buffer->borrowed = true;
+                return res_buffer->body_len;
+            }
+            continue;
+        }
+        bool is_data_remain;
+        if (client->response->is_chunked) {
+            is_data_remain = !client->is_chunk_complete;
+        } else {
+            is_data_remain = client->response->data_process < client->response->content_length;
+        }
+        if (!is_data_remain) {
+            return 0;
+        }
+
+        errno = 0;
+        int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, client->timeout_ms);
+        ESP_LOGD(TAG, "rlen=%d", rlen);
+        if (rlen > 0) {
+            res_buffer->pending_data = res_buffer->data;
+            res_buffer->pending_len = rlen;
+            continue;
+        }
+        if (rlen == ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT) {
+            ESP_LOGD(TAG, "Connection timed out before data was ready!");
+            return -ESP_ERR_HTTP_EAGAIN;
+        }
+        if (rlen == ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN && client->response->is_chunked) {
+            /* Explicit call to parser for invoking `message_complete` callback */
+            http_parser_execute(client->parser, client->parser_settings, res_buffer->data, 0);
+        } else if (rlen < 0) {
+            esp_err_t err = esp_transport_translate_error(rlen);
+            ESP_LOGE(TAG, "transport_read: error - %d | %s", err, esp_err_to_name(err));
+        }
+        if (rlen < 0 && !esp_http_client_is_complete_data_received(client)) {
+            http_dispatch_event(client, HTTP_EVENT_ERROR, esp_transport_get_error_handle(client->transport), 0);
+            http_dispatch_event_to_event_loop(HTTP_EVENT_ERROR, &client, sizeof(esp_http_client_handle_t));
+            return ESP_FAIL;
+        }
+        return 0;
+    }
+}
+
+esp_err_t esp_http_client_read_release(esp_http_client_handle_t client)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+
+    if (!res_buffer->borrowed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    res_buffer->borrowed = false;
+    if (res_buffer->raw_len) {
+        esp_http_client_cached_buf_cleanup(res_buffer);
+    }
+    return ESP_OK;
+}
+
+/* Performs the request again after a pooled connection was found closed. The request is sent at most once more,
+   as the new connection is not taken from the pool. */
+/* A request which failed on a reused connection can only be sent again if the server can't have processed it yet,
+ * or if processing it twice has the same effect as processing it once */
+static bool http_client_can_retry_request(esp_http_client_handle_t client)
+{
+    if (!client->request_data_written) {
+        return true;
+    }
+    switch (client->connection_info.method) {
+        case HTTP_METHOD_GET:
+        case HTTP_METHOD_HEAD:
+        case HTTP_METHOD_PUT:
+        case HTTP_METHOD_DELETE:
+        case HTTP_METHOD_OPTIONS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static esp_err_t http_client_perform_on_new_conn(esp_http_client_handle_t client)
+{
+    client->conn_pool_bypass = true;
+    esp_err_t err = esp_http_client_perform(client);
+    if (err != ESP_ERR_HTTP_EAGAIN) {
+        client->conn_pool_bypass = false;
+    }
+    return err;
+}
+
 esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
 {
     esp_err_t err;
+    bool conn_reused;
     do {
         if (client->process_again) {
             esp_http_client_prepare(client);
@@ -1220,10 +1422,16 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                 }
                 /* falls through */
             case HTTP_STATE_CONNECTED:
+                conn_reused = client->conn_reused;
                 if ((err = esp_http_client_request_send(client, client->post_len)) != ESP_OK) {
                     if (client->is_async && errno == EAGAIN) {
                         return ESP_ERR_HTTP_EAGAIN;
                     }
+                    if (conn_reused && client->state == HTTP_STATE_INIT && http_client_can_retry_request(client)) {
+                        /* The server closed the pooled connection in the meantime, retry once on a new one */
+                        ESP_LOGD(TAG, "Pooled connection closed, retry on a new connection");
+                        return http_client_perform_on_new_conn(client);
+                    }
                     http_dispatch_event(client, HTTP_EVENT_ERROR, esp_transport_get_error_handle(client->transport), 0);
                     http_dispatch_event_to_event_loop(HTTP_EVENT_ERROR, &client, sizeof(esp_http_client_handle_t));
                     return err;
@@ -1251,6 +1459,12 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     /* Enable caching after error condition because next
                      * request could be performed using native APIs */
                     client->cache_data_in_fetch_hdr = 1;
+                    if (client->conn_reused && client->response->status_code == -1 && http_client_can_retry_request(client)) {
+                        /* The server closed the pooled connection without responding, retry once on a new one */
+                        ESP_LOGD(TAG, "Pooled connection closed, retry on a new connection");
+                        esp_http_client_close(client);
+                        return http_client_perform_on_new_conn(client);
+                    }
                     if (esp_transport_get_errno(client->transport) == ENOTCONN) {
                         ESP_LOGW(TAG, "Close connection due to FIN received");
                         esp_http_client_close(client);
@@ -1342,6 +1556,251 @@ int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
     return client->response->content_length;
 }
 
+/* Send a request of a pipelined batch, its response is read later by http_client_pipeline_fetch_response */
+static esp_err_t http_client_pipeline_send(esp_http_client_handle_t client, const esp_http_client_pipeline_request_t *request)
+{
+    client->connection_info.method = request->method;
+    client->request_path = request->path;
+    client->post_data = (char *)request->post_data;
+    client->post_len = request->post_len;
+    client->first_line_prepared = false;
+    esp_err_t err = esp_http_client_request_send(client, client->post_len);
+    client->request_path = NULL;
+    if (err != ESP_OK) {
+        return err;
+    }
+    if ((err = esp_http_client_send_post_data(client)) != ESP_OK) {
+        /* The server would take the next request for the rest of the data */
+        esp_http_client_close(client);
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    return ESP_OK;
+}
+
+/* Parse the response to the oldest outstanding request. The parser stops at the end of the response,
+ * the data of the following responses stays pending in the receive buffer. */
+static esp_err_t http_client_pipeline_fetch_response(esp_http_client_handle_t client, esp_http_client_method_t method, bool *received)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+
+    /* The parser needs the method of the request to know if the response has a body */
+    client->connection_info.method = method;
+    client->state = HTTP_STATE_REQ_COMPLETE_DATA;
+    client->response->status_code = -1;
+    client->is_chunk_complete = false;
+    *received = false;
+    while (!client->is_chunk_complete) {
+        if (res_buffer->pending_len == 0) {
+            int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, client->timeout_ms);
+            if (rlen == ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN && *received) {
+                /* Explicit call to parser for invoking `message_complete` callback, if the body ends with the connection */
+                http_parser_pause(client->parser, 0);
+                http_parser_execute(client->parser, client->parser_settings, res_buffer->data, 0);
+                if (client->is_chunk_complete) {
+                    break;
+                }
+            }
+            if (rlen <= 0) {
+                ESP_LOGD(TAG, "esp_transport_read returned:%d", rlen);
+                return rlen == ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN ? ESP_ERR_HTTP_CONNECTION_CLOSED : ESP_ERR_HTTP_FETCH_HEADER;
+            }
+            res_buffer->pending_data = res_buffer->data;
+            res_buffer->pending_len = rlen;
+        }
+        *received = true;
+        http_parser_pause(client->parser, 0);
+        size_t parsed = http_parser_execute(client->parser, client->parser_settings, res_buffer->pending_data, res_buffer->pending_len);
+        enum http_errno parser_errno = HTTP_PARSER_ERRNO(client->parser);
+        if (parser_errno != HPE_OK && parser_errno != HPE_PAUSED) {
+            ESP_LOGE(TAG, "Failed to parse the response: %s", http_errno_description(parser_errno));
+            return ESP_FAIL;
+        }
+        res_buffer->pending_data += parsed;
+        res_buffer->pending_len -= parsed;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform_pipelined(esp_http_client_handle_t client, esp_http_client_pipeline_request_t *requests, size_t num)
+{
+    if (client == NULL || requests == NULL || num == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->is_async) {
+        ESP_LOGE(TAG, "Pipelining is not supported in asynchronous mode");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    const esp_http_client_method_t method = client->connection_info.method;
+    char *post_data = client->post_data;
+    const int post_len = client->post_len;
+    size_t depth = CONFIG_ESP_HTTP_CLIENT_PIPELINE_DEPTH;
+    size_t sent = 0, done = 0;
+    size_t resent_end = 0;  /* The requests before this one have already been sent again on a new connection */
+    esp_err_t ret = ESP_OK;
+
+    for (size_t i = 0; i < num; i++) {
+        requests[i].err = ESP_FAIL;
+        requests[i].status_code = -1;
+        requests[i].content_length = 0;
+    }
+    client->pipelining = true;
+    /* The body is only delivered with HTTP_EVENT_ON_DATA */
+    client->cache_data_in_fetch_hdr = 0;
+    while (done < num) {
+        esp_err_t err = ESP_OK;
+        if (client->state < HTTP_STATE_CONNECTED) {
+            esp_http_client_prepare(client);
+            if ((err = esp_http_client_connect(client)) != ESP_OK) {
+                ret = err;
+                break;
+            }
+            /* The requests not answered on the previous connection are sent again */
+            sent = done;
+        }
+        while (sent < num && sent - done < depth) {
+            if ((err = http_client_pipeline_send(client, &requests[sent])) != ESP_OK) {
+                break;
+            }
+            sent++;
+        }
+
+        bool received = false;
+        if (sent > done && client->state >= HTTP_STATE_CONNECTED) {
+            err = http_client_pipeline_fetch_response(client, requests[done].method, &received);
+        }
+        if (err == ESP_OK) {
+            requests[done].err = ESP_OK;
+            requests[done].status_code = client->response->status_code;
+            requests[done].content_length = client->response->content_length;
+            http_dispatch_event(client, HTTP_EVENT_ON_FINISH, NULL, 0);
+            http_dispatch_event_to_event_loop(HTTP_EVENT_ON_FINISH, &client, sizeof(esp_http_client_handle_t));
+            client->response->buffer->raw_len = 0;
+            done++;
+            if (!http_should_keep_alive(client->parser)) {
+                /* The server ignores the requests sent after this one, they are sent again one by one.
+                   As they are sent one by one from now on, no request is outstanding when this happens again. */
+                ESP_LOGD(TAG, "Server closes the connection, %d requests not answered", (int)(sent - done));
+                if (sent > done) {
+                    resent_end = sent;
+                    depth = 1;
+                }
+                esp_http_client_close(client);
+            }
+            continue;
+        }
+
+        /* The responses to the outstanding requests cannot be received anymore */
+        esp_http_client_close(client);
+        if (!received && done >= resent_end) {
+            /* The server closed the connection without answering, maybe it does not support pipelining */
+            ESP_LOGW(TAG, "Connection closed with %d requests not answered, sending them again one by one", (int)(sent - done));
+            /* The oldest request counts as sent, even if sending it has failed */
+            resent_end = MAX(sent, done + 1);
+            depth = 1;
+            continue;
+        }
+        ret = err;
+        break;
+    }
+    for (size_t i = done; i < num; i++) {
+        requests[i].err = ret;
+    }
+
+    /* The parser may be stopped at the end of the last response */
+    http_parser_init(client->parser, HTTP_RESPONSE);
+    client->pipelining = false;
+    client->cache_data_in_fetch_hdr = 1;
+    client->response->buffer->pending_len = 0;
+    client->connection_info.method = method;
+    client->post_data = post_data;
+    client->post_len = post_len;
+    if (client->state > HTTP_STATE_CONNECTED) {
+        client->state = HTTP_STATE_CONNECTED;
+        client->first_line_prepared = false;
+    }
+    return ret;
+}
+
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+static void http_client_pool_key(esp_http_client_handle_t client, http_conn_pool_key_t *key)
+{
+    key->origin = client->conn_origin;
+    key->security = &client->pool_security;
+    key->security_len = sizeof(client->pool_security);
+}
+
+static esp_err_t http_client_attach_conn(esp_http_client_handle_t client, esp_transport_conn_handle_t conn)
+{
+#ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
+    if (strncasecmp(client->conn_origin, "https:", 6) == 0) {
+        return esp_transport_ssl_attach_conn(client->transport, conn);
+    }
+#endif
+    return esp_transport_tcp_attach_conn(client->transport, conn);
+}
+
+static esp_transport_conn_handle_t http_client_detach_conn(esp_http_client_handle_t client)
+{
+#ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
+    if (strncasecmp(client->conn_origin, "https:", 6) == 0) {
+        return esp_transport_ssl_detach_conn(client->transport);
+    }
+#endif
+    return esp_transport_tcp_detach_conn(client->transport);
+}
+
+/* Attach an idle connection of the pool to the transport, returns true if the transport is connected */
+static bool http_client_pool_borrow(esp_http_client_handle_t client)
+{
+    http_conn_pool_key_t key;
+    esp_transport_conn_handle_t conn;
+
+    free(client->conn_origin);
+    if (asprintf(&client->conn_origin, "%s://%s:%d", client->connection_info.scheme,
+                 client->connection_info.host, client->connection_info.port) < 0) {
+        client->conn_origin = NULL;
+        return false;
+    }
+    http_client_pool_key(client, &key);
+    while ((conn = http_conn_pool_take(&key)) != NULL) {
+        if (http_client_attach_conn(client, conn) != ESP_OK) {
+            esp_transport_conn_destroy(conn);
+            return false;
+        }
+        /* Nothing is readable on a healthy idle connection, otherwise the server closed it or sent unexpected data */
+        if (esp_transport_poll_read(client->transport, 0) == 0) {
+            return true;
+        }
+        ESP_LOGD(TAG, "Drop pooled connection closed by the server");
+        esp_transport_close(client->transport);
+    }
+    return false;
+}
+
+/* Give the connection to the pool if no request is in progress on it and the server allows to keep it alive */
+static bool http_client_pool_release(esp_http_client_handle_t client)
+{
+    bool idle = false;
+    if (client->state == HTTP_STATE_CONNECTED) {
+        idle = !client->first_line_prepared;
+    } else if (client->state >= HTTP_STATE_RES_ON_DATA_START) {
+        idle = http_should_keep_alive(client->parser) && esp_http_client_is_complete_data_received(client);
+    }
+    if (!idle || client->conn_origin == NULL) {
+        return false;
+    }
+    esp_transport_conn_handle_t conn = http_client_detach_conn(client);
+    if (conn == NULL) {
+        return false;
+    }
+    http_conn_pool_key_t key;
+    http_client_pool_key(client, &key);
+    http_conn_pool_put(&key, conn);
+    return true;
+}
+#endif /* CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL */
+
 static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 {
     esp_err_t err;
@@ -1369,7 +1828,12 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 #endif
             return ESP_ERR_HTTP_INVALID_TRANSPORT;
         }
-        if (!client->is_async) {
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        client->conn_reused = client->use_connection_pool && !client->conn_pool_bypass && http_client_pool_borrow(client);
+#endif
+        if (client->conn_reused) {
+            ESP_LOGD(TAG, "Reusing pooled connection");
+        } else if (!client->is_async) {
             if (esp_transport_connect(client->transport, client->connection_info.host, client->connection_info.port, client->timeout_ms) < 0) {
                 ESP_LOGE(TAG, "Connection failed, sock < 0");
                 return ESP_ERR_HTTP_CONNECT;
@@ -1389,6 +1853,7 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
             }
         }
         client->state = HTTP_STATE_CONNECTED;
+        client->conn_pool_bypass = false;
         http_dispatch_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0);
         http_dispatch_event_to_event_loop(HTTP_EVENT_ON_CONNECTED, &client, sizeof(esp_http_client_handle_t));
     }
@@ -1408,13 +1873,13 @@ static int http_client_prepare_first_line(esp_http_client_handle_t client, int w
     int first_line_len = snprintf(client->request->buffer->data,
                                   client->buffer_size_tx, "%s %s",
                                   method,
-                                  client->connection_info.path);
+                                  client->request_path ? client->request_path : client->connection_info.path);
     if (first_line_len >= client->buffer_size_tx) {
         ESP_LOGE(TAG, "Out of buffer");
         return -1;
     }
 
-    if (client->connection_info.query) {
+    if (client->connection_info.query && !client->request_path) {
         first_line_len += snprintf(client->request->buffer->data + first_line_len,
                                    client->buffer_size_tx - first_line_len, "?%s", client->connection_info.query);
         if (first_line_len >= client->buffer_size_tx) {
@@ -1440,6 +1905,7 @@ static esp_err_t esp_http_client_request_send(esp_http_client_handle_t client, i
             return first_line_len;
         }
         client->first_line_prepared = true;
+        client->request_data_written = false;
         client->header_index = 0;
         client->data_written_index = 0;
         client->data_write_left = 0;
@@ -1481,6 +1947,7 @@ static esp_err_t esp_http_client_request_send(esp_http_client_handle_t client, i
                 esp_http_client_close(client);
                 return ESP_ERR_HTTP_WRITE_DATA;
             }
+            client->request_data_written = true;
             client->data_write_left -= wret;
             client->data_written_index += wret;
         }
@@ -1565,6 +2032,13 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client)
     if (client->state >= HTTP_STATE_INIT) {
         http_dispatch_event(client, HTTP_EVENT_DISCONNECTED, esp_transport_get_error_handle(client->transport), 0);
         http_dispatch_event_to_event_loop(HTTP_EVENT_DISCONNECTED, &client, sizeof(esp_http_client_handle_t));
+        client->conn_reused = false;
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        if (client->use_connection_pool && http_client_pool_release(client)) {
+            client->state = HTTP_STATE_INIT;
+            return ESP_OK;
+        }
+#endif
         client->state = HTTP_STATE_INIT;
         return esp_transport_close(client->transport);
     }
@@ -1747,3 +2221,13 @@ esp_err_t esp_http_client_get_chunk_length(esp_http_client_handle_t client, int
     }
     return ESP_OK;
 }
+
+esp_err_t esp_http_client_connection_pool_flush(void)
+{
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+    http_conn_pool_flush();
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -157,6 +157,10 @@ typedef struct {
     int                         keep_alive_interval; /*!< Keep-alive interval time. Default is 5 (second) */
     int                         keep_alive_count;    /*!< Keep-alive packet retry send count. Default is 3 counts */
     struct ifreq                *if_name;            /*!< The name of interface for data to go through. Use the default interface without setting */
+    bool                        use_connection_pool; /*!< Reuse idle connections of the shared pool and give them back to it when closed,
+                                                          ESP_HTTP_CLIENT_CONNECTION_POOL must be enabled in menuconfig. Not supported with `is_async`.
+                                                          If the server has closed the pooled connection, esp_http_client_perform() sends
+                                                          the request once more, on a new connection */
 #if CONFIG_ESP_TLS_USE_SECURE_ELEMENT
     bool use_secure_element;                /*!< Enable this option to use secure element */
 #endif
@@ -236,6 +240,46 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
  */
 esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
 
+/**
+ * @brief Request of a batch performed by `esp_http_client_perform_pipelined`
+ */
+typedef struct {
+    esp_http_client_method_t method;    /*!< HTTP method */
+    const char *path;                   /*!< Path, including the query if any. NULL to use the path and query of the client URL */
+    const char *post_data;              /*!< Data to send, NULL if none */
+    int post_len;                       /*!< Length of the data to send */
+    esp_err_t err;                      /*!< Result: ESP_OK if the response has been received */
+    int status_code;                    /*!< Result: HTTP status code of the response, -1 if no response */
+    int64_t content_length;             /*!< Result: Content length of the response */
+} esp_http_client_pipeline_request_t;
+
+/**
+ * @brief      Perform several requests to the host of the client, sending each request without waiting
+ *             for the responses to the previous ones (HTTP/1.1 pipelining)
+ *
+ *             Up to CONFIG_ESP_HTTP_CLIENT_PIPELINE_DEPTH requests are outstanding on the connection. The responses
+ *             are received in the order of the requests: the events of each response (HTTP_EVENT_ON_HEADER,
+ *             HTTP_EVENT_ON_DATA) are followed by HTTP_EVENT_ON_FINISH before the ones of the next response,
+ *             and the result is stored in the request.
+ *             If the server closes the connection before answering all the requests, the requests not answered
+ *             are sent again one by one on a new connection. A request is sent at most twice.
+ *             Redirections and authentication challenges are not followed, their status code is returned.
+ *
+ * @note       Not supported in asynchronous mode
+ * @note       The request headers of the client (e.g. Content-Type) are sent with every request
+ *
+ * @param[in]     client    The esp_http_client handle
+ * @param[in,out] requests  The requests
+ * @param[in]     num       The number of requests
+ *
+ * @return
+ *  - ESP_OK if all the responses have been received
+ *  - ESP_ERR_INVALID_ARG
+ *  - ESP_ERR_NOT_SUPPORTED in asynchronous mode
+ *  - The error of the first failed request otherwise
+ */
+esp_err_t esp_http_client_perform_pipelined(esp_http_client_handle_t client, esp_http_client_pipeline_request_t *requests, size_t num);
+
 /**
  * @brief       Cancel an ongoing HTTP request. This API closes the current socket and opens a new socket with the same esp_http_client context.
  *
@@ -520,6 +564,37 @@ bool esp_http_client_is_chunked_response(esp_http_client_handle_t client);
  */
 int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
 
+/**
+ * @brief      Read the next fragment of the response body without copying it
+ *
+ *             The fragment points into the receive buffer of the client, chunked encoding already removed.
+ *             It stays valid until `esp_http_client_read_release` is called, which must be done before
+ *             reading the next fragment. The fragments are at most `buffer_size` bytes long.
+ *
+ * @param[in]  client  The esp_http_client handle
+ * @param[out] data    The fragment
+ *
+ * @return
+ *     - (-1) if any errors
+ *     - 0 if the whole body has been read
+ *     - Length of the fragment
+ *
+ * @note  (-ESP_ERR_HTTP_EAGAIN = -0x7007) is returned when call is timed-out before any data was ready
+ * @note  Once a response is read with this function, it cannot be read with `esp_http_client_read` anymore
+ */
+int esp_http_client_read_borrow(esp_http_client_handle_t client, const char **data);
+
+/**
+ * @brief      Release the body fragment returned by `esp_http_client_read_borrow`
+ *
+ * @param[in]  client  The esp_http_client handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_STATE if no fragment is borrowed
+ */
+esp_err_t esp_http_client_read_release(esp_http_client_handle_t client);
+
 
 /**
  * @brief      Get http response status code, the valid value if this function invoke after `esp_http_client_perform`
@@ -671,6 +746,15 @@ esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, co
  */
 esp_err_t esp_http_client_get_chunk_length(esp_http_client_handle_t client, int *len);
 
+/**
+ * @brief          Close all the idle connections of the connection pool
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NOT_SUPPORTED  If ESP_HTTP_CLIENT_CONNECTION_POOL is not enabled in menuconfig
+ */
+esp_err_t esp_http_client_connection_pool_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
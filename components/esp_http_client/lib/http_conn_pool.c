@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "http_conn_pool.h"
+
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+
+static const char *TAG = "HTTP_CONN_POOL";
+
+#define POOL_SIZE           CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_SIZE
+#define POOL_IDLE_TICKS     pdMS_TO_TICKS(CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_IDLE_TIMEOUT * 1000)
+
+/**
+ * Idle connection. The key is stored in a single allocation:
+ * the security settings followed by the origin string.
+ */
+typedef struct {
+    esp_transport_conn_handle_t conn;   /*!< NULL if the entry is free */
+    char                        *key;
+    size_t                      security_len;
+    TickType_t                  released_at;
+} http_conn_pool_entry_t;
+
+static http_conn_pool_entry_t s_entries[POOL_SIZE];
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool entry_matches(const http_conn_pool_entry_t *entry, const http_conn_pool_key_t *key)
+{
+    return entry->security_len == key->security_len &&
+           memcmp(entry->key, key->security, key->security_len) == 0 &&
+           strcasecmp(entry->key + entry->security_len, key->origin) == 0;
+}
+
+/* Move the entry to the list of entries to be closed out of the critical section */
+static void entry_evict(http_conn_pool_entry_t *entry, http_conn_pool_entry_t *evicted, int *evicted_num)
+{
+    evicted[(*evicted_num)++] = *entry;
+    entry->conn = NULL;
+    entry->key = NULL;
+}
+
+/* Must be called in the critical section */
+static void evict_expired(TickType_t now, http_conn_pool_entry_t *evicted, int *evicted_num)
+{
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (s_entries[i].conn && now - s_entries[i].released_at >= POOL_IDLE_TICKS) {
+            entry_evict(&s_entries[i], evicted, evicted_num);
+        }
+    }
+}
+
+static void close_evicted(http_conn_pool_entry_t *evicted, int evicted_num)
+{
+    for (int i = 0; i < evicted_num; i++) {
+        esp_transport_conn_destroy(evicted[i].conn);
+        free(evicted[i].key);
+    }
+}
+
+esp_transport_conn_handle_t http_conn_pool_take(const http_conn_pool_key_t *key)
+{
+    http_conn_pool_entry_t evicted[POOL_SIZE];
+    int evicted_num = 0;
+    http_conn_pool_entry_t *best = NULL;
+    esp_transport_conn_handle_t conn = NULL;
+    char *entry_key = NULL;
+
+    portENTER_CRITICAL(&s_pool_lock);
+    const TickType_t now = xTaskGetTickCount();
+    evict_expired(now, evicted, &evicted_num);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        http_conn_pool_entry_t *entry = &s_entries[i];
+        /* The most recently used connection is the least likely to be closed by the server */
+        if (entry->conn && entry_matches(entry, key) &&
+                (best == NULL || now - entry->released_at < now - best->released_at)) {
+            best = entry;
+        }
+    }
+    if (best) {
+        conn = best->conn;
+        entry_key = best->key;
+        best->conn = NULL;
+        best->key = NULL;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+
+    close_evicted(evicted, evicted_num);
+    free(entry_key);
+    ESP_LOGD(TAG, "%s connection to %s", conn ? "Reusing" : "No idle", key->origin);
+    return conn;
+}
+
+esp_err_t http_conn_pool_put(const http_conn_pool_key_t *key, esp_transport_conn_handle_t conn)
+{
+    const size_t origin_len = strlen(key->origin) + 1;
+    char *entry_key = malloc(key->security_len + origin_len);
+    if (entry_key == NULL) {
+        ESP_LOGE(TAG, "Memory exhausted");
+        esp_transport_conn_destroy(conn);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(entry_key, key->security, key->security_len);
+    memcpy(entry_key + key->security_len, key->origin, origin_len);
+
+    /* Room for all the expired connections and the oldest one */
+    http_conn_pool_entry_t evicted[POOL_SIZE + 1];
+    int evicted_num = 0;
+    http_conn_pool_entry_t *slot = NULL;
+
+    portENTER_CRITICAL(&s_pool_lock);
+    const TickType_t now = xTaskGetTickCount();
+    evict_expired(now, evicted, &evicted_num);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        http_conn_pool_entry_t *entry = &s_entries[i];
+        if (entry->conn == NULL) {
+            slot = entry;
+            break;
+        }
+        if (slot == NULL || now - entry->released_at > now - slot->released_at) {
+            slot = entry;
+        }
+    }
+    if (slot->conn) {
+        entry_evict(slot, evicted, &evicted_num);
+    }
+    slot->conn = conn;
+    slot->key = entry_key;
+    slot->security_len = key->security_len;
+    slot->released_at = now;
+    portEXIT_CRITICAL(&s_pool_lock);
+
+    close_evicted(evicted, evicted_num);
+    ESP_LOGD(TAG, "Keeping connection to %s, %d closed", key->origin, evicted_num);
+    return ESP_OK;
+}
+
+void http_conn_pool_flush(void)
+{
+    http_conn_pool_entry_t evicted[POOL_SIZE];
+    int evicted_num = 0;
+
+    portENTER_CRITICAL(&s_pool_lock);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (s_entries[i].conn) {
+            entry_evict(&s_entries[i], evicted, &evicted_num);
+        }
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+
+    close_evicted(evicted, evicted_num);
+}
+
+#endif /* CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL */
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _HTTP_CONN_POOL_H_
+#define _HTTP_CONN_POOL_H_
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Identifies the connections which can be reused for a request
+ */
+typedef struct {
+    const char *origin;         /*!< Scheme, host and port the connection was opened to, as "scheme://host:port" */
+    const void *security;       /*!< Settings used to open the connection (server verification, interface...),
+                                     compared byte by byte */
+    size_t security_len;        /*!< Length of the settings */
+} http_conn_pool_key_t;
+
+/**
+ * @brief      Take an idle connection matching the key out of the pool
+ *
+ *             Connections idle for longer than the timeout are closed, the most recently
+ *             released matching connection is returned.
+ *
+ * @param[in]  key   The key
+ *
+ * @return
+ *     - The connection, the caller becomes its owner
+ *     - NULL if there is no matching connection
+ */
+esp_transport_conn_handle_t http_conn_pool_take(const http_conn_pool_key_t *key);
+
+/**
+ * @brief      Give an idle connection to the pool
+ *
+ *             If the pool is full, its oldest connection is closed.
+ *
+ * @param[in]  key   The key of the connection
+ * @param[in]  conn  The connection, the pool always becomes its owner
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NO_MEM, the connection has been closed
+ */
+esp_err_t http_conn_pool_put(const http_conn_pool_key_t *key, esp_transport_conn_handle_t conn);
+
+/**
+ * @brief      Close all the connections of the pool
+ */
+void http_conn_pool_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
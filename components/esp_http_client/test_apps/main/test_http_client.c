@@ -4,13 +4,18 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <sys/param.h>
 #include <esp_system.h>
 #include <esp_http_client.h>
 
 #include "unity.h"
 #include "test_utils.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
 
 #define HOST  "httpbin.org"
 #define USERNAME  "user"
@@ -146,6 +151,515 @@ TEST_CASE("esp_http_client_init() should return NULL if configured with wrong ur
     esp_http_client_cleanup(client);
 }
 
+#define BORROW_TEST_PORT            8071
+#define PIPELINE_TEST_PORT          8072
+#define PIPELINE_CLOSE_TEST_PORT    8074
+#define PIPELINE_RESEND_TEST_PORT   8075
+
+static int test_server_listen(int port)
+{
+    struct sockaddr_in addr = {
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    TEST_ASSERT_EQUAL(0, bind(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(sock, 1));
+    return sock;
+}
+
+typedef struct {
+    int listen_sock;
+    SemaphoreHandle_t done;
+} borrow_test_server_t;
+
+/* Answers one request with a chunked body spread over several fragments of the client buffer */
+static void borrow_test_server_task(void *arg)
+{
+    borrow_test_server_t *server = arg;
+    static const char response[] = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                   "1a\r\nabcdefghijklmnopqrstuvwxyz\r\n"
+                                   "3\r\n012\r\n"
+                                   "40\r\n0123456789012345678901234567890123456789012345678901234567890123\r\n"
+                                   "0\r\n\r\n";
+    char buf[256];
+    int sock = accept(server->listen_sock, NULL, NULL);
+    if (sock >= 0) {
+        recv(sock, buf, sizeof(buf), 0);
+        send(sock, response, sizeof(response) - 1, 0);
+        /* Let the client close the connection first */
+        while (recv(sock, buf, sizeof(buf), 0) > 0) {
+        }
+        close(sock);
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Body fragments are read without copying by esp_http_client_read_borrow", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    borrow_test_server_t server = { .done = xSemaphoreCreateBinary() };
+    TEST_ASSERT_NOT_NULL(server.done);
+    server.listen_sock = test_server_listen(BORROW_TEST_PORT);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(borrow_test_server_task, "borrow_server", 4096, &server, 5, NULL));
+
+    esp_http_client_config_t config = {
+        .url = "http://127.0.0.1:8071/",
+        .buffer_size = 64,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_open(client, 0));
+    TEST_ASSERT_EQUAL(0, esp_http_client_fetch_headers(client));
+    TEST_ASSERT_EQUAL(200, esp_http_client_get_status_code(client));
+
+    char body[128];
+    int body_len = 0;
+    const char *data;
+    int len;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_http_client_read_release(client));
+    while ((len = esp_http_client_read_borrow(client, &data)) > 0) {
+        TEST_ASSERT_LESS_OR_EQUAL(sizeof(body) - body_len, len);
+        memcpy(body + body_len, data, len);
+        body_len += len;
+        /* The fragment must be released before the next one is read */
+        TEST_ASSERT_EQUAL(ESP_FAIL, esp_http_client_read_borrow(client, &data));
+        TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_read_release(client));
+    }
+    TEST_ASSERT_EQUAL(0, len);
+    TEST_ASSERT_EQUAL(26 + 3 + 64, body_len);
+    TEST_ASSERT_EQUAL_MEMORY("abcdefghijklmnopqrstuvwxyz012", body, 29);
+    TEST_ASSERT_EQUAL_MEMORY("0123456789012345678901234567890123456789012345678901234567890123", body + 29, 64);
+    TEST_ASSERT_TRUE(esp_http_client_is_complete_data_received(client));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(client));
+
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server.done, pdMS_TO_TICKS(1000)));
+    close(server.listen_sock);
+    vSemaphoreDelete(server.done);
+}
+
+typedef struct {
+    int listen_sock;
+    SemaphoreHandle_t done;
+} pipeline_test_server_t;
+
+/* Answers the requests of one connection in order, the body of each response is its index */
+static void pipeline_test_server_task(void *arg)
+{
+    pipeline_test_server_t *server = arg;
+    char buf[256];
+    int len;
+    int end_match = 0;
+    int request_len = 0;
+    bool head = false;
+    char index = '0';
+    int sock = accept(server->listen_sock, NULL, NULL);
+    /* The requests have no body, each one ends with an empty line */
+    while (sock >= 0 && (len = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        for (int i = 0; i < len; i++) {
+            if (request_len++ == 0) {
+                head = (buf[i] == 'H');
+            }
+            end_match = (buf[i] == "\r\n\r\n"[end_match]) ? end_match + 1 : (buf[i] == '\r');
+            if (end_match == 4) {
+                char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\n0";
+                response[sizeof(response) - 2] = index++;
+                /* No body in the response to a HEAD request */
+                send(sock, response, sizeof(response) - (head ? 2 : 1), 0);
+                end_match = 0;
+                request_len = 0;
+            }
+        }
+    }
+    close(sock);
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t pipeline_test_event_handler(esp_http_client_event_t *evt)
+{
+    char *bodies = evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_DATA) {
+        strncat(bodies, evt->data, evt->data_len);
+    } else if (evt->event_id == HTTP_EVENT_ON_FINISH) {
+        strcat(bodies, ",");
+    }
+    return ESP_OK;
+}
+
+TEST_CASE("Pipelined requests are answered in order on one connection", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    pipeline_test_server_t server = { .done = xSemaphoreCreateBinary() };
+    TEST_ASSERT_NOT_NULL(server.done);
+    server.listen_sock = test_server_listen(PIPELINE_TEST_PORT);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(pipeline_test_server_task, "pipeline_server", 4096, &server, 5, NULL));
+
+    char bodies[32] = "";
+    esp_http_client_config_t config = {
+        .url = "http://127.0.0.1:8072/",
+        .event_handler = pipeline_test_event_handler,
+        .user_data = bodies,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    esp_http_client_pipeline_request_t requests[6];
+    for (int i = 0; i < 6; i++) {
+        requests[i] = (esp_http_client_pipeline_request_t) {
+            .method = (i == 3) ? HTTP_METHOD_HEAD : HTTP_METHOD_GET,
+            .path = "/telemetry",
+        };
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_perform_pipelined(client, requests, 6));
+    for (int i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, requests[i].err);
+        TEST_ASSERT_EQUAL(200, requests[i].status_code);
+        TEST_ASSERT_EQUAL(1, requests[i].content_length);
+    }
+    /* The response to the HEAD request has no body */
+    TEST_ASSERT_EQUAL_STRING("0,1,2,,4,5,", bodies);
+
+    /* The connection is still usable for regular requests */
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_perform(client));
+    TEST_ASSERT_EQUAL_STRING("0,1,2,,4,5,6,", bodies);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(client));
+
+    /* All the requests were sent on the same connection, the server stops once it is closed */
+    close(server.listen_sock);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server.done, pdMS_TO_TICKS(1000)));
+    vSemaphoreDelete(server.done);
+}
+
+#define PIPELINE_CLOSE_TEST_MAX_CONNS   4
+
+typedef struct {
+    int listen_sock;
+    int responses[PIPELINE_CLOSE_TEST_MAX_CONNS];   /* Responses on each connection, 0 to close it without answering */
+    int accepted;
+    char index;
+    volatile bool stop;
+    SemaphoreHandle_t done;
+} pipeline_close_test_server_t;
+
+static bool pipeline_close_test_wait_readable(pipeline_close_test_server_t *server, int sock)
+{
+    while (!server->stop) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(sock, &rfds);
+        struct timeval tv = { .tv_usec = 100000 };
+        if (select(sock + 1, &rfds, NULL, NULL, &tv) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Serves one connection at a time. The last response on a connection has "Connection: close" and the requests
+   received after it are ignored. The body of each response is its index among all the responses. */
+static void pipeline_close_test_server_task(void *arg)
+{
+    pipeline_close_test_server_t *server = arg;
+    char buf[256];
+    for (int conn = 0; conn < PIPELINE_CLOSE_TEST_MAX_CONNS && pipeline_close_test_wait_readable(server, server->listen_sock); conn++) {
+        int sock = accept(server->listen_sock, NULL, NULL);
+        if (sock < 0) {
+            break;
+        }
+        server->accepted++;
+        int answered = 0;
+        int end_match = 0;
+        int len = 0;
+        while (pipeline_close_test_wait_readable(server, sock) && (len = recv(sock, buf, sizeof(buf), 0)) > 0) {
+            if (server->responses[conn] == 0) {
+                break;
+            }
+            for (int i = 0; i < len && answered < server->responses[conn]; i++) {
+                end_match = (buf[i] == "\r\n\r\n"[end_match]) ? end_match + 1 : (buf[i] == '\r');
+                if (end_match == 4) {
+                    char response[64];
+                    int response_len = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n%s\r\n%c",
+                                                (++answered == server->responses[conn]) ? "Connection: close\r\n" : "", server->index++);
+                    send(sock, response, response_len, 0);
+                    end_match = 0;
+                }
+            }
+            if (answered == server->responses[conn]) {
+                /* Let the client read the responses and close the connection first */
+                shutdown(sock, SHUT_WR);
+                while (pipeline_close_test_wait_readable(server, sock) && recv(sock, buf, sizeof(buf), 0) > 0) {
+                }
+                break;
+            }
+        }
+        close(sock);
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+/* Performs 6 pipelined GET requests against the server and returns the result */
+static esp_err_t pipeline_close_test(pipeline_close_test_server_t *server, int port, esp_http_client_pipeline_request_t *requests, char *bodies)
+{
+    server->done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(server->done);
+    server->index = '0';
+    server->listen_sock = test_server_listen(port);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(pipeline_close_test_server_task, "pipeline_server", 4096, server, 5, NULL));
+
+    esp_http_client_config_t config = {
+        .host = "127.0.0.1",
+        .port = port,
+        .path = "/",
+        .event_handler = pipeline_test_event_handler,
+        .user_data = bodies,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    for (int i = 0; i < 6; i++) {
+        requests[i] = (esp_http_client_pipeline_request_t) {
+            .method = HTTP_METHOD_GET,
+            .path = "/telemetry",
+        };
+    }
+    esp_err_t ret = esp_http_client_perform_pipelined(client, requests, 6);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(client));
+    server->stop = true;
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server->done, pdMS_TO_TICKS(1000)));
+    close(server->listen_sock);
+    vSemaphoreDelete(server->done);
+    return ret;
+}
+
+TEST_CASE("Pipelined requests not answered before the server closes the connection are sent again", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    /* Every connection is closed after two responses, while more requests are outstanding */
+    pipeline_close_test_server_t server = { .responses = { 2, 2, 2 } };
+    esp_http_client_pipeline_request_t requests[6];
+    char bodies[32] = "";
+    TEST_ASSERT_EQUAL(ESP_OK, pipeline_close_test(&server, PIPELINE_CLOSE_TEST_PORT, requests, bodies));
+    for (int i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, requests[i].err);
+        TEST_ASSERT_EQUAL(200, requests[i].status_code);
+    }
+    /* Each request is answered exactly once */
+    TEST_ASSERT_EQUAL_STRING("0,1,2,3,4,5,", bodies);
+    TEST_ASSERT_EQUAL(3, server.accepted);
+}
+
+TEST_CASE("A pipelined request is not sent a third time", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    /* The second request is not answered on the first connection, then the second connection is closed
+       without answering it */
+    pipeline_close_test_server_t server = { .responses = { 1, 0, 6 } };
+    esp_http_client_pipeline_request_t requests[6];
+    char bodies[32] = "";
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, pipeline_close_test(&server, PIPELINE_RESEND_TEST_PORT, requests, bodies));
+    TEST_ASSERT_EQUAL(ESP_OK, requests[0].err);
+    for (int i = 1; i < 6; i++) {
+        TEST_ASSERT_NOT_EQUAL(ESP_OK, requests[i].err);
+    }
+    TEST_ASSERT_EQUAL_STRING("0,", bodies);
+    TEST_ASSERT_EQUAL(2, server.accepted);
+}
+
+#if CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+#define POOL_TEST_PORT  8070
+#define POOL_TEST_URL   "http://127.0.0.1:8070/"
+
+typedef struct {
+    int listen_sock;
+    int accepted;
+    SemaphoreHandle_t done;
+} pool_test_server_t;
+
+/* Serves the keep-alive requests of one connection at a time, until the listening socket is closed */
+static void pool_test_server_task(void *arg)
+{
+    pool_test_server_t *server = arg;
+    static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    char buf[256];
+    int sock;
+    while ((sock = accept(server->listen_sock, NULL, NULL)) >= 0) {
+        server->accepted++;
+        /* The requests have no body and are received in one piece on the loopback interface */
+        while (recv(sock, buf, sizeof(buf), 0) > 0) {
+            send(sock, response, sizeof(response) - 1, 0);
+        }
+        close(sock);
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+static void pool_test_request(bool use_connection_pool)
+{
+    esp_http_client_config_t config = {
+        .url = POOL_TEST_URL,
+        .use_connection_pool = use_connection_pool,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_perform(client));
+    TEST_ASSERT_EQUAL(200, esp_http_client_get_status_code(client));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(client));
+}
+
+TEST_CASE("Idle connections are reused by other clients through the connection pool", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    pool_test_server_t server = { .done = xSemaphoreCreateBinary() };
+    TEST_ASSERT_NOT_NULL(server.done);
+    server.listen_sock = test_server_listen(POOL_TEST_PORT);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(pool_test_server_task, "pool_server", 4096, &server, 5, NULL));
+
+    /* Without the pool, the connection is closed by the cleanup */
+    pool_test_request(false);
+    pool_test_request(false);
+    TEST_ASSERT_EQUAL(2, server.accepted);
+
+    /* With the pool, all the clients use the same connection */
+    pool_test_request(true);
+    pool_test_request(true);
+    pool_test_request(true);
+    TEST_ASSERT_EQUAL(3, server.accepted);
+
+    /* The server closes the pooled connection once it is flushed */
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_connection_pool_flush());
+    close(server.listen_sock);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server.done, pdMS_TO_TICKS(1000)));
+    vSemaphoreDelete(server.done);
+}
+
+#define STALE_POOL_TEST_PORT        8073
+#define STALE_POOL_TEST_URL         "http://127.0.0.1:8073/"
+#define STALE_POOL_TEST_MAX_CONNS   4
+
+typedef struct {
+    int listen_sock;
+    int accepted;
+    int requests;
+    volatile bool stop;
+    SemaphoreHandle_t done;
+} stale_pool_test_server_t;
+
+/* Answers the first request of each connection, then closes the connection when the next request arrives */
+static void stale_pool_test_server_task(void *arg)
+{
+    stale_pool_test_server_t *server = arg;
+    static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    int socks[STALE_POOL_TEST_MAX_CONNS];
+    bool answered[STALE_POOL_TEST_MAX_CONNS] = { false };
+    int num = 0;
+    char buf[256];
+    while (!server->stop) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(server->listen_sock, &rfds);
+        int max_fd = server->listen_sock;
+        for (int i = 0; i < num; i++) {
+            if (socks[i] >= 0) {
+                FD_SET(socks[i], &rfds);
+                max_fd = MAX(max_fd, socks[i]);
+            }
+        }
+        struct timeval tv = { .tv_usec = 100000 };
+        if (select(max_fd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < num; i++) {
+            if (socks[i] < 0 || !FD_ISSET(socks[i], &rfds)) {
+                continue;
+            }
+            /* The requests have no body and are received in one piece on the loopback interface */
+            if (recv(socks[i], buf, sizeof(buf), 0) > 0) {
+                server->requests++;
+                if (!answered[i]) {
+                    send(socks[i], response, sizeof(response) - 1, 0);
+                    answered[i] = true;
+                    continue;
+                }
+            }
+            close(socks[i]);
+            socks[i] = -1;
+        }
+        if (FD_ISSET(server->listen_sock, &rfds) && num < STALE_POOL_TEST_MAX_CONNS) {
+            socks[num++] = accept(server->listen_sock, NULL, NULL);
+            server->accepted++;
+        }
+    }
+    for (int i = 0; i < num; i++) {
+        if (socks[i] >= 0) {
+            close(socks[i]);
+        }
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Idempotent requests are retried once on a new connection if pooled connections are closed", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    stale_pool_test_server_t server = { .done = xSemaphoreCreateBinary() };
+    TEST_ASSERT_NOT_NULL(server.done);
+    server.listen_sock = test_server_listen(STALE_POOL_TEST_PORT);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(stale_pool_test_server_task, "stale_pool_server", 4096, &server, 5, NULL));
+
+    /* Two clients open two connections, both are pooled by the cleanup */
+    esp_http_client_config_t config = {
+        .url = STALE_POOL_TEST_URL,
+        .use_connection_pool = true,
+    };
+    esp_http_client_handle_t clients[2];
+    for (int i = 0; i < 2; i++) {
+        clients[i] = esp_http_client_init(&config);
+        TEST_ASSERT_NOT_NULL(clients[i]);
+        TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_perform(clients[i]));
+    }
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(clients[i]));
+    }
+    TEST_ASSERT_EQUAL(2, server.accepted);
+
+    /* The request is sent on a pooled connection, which the server closes, then on a new connection
+       rather than on the other pooled connection */
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_perform(client));
+    TEST_ASSERT_EQUAL(200, esp_http_client_get_status_code(client));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(client));
+    TEST_ASSERT_EQUAL(3, server.accepted);
+    TEST_ASSERT_EQUAL(2 + 2, server.requests);
+
+    /* The server may have processed a POST request before closing the connection, so it is not sent again */
+    config.method = HTTP_METHOD_POST;
+    client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_set_post_field(client, "data", 4));
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, esp_http_client_perform(client));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_cleanup(client));
+    TEST_ASSERT_EQUAL(3, server.accepted);
+    TEST_ASSERT_EQUAL(2 + 2 + 1, server.requests);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_connection_pool_flush());
+    server.stop = true;
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server.done, pdMS_TO_TICKS(1000)));
+    close(server.listen_sock);
+    vSemaphoreDelete(server.done);
+}
+#endif /* CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL */
+
 void app_main(void)
 {
     unity_run_menu();
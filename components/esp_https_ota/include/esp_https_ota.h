@@ -59,6 +59,7 @@ typedef struct {
     bool bulk_flash_erase;                         /*!< Erase entire flash partition during initialization. By default flash partition is erased during write operation and in chunk of 4K sector size */
     bool partial_http_download;                    /*!< Enable Firmware image to be downloaded over multiple HTTP requests */
     int max_http_request_size;                     /*!< Maximum request size for partial HTTP download */
+    bool decode_image;                             /*!< Downloaded file may be a compressed image or a delta patch against the running app, generated by gen_ota_patch.py (see esp_ota_decoder.h). Plain images are still accepted. */
 #if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
     decrypt_cb_t decrypt_cb;                       /*!< Callback for external decryption layer */
     void *decrypt_user_ctx;                        /*!< User context for external decryption layer */
@@ -206,6 +207,7 @@ esp_err_t esp_https_ota_abort(esp_https_ota_handle_t https_ota_handle);
  *
  * @note    This API can be called only after esp_https_ota_begin() and before esp_https_ota_perform().
  *          Calling this API is not mandatory.
+ *          If `decode_image` is set, the app description can only be read from plain (not compressed) images.
  *
  * @param[in]   https_ota_handle   pointer to esp_https_ota_handle_t structure
  * @param[out]  new_app_info       pointer to an allocated esp_app_desc_t structure
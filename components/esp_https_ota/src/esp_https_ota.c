@@ -10,6 +10,7 @@
 #include <esp_https_ota.h>
 #include <esp_log.h>
 #include <esp_ota_ops.h>
+#include <esp_ota_decoder.h>
 #include <errno.h>
 #include <sys/param.h>
 #include <inttypes.h>
@@ -50,6 +51,7 @@ struct esp_https_ota_handle {
     bool bulk_flash_erase;
     bool partial_http_download;
     int max_authorization_retries;
+    esp_ota_decoder_handle_t decoder;
 #if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
     decrypt_cb_t decrypt_cb;
     void *decrypt_user_ctx;
@@ -223,12 +225,24 @@ static void esp_https_ota_decrypt_cb_free_buf(void *buffer)
 }
 #endif // CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
 
+static esp_err_t _ota_decoder_write_cb(void *arg, const void *data, size_t size)
+{
+    esp_https_ota_t *https_ota_handle = (esp_https_ota_t *)arg;
+    return esp_ota_write(https_ota_handle->update_handle, data, size);
+}
+
 static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffer, size_t buf_len)
 {
     if (buffer == NULL || https_ota_handle == NULL) {
         return ESP_FAIL;
     }
-    esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
+    esp_err_t err;
+    if (https_ota_handle->decoder) {
+        /* binary_file_len keeps counting downloaded bytes, which is what partial download requests rely on */
+        err = esp_ota_decoder_write(https_ota_handle->decoder, buffer, buf_len);
+    } else {
+        err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
     } else {
@@ -377,6 +391,19 @@ esp_err_t esp_https_ota_begin(const esp_https_ota_config_t *ota_config, esp_http
     https_ota_handle->decrypt_cb = ota_config->decrypt_cb;
     https_ota_handle->decrypt_user_ctx = ota_config->decrypt_user_ctx;
 #endif
+    if (ota_config->decode_image) {
+        const esp_ota_decoder_cfg_t decoder_cfg = {
+            .write_cb = _ota_decoder_write_cb,
+            .write_cb_arg = https_ota_handle,
+            .src_partition = esp_ota_get_running_partition(),
+        };
+        err = esp_ota_decoder_new(&decoder_cfg, &https_ota_handle->decoder);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't create OTA image decoder");
+            free(https_ota_handle->ota_upgrade_buf);
+            goto http_cleanup;
+        }
+    }
     https_ota_handle->ota_upgrade_buf_size = alloc_size;
     https_ota_handle->bulk_flash_erase = ota_config->bulk_flash_erase;
     https_ota_handle->binary_file_len = 0;
@@ -528,9 +555,12 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
                 return ESP_FAIL;
             }
 #endif // CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
-            err = esp_ota_verify_chip_id(data_buf);
-            if (err != ESP_OK) {
-                return err;
+            /* Compressed images and delta patches have the chip ID checked by esp_ota_end() after decoding */
+            if (handle->decoder == NULL || *(const uint8_t *)data_buf == ESP_IMAGE_HEADER_MAGIC) {
+                err = esp_ota_verify_chip_id(data_buf);
+                if (err != ESP_OK) {
+                    return err;
+                }
             }
             return _ota_write(handle, data_buf, binary_file_len);
         case ESP_HTTPS_OTA_IN_PROGRESS:
@@ -633,12 +663,21 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
     switch (handle->state) {
         case ESP_HTTPS_OTA_SUCCESS:
         case ESP_HTTPS_OTA_IN_PROGRESS:
-            err = esp_ota_end(handle->update_handle);
+            if (handle->decoder) {
+                err = esp_ota_decoder_finish(handle->decoder);
+            }
+            if (err == ESP_OK) {
+                err = esp_ota_end(handle->update_handle);
+            } else {
+                ESP_LOGE(TAG, "OTA image decoding incomplete (0x%x)", err);
+                esp_ota_abort(handle->update_handle);
+            }
             /* falls through */
         case ESP_HTTPS_OTA_BEGIN:
             if (handle->ota_upgrade_buf) {
                 free(handle->ota_upgrade_buf);
             }
+            esp_ota_decoder_delete(handle->decoder);
             if (handle->http_client) {
                 _http_cleanup(handle->http_client);
             }
@@ -685,6 +724,7 @@ esp_err_t esp_https_ota_abort(esp_https_ota_handle_t https_ota_handle)
             if (handle->ota_upgrade_buf) {
                 free(handle->ota_upgrade_buf);
             }
+            esp_ota_decoder_delete(handle->decoder);
             if (handle->http_client) {
                 _http_cleanup(handle->http_client);
             }
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -24,6 +24,29 @@ extern "C" {
  */
 struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len, void *l2_buff);
 
+/**
+ * @brief Statistics of the pool of custom pbufs for received frames of an esp-netif
+ */
+typedef struct {
+    uint32_t pool_size;         /*!< Number of pbufs in the pool */
+    uint32_t in_use;            /*!< Pbufs taken from the pool and not freed yet */
+    uint32_t pool_allocs;       /*!< Allocations served from the pool */
+    uint32_t heap_allocs;       /*!< Allocations served from the heap because the pool was empty */
+    uint32_t alloc_failures;    /*!< Allocations which failed because the pool was empty and the heap exhausted */
+} esp_pbuf_pool_stats_t;
+
+/**
+ * @brief Get the statistics of the RX pbuf pool of an esp-netif
+ *
+ * @param esp_netif esp-netif handle
+ * @param[out] stats Statistics
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if esp_netif or stats is NULL
+ *      - ESP_ERR_INVALID_STATE if the esp-netif has no pool, see CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE
+ */
+esp_err_t esp_pbuf_pool_get_stats(esp_netif_t *esp_netif, esp_pbuf_pool_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
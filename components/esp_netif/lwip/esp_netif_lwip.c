@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2019-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2019-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -791,6 +791,18 @@ esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config)
     }
     lwip_set_esp_netif(lwip_netif, esp_netif);
 
+#if CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE > 0
+    // PPP receives into its own pbufs, other interfaces wrap the driver's buffers in pooled custom pbufs
+    if (!(esp_netif->flags & ESP_NETIF_FLAG_IS_PPP)) {
+        esp_netif->rx_pbuf_pool = esp_pbuf_pool_create(CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE);
+        if (esp_netif->rx_pbuf_pool == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate RX pbuf pool");
+            esp_netif_destroy(esp_netif);
+            return NULL;
+        }
+    }
+#endif
+
     if (netif_callback.callback_fn == NULL ) {
         esp_netif_lwip_ipc_no_args(set_lwip_netif_callback);
     }
@@ -911,6 +923,9 @@ void esp_netif_destroy(esp_netif_t *esp_netif)
 #if ESP_DHCPS
         dhcps_delete(esp_netif->dhcps);
 #endif
+        if (esp_netif->rx_pbuf_pool) {
+            esp_pbuf_pool_release(esp_netif->rx_pbuf_pool);
+        }
         free(esp_netif);
     }
 }
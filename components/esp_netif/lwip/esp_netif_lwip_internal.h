@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -56,6 +56,24 @@ enum netif_types {
     PPP_LWIP_NETIF,
 };
 
+typedef struct esp_pbuf_pool esp_pbuf_pool_t;
+
+/**
+ * @brief Create a pool of custom pbufs for received frames
+ *
+ * @param size Number of pbufs in the pool
+ * @return The pool, NULL if out of memory
+ */
+esp_pbuf_pool_t *esp_pbuf_pool_create(size_t size);
+
+/**
+ * @brief Release the pool of a destroyed esp-netif
+ *
+ * @note The pool is freed once lwIP has freed all pbufs taken from it. Pbufs do not refer
+ *       to the esp-netif, they release the driver's buffer with the driver's free function.
+ */
+void esp_pbuf_pool_release(esp_pbuf_pool_t *pool);
+
 /**
  * @brief Related data to esp-netif (additional data for some special types of netif
  * (typically for point-point network types, such as PPP)
@@ -83,6 +101,9 @@ struct esp_netif_obj {
 #if ESP_DHCPS
     dhcps_t *dhcps;
 #endif
+    // pool of custom pbufs for received frames, NULL if disabled
+    esp_pbuf_pool_t *rx_pbuf_pool;
+
     // io driver related
     void* driver_handle;
     esp_err_t (*driver_transmit)(void *h, void *buffer, size_t len);
@@ -1,17 +1,19 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 /**
  * @file esp_pbuf reference
  * This file handles lwip custom pbufs interfacing with esp_netif
- * and the L2 free function esp_netif_free_rx_buffer()
+ * and the L2 free function of the driver
  */
 
+#include <stdatomic.h>
 #include "lwip/mem.h"
 #include "lwip/esp_pbuf_ref.h"
 #include "esp_netif_net_stack.h"
+#include "esp_netif_lwip_internal.h"
 
 /**
  * @brief Specific pbuf structure for pbufs allocated by ESP netif
@@ -20,10 +22,91 @@
 typedef struct esp_custom_pbuf
 {
     struct pbuf_custom p;
-    esp_netif_t *esp_netif;
+    void (*driver_free_rx_buffer)(void *h, void* buffer); // taken from the esp-netif, which may be destroyed before the pbuf is freed
+    void* driver_handle;
     void* l2_buf;
+    esp_pbuf_pool_t *pool;      // pool the pbuf belongs to, NULL if allocated from heap
+    atomic_uint_least16_t next; // free list link (index + 1) while in the pool
 } esp_custom_pbuf_t;
 
+/**
+ * @brief Pool of custom pbufs of one esp-netif
+ *
+ * Free pbufs are kept in a lock-free stack, as pbufs are allocated in the driver's RX task
+ * and freed wherever lwIP or the application frees them. The head of the stack combines
+ * the index of the first pbuf (+1, 0 if empty) in the lower 16 bits with a tag in the upper
+ * 16 bits, which changes on every update, so that a compare-and-swap based on a stale head fails.
+ */
+struct esp_pbuf_pool {
+    atomic_uint_least32_t free_head;
+    atomic_uint refs;               // pbufs taken from the pool + 1 until the esp-netif is destroyed
+    atomic_uint pool_allocs;
+    atomic_uint heap_allocs;
+    atomic_uint alloc_failures;
+    uint32_t size;
+    esp_custom_pbuf_t pbufs[];
+};
+
+#define POOL_HEAD_INDEX_MASK    0xFFFF
+#define POOL_HEAD_TAG_INC       0x10000
+
+static esp_custom_pbuf_t *esp_pbuf_pool_get(esp_pbuf_pool_t *pool)
+{
+    uint_least32_t head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    uint_least32_t new_head;
+    do {
+        uint32_t index = head & POOL_HEAD_INDEX_MASK;
+        if (index == 0) {
+            return NULL;
+        }
+        // if another task has taken this pbuf in the meantime, the read link is stale but the tag has changed
+        uint32_t next = atomic_load_explicit(&pool->pbufs[index - 1].next, memory_order_relaxed);
+        new_head = ((head + POOL_HEAD_TAG_INC) & ~POOL_HEAD_INDEX_MASK) | next;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                                                    memory_order_acquire, memory_order_acquire));
+    atomic_fetch_add_explicit(&pool->refs, 1, memory_order_relaxed);
+    return &pool->pbufs[(head & POOL_HEAD_INDEX_MASK) - 1];
+}
+
+static void esp_pbuf_pool_put(esp_pbuf_pool_t *pool, esp_custom_pbuf_t *esp_pbuf)
+{
+    uint32_t index = esp_pbuf - pool->pbufs + 1;
+    uint_least32_t head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    uint_least32_t new_head;
+    do {
+        atomic_store_explicit(&esp_pbuf->next, head & POOL_HEAD_INDEX_MASK, memory_order_relaxed);
+        new_head = ((head + POOL_HEAD_TAG_INC) & ~POOL_HEAD_INDEX_MASK) | index;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                                                    memory_order_release, memory_order_relaxed));
+    esp_pbuf_pool_release(pool);
+}
+
+esp_pbuf_pool_t *esp_pbuf_pool_create(size_t size)
+{
+    esp_pbuf_pool_t *pool = mem_malloc(sizeof(esp_pbuf_pool_t) + size * sizeof(esp_custom_pbuf_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->size = size;
+    for (size_t i = 0; i < size; i++) {
+        pool->pbufs[i].pool = pool;
+        atomic_init(&pool->pbufs[i].next, (i + 1 < size) ? i + 2 : 0);
+    }
+    atomic_init(&pool->free_head, size > 0 ? 1 : 0);
+    atomic_init(&pool->refs, 1);
+    atomic_init(&pool->pool_allocs, 0);
+    atomic_init(&pool->heap_allocs, 0);
+    atomic_init(&pool->alloc_failures, 0);
+    return pool;
+}
+
+void esp_pbuf_pool_release(esp_pbuf_pool_t *pool)
+{
+    if (atomic_fetch_sub_explicit(&pool->refs, 1, memory_order_acq_rel) == 1) {
+        mem_free(pool);
+    }
+}
+
 /**
  * @brief Free custom pbuf containing the L2 layer buffer allocated in the driver
  *
@@ -33,8 +116,12 @@ typedef struct esp_custom_pbuf
 static void esp_pbuf_free(struct pbuf *pbuf)
 {
     esp_custom_pbuf_t* esp_pbuf = (esp_custom_pbuf_t*)pbuf;
-    esp_netif_free_rx_buffer(esp_pbuf->esp_netif, esp_pbuf->l2_buf);
-    mem_free(pbuf);
+    esp_pbuf->driver_free_rx_buffer(esp_pbuf->driver_handle, esp_pbuf->l2_buf);
+    if (esp_pbuf->pool) {
+        esp_pbuf_pool_put(esp_pbuf->pool, esp_pbuf);
+    } else {
+        mem_free(pbuf);
+    }
 }
 
 /**
@@ -48,18 +135,53 @@ static void esp_pbuf_free(struct pbuf *pbuf)
 struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len, void *l2_buff)
 {
     struct pbuf *p;
+    esp_pbuf_pool_t *pool = esp_netif->rx_pbuf_pool;
 
-    esp_custom_pbuf_t* esp_pbuf  = mem_malloc(sizeof(esp_custom_pbuf_t));
+    esp_custom_pbuf_t* esp_pbuf = pool ? esp_pbuf_pool_get(pool) : NULL;
     if (esp_pbuf == NULL) {
-        return NULL;
+        esp_pbuf = mem_malloc(sizeof(esp_custom_pbuf_t));
+        if (esp_pbuf == NULL) {
+            if (pool) {
+                atomic_fetch_add_explicit(&pool->alloc_failures, 1, memory_order_relaxed);
+            }
+            return NULL;
+        }
+        esp_pbuf->pool = NULL;
+        if (pool) {
+            atomic_fetch_add_explicit(&pool->heap_allocs, 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_fetch_add_explicit(&pool->pool_allocs, 1, memory_order_relaxed);
     }
     esp_pbuf->p.custom_free_function = esp_pbuf_free;
-    esp_pbuf->esp_netif = esp_netif;
+    esp_pbuf->driver_free_rx_buffer = esp_netif->driver_free_rx_buffer;
+    esp_pbuf->driver_handle = esp_netif->driver_handle;
     esp_pbuf->l2_buf = l2_buff;
     p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &esp_pbuf->p, buffer, len);
     if (p == NULL) {
-        mem_free(esp_pbuf);
+        if (esp_pbuf->pool) {
+            esp_pbuf_pool_put(esp_pbuf->pool, esp_pbuf);
+        } else {
+            mem_free(esp_pbuf);
+        }
         return NULL;
     }
     return p;
 }
+
+esp_err_t esp_pbuf_pool_get_stats(esp_netif_t *esp_netif, esp_pbuf_pool_stats_t *stats)
+{
+    if (esp_netif == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_pbuf_pool_t *pool = esp_netif->rx_pbuf_pool;
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    stats->pool_size = pool->size;
+    stats->in_use = atomic_load(&pool->refs) - 1;
+    stats->pool_allocs = atomic_load(&pool->pool_allocs);
+    stats->heap_allocs = atomic_load(&pool->heap_allocs);
+    stats->alloc_failures = atomic_load(&pool->alloc_failures);
+    return ESP_OK;
+}
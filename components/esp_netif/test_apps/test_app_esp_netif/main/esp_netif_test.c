@@ -5,6 +5,7 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include "unity.h"
 #include "unity_fixture.h"
 #include "esp_netif.h"
@@ -17,6 +18,8 @@
 #include "test_utils.h"
 #include "memory_checks.h"
 #include "lwip/netif.h"
+#include "lwip/esp_pbuf_ref.h"
+#include "esp_cpu.h"
 
 TEST_GROUP(esp_netif);
 
@@ -449,6 +452,73 @@ TEST(esp_netif, route_priority)
     }
 }
 
+#if CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE > 0
+static int s_rx_buffers_freed;
+static int s_rx_buffers_freed_with_wrong_handle;
+
+static void count_free_rx_buffer(void *h, void *buffer)
+{
+    if (h != (void*)1) {
+        s_rx_buffers_freed_with_wrong_handle++;
+    }
+    s_rx_buffers_freed++;
+}
+
+TEST(esp_netif, rx_pbuf_pool)
+{
+    const int iterations = 10000;
+    const int pool_size = CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE;
+    esp_netif_driver_ifconfig_t driver_config = { .handle = (void*)1, .transmit = dummy_transmit,
+                                                  .driver_free_rx_buffer = count_free_rx_buffer };
+    esp_netif_inherent_config_t base_netif_config = { .if_key = "rx_pool" };
+    esp_netif_config_t cfg = {  .base = &base_netif_config,
+                                .stack = ESP_NETIF_NETSTACK_DEFAULT_WIFI_STA,
+                                .driver = &driver_config };
+    esp_netif_t *esp_netif = esp_netif_new(&cfg);
+    TEST_ASSERT_NOT_NULL(esp_netif);
+    esp_pbuf_pool_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_pbuf_pool_get_stats(esp_netif, NULL));
+    TEST_ESP_OK(esp_pbuf_pool_get_stats(esp_netif, &stats));
+    TEST_ASSERT_EQUAL(pool_size, stats.pool_size);
+    TEST_ASSERT_EQUAL(0, stats.in_use);
+
+    // synthetic RX path: wrap a driver buffer in a pbuf and free it, as lwIP does after processing a frame
+    static uint8_t frame[64];
+    s_rx_buffers_freed = 0;
+    s_rx_buffers_freed_with_wrong_handle = 0;
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < iterations; ++i) {
+        struct pbuf *p = esp_pbuf_allocate(esp_netif, frame, sizeof(frame), frame);
+        TEST_ASSERT_NOT_NULL(p);
+        pbuf_free(p);
+    }
+    uint32_t cycles = (esp_cpu_get_cycle_count() - start) / iterations;
+    printf("RX pbuf allocate and free: %"PRIu32" cycles per frame\n", cycles);
+    TEST_ASSERT_EQUAL(iterations, s_rx_buffers_freed);
+    TEST_ESP_OK(esp_pbuf_pool_get_stats(esp_netif, &stats));
+    TEST_ASSERT_EQUAL(iterations, stats.pool_allocs);
+    TEST_ASSERT_EQUAL(0, stats.heap_allocs);
+
+    // exhaust the pool, further frames fall back to heap allocated pbufs
+    struct pbuf *held[pool_size + 2];
+    for (int i = 0; i < pool_size + 2; ++i) {
+        held[i] = esp_pbuf_allocate(esp_netif, frame, sizeof(frame), frame);
+        TEST_ASSERT_NOT_NULL(held[i]);
+    }
+    TEST_ESP_OK(esp_pbuf_pool_get_stats(esp_netif, &stats));
+    TEST_ASSERT_EQUAL(pool_size, stats.in_use);
+    TEST_ASSERT_EQUAL(2, stats.heap_allocs);
+
+    // pbufs still held by lwIP keep the pool alive after the esp-netif is destroyed,
+    // and are released to the driver without accessing the esp-netif
+    esp_netif_destroy(esp_netif);
+    for (int i = 0; i < pool_size + 2; ++i) {
+        pbuf_free(held[i]);
+    }
+    TEST_ASSERT_EQUAL(iterations + pool_size + 2, s_rx_buffers_freed);
+    TEST_ASSERT_EQUAL(0, s_rx_buffers_freed_with_wrong_handle);
+}
+#endif
 
 TEST_GROUP_RUNNER(esp_netif)
 {
@@ -461,6 +531,9 @@ TEST_GROUP_RUNNER(esp_netif)
     RUN_TEST_CASE(esp_netif, convert_ip_addresses)
     RUN_TEST_CASE(esp_netif, get_from_if_key)
     RUN_TEST_CASE(esp_netif, create_delete_multiple_netifs)
+#if CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE > 0
+    RUN_TEST_CASE(esp_netif, rx_pbuf_pool)
+#endif
 #ifdef CONFIG_ESP_WIFI_ENABLED
     RUN_TEST_CASE(esp_netif, create_custom_wifi_interfaces)
     RUN_TEST_CASE(esp_netif, create_destroy_default_wifi)
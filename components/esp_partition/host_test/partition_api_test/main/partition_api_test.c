@@ -6,6 +6,7 @@
  * Linux host partition API test
  */
 
+#include <stdlib.h>
 #include <string.h>
 #if __has_include(<bsd/string.h>)
 #include <bsd/string.h>
@@ -15,6 +16,8 @@
 #include "esp_err.h"
 #include "esp_partition.h"
 #include "esp_private/partition_linux.h"
+#include "esp_image_format.h"
+#include "mbedtls/sha256.h"
 #include "unity.h"
 #include "unity_fixture.h"
 #include "esp_log.h"
@@ -124,6 +127,33 @@ TEST(partition_api, test_partition_ops)
     TEST_ASSERT_NOT_NULL(verified_partition);
 }
 
+TEST(partition_api, test_partition_get_sha256)
+{
+    const esp_partition_t *partition_data = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    TEST_ASSERT_NOT_NULL(partition_data);
+
+    // SHA-256 of a data partition is calculated for its entire content
+    uint8_t buff[] = "ABCDEFGHIJKLMNOP";
+    TEST_ESP_OK(esp_partition_erase_range(partition_data, 0, partition_data->size));
+    TEST_ESP_OK(esp_partition_write(partition_data, 0x100, (const void *)buff, sizeof(buff)));
+    uint8_t *content = malloc(partition_data->size);
+    TEST_ASSERT_NOT_NULL(content);
+    TEST_ESP_OK(esp_partition_read(partition_data, 0, content, partition_data->size));
+    uint8_t expected_sha256[ESP_IMAGE_HASH_LEN];
+    mbedtls_sha256(content, partition_data->size, expected_sha256, 0);
+    free(content);
+
+    uint8_t sha256[ESP_IMAGE_HASH_LEN];
+    TEST_ESP_OK(esp_partition_get_sha256(partition_data, sha256));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_sha256, sha256, sizeof(sha256));
+
+    // app partition without a valid app image
+    const esp_partition_t *partition_app = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+    TEST_ASSERT_NOT_NULL(partition_app);
+    TEST_ESP_OK(esp_partition_erase_range(partition_app, 0, partition_app->erase_size));
+    TEST_ASSERT_EQUAL(ESP_ERR_IMAGE_INVALID, esp_partition_get_sha256(partition_app, sha256));
+}
+
 TEST(partition_api, test_partition_mmap)
 {
     const esp_partition_t *partition_data = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
@@ -731,6 +761,7 @@ TEST_GROUP_RUNNER(partition_api)
     RUN_TEST_CASE(partition_api, test_partition_find_data);
     RUN_TEST_CASE(partition_api, test_partition_find_first);
     RUN_TEST_CASE(partition_api, test_partition_ops);
+    RUN_TEST_CASE(partition_api, test_partition_get_sha256);
     RUN_TEST_CASE(partition_api, test_partition_mmap);
     RUN_TEST_CASE(partition_api, test_partition_mmap_diff_size);
     RUN_TEST_CASE(partition_api, test_partition_mmap_reopen);
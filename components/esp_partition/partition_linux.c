@@ -21,10 +21,14 @@
 #include "esp_partition.h"
 #include "esp_flash_partitions.h"
 #include "esp_private/partition_linux.h"
+#include "esp_image_format.h"
 #include "esp_log.h"
+#include "mbedtls/sha256.h"
 
 static const char *TAG = "linux_spiflash";
 
+#define IMAGE_CHECKSUM_INITIAL  0xEF    // Initial value of the checksum of an app image
+
 static void *s_spiflash_mem_file_buf = NULL;
 static int s_spiflash_mem_file_fd = -1;
 static const esp_partition_mmap_handle_t s_default_partition_mmap_handle = 0;
@@ -517,6 +521,84 @@ void esp_partition_munmap(esp_partition_mmap_handle_t handle __attribute__((unus
 {
 }
 
+/*
+ * Gets the length of the app image in the partition, without its appended SHA-256, after checking its checksum like
+ * esp_image_get_metadata() does on chips
+ */
+static esp_err_t esp_partition_get_app_image_len(const esp_partition_t *partition, size_t *image_len, bool *hash_appended)
+{
+    const uint8_t *data = s_spiflash_mem_file_buf + partition->address;
+    esp_image_header_t header;
+
+    if (partition->size < sizeof(header)) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != ESP_IMAGE_HEADER_MAGIC) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+
+    uint8_t checksum = IMAGE_CHECKSUM_INITIAL;
+    size_t offset = sizeof(header);
+    for (int i = 0; i < header.segment_count; i++) {
+        esp_image_segment_header_t segment;
+        if (offset + sizeof(segment) > partition->size) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        memcpy(&segment, data + offset, sizeof(segment));
+        offset += sizeof(segment);
+        if (segment.data_len > partition->size - offset) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        for (size_t end = offset + segment.data_len; offset < end; offset++) {
+            checksum ^= data[offset];
+        }
+    }
+    // the checksum byte ends a 16 byte block
+    offset += 15 - offset % 16;
+    if (offset >= partition->size || data[offset] != checksum) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+
+    *image_len = offset + 1;
+    *hash_appended = (header.hash_appended == 1);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    assert(partition != NULL && s_spiflash_mem_file_buf != NULL);
+
+    if (sha_256 == NULL || partition->size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint8_t *data = s_spiflash_mem_file_buf + partition->address;
+    size_t size = partition->size;
+    if (partition->type == ESP_PARTITION_TYPE_APP) {
+        bool hash_appended;
+        esp_err_t err = esp_partition_get_app_image_len(partition, &size, &hash_appended);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (hash_appended) {
+            // the appended SHA-256 is verified before being returned
+            if (size + ESP_IMAGE_HASH_LEN > partition->size) {
+                return ESP_ERR_IMAGE_INVALID;
+            }
+            mbedtls_sha256(data, size, sha_256, 0);
+            if (memcmp(sha_256, data + size, ESP_IMAGE_HASH_LEN) != 0) {
+                return ESP_ERR_IMAGE_INVALID;
+            }
+            return ESP_OK;
+        }
+    }
+    // the SHA-256 of a data partition is calculated for the entire partition
+    mbedtls_sha256(data, size, sha_256, 0);
+
+    return ESP_OK;
+}
+
 esp_partition_file_mmap_ctrl_t *esp_partition_get_file_mmap_ctrl_input(void)
 {
     return &s_esp_partition_file_mmap_ctrl_input;
@@ -96,10 +96,13 @@ esp_err_t esp_task_wdt_add(TaskHandle_t task_handle);
  * periodically. Each subscribed user must periodically call esp_task_wdt_reset_user() to prevent the TWDT from elapsing
  * its timeout period. Failure to do so will result in a TWDT timeout.
  *
+ * @note At most 1024 users can be subscribed at the same time.
+ *
  * @param[in] user_name String to identify the user
  * @param[out] user_handle_ret Handle of the user
  * @return
  *  - ESP_OK: Successfully subscribed the user to the TWDT
+ *  - ESP_ERR_NO_MEM: Out of memory, or too many subscribed users
  *  - Other: Failed to subscribe user
  */
 esp_err_t esp_task_wdt_add_user(const char *user_name, esp_task_wdt_user_handle_t *user_handle_ret);
@@ -125,6 +128,7 @@ esp_err_t esp_task_wdt_reset(void);
  * timeout will occur.
  *
  * @param[in] user_handle User handle
+ * @return
  *  - ESP_OK: Successfully reset the TWDT on behalf of the user
  *  - Other: Failed to reset
  */
@@ -7,6 +7,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
 #include <sys/queue.h>
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
@@ -28,6 +30,10 @@
 #include "esp_private/eh_frame_parser.h"
 #endif // CONFIG_ESP_SYSTEM_USE_EH_FRAME
 
+#if CONFIG_ESP_TASK_WDT_TLSP_INDEX >= CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS
+#error "CONFIG_ESP_TASK_WDT_TLSP_INDEX must be lower than CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS"
+#endif
+
 
 #if CONFIG_IDF_TARGET_ARCH_RISCV && !CONFIG_ESP_SYSTEM_USE_EH_FRAME
 /* Function used to print all the registers pointed by the given frame .*/
@@ -53,6 +59,12 @@ bool g_twdt_isr = false;
 
 // ---------------------- Typedefs -------------------------
 
+/* A user handle holds the index of the slot of the user and the generation of the user, so that the handle of a
+ * deleted user is rejected, even once its slot has been given to another user. */
+#define TWDT_USER_INDEX_BITS    10
+#define TWDT_USER_INDEX_MASK    ((1 << TWDT_USER_INDEX_BITS) - 1)
+#define TWDT_USER_SLOTS_MIN     4   // Number of user slots allocated for the first user
+
 /**
  * @brief Structure used for each subscribed task
  */
@@ -61,15 +73,28 @@ struct twdt_entry {
     SLIST_ENTRY(twdt_entry) slist_entry;
     TaskHandle_t task_handle;   // NULL if user entry
     const char *user_name;      // NULL if task entry
-    bool has_reset;
+    uint32_t reset_period;      // Feed period in which the entry was last reset
 };
 
+/**
+ * @brief Slot of a subscribed user
+ */
+typedef struct {
+    twdt_entry_t *entry;        // NULL if the slot is free
+    uint32_t generation;        // Generation of the user of the slot, 0 if the slot is free
+} twdt_user_slot_t;
+
 // Structure used to hold run time configuration of the TWDT
 typedef struct twdt_obj twdt_obj_t;
 struct twdt_obj {
     twdt_ctx_t impl_ctx;
     SLIST_HEAD(entry_list_head, twdt_entry) entries_slist;
     uint32_t idle_core_mask;    // Current core's who's idle tasks are subscribed
+    uint32_t period;            // Incremented each time the timer is fed, which un-resets all the entries at once
+    uint32_t entries_num;       // Number of entries in the list
+    uint32_t not_reset_num;     // Number of entries not reset in the current period
+    twdt_user_slot_t *user_slots;   // Slots of the subscribed users, indexed by the user handles
+    uint32_t user_slots_num;    // Number of slots in user_slots
     bool panic; // Flag to trigger panic when TWDT times out
     bool waiting_for_task; // Flag to start the timer as soon as a task is added
 };
@@ -79,6 +104,9 @@ struct twdt_obj {
 static const char *TAG = "task_wdt";
 static portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
 static twdt_obj_t *p_twdt_obj = NULL;
+/* Generation of the last subscribed user. It is kept when the TWDT is deinitialized, so that the handles of the users
+ * of a previous initialization are rejected too. */
+static uint32_t user_generation = 0;
 
 #if CONFIG_FREERTOS_SMP
 #define CORE_USER_NAME_LEN      8   // Long enough for "CPU XXX"
@@ -98,61 +126,132 @@ static void task_wdt_timer_feed(void)
 {
     esp_task_wdt_impl_timer_feed(p_twdt_obj->impl_ctx);
 
-    /* Clear the has_reset flag in each entry */
-    twdt_entry_t *entry;
-    SLIST_FOREACH(entry, &p_twdt_obj->entries_slist, slist_entry) {
-        entry->has_reset = false;
+    /* Starting a new period clears the reset state of each entry, without walking the list */
+    p_twdt_obj->period++;
+    p_twdt_obj->not_reset_num = p_twdt_obj->entries_num;
+}
+
+/**
+ * @brief Check whether an entry has been reset since the timer was last fed
+ *
+ * @param[in] entry Task or user entry
+ * @return Whether the entry has been reset
+ */
+static inline bool entry_has_reset(const twdt_entry_t *entry)
+{
+    return entry->reset_period == p_twdt_obj->period;
+}
+
+/**
+ * @brief Mark an entry as reset, and feed the timer if all entries have been reset
+ *
+ * @param[in] entry Task or user entry
+ */
+static void reset_entry(twdt_entry_t *entry)
+{
+    if (!entry_has_reset(entry)) {
+        entry->reset_period = p_twdt_obj->period;
+        p_twdt_obj->not_reset_num--;
+    }
+    if (p_twdt_obj->not_reset_num == 0) {
+        task_wdt_timer_feed();
     }
 }
 
 /**
- * @brief Checks whether a user entry exists and if all other entries have been reset
+ * @brief Find the slot of a subscribed user
+ * The handle is only decoded, it is not dereferenced. When entering this function, the spinlock has already been taken.
  *
- * @param[in] user_entry User entry
- * @param[out] all_reset Whether all entries have been reset
- * @return Whether the user entry exists
+ * @param[in] handle User handle
+ * @return Slot of the user, or NULL if the user is not subscribed
  */
-static bool find_entry_and_check_all_reset(twdt_entry_t *user_entry, bool *all_reset)
+static twdt_user_slot_t *find_user_slot(esp_task_wdt_user_handle_t handle)
 {
-    bool found_user_entry = false;
-    bool found_non_reset = false;
+    const uintptr_t index = (uintptr_t)handle & TWDT_USER_INDEX_MASK;
+    const uintptr_t generation = (uintptr_t)handle >> TWDT_USER_INDEX_BITS;
+    if (index >= p_twdt_obj->user_slots_num) {
+        return NULL;
+    }
+    twdt_user_slot_t *slot = &p_twdt_obj->user_slots[index];
+    if (slot->entry == NULL || slot->generation != generation) {
+        return NULL;
+    }
+    return slot;
+}
 
-    twdt_entry_t *entry;
-    SLIST_FOREACH(entry, &p_twdt_obj->entries_slist, slist_entry) {
-        if (entry == user_entry) {
-            found_user_entry = true;
-        } else if (entry->has_reset == false) {
-            found_non_reset = true;
-        }
+/**
+ * @brief Grow the array of user slots, unless it has been grown by another task in the meantime
+ *
+ * @param[in] slots_num Number of slots when they were all found used
+ * @return ESP_OK if the array has more than slots_num slots, failure otherwise
+ */
+static esp_err_t grow_user_slots(uint32_t slots_num)
+{
+    uint32_t new_slots_num = (slots_num == 0) ? TWDT_USER_SLOTS_MIN : MIN(slots_num * 2, TWDT_USER_INDEX_MASK + 1);
+    if (new_slots_num <= slots_num) {
+        return ESP_ERR_NO_MEM;
+    }
+    twdt_user_slot_t *slots = calloc(new_slots_num, sizeof(twdt_user_slot_t));
+    if (slots == NULL) {
+        return ESP_ERR_NO_MEM;
     }
 
-    *all_reset = !found_non_reset;
-    return found_user_entry;
+    portENTER_CRITICAL(&spinlock);
+    if (p_twdt_obj == NULL) {
+        portEXIT_CRITICAL(&spinlock);
+        free(slots);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (p_twdt_obj->user_slots_num == slots_num) {
+        twdt_user_slot_t *old_slots = p_twdt_obj->user_slots;
+        if (slots_num != 0) {
+            memcpy(slots, old_slots, slots_num * sizeof(twdt_user_slot_t));
+        }
+        p_twdt_obj->user_slots = slots;
+        p_twdt_obj->user_slots_num = new_slots_num;
+        slots = old_slots;
+    }
+    portEXIT_CRITICAL(&spinlock);
+    // Free the previous array, or the new one if the array has been grown by another task
+    free(slots);
+    return ESP_OK;
 }
 
 /**
- * @brief Find whether a task entry exists, and checks if all other entries have been reset
+ * @brief Find a task entry
  *
  * @param[in] handle Task handle
- * @param[out] all_reset Whether all entries have been reset
  * @return Task entry, or NULL if not found
  */
-static twdt_entry_t *find_entry_from_task_handle_and_check_all_reset(TaskHandle_t handle, bool *all_reset)
+static twdt_entry_t *find_entry_from_task_handle(TaskHandle_t handle)
 {
-    twdt_entry_t *target = NULL;
-    bool found_non_reset = false;
-
     twdt_entry_t *entry;
     SLIST_FOREACH(entry, &p_twdt_obj->entries_slist, slist_entry) {
         if (entry->task_handle == handle) {
-            target = entry;
-        } else if (entry->has_reset == false) {
-            found_non_reset = true;
+            return entry;
         }
     }
+    return NULL;
+}
 
-    *all_reset = !found_non_reset;
-    return target;
+/**
+ * @brief Find the entry of the currently running task
+ *
+ * With CONFIG_ESP_TASK_WDT_TLSP_INDEX, the entry is stored in a thread local storage pointer of the task when it is
+ * subscribed, so that feeding the TWDT does not depend on the number of subscribed tasks and users.
+ *
+ * @param[in] handle Handle of the currently running task
+ * @return Task entry, or NULL if not found
+ */
+static twdt_entry_t *find_entry_from_current_task(TaskHandle_t handle)
+{
+#if CONFIG_ESP_TASK_WDT_TLSP_INDEX
+    twdt_entry_t *entry = pvTaskGetThreadLocalStoragePointer(handle, CONFIG_ESP_TASK_WDT_TLSP_INDEX);
+    assert(entry == NULL || entry->task_handle == handle);
+    return entry;
+#else // CONFIG_ESP_TASK_WDT_TLSP_INDEX
+    return find_entry_from_task_handle(handle);
+#endif // CONFIG_ESP_TASK_WDT_TLSP_INDEX
 }
 
 /**
@@ -160,12 +259,13 @@ static twdt_entry_t *find_entry_from_task_handle_and_check_all_reset(TaskHandle_
  *
  * @param[in] is_task Whether the entry is a task entry or user entry
  * @param[in] entry_data Data associated with the entry (either a task handle or user entry name)
- * @param[out] entry_ret Pointer to created entry
+ * @param[out] user_handle_ret Handle of the user if user entry, NULL if task entry
  * @return ESP_OK if entry was added, failure otherwise
  */
-static esp_err_t add_entry(bool is_task, void *entry_data, twdt_entry_t **entry_ret)
+static esp_err_t add_entry(bool is_task, void *entry_data, esp_task_wdt_user_handle_t *user_handle_ret)
 {
     esp_err_t ret;
+    uint32_t user_index = 0;
 
     // Allocate entry object
     twdt_entry_t *entry = calloc(1, sizeof(twdt_entry_t));
@@ -178,20 +278,48 @@ static esp_err_t add_entry(bool is_task, void *entry_data, twdt_entry_t **entry_
         entry->user_name = (const char *)entry_data;
     }
 
+retry:
     portENTER_CRITICAL(&spinlock);
     // Check TWDT state
     ESP_GOTO_ON_FALSE_ISR((p_twdt_obj != NULL), ESP_ERR_INVALID_STATE, state_err, TAG, "task watchdog was never initialized");
-    // Check if the task is an entry, and if all entries have been reset
-    bool all_reset;
+    // Check if the task is an entry
     if (is_task) {
-        twdt_entry_t *entry_found = find_entry_from_task_handle_and_check_all_reset(entry->task_handle, &all_reset);
+        twdt_entry_t *entry_found = find_entry_from_task_handle(entry->task_handle);
         ESP_GOTO_ON_FALSE_ISR((entry_found == NULL), ESP_ERR_INVALID_ARG, state_err, TAG, "task is already subscribed");
+#if CONFIG_ESP_TASK_WDT_TLSP_INDEX
+        vTaskSetThreadLocalStoragePointer(entry->task_handle, CONFIG_ESP_TASK_WDT_TLSP_INDEX, entry);
+#endif // CONFIG_ESP_TASK_WDT_TLSP_INDEX
     } else {
-        bool entry_found = find_entry_and_check_all_reset(entry, &all_reset);
-        ESP_GOTO_ON_FALSE_ISR(!entry_found, ESP_ERR_INVALID_ARG, state_err, TAG, "user is already subscribed");
+        // Find a free slot for the user, the array of slots cannot be grown with the spinlock taken
+        while (user_index < p_twdt_obj->user_slots_num && p_twdt_obj->user_slots[user_index].entry != NULL) {
+            user_index++;
+        }
+        if (user_index == p_twdt_obj->user_slots_num) {
+            const uint32_t slots_num = p_twdt_obj->user_slots_num;
+            portEXIT_CRITICAL(&spinlock);
+            ret = grow_user_slots(slots_num);
+            if (ret != ESP_OK) {
+                free(entry);
+                return ret;
+            }
+            goto retry;
+        }
+        // Skip the generation 0 of the free slots when wrapping around
+        user_generation = (user_generation + 1) & (UINT32_MAX >> TWDT_USER_INDEX_BITS);
+        if (user_generation == 0) {
+            user_generation = 1;
+        }
+        p_twdt_obj->user_slots[user_index].entry = entry;
+        p_twdt_obj->user_slots[user_index].generation = user_generation;
+        *user_handle_ret = (esp_task_wdt_user_handle_t)(((uintptr_t)user_generation << TWDT_USER_INDEX_BITS) | user_index);
     }
+    // Check if all entries have been reset, the new entry is not
+    bool all_reset = (p_twdt_obj->not_reset_num == 0);
+    entry->reset_period = p_twdt_obj->period - 1;
     // Add entry to list
     SLIST_INSERT_HEAD(&p_twdt_obj->entries_slist, entry, slist_entry);
+    p_twdt_obj->entries_num++;
+    p_twdt_obj->not_reset_num++;
     // Start the timer if it has not been started yet and was waiting on a task to registered
     if (p_twdt_obj->waiting_for_task) {
         esp_task_wdt_impl_timer_restart(p_twdt_obj->impl_ctx);
@@ -201,7 +329,6 @@ static esp_err_t add_entry(bool is_task, void *entry_data, twdt_entry_t **entry_
         task_wdt_timer_feed();
     }
     portEXIT_CRITICAL(&spinlock);
-    *entry_ret = entry;
     return ESP_OK;
 
 state_err:
@@ -214,7 +341,7 @@ state_err:
  * @brief Delete a task/user entry
  *
  * @param[in] is_task Whether the entry is a task entry or user entry
- * @param[in] entry_data Data associated with the entry (either a task handle or user entry name)
+ * @param[in] entry_data Data associated with the entry (either a task handle or user handle)
  * @return ESP_OK if entry was deleted, failure otherwise
  */
 static esp_err_t delete_entry(bool is_task, void *entry_data)
@@ -225,18 +352,28 @@ static esp_err_t delete_entry(bool is_task, void *entry_data)
     // Check TWDT state
     ESP_GOTO_ON_FALSE_ISR((p_twdt_obj != NULL), ESP_ERR_INVALID_STATE, err, TAG, "task watchdog was never initialized");
     // Find entry for task
-    bool all_reset;
     twdt_entry_t *entry;
     if (is_task) {
-        entry = find_entry_from_task_handle_and_check_all_reset((TaskHandle_t)entry_data, &all_reset);
+        entry = find_entry_from_task_handle((TaskHandle_t)entry_data);
         ESP_GOTO_ON_FALSE_ISR((entry != NULL), ESP_ERR_NOT_FOUND, err, TAG, "task not found");
+#if CONFIG_ESP_TASK_WDT_TLSP_INDEX
+        vTaskSetThreadLocalStoragePointer(entry->task_handle, CONFIG_ESP_TASK_WDT_TLSP_INDEX, NULL);
+#endif // CONFIG_ESP_TASK_WDT_TLSP_INDEX
     } else {
-        entry = (twdt_entry_t *)entry_data;
-        bool entry_found = find_entry_and_check_all_reset(entry, &all_reset);
-        ESP_GOTO_ON_FALSE_ISR(entry_found, ESP_ERR_NOT_FOUND, err, TAG, "user not found");
+        twdt_user_slot_t *slot = find_user_slot((esp_task_wdt_user_handle_t)entry_data);
+        ESP_GOTO_ON_FALSE_ISR((slot != NULL), ESP_ERR_NOT_FOUND, err, TAG, "user not found");
+        entry = slot->entry;
+        // Free the slot, the handle of the user is no longer valid
+        slot->entry = NULL;
+        slot->generation = 0;
     }
     // Remove entry
     SLIST_REMOVE(&p_twdt_obj->entries_slist, entry, twdt_entry, slist_entry);
+    p_twdt_obj->entries_num--;
+    if (!entry_has_reset(entry)) {
+        p_twdt_obj->not_reset_num--;
+    }
+    bool all_reset = (p_twdt_obj->not_reset_num == 0);
     /* Stop the timer if we don't have any more tasks/objects to watch */
     if (SLIST_EMPTY(&p_twdt_obj->entries_slist)) {
         p_twdt_obj->waiting_for_task = true;
@@ -524,7 +661,7 @@ static void task_wdt_isr(void *arg)
     bool panic = p_twdt_obj->panic;
 
     SLIST_FOREACH(entry, &p_twdt_obj->entries_slist, slist_entry) {
-        if (!entry->has_reset) {
+        if (!entry_has_reset(entry)) {
             if (entry->task_handle) {
 #if CONFIG_FREERTOS_SMP
 #if configNUM_CORES > 1
@@ -732,6 +869,7 @@ esp_err_t esp_task_wdt_deinit(void)
     esp_task_wdt_impl_timer_free(p_twdt_obj->impl_ctx);
 
     // Free the global object
+    free(p_twdt_obj->user_slots);
     free(p_twdt_obj);
     p_twdt_obj = NULL;
 
@@ -750,9 +888,7 @@ esp_err_t esp_task_wdt_add(TaskHandle_t task_handle)
         task_handle = xTaskGetCurrentTaskHandle();
     }
 
-    twdt_entry_t *entry;
-    ret = add_entry(true, (void *)task_handle, &entry);
-    (void) entry; // Returned entry pointer not used
+    ret = add_entry(true, (void *)task_handle, NULL);
     return ret;
 }
 
@@ -760,13 +896,7 @@ esp_err_t esp_task_wdt_add_user(const char *user_name, esp_task_wdt_user_handle_
 {
     ESP_RETURN_ON_FALSE((user_name != NULL && user_handle_ret != NULL), ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
     ESP_RETURN_ON_FALSE(p_twdt_obj != NULL, ESP_ERR_INVALID_STATE, TAG, "TWDT was never initialized");
-    esp_err_t ret;
-    twdt_entry_t *entry;
-    ret = add_entry(false, (void *)user_name, &entry);
-    if (ret == ESP_OK) {
-        *user_handle_ret = (esp_task_wdt_user_handle_t)entry;
-    }
-    return ret;
+    return add_entry(false, (void *)user_name, user_handle_ret);
 }
 
 esp_err_t esp_task_wdt_reset(void)
@@ -777,15 +907,10 @@ esp_err_t esp_task_wdt_reset(void)
 
     portENTER_CRITICAL(&spinlock);
     // Find entry from task handle
-    bool all_reset;
-    twdt_entry_t *entry;
-    entry = find_entry_from_task_handle_and_check_all_reset(handle, &all_reset);
+    twdt_entry_t *entry = find_entry_from_current_task(handle);
     ESP_GOTO_ON_FALSE_ISR((entry != NULL), ESP_ERR_NOT_FOUND, err, TAG, "task not found");
     // Mark entry as reset and issue timer reset if all entries have been reset
-    entry->has_reset = true;    // Reset the task if it's on the task list
-    if (all_reset) {    // Reset if all other tasks in list have reset in
-        task_wdt_timer_feed();
-    }
+    reset_entry(entry);
     ret = ESP_OK;
 err:
     portEXIT_CRITICAL(&spinlock);
@@ -800,16 +925,12 @@ esp_err_t esp_task_wdt_reset_user(esp_task_wdt_user_handle_t user_handle)
     esp_err_t ret;
 
     portENTER_CRITICAL(&spinlock);
-    // Check if entry exists
-    bool all_reset;
-    twdt_entry_t *entry = (twdt_entry_t *)user_handle;
-    bool entry_found = find_entry_and_check_all_reset(entry, &all_reset);
-    ESP_GOTO_ON_FALSE_ISR(entry_found, ESP_ERR_NOT_FOUND, err, TAG, "user handle not found");
+    /* The handle gives the slot of the user instead of being searched in the list, so that feeding the TWDT does not
+     * depend on the number of subscribed tasks and users. */
+    twdt_user_slot_t *slot = find_user_slot(user_handle);
+    ESP_GOTO_ON_FALSE_ISR((slot != NULL), ESP_ERR_NOT_FOUND, err, TAG, "user not found");
     // Mark entry as reset and issue timer reset if all entries have been reset
-    entry->has_reset = true;    // Reset the task if it's on the task list
-    if (all_reset) {    // Reset if all other tasks in list have reset in
-        task_wdt_timer_feed();
-    }
+    reset_entry(slot->entry);
     ret = ESP_OK;
 err:
     portEXIT_CRITICAL(&spinlock);
@@ -846,10 +967,7 @@ esp_err_t esp_task_wdt_status(TaskHandle_t task_handle)
 
     portENTER_CRITICAL(&spinlock);
     // Find entry for task
-    bool all_reset;
-    twdt_entry_t *entry;
-    entry = find_entry_from_task_handle_and_check_all_reset(task_handle, &all_reset);
-    (void) all_reset;   // Unused
+    twdt_entry_t *entry = find_entry_from_task_handle(task_handle);
     ret = (entry != NULL) ? ESP_OK : ESP_ERR_NOT_FOUND;
     portEXIT_CRITICAL(&spinlock);
 
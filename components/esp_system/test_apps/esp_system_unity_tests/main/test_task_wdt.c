@@ -153,4 +153,47 @@ TEST_CASE("Task WDT user feed", "[task_wdt]")
     TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_deinit());
 }
 
+TEST_CASE("Task WDT many users feed", "[task_wdt]")
+{
+    const char *user_name = "test_user";
+    esp_task_wdt_user_handle_t user_handles[40];
+    const int users_num = sizeof(user_handles) / sizeof(user_handles[0]);
+    timeout_flag = false;
+    esp_task_wdt_config_t twdt_config = {
+        .timeout_ms = TASK_WDT_TIMEOUT_MS,
+        .idle_core_mask = 0,
+        .trigger_panic = false,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_init(&twdt_config));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_add(NULL));
+    for (int i = 0; i < users_num; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_add_user(user_name, &user_handles[i]));
+    }
+    // Feed the watchdog on behalf of all but one user, which must trigger a timeout
+    for (int i = 0; i < 4; i++) {
+        esp_rom_delay_us((TASK_WDT_TIMEOUT_MS * 1000) / 4);
+        TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_reset());
+        for (int j = 1; j < users_num; j++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_reset_user(user_handles[j]));
+        }
+    }
+    TEST_ASSERT_EQUAL(true, timeout_flag);
+    // Once the last user is unsubscribed, feeding the others is enough
+    TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_delete_user(user_handles[0]));
+    timeout_flag = false;
+    for (int i = 0; i < 4; i++) {
+        esp_rom_delay_us((TASK_WDT_TIMEOUT_MS * 1000) / 2);
+        TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_reset());
+        for (int j = 1; j < users_num; j++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_reset_user(user_handles[j]));
+        }
+    }
+    TEST_ASSERT_EQUAL(false, timeout_flag);
+    for (int i = 1; i < users_num; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_delete_user(user_handles[i]));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_delete(NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_task_wdt_deinit());
+}
+
 #endif // CONFIG_ESP_TASK_WDT_EN
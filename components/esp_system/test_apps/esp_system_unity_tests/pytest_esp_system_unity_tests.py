@@ -12,6 +12,7 @@ from pytest_embedded import Dut
         pytest.param('default', marks=[pytest.mark.supported_targets]),
         pytest.param('psram', marks=[pytest.mark.esp32, pytest.mark.esp32s2, pytest.mark.esp32s3]),
         pytest.param('single_core_esp32', marks=[pytest.mark.esp32]),
+        pytest.param('task_wdt_tlsp', marks=[pytest.mark.esp32, pytest.mark.esp32c3]),
     ]
 )
 def test_esp_system(dut: Dut) -> None:
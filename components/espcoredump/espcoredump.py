@@ -1,14 +1,19 @@
 #!/usr/bin/env python
 #
-# SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
 #
 # SPDX-License-Identifier: Apache-2.0
 #
 
+import hashlib
 import json
 import logging
 import os.path
-from typing import Any
+import struct
+import sys
+import tempfile
+import zlib
+from typing import Any, List, Optional
 
 try:
     from esp_coredump import CoreDump
@@ -18,6 +23,18 @@ except ImportError:
 
 from esp_coredump.cli_ext import parser
 
+# Core dump header: data_len, version, tasks_num, tcb_sz, mem_segs_num
+COREDUMP_HEADER = struct.Struct('<5I')
+COREDUMP_CACHE_SIZE = 32
+COREDUMP_VERSION_ELF = 1
+COREDUMP_VERSION_ELF_COMPRESSED = 2
+# Checksum length by minor version of the ELF formats
+COREDUMP_CHECKSUM_LEN = {0: 4, 1: 32}
+
+# Parameters of the compressed stream, see core_dump_compress.h
+COMPRESS_MIN_MATCH = 3
+COMPRESS_LONG_CODE = 63
+
 
 def get_prefix_map_gdbinit_path(prog_path):  # type: (str) -> Any
     build_dir = os.path.abspath(os.path.dirname(prog_path))
@@ -32,6 +49,115 @@ def get_prefix_map_gdbinit_path(prog_path):  # type: (str) -> Any
     return project_desc.get('debug_prefix_map_gdbinit')
 
 
+def is_compression_enabled(prog_path):  # type: (str) -> bool
+    desc_path = os.path.abspath(os.path.join(os.path.dirname(prog_path), 'project_description.json'))
+    if not os.path.isfile(desc_path):
+        return False
+
+    with open(desc_path, 'r') as f:
+        config_file = json.load(f).get('config_file')
+    if not config_file or not os.path.isfile(config_file):
+        return False
+
+    with open(config_file, 'r') as f:
+        return any(line.strip() == 'CONFIG_ESP_COREDUMP_COMPRESSION=y' for line in f)
+
+
+def calc_checksum(data, minor):  # type: (bytes, int) -> bytes
+    if minor == 1:
+        return hashlib.sha256(data).digest()
+    return struct.pack('<I', zlib.crc32(data) & 0xFFFFFFFF)
+
+
+def decompress(data, out_len):  # type: (bytes, int) -> bytes
+    out = bytearray()
+    pos = 0
+    try:
+        while len(out) < out_len:
+            flags = data[pos]
+            pos += 1
+            for i in range(8):
+                if len(out) >= out_len:
+                    break
+                if not flags & (1 << i):
+                    out.append(data[pos])
+                    pos += 1
+                    continue
+                offset = (data[pos] | ((data[pos + 1] & 0x3) << 8)) + 1
+                code = data[pos + 1] >> 2
+                pos += 2
+                length = code + COMPRESS_MIN_MATCH
+                if code == COMPRESS_LONG_CODE:
+                    length += data[pos]
+                    pos += 1
+                if offset > len(out):
+                    raise ValueError('Corrupted core dump: match offset {} at position {}'.format(offset, len(out)))
+                start = len(out) - offset
+                if offset >= length:
+                    out += out[start:start + length]
+                else:
+                    # the match overlaps the bytes it produces
+                    for j in range(length):
+                        out.append(out[start + j])
+    except IndexError:
+        raise ValueError('Corrupted core dump: stream ends at position {}'.format(len(out)))
+    if len(out) != out_len:
+        raise ValueError('Corrupted core dump: {} bytes decompressed instead of {}'.format(len(out), out_len))
+    return bytes(out)
+
+
+def decompress_raw_core(core_path):  # type: (str) -> Optional[str]
+    """
+    If the raw core dump is compressed, write the uncompressed core dump to a temporary file and return its path.
+    Returns None if the core dump is not compressed.
+    """
+    with open(core_path, 'rb') as f:
+        raw = f.read()
+    if len(raw) < COREDUMP_HEADER.size:
+        return None
+    data_len, version, elf_len, _, _ = COREDUMP_HEADER.unpack_from(raw)
+    if (version >> 8) & 0xFF != COREDUMP_VERSION_ELF_COMPRESSED:
+        return None
+
+    minor = version & 0xFF
+    cs_len = COREDUMP_CHECKSUM_LEN[minor]
+    if data_len > len(raw) or data_len < COREDUMP_HEADER.size + cs_len:
+        raise ValueError('Invalid core dump length {}'.format(data_len))
+    body = raw[:data_len - cs_len]
+    if calc_checksum(body, minor) != raw[data_len - cs_len:data_len]:
+        raise ValueError('Core dump checksum mismatch')
+    elf = decompress(body[COREDUMP_HEADER.size:], elf_len)
+    logging.info('Decompressed core dump of %d bytes to %d bytes', data_len, elf_len)
+
+    # Rebuild the core dump as the target writes it without compression
+    padding = -(COREDUMP_HEADER.size + elf_len) % COREDUMP_CACHE_SIZE
+    out_len = COREDUMP_HEADER.size + elf_len + padding + cs_len
+    out_version = (version & ~0xFF00) | (COREDUMP_VERSION_ELF << 8)
+    body = COREDUMP_HEADER.pack(out_len, out_version, 0, 0, 0) + elf + b'\x00' * padding
+
+    fd, out_path = tempfile.mkstemp(prefix='coredump_', suffix='.bin')
+    with os.fdopen(fd, 'wb') as f:
+        f.write(body + calc_checksum(body, minor))
+    return out_path
+
+
+def read_flash_core(port, baud):  # type: (Optional[str], Optional[int]) -> str
+    """
+    Read the core dump partition into a temporary file and return its path.
+    """
+    try:
+        from parttool import PartitionType, ParttoolTarget
+    except ImportError:
+        sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'partition_table'))
+        from parttool import PartitionType, ParttoolTarget
+
+    fd, out_path = tempfile.mkstemp(prefix='coredump_', suffix='.bin')
+    os.close(fd)
+    target = ParttoolTarget(port=port, baud=baud)
+    target.read_partition(PartitionType('data', 'coredump'), out_path)
+    return out_path
+
+
 def main():  # type: () -> None
     args = parser.parse_args()
 
@@ -54,23 +180,32 @@ def main():  # type: () -> None
     del kwargs['debug']
     del kwargs['operation']
 
-    espcoredump = CoreDump(**kwargs)
-    temp_core_files = None
+    # Compressed core dumps are decompressed before they are passed to esp_coredump
+    temp_core_files = []  # type: List[str]
+    if 'core' not in kwargs and is_compression_enabled(kwargs['prog']):
+        kwargs['core'] = read_flash_core(kwargs.get('port'), kwargs.get('baud'))
+        kwargs['core_format'] = 'raw'
+        temp_core_files.append(kwargs['core'])
+    if 'core' in kwargs and kwargs.get('core_format') == 'raw':
+        decompressed = decompress_raw_core(kwargs['core'])
+        if decompressed:
+            kwargs['core'] = decompressed
+            temp_core_files.append(decompressed)
 
     try:
+        espcoredump = CoreDump(**kwargs)
         if args.operation == 'info_corefile':
-            temp_core_files = espcoredump.info_corefile()
+            temp_core_files += espcoredump.info_corefile() or []
         elif args.operation == 'dbg_corefile':
-            temp_core_files = espcoredump.dbg_corefile()
+            temp_core_files += espcoredump.dbg_corefile() or []
         else:
             raise ValueError('Please specify action, should be info_corefile or dbg_corefile')
     finally:
-        if temp_core_files:
-            for f in temp_core_files:
-                try:
-                    os.remove(f)
-                except OSError:
-                    pass
+        for f in temp_core_files:
+            try:
+                os.remove(f)
+            except OSError:
+                pass
 
 
 if __name__ == '__main__':
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Core dump streaming compression interface.
+ *
+ * The compressor sits between the ELF generator and the write callback of the
+ * destination. It uses a LZSS scheme with a small static window, so it needs
+ * no heap and can run in the panic handler.
+ *
+ * Stream format: groups of one flag byte followed by up to 8 tokens. Bit i of
+ * the flag byte (LSB first) tells whether token i is a literal (0), a single
+ * byte, or a match (1), which copies bytes from earlier output:
+ *
+ *     byte 0: (offset - 1) & 0xff
+ *     byte 1: ((offset - 1) >> 8) | (code << 2)
+ *     byte 2: length - COREDUMP_COMPRESS_LONG_MIN, only present if code is 63
+ *
+ * where offset is in [1, COREDUMP_COMPRESS_WINDOW_SIZE] and length is code + 3
+ * for codes up to 62. Matches can overlap the bytes they produce. The
+ * uncompressed length is stored in the core dump header, the decoder stops
+ * once it has produced that many bytes.
+ */
+
+#ifndef CORE_DUMP_COMPRESS_H_
+#define CORE_DUMP_COMPRESS_H_
+
+#include "esp_core_dump_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COREDUMP_COMPRESS_WINDOW_SIZE   1024
+#define COREDUMP_COMPRESS_MIN_MATCH     3
+#define COREDUMP_COMPRESS_LONG_CODE     63
+#define COREDUMP_COMPRESS_LONG_MIN      (COREDUMP_COMPRESS_LONG_CODE + COREDUMP_COMPRESS_MIN_MATCH)
+#define COREDUMP_COMPRESS_MAX_MATCH     (COREDUMP_COMPRESS_LONG_MIN + 255)
+
+/**
+ * @brief Start a new compressed stream.
+ *
+ * @param write_cfg Destination of the compressed data. If NULL, the data is
+ *                  only compressed and counted, which is used to find the size
+ *                  of the compressed core dump before writing it.
+ */
+void esp_core_dump_compress_start(core_dump_write_config_t *write_cfg);
+
+/**
+ * @brief Compress data and pass the output to the destination.
+ *
+ * It has the signature of a write callback, so that it can replace the write
+ * function of the destination in a core_dump_write_config_t.
+ *
+ * @param priv      Private data of the destination.
+ * @param data      Data to compress.
+ * @param data_len  Length of the data, in bytes.
+ *
+ * @return ESP_OK on success, otherwise the error returned by the destination.
+ */
+esp_err_t esp_core_dump_compress_write(core_dump_write_data_t *priv, void *data, uint32_t data_len);
+
+/**
+ * @brief Compress the remaining data and end the stream.
+ *
+ * @param[out] in_len   Total length of the data received, in bytes.
+ * @param[out] out_len  Total length of the compressed stream, in bytes.
+ *
+ * @return ESP_OK on success, otherwise the error returned by the destination.
+ */
+esp_err_t esp_core_dump_compress_finish(uint32_t *in_len, uint32_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -61,8 +61,10 @@ extern "C" {
                                                 (((_maj_)&0xFF) << 8) | \
                                                 (((_min_)&0xFF) << 0) \
                                             )
+#define COREDUMP_VERSION_GET_FORMAT(_ver_)  (((_ver_) >> 8) & 0xFF)
 #define COREDUMP_VERSION_BIN                0
 #define COREDUMP_VERSION_ELF                1
+#define COREDUMP_VERSION_ELF_COMPRESSED     2 // minor number is the one of the uncompressed ELF format, see core_dump_compress.h
 
 /* legacy bin coredumps (before IDF v4.1) has version set to 1 */
 #define COREDUMP_VERSION_BIN_LEGACY         COREDUMP_VERSION_MAKE(COREDUMP_VERSION_BIN, 1) // -> 0x0001
@@ -140,7 +142,7 @@ typedef struct _core_dump_header_t
 {
     uint32_t data_len;  /*!< Data length */
     uint32_t version;   /*!< Core dump version */
-    uint32_t tasks_num; /*!< Number of tasks */
+    uint32_t tasks_num; /*!< Number of tasks, length of the uncompressed ELF file for compressed ELF core dumps */
     uint32_t tcb_sz;    /*!< Size of a TCB, in bytes */
     uint32_t mem_segs_num; /*!< Number of memory segments */
 } core_dump_header_t;
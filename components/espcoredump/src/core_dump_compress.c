@@ -0,0 +1,196 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/**
+ * @file
+ * @brief Core dump streaming compression implementation
+ *
+ * Please refer to "core_dump_compress.h" for the description of the format.
+ */
+
+#include <string.h>
+#include "esp_attr.h"
+#include "core_dump_compress.h"
+
+#if CONFIG_ESP_COREDUMP_COMPRESSION
+
+const static DRAM_ATTR char TAG[] __attribute__((unused)) = "esp_core_dump_compress";
+
+/* The ring holds the window of already encoded data followed by the data
+ * waiting to be encoded, which is at most one maximum length match. */
+#define RING_SIZE           (2 * COREDUMP_COMPRESS_WINDOW_SIZE)
+#define RING_MASK           (RING_SIZE - 1)
+#define HASH_BITS           8
+#define HASH_SIZE           (1 << HASH_BITS)
+/* Flag byte and 8 tokens of at most 3 bytes */
+#define GROUP_MAX_SIZE      (1 + 8 * 3)
+#define OUT_BUF_SIZE        128
+
+_Static_assert(COREDUMP_COMPRESS_WINDOW_SIZE + COREDUMP_COMPRESS_MAX_MATCH <= RING_SIZE,
+               "Compression ring too small");
+_Static_assert(COREDUMP_COMPRESS_WINDOW_SIZE <= 1024, "Match offsets are encoded on 10 bits");
+
+typedef struct {
+    core_dump_write_config_t *write_cfg;
+    uint32_t pos;                   /* Position of the next byte to encode */
+    uint32_t end;                   /* Position after the last byte received */
+    uint32_t total_out;             /* Bytes of compressed output */
+    uint32_t hash_head[HASH_SIZE];  /* Last position + 1 of each hashed 3-byte sequence, 0 if none */
+    uint8_t ring[RING_SIZE];
+    uint8_t out[OUT_BUF_SIZE];
+    uint32_t out_len;
+    uint32_t flag_idx;              /* Index in out of the flag byte of the current group */
+    uint32_t tokens;                /* Number of tokens in the current group */
+} core_dump_compress_ctx_t;
+
+static core_dump_compress_ctx_t s_ctx;
+
+static inline uint32_t hash3(const uint8_t *ring, uint32_t pos)
+{
+    const uint32_t v = (ring[pos & RING_MASK] << 16) |
+                       (ring[(pos + 1) & RING_MASK] << 8) |
+                       ring[(pos + 2) & RING_MASK];
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static esp_err_t flush_out(void)
+{
+    esp_err_t err = ESP_OK;
+    if (s_ctx.write_cfg && s_ctx.out_len > 0) {
+        err = s_ctx.write_cfg->write(s_ctx.write_cfg->priv, s_ctx.out, s_ctx.out_len);
+    }
+    s_ctx.total_out += s_ctx.out_len;
+    s_ctx.out_len = 0;
+    return err;
+}
+
+static esp_err_t begin_token(bool is_match)
+{
+    if (s_ctx.tokens == 8) {
+        s_ctx.tokens = 0;
+    }
+    if (s_ctx.tokens == 0) {
+        /* Start a new group, making sure that it fits in the output buffer entirely */
+        if (s_ctx.out_len + GROUP_MAX_SIZE > OUT_BUF_SIZE) {
+            esp_err_t err = flush_out();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        s_ctx.flag_idx = s_ctx.out_len;
+        s_ctx.out[s_ctx.out_len++] = 0;
+    }
+    if (is_match) {
+        s_ctx.out[s_ctx.flag_idx] |= 1 << s_ctx.tokens;
+    }
+    s_ctx.tokens++;
+    return ESP_OK;
+}
+
+/* Encode one token at the current position */
+static esp_err_t encode_token(void)
+{
+    const uint32_t pending = s_ctx.end - s_ctx.pos;
+    uint32_t best_len = 0;
+    uint32_t offset = 0;
+
+    if (pending >= COREDUMP_COMPRESS_MIN_MATCH) {
+        const uint32_t h = hash3(s_ctx.ring, s_ctx.pos);
+        const uint32_t cand = s_ctx.hash_head[h];
+        s_ctx.hash_head[h] = s_ctx.pos + 1;
+        if (cand != 0 && s_ctx.pos - (cand - 1) <= COREDUMP_COMPRESS_WINDOW_SIZE) {
+            const uint32_t max_len = pending < COREDUMP_COMPRESS_MAX_MATCH ? pending : COREDUMP_COMPRESS_MAX_MATCH;
+            offset = s_ctx.pos - (cand - 1);
+            while (best_len < max_len &&
+                   s_ctx.ring[(s_ctx.pos + best_len - offset) & RING_MASK] == s_ctx.ring[(s_ctx.pos + best_len) & RING_MASK]) {
+                best_len++;
+            }
+        }
+    }
+
+    esp_err_t err = begin_token(best_len >= COREDUMP_COMPRESS_MIN_MATCH);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (best_len < COREDUMP_COMPRESS_MIN_MATCH) {
+        s_ctx.out[s_ctx.out_len++] = s_ctx.ring[s_ctx.pos & RING_MASK];
+        s_ctx.pos++;
+        return ESP_OK;
+    }
+
+    uint32_t code = best_len - COREDUMP_COMPRESS_MIN_MATCH;
+    if (code > COREDUMP_COMPRESS_LONG_CODE) {
+        code = COREDUMP_COMPRESS_LONG_CODE;
+    }
+    s_ctx.out[s_ctx.out_len++] = (offset - 1) & 0xff;
+    s_ctx.out[s_ctx.out_len++] = ((offset - 1) >> 8) | (code << 2);
+    if (code == COREDUMP_COMPRESS_LONG_CODE) {
+        s_ctx.out[s_ctx.out_len++] = best_len - COREDUMP_COMPRESS_LONG_MIN;
+    }
+    /* Remember the end of the match too, so that long runs of the same data
+     * continue with another match right away */
+    const uint32_t last = s_ctx.pos + best_len - 1;
+    if (s_ctx.end - last >= COREDUMP_COMPRESS_MIN_MATCH) {
+        s_ctx.hash_head[hash3(s_ctx.ring, last)] = last + 1;
+    }
+    s_ctx.pos += best_len;
+    return ESP_OK;
+}
+
+void esp_core_dump_compress_start(core_dump_write_config_t *write_cfg)
+{
+    memset(&s_ctx, 0, sizeof(s_ctx));
+    s_ctx.write_cfg = write_cfg;
+}
+
+esp_err_t esp_core_dump_compress_write(core_dump_write_data_t *priv, void *data, uint32_t data_len)
+{
+    const uint8_t *in = (const uint8_t *)data;
+    (void)priv;
+
+    while (data_len > 0) {
+        /* Receive as much data as the ring can take without overwriting the window */
+        uint32_t n = COREDUMP_COMPRESS_MAX_MATCH - (s_ctx.end - s_ctx.pos);
+        if (n > data_len) {
+            n = data_len;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            s_ctx.ring[(s_ctx.end + i) & RING_MASK] = in[i];
+        }
+        s_ctx.end += n;
+        in += n;
+        data_len -= n;
+
+        /* Only encode once the longest possible match is available, the
+         * rest waits for more data or for the end of the stream */
+        while (s_ctx.end - s_ctx.pos >= COREDUMP_COMPRESS_MAX_MATCH) {
+            esp_err_t err = encode_token();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_core_dump_compress_finish(uint32_t *in_len, uint32_t *out_len)
+{
+    while (s_ctx.pos < s_ctx.end) {
+        esp_err_t err = encode_token();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    esp_err_t err = flush_out();
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_COREDUMP_LOGD("Compressed %u bytes to %u bytes", s_ctx.end, s_ctx.total_out);
+    *in_len = s_ctx.end;
+    *out_len = s_ctx.total_out;
+    return ESP_OK;
+}
+
+#endif /* CONFIG_ESP_COREDUMP_COMPRESSION */
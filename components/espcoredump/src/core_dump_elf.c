@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -13,6 +13,7 @@
 #include "esp_core_dump_port.h"
 #include "esp_core_dump_port_impl.h"
 #include "esp_core_dump_common.h"
+#include "core_dump_compress.h"
 
 #ifdef CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF
 #include "esp_app_desc.h"
@@ -564,13 +565,35 @@ static int esp_core_dump_do_write_elf_pass(core_dump_elf_t *self)
     return tot_len;
 }
 
+// Writes the ELF file headers and data, the sizes must have been calculated before
+static int esp_core_dump_write_elf_contents(core_dump_elf_t *self)
+{
+    int write_len = 0;
+
+    self->elf_stage = ELF_STAGE_PLACE_HEADERS;
+    // set initial offset to elf segments data area
+    self->elf_next_data_offset = sizeof(elfhdr) + ELF_SEG_HEADERS_COUNT(self) * sizeof(elf_phdr);
+    int ret = esp_core_dump_do_write_elf_pass(self);
+    if (ret < 0) return ret;
+    write_len += ret;
+    ESP_COREDUMP_LOG_PROCESS("============== Headers size = %d bytes ============", write_len);
+
+    self->elf_stage = ELF_STAGE_PLACE_DATA;
+    // set initial offset to elf segments data area, this is not necessary in this stage, just for pretty debug output
+    self->elf_next_data_offset = sizeof(elfhdr) + ELF_SEG_HEADERS_COUNT(self) * sizeof(elf_phdr);
+    ret = esp_core_dump_do_write_elf_pass(self);
+    if (ret < 0) return ret;
+    write_len += ret;
+    ESP_COREDUMP_LOG_PROCESS("=========== Data written size = %d bytes ==========", write_len);
+    return write_len;
+}
+
 esp_err_t esp_core_dump_write_elf(core_dump_write_config_t *write_cfg)
 {
     static core_dump_elf_t self = { 0 };
     static core_dump_header_t dump_hdr = { 0 };
     esp_err_t err = ESP_OK;
     int tot_len = sizeof(dump_hdr);
-    int write_len = sizeof(dump_hdr);
 
     ELF_CHECK_ERR((write_cfg), ESP_ERR_INVALID_ARG, "Invalid input data.");
 
@@ -585,6 +608,26 @@ esp_err_t esp_core_dump_write_elf(core_dump_write_config_t *write_cfg)
     ESP_COREDUMP_LOG_PROCESS("Core dump tot_len=%lu", tot_len);
     ESP_COREDUMP_LOG_PROCESS("============== Data size = %d bytes ============", tot_len);
 
+#if CONFIG_ESP_COREDUMP_COMPRESSION
+    // The ELF file goes through the compressor, only the core dump header is written as is
+    static core_dump_write_config_t compress_cfg = { 0 };
+    uint32_t elf_len = 0;
+    uint32_t compressed_len = 0;
+    compress_cfg.write = esp_core_dump_compress_write;
+    compress_cfg.priv = write_cfg->priv;
+    self.write_cfg = &compress_cfg;
+
+    // The storage has to be prepared for the compressed size, so compress once without writing to find it
+    ESP_COREDUMP_LOG_PROCESS("============== Calc compressed size ============");
+    esp_core_dump_compress_start(NULL);
+    ret = esp_core_dump_write_elf_contents(&self);
+    if (ret < 0) return ret;
+    err = esp_core_dump_compress_finish(&elf_len, &compressed_len);
+    if (err != ESP_OK) return err;
+    tot_len = sizeof(dump_hdr) + compressed_len;
+    ESP_COREDUMP_LOG_PROCESS("========= Compressed size = %d bytes ===========", tot_len);
+#endif
+
     // Prepare write elf
     if (write_cfg->prepare) {
         err = write_cfg->prepare(write_cfg->priv, (uint32_t*)&tot_len);
@@ -605,8 +648,13 @@ esp_err_t esp_core_dump_write_elf(core_dump_write_config_t *write_cfg)
 
     // Write core dump header
     dump_hdr.data_len = tot_len;
+#if CONFIG_ESP_COREDUMP_COMPRESSION
+    dump_hdr.version = COREDUMP_VERSION_MAKE(COREDUMP_VERSION_ELF_COMPRESSED, esp_core_dump_elf_version());
+    dump_hdr.tasks_num = elf_len; // length of the ELF file before compression
+#else
     dump_hdr.version = esp_core_dump_elf_version();
     dump_hdr.tasks_num = 0; // unused in ELF format
+#endif
     dump_hdr.tcb_sz = 0; // unused in ELF format
     dump_hdr.mem_segs_num = 0; // unused in ELF format
     err = write_cfg->write(write_cfg->priv,
@@ -617,21 +665,23 @@ esp_err_t esp_core_dump_write_elf(core_dump_write_config_t *write_cfg)
         return err;
     }
 
-    self.elf_stage = ELF_STAGE_PLACE_HEADERS;
-    // set initial offset to elf segments data area
-    self.elf_next_data_offset = sizeof(elfhdr) + ELF_SEG_HEADERS_COUNT(&self) * sizeof(elf_phdr);
-    ret = esp_core_dump_do_write_elf_pass(&self);
-    if (ret < 0) return ret;
-    write_len += ret;
-    ESP_COREDUMP_LOG_PROCESS("============== Headers size = %d bytes ============", write_len);
-
-    self.elf_stage = ELF_STAGE_PLACE_DATA;
-    // set initial offset to elf segments data area, this is not necessary in this stage, just for pretty debug output
-    self.elf_next_data_offset = sizeof(elfhdr) + ELF_SEG_HEADERS_COUNT(&self) * sizeof(elf_phdr);
-    ret = esp_core_dump_do_write_elf_pass(&self);
+#if CONFIG_ESP_COREDUMP_COMPRESSION
+    esp_core_dump_compress_start(write_cfg);
+#endif
+    ret = esp_core_dump_write_elf_contents(&self);
     if (ret < 0) return ret;
-    write_len += ret;
-    ESP_COREDUMP_LOG_PROCESS("=========== Data written size = %d bytes ==========", write_len);
+#if CONFIG_ESP_COREDUMP_COMPRESSION
+    uint32_t written_len = 0;
+    err = esp_core_dump_compress_finish(&elf_len, &written_len);
+    if (err != ESP_OK) {
+        ESP_COREDUMP_LOGE("Failed to write compressed data (%d)!", err);
+        return err;
+    }
+    if (written_len != compressed_len) {
+        ESP_COREDUMP_LOGE("Compressed size changed from %d to %d bytes!", compressed_len, written_len);
+        return ESP_FAIL;
+    }
+#endif
 
     // Write end, update checksum
     if (write_cfg->end) {
@@ -720,6 +770,12 @@ esp_err_t esp_core_dump_get_summary(esp_core_dump_summary_t *summary)
     if (err != ESP_OK) {
         return err;
     }
+    const core_dump_header_t *dump_hdr = (const core_dump_header_t *) map_addr;
+    if (COREDUMP_VERSION_GET_FORMAT(dump_hdr->version) == COREDUMP_VERSION_ELF_COMPRESSED) {
+        ESP_COREDUMP_LOGE("Summary of compressed core dumps is not supported!");
+        esp_partition_munmap(core_data_handle);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     uint8_t *ptr = (uint8_t *) map_addr + sizeof(core_dump_header_t);
     elfhdr *eh = (elfhdr *)ptr;
 
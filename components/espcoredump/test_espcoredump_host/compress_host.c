@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/*
+ * Compresses the data read from stdin with the core dump compressor and
+ * writes the compressed stream to stdout. As on the target, the data is
+ * compressed once to find the compressed size and once more to write it.
+ *
+ * Usage: compress_host <chunk size>
+ * The data is passed to the compressor in chunks of the given size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "core_dump_compress.h"
+
+static esp_err_t write_stdout(core_dump_write_data_t *priv, void *data, uint32_t data_len)
+{
+    (void)priv;
+    return fwrite(data, 1, data_len, stdout) == data_len ? ESP_OK : ESP_FAIL;
+}
+
+static void compress(core_dump_write_config_t *write_cfg, const uint8_t *data, size_t len, size_t chunk,
+                     uint32_t *in_len, uint32_t *out_len)
+{
+    esp_core_dump_compress_start(write_cfg);
+    for (size_t off = 0; off < len; off += chunk) {
+        const size_t n = len - off < chunk ? len - off : chunk;
+        if (esp_core_dump_compress_write(NULL, (void *)(data + off), n) != ESP_OK) {
+            fprintf(stderr, "Failed to compress\n");
+            exit(1);
+        }
+    }
+    if (esp_core_dump_compress_finish(in_len, out_len) != ESP_OK) {
+        fprintf(stderr, "Failed to finish the compression\n");
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    core_dump_write_config_t write_cfg = { .write = write_stdout };
+    uint8_t *data = NULL;
+    size_t len = 0;
+    size_t size = 0;
+    uint32_t in_len;
+    uint32_t calc_len;
+    uint32_t out_len;
+
+    if (argc != 2 || atoi(argv[1]) <= 0) {
+        fprintf(stderr, "Usage: %s <chunk size>\n", argv[0]);
+        return 1;
+    }
+    while (!feof(stdin)) {
+        if (len == size) {
+            size = size ? 2 * size : 4096;
+            data = realloc(data, size);
+            if (!data) {
+                return 1;
+            }
+        }
+        len += fread(data + len, 1, size - len, stdin);
+    }
+
+    compress(NULL, data, len, atoi(argv[1]), &in_len, &calc_len);
+    compress(&write_cfg, data, len, atoi(argv[1]), &in_len, &out_len);
+    free(data);
+    if (in_len != len || out_len != calc_len) {
+        fprintf(stderr, "Compressed %u of %zu bytes to %u bytes, %u bytes expected\n", in_len, len, out_len, calc_len);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/* Configuration used to build the core dump compressor on the host */
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_IDF_FIRMWARE_CHIP_ID 0x0000
+#define CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH 1
+#define CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF 1
+#define CONFIG_ESP_COREDUMP_CHECKSUM_CRC32 1
+#define CONFIG_ESP_COREDUMP_COMPRESSION 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_LOG_MAXIMUM_LEVEL 3
@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+import zlib
+
+try:
+    import espcoredump
+except ImportError:
+    sys.path.append('..')
+    import espcoredump
+
+
+'''
+Round trip of the core dump compressor (src/core_dump_compress.c), built for the host, through the decompressor of
+espcoredump.py.
+
+To run the test on local PC:
+cd ~/esp/esp-idf/components/espcoredump/test_espcoredump_host/
+ ./test_compress.py
+'''
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+COMPONENT_DIR = os.path.dirname(TEST_DIR)
+COMPONENTS_DIR = os.path.dirname(COMPONENT_DIR)
+
+INCLUDE_DIRS = [
+    TEST_DIR,
+    os.path.join(COMPONENT_DIR, 'include_core_dump'),
+    os.path.join(COMPONENT_DIR, 'include'),
+    os.path.join(COMPONENTS_DIR, 'esp_common', 'include'),
+    os.path.join(COMPONENTS_DIR, 'esp_system', 'include'),
+    os.path.join(COMPONENTS_DIR, 'esp_rom', 'include'),
+    os.path.join(COMPONENTS_DIR, 'log', 'include'),
+    os.path.join(COMPONENTS_DIR, 'soc', 'include'),
+    os.path.join(COMPONENTS_DIR, 'soc', 'esp32', 'include'),
+    os.path.join(COMPONENTS_DIR, 'hal', 'include'),
+    os.path.join(COMPONENTS_DIR, 'esp_hw_support', 'include'),
+]
+
+# Chunk sizes in which the data is passed to the compressor
+CHUNK_SIZES = [1, 7, 32, 4096]
+
+
+class CompressTestCase(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):  # type: () -> None
+        cls.build_dir = tempfile.mkdtemp(prefix='coredump_compress_')
+        cls.compressor = os.path.join(cls.build_dir, 'compress_host')
+        subprocess.check_call([os.environ.get('CC', 'cc'), '-O2', '-Wall', '-Werror', '-o', cls.compressor,
+                               os.path.join(TEST_DIR, 'compress_host.c'),
+                               os.path.join(COMPONENT_DIR, 'src', 'core_dump_compress.c')] +
+                              ['-I' + d for d in INCLUDE_DIRS])
+
+    @classmethod
+    def tearDownClass(cls):  # type: () -> None
+        shutil.rmtree(cls.build_dir)
+
+    def compress(self, data, chunk_size):  # type: (bytes, int) -> bytes
+        return subprocess.run([self.compressor, str(chunk_size)], input=data, stdout=subprocess.PIPE,
+                              check=True).stdout
+
+    def check_round_trip(self, data):  # type: (bytes) -> bytes
+        compressed = b''
+        for chunk_size in CHUNK_SIZES:
+            out = self.compress(data, chunk_size)
+            # The output doesn't depend on how the data is split
+            if compressed:
+                self.assertEqual(compressed, out)
+            compressed = out
+            self.assertEqual(data, espcoredump.decompress(compressed, len(data)))
+        return compressed
+
+    def test_empty(self):  # type: () -> None
+        self.assertEqual(b'', self.check_round_trip(b''))
+
+    def test_literals(self):  # type: () -> None
+        data = random.Random(1).getrandbits(8 * 20000).to_bytes(20000, 'little')
+        compressed = self.check_round_trip(data)
+        # At most one flag byte per group of 8 literals
+        self.assertLessEqual(len(compressed), len(data) + (len(data) + 7) // 8)
+
+    def test_long_matches(self):  # type: () -> None
+        compressed = self.check_round_trip(bytes(65536))
+        self.assertLess(len(compressed), 65536 // 100)
+
+    def test_overlapping_matches(self):  # type: () -> None
+        for period in range(1, 6):
+            pattern = bytes(range(1, period + 1))
+            self.check_round_trip(b'\xff' + pattern * (3000 // period) + b'\xfe')
+
+    def test_window(self):  # type: () -> None
+        # Data repeating just inside and just outside of the window
+        rng = random.Random(2)
+        for period in (1023, 1024, 1025, 1500):
+            block = rng.getrandbits(8 * period).to_bytes(period, 'little')
+            self.check_round_trip(block * 4)
+
+    def test_stacks(self):  # type: () -> None
+        # Task stacks: unused parts filled with the stack watermark, random words in the used part
+        rng = random.Random(3)
+        data = b''
+        for _ in range(8):
+            unused = rng.randrange(0, 4096) // 4
+            used = rng.randrange(64, 2048) // 4
+            data += b'\xa5\xa5\xa5\xa5' * unused
+            data += b''.join(struct.pack('<I', rng.choice([0, 0x3ffb0000 + rng.randrange(0x10000), rng.getrandbits(32)]))
+                             for _ in range(used))
+        self.check_round_trip(data)
+
+    def test_elf(self):  # type: () -> None
+        with open(self.compressor, 'rb') as f:
+            data = f.read()
+        compressed = self.check_round_trip(data)
+        self.assertLess(len(compressed), len(data))
+
+    def test_corrupted(self):  # type: () -> None
+        data = bytes(range(256)) * 8
+        compressed = self.compress(data, 4096)
+        with self.assertRaises(ValueError):
+            espcoredump.decompress(compressed, len(data) + 1)
+        # First token is a match, referring to data before the start of the stream
+        with self.assertRaises(ValueError):
+            espcoredump.decompress(b'\x01\x00\x00', 3)
+
+    def test_raw_core(self):  # type: () -> None
+        # A compressed core dump as written to flash, with a CRC32 checksum
+        elf = b'\x7fELF' + bytes(range(256)) * 16 + bytes(1000)
+        compressed = self.compress(elf, 4096)
+        header = espcoredump.COREDUMP_HEADER
+        data_len = header.size + len(compressed) + 4
+        body = header.pack(data_len, 0x0200, len(elf), 0, 0) + compressed
+        core_path = os.path.join(self.build_dir, 'core.bin')
+        with open(core_path, 'wb') as f:
+            f.write(body + struct.pack('<I', zlib.crc32(body)) + b'\xff' * 64)
+
+        out_path = espcoredump.decompress_raw_core(core_path)
+        self.assertIsNotNone(out_path)
+        try:
+            with open(out_path, 'rb') as f:
+                out = f.read()
+        finally:
+            os.remove(out_path)
+        out_len, version, _, _, _ = header.unpack_from(out)
+        self.assertEqual(len(out), out_len)
+        self.assertEqual(0x0100, version)
+        self.assertEqual(elf, out[header.size:header.size + len(elf)])
+        self.assertEqual(struct.pack('<I', zlib.crc32(out[:-4])), out[-4:])
+
+
+if __name__ == '__main__':
+    unittest.main()
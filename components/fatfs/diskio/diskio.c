@@ -9,15 +9,43 @@
 /*-----------------------------------------------------------------------*/
 
 #include <string.h>
+#include <stdbool.h>
 #include <time.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include "diskio_impl.h"
 #include "ffconf.h"
 #include "ff.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
 
 static ff_diskio_impl_t * s_impls[FF_VOLUMES] = { NULL };
 
+static const char* TAG = "ff_diskio";
+
+/* One cached sector */
+typedef struct {
+    LBA_t sector;
+    uint32_t last_use;      /* Value of ff_disk_cache_t::clock when last accessed */
+    bool valid;
+    bool dirty;             /* Newer than the sector on the drive */
+    bool meta;              /* FAT or directory sector, evicted only if no file data sector is cached */
+} ff_cache_slot_t;
+
+/* Write-back sector cache of a drive, between FatFs and the diskio driver */
+typedef struct {
+    UINT count;             /* Number of slots, 0 if the cache is disabled */
+    WORD sector_size;       /* 0 until the buffers are allocated on first access */
+    uint32_t clock;
+    const BYTE* win;        /* FatFs volume window, which FatFs uses for FAT and directory sectors */
+    LBA_t fat_start;        /* Reserved sectors, FATs and FAT12/16 root directory of the mounted volume */
+    LBA_t data_start;
+    ff_cache_slot_t* slots;
+    BYTE* buf;
+} ff_disk_cache_t;
+
+static ff_disk_cache_t s_caches[FF_VOLUMES];
+
 #if FF_MULTI_PARTITION		/* Multiple partition configuration */
 const PARTITION VolToPart[FF_VOLUMES] = {
     {0, 0},    /* Logical drive 0 ==> Physical drive 0, auto detection */
@@ -61,11 +89,157 @@ esp_err_t ff_diskio_get_drive(BYTE* out_pdrv)
     return ESP_ERR_NOT_FOUND;
 }
 
+static DRESULT cache_write_back(BYTE pdrv, ff_disk_cache_t* c, UINT i)
+{
+    DRESULT res = s_impls[pdrv]->write(pdrv, c->buf + i * c->sector_size, c->slots[i].sector, 1);
+    if (res == RES_OK) {
+        c->slots[i].dirty = false;
+    }
+    return res;
+}
+
+/* Write all dirty sectors in ascending order */
+static DRESULT cache_flush(BYTE pdrv, ff_disk_cache_t* c)
+{
+    while (true) {
+        int first = -1;
+        for (UINT i = 0; i < c->count; i++) {
+            if (c->slots[i].dirty && (first < 0 || c->slots[i].sector < c->slots[first].sector)) {
+                first = i;
+            }
+        }
+        if (first < 0) {
+            return RES_OK;
+        }
+        DRESULT res = cache_write_back(pdrv, c, first);
+        if (res != RES_OK) {
+            return res;
+        }
+    }
+}
+
+static void cache_free(BYTE pdrv)
+{
+    ff_disk_cache_t* c = &s_caches[pdrv];
+    if (c->sector_size != 0 && s_impls[pdrv] && cache_flush(pdrv, c) != RES_OK) {
+        ESP_LOGE(TAG, "pdrv=%i: failed to write back cached sectors", (unsigned int)pdrv);
+    }
+    free(c->slots);
+    ff_memfree(c->buf);
+    c->slots = NULL;
+    c->buf = NULL;
+    c->sector_size = 0;
+    c->win = NULL;
+    c->fat_start = 0;
+    c->data_start = 0;
+}
+
+/* Returns the cache of the drive, allocating it on first access, or NULL if the drive is not cached */
+static ff_disk_cache_t* cache_get(BYTE pdrv)
+{
+    ff_disk_cache_t* c = &s_caches[pdrv];
+    if (c->count == 0) {
+        return NULL;
+    }
+    if (c->sector_size != 0) {
+        return c;
+    }
+    WORD sector_size;
+    if (s_impls[pdrv]->ioctl(pdrv, GET_SECTOR_SIZE, &sector_size) != RES_OK || sector_size == 0) {
+        return NULL;
+    }
+    c->slots = calloc(c->count, sizeof(ff_cache_slot_t));
+    c->buf = ff_memalloc(c->count * sector_size);
+    if (!c->slots || !c->buf) {
+        ESP_LOGW(TAG, "pdrv=%i: not enough memory for %u cached sectors, caching disabled", (unsigned int)pdrv, c->count);
+        free(c->slots);
+        ff_memfree(c->buf);
+        c->slots = NULL;
+        c->buf = NULL;
+        c->count = 0;
+        return NULL;
+    }
+    c->sector_size = sector_size;
+    return c;
+}
+
+static int cache_find(const ff_disk_cache_t* c, LBA_t sector)
+{
+    for (UINT i = 0; i < c->count; i++) {
+        if (c->slots[i].valid && c->slots[i].sector == sector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Least recently used file data sector, or the least recently used FAT/directory sector if there is none */
+static UINT cache_victim(const ff_disk_cache_t* c)
+{
+    int victim = -1;
+    for (UINT i = 0; i < c->count; i++) {
+        const ff_cache_slot_t* slot = &c->slots[i];
+        if (!slot->valid) {
+            return i;
+        }
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+        const ff_cache_slot_t* best = &c->slots[victim];
+        if ((best->meta && !slot->meta) || (best->meta == slot->meta && slot->last_use < best->last_use)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+static bool cache_is_meta(const ff_disk_cache_t* c, const BYTE* buff, LBA_t sector)
+{
+    return buff == c->win || (sector >= c->fat_start && sector < c->data_start);
+}
+
+/* FatFs reads the boot sector of a volume into its window when mounting it.
+ * Remember the window and the location of the FATs to recognize FAT and directory sectors.
+ */
+static void cache_check_boot_sector(ff_disk_cache_t* c, const BYTE* buff, LBA_t sector)
+{
+    if (c->win != NULL || buff[510] != 0x55 || buff[511] != 0xAA
+            || (buff[0] != 0xEB && buff[0] != 0xE9 && buff[0] != 0xE8)) {
+        return;
+    }
+    WORD bytes_per_sector = buff[11] | (buff[12] << 8);
+    WORD reserved = buff[14] | (buff[15] << 8);
+    BYTE n_fats = buff[16];
+    WORD root_entries = buff[17] | (buff[18] << 8);
+    DWORD fat_size = buff[22] | (buff[23] << 8);
+    if (fat_size == 0) {    /* FAT32 */
+        fat_size = buff[36] | (buff[37] << 8) | ((DWORD)buff[38] << 16) | ((DWORD)buff[39] << 24);
+    }
+    if (bytes_per_sector != c->sector_size || reserved == 0 || (n_fats != 1 && n_fats != 2) || fat_size == 0) {
+        return;
+    }
+    c->win = buff;
+    c->fat_start = sector + reserved;
+    c->data_start = c->fat_start + n_fats * fat_size + (root_entries * 32 + c->sector_size - 1) / c->sector_size;
+}
+
+esp_err_t ff_diskio_set_cache_size(BYTE pdrv, UINT sectors)
+{
+    if (pdrv >= FF_VOLUMES || sectors > FF_DISKIO_CACHE_MAX_SECTORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cache_free(pdrv);
+    s_caches[pdrv].count = sectors;
+    return ESP_OK;
+}
+
 void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl)
 {
     assert(pdrv < FF_VOLUMES);
 
     if (s_impls[pdrv]) {
+        cache_free(pdrv);
         ff_diskio_impl_t* im = s_impls[pdrv];
         s_impls[pdrv] = NULL;
         free(im);
@@ -79,10 +253,13 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl)
     assert(impl != NULL);
     memcpy(impl, discio_impl, sizeof(ff_diskio_impl_t));
     s_impls[pdrv] = impl;
+    s_caches[pdrv].count = CONFIG_FATFS_DISKIO_CACHE_SECTORS;
 }
 
 DSTATUS ff_disk_initialize (BYTE pdrv)
 {
+    /* Called when FatFs mounts a volume, which may use a different window */
+    s_caches[pdrv].win = NULL;
     return s_impls[pdrv]->init(pdrv);
 }
 DSTATUS ff_disk_status (BYTE pdrv)
@@ -91,14 +268,89 @@ DSTATUS ff_disk_status (BYTE pdrv)
 }
 DRESULT ff_disk_read (BYTE pdrv, BYTE* buff, LBA_t sector, UINT count)
 {
-    return s_impls[pdrv]->read(pdrv, buff, sector, count);
+    ff_disk_cache_t* c = cache_get(pdrv);
+    if (!c) {
+        return s_impls[pdrv]->read(pdrv, buff, sector, count);
+    }
+
+    if (count > 1) {
+        /* Multi-sector transfers are file data, read them directly and apply cached changes */
+        DRESULT res = s_impls[pdrv]->read(pdrv, buff, sector, count);
+        if (res == RES_OK) {
+            for (UINT i = 0; i < c->count; i++) {
+                if (c->slots[i].dirty && c->slots[i].sector - sector < count) {
+                    memcpy(buff + (c->slots[i].sector - sector) * c->sector_size, c->buf + i * c->sector_size, c->sector_size);
+                }
+            }
+        }
+        return res;
+    }
+
+    int i = cache_find(c, sector);
+    if (i < 0) {
+        i = cache_victim(c);
+        if (c->slots[i].dirty && cache_write_back(pdrv, c, i) != RES_OK) {
+            return RES_ERROR;
+        }
+        c->slots[i].valid = false;
+        DRESULT res = s_impls[pdrv]->read(pdrv, c->buf + i * c->sector_size, sector, 1);
+        if (res != RES_OK) {
+            return res;
+        }
+        c->slots[i].valid = true;
+        c->slots[i].sector = sector;
+    }
+    memcpy(buff, c->buf + i * c->sector_size, c->sector_size);
+    cache_check_boot_sector(c, buff, sector);
+    c->slots[i].meta = cache_is_meta(c, buff, sector);
+    c->slots[i].last_use = ++c->clock;
+    return RES_OK;
 }
 DRESULT ff_disk_write (BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count)
 {
-    return s_impls[pdrv]->write(pdrv, buff, sector, count);
+    ff_disk_cache_t* c = cache_get(pdrv);
+    if (!c) {
+        return s_impls[pdrv]->write(pdrv, buff, sector, count);
+    }
+
+    if (count > 1) {
+        /* Write through, cached copies of the sectors become clean */
+        DRESULT res = s_impls[pdrv]->write(pdrv, buff, sector, count);
+        if (res == RES_OK) {
+            for (UINT i = 0; i < c->count; i++) {
+                if (c->slots[i].valid && c->slots[i].sector - sector < count) {
+                    memcpy(c->buf + i * c->sector_size, buff + (c->slots[i].sector - sector) * c->sector_size, c->sector_size);
+                    c->slots[i].dirty = false;
+                }
+            }
+        }
+        return res;
+    }
+
+    int i = cache_find(c, sector);
+    if (i < 0) {
+        i = cache_victim(c);
+        if (c->slots[i].dirty && cache_write_back(pdrv, c, i) != RES_OK) {
+            return RES_ERROR;
+        }
+        c->slots[i].valid = true;
+        c->slots[i].sector = sector;
+    }
+    memcpy(c->buf + i * c->sector_size, buff, c->sector_size);
+    c->slots[i].dirty = true;
+    c->slots[i].meta = cache_is_meta(c, buff, sector);
+    c->slots[i].last_use = ++c->clock;
+    return RES_OK;
 }
 DRESULT ff_disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
 {
+    ff_disk_cache_t* c = &s_caches[pdrv];
+    if (cmd == CTRL_SYNC && c->sector_size != 0) {
+        DRESULT res = cache_flush(pdrv, c);
+        if (res != RES_OK) {
+            return res;
+        }
+    }
     return s_impls[pdrv]->ioctl(pdrv, cmd, buff);
 }
 
@@ -55,6 +55,29 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl);
 
 #define ff_diskio_unregister(pdrv_) ff_diskio_register(pdrv_, NULL)
 
+#define FF_DISKIO_CACHE_MAX_SECTORS 64 /*!< Maximum number of sectors cached per drive */
+
+/**
+ * Set the number of sectors cached for given drive number.
+ *
+ * Sectors are cached between FatFs and the diskio driver, with write-back and
+ * least recently used replacement. FAT and directory sectors are replaced only if
+ * no file data sector is cached. Modified sectors are written to the drive when
+ * FatFs syncs the volume (CTRL_SYNC), when they are replaced and when the drive
+ * is unregistered. Transfers of multiple sectors bypass the cache.
+ *
+ * ff_diskio_register() sets the number to CONFIG_FATFS_DISKIO_CACHE_SECTORS.
+ * Call this function while the volume is not in use, as it writes back and
+ * frees the current cache. The new cache is allocated on the next access.
+ *
+ * @param pdrv      drive number
+ * @param sectors   number of sectors to cache, 0 to disable the cache
+ *
+ * @return  ESP_OK              on success
+ *          ESP_ERR_INVALID_ARG if pdrv or sectors is out of range
+ */
+esp_err_t ff_diskio_set_cache_size(BYTE pdrv, UINT sectors);
+
 
 /**
  * Get next available drive number
@@ -8,6 +8,7 @@
 
 #include "ff.h"
 #include "esp_partition.h"
+#include "esp_private/partition_linux.h"
 #include "wear_levelling.h"
 #include "diskio_impl.h"
 #include "diskio_wl.h"
@@ -90,6 +91,96 @@ TEST_CASE("create volume, open file, write and read back data", "[fatfs]")
     fr_result = f_mount(0, "", 0);
     REQUIRE(fr_result == FR_OK);
 
+    // Release drive
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+
     free(read);
     free(data);
 }
+
+static const int bench_dir_count = 4;
+static const int bench_files_per_dir = 25;
+
+// Lists all directories and stats every file, returns number of entries found
+static int traverse_bench_dirs(const char *drv)
+{
+    FF_DIR dir;
+    FILINFO info;
+    char path[FF_MAX_LFN * 2 + 2];
+    int entries = 0;
+
+    for (int d = 0; d < bench_dir_count; d++) {
+        char dir_name[32];
+        snprintf(dir_name, sizeof(dir_name), "%sdirectory_%d", drv, d);
+        REQUIRE(f_opendir(&dir, dir_name) == FR_OK);
+        while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != 0) {
+            FILINFO file_info;
+            snprintf(path, sizeof(path), "%s/%s", dir_name, info.fname);
+            REQUIRE(f_stat(path, &file_info) == FR_OK);
+            entries++;
+        }
+        REQUIRE(f_closedir(&dir) == FR_OK);
+    }
+    return entries;
+}
+
+TEST_CASE("sector cache reduces storage reads of directory traversal", "[fatfs][benchmark]")
+{
+    FATFS fs;
+    FIL file;
+    BYTE pdrv;
+    UINT bw;
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+    wl_handle_t wl_handle;
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+    BYTE work_area[FF_MAX_SS];
+    const MKFS_PARM opt = {(BYTE)FM_ANY, 0, 0, 0, 0};
+    REQUIRE(f_mkfs(drv, &opt, work_area, sizeof(work_area)) == FR_OK);
+    REQUIRE(f_mount(&fs, drv, 1) == FR_OK);
+
+    // Populate the volume
+    for (int d = 0; d < bench_dir_count; d++) {
+        char path[128];
+        snprintf(path, sizeof(path), "%sdirectory_%d", drv, d);
+        REQUIRE(f_mkdir(path) == FR_OK);
+        for (int i = 0; i < bench_files_per_dir; i++) {
+            snprintf(path, sizeof(path), "%sdirectory_%d/file_with_a_long_name_%03d.txt", drv, d, i);
+            REQUIRE(f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+            REQUIRE(f_write(&file, path, strlen(path), &bw) == FR_OK);
+            REQUIRE(f_close(&file) == FR_OK);
+        }
+    }
+    REQUIRE(f_mount(0, drv, 0) == FR_OK);
+
+    const UINT cache_sizes[] = {0, 8};
+    size_t read_ops[2];
+    for (int i = 0; i < 2; i++) {
+        REQUIRE(ff_diskio_set_cache_size(pdrv, cache_sizes[i]) == ESP_OK);
+        REQUIRE(f_mount(&fs, drv, 1) == FR_OK);
+
+        esp_partition_clear_stats();
+        int entries = 0;
+        for (int pass = 0; pass < 3; pass++) {
+            entries += traverse_bench_dirs(drv);
+        }
+        read_ops[i] = esp_partition_get_read_ops();
+        printf("traversal with %u cached sectors: %d entries, %u reads (%u bytes), est. %u us\n",
+               cache_sizes[i], entries, (unsigned)read_ops[i], (unsigned)esp_partition_get_read_bytes(),
+               (unsigned)esp_partition_get_total_time());
+        REQUIRE(entries == 3 * bench_dir_count * bench_files_per_dir);
+
+        REQUIRE(f_mount(0, drv, 0) == FR_OK);
+    }
+    REQUIRE(read_ops[1] < read_ops[0]);
+
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+}
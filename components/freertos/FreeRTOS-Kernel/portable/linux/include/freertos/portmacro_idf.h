@@ -13,6 +13,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>  // This is for FILE, used by the scheduler trace
 #include <stdlib.h> // This is for malloc(), used by portmacro.h
 #include "sdkconfig.h"
 #include "esp_attr.h"
@@ -95,6 +96,138 @@ static inline BaseType_t xPortInIsrContext(void)
     return xPortCheckIfInISR();
 }
 
+#if CONFIG_FREERTOS_LINUX_VIRTUAL_TIME
+/**
+ * @brief Increments the tick count, as the tick interrupt would do
+ *
+ * - Called by the Idle task, as there is no tick interrupt in virtual time
+ */
+void vPortVirtualTimeTick(void);
+
+/**
+ * @brief Makes the tick count jump to the next time a task has to be unblocked
+ *
+ * - Called by the Idle task with the scheduler suspended, see portSUPPRESS_TICKS_AND_SLEEP()
+ *
+ * @param xExpectedIdleTime Number of ticks until the next task has to be unblocked
+ */
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+
+#define portSUPPRESS_TICKS_AND_SLEEP(idle_time)     vPortSuppressTicksAndSleep(idle_time)
+#endif /* CONFIG_FREERTOS_LINUX_VIRTUAL_TIME */
+
+#if CONFIG_FREERTOS_LINUX_SCHED_TRACE
+/**
+ * @brief Type of an event of the scheduler trace
+ */
+typedef enum {
+    eSchedTraceSwitchIn = 0,    /**< A task starts running */
+    eSchedTraceTickJump,        /**< The tick count jumped while all tasks were blocked (virtual time) */
+    eSchedTraceBlock,           /**< The running task blocks on a queue, semaphore or mutex */
+} eSchedTraceEventType;
+
+/**
+ * @brief Event of the scheduler trace
+ */
+typedef struct {
+    eSchedTraceEventType eType;                 /**< Type of the event */
+    TickType_t xTickCount;                      /**< Tick count after the event */
+    TickType_t xTicks;                          /**< Number of ticks skipped by eSchedTraceTickJump, 0 otherwise */
+    uint64_t ullTimeNs;                         /**< Time of the host (CLOCK_MONOTONIC) in nanoseconds */
+    void *pvTask;                               /**< Handle of the running task */
+    UBaseType_t uxTaskId;                       /**< Number of the running task in the statistics, 0 if none */
+    char pcTaskName[configMAX_TASK_NAME_LEN];   /**< Name of the running task */
+    void *pvObject;                             /**< Queue, semaphore or mutex of eSchedTraceBlock, NULL otherwise */
+} SchedTraceEvent_t;
+
+/**
+ * @brief Statistics of a task in the scheduler trace
+ */
+typedef struct {
+    UBaseType_t uxTaskId;                       /**< Number of the task, from 1, in the order the tasks first ran */
+    void *pvTask;                               /**< Handle of the task, NULL if it has been deleted */
+    char pcTaskName[configMAX_TASK_NAME_LEN];   /**< Name of the task */
+    uint64_t ullRunTimeNs;                      /**< Time of the host during which the task was running */
+    uint32_t ulSwitchIns;                       /**< Number of times the task started running */
+    uint64_t ullBlockedTimeNs;                  /**< Time the task was blocked on queues, semaphores and mutexes */
+    uint32_t ulCriticalSections;                /**< Number of critical sections (CONFIG_FREERTOS_LINUX_SCHED_TRACE_CRITICAL) */
+    uint64_t ullCriticalTimeNs;                 /**< Time spent in critical sections, without the time switched out */
+    uint64_t ullCriticalMaxNs;                  /**< Duration of the longest critical section */
+} SchedTraceTaskStats_t;
+
+/**
+ * @brief Statistics of a queue, semaphore or mutex in the scheduler trace
+ */
+typedef struct {
+    void *pvQueue;                              /**< Handle of the queue, NULL if it has been deleted */
+    uint8_t ucQueueType;                        /**< Type of the queue, see queueQUEUE_TYPE_BASE and following */
+    uint32_t ulBlocks;                          /**< Number of times a task was blocked on it */
+    uint64_t ullBlockedTimeNs;                  /**< Time the tasks were blocked on it */
+    uint64_t ullMaxBlockedTimeNs;               /**< Longest time a task was blocked on it */
+} SchedTraceQueueStats_t;
+
+/**
+ * @brief Reads the oldest events of the scheduler trace
+ *
+ * The events read are removed from the trace. Once the trace is full, the oldest events are overwritten.
+ *
+ * @param pxEvents Array to fill with the events, oldest first
+ * @param uxMaxEvents Number of events of the array
+ * @return Number of events read
+ */
+UBaseType_t uxPortSchedTraceRead(SchedTraceEvent_t *pxEvents, UBaseType_t uxMaxEvents);
+
+/**
+ * @brief Writes all the events of the scheduler trace to a file, one per line, and removes them from the trace
+ *
+ * Each line holds the time of the host in nanoseconds and the tick count, then either "switch" and the name of the task
+ * which starts running, "block" and the handle of the queue the running task blocks on, or "jump" and the number of
+ * ticks skipped.
+ *
+ * @param pxFile File to write to, e.g., stdout
+ */
+void vPortSchedTraceDump(FILE *pxFile);
+
+/**
+ * @brief Reads the statistics of the tasks
+ *
+ * @param pxStats Array to fill with the statistics, in the order of uxTaskId
+ * @param uxMaxTasks Number of statistics of the array
+ * @return Number of statistics read
+ */
+UBaseType_t uxPortSchedTraceGetTaskStats(SchedTraceTaskStats_t *pxStats, UBaseType_t uxMaxTasks);
+
+/**
+ * @brief Reads the statistics of the queues, semaphores and mutexes which tasks were blocked on
+ *
+ * @param pxStats Array to fill with the statistics, in the order the queues were first blocked on
+ * @param uxMaxQueues Number of statistics of the array
+ * @return Number of statistics read
+ */
+UBaseType_t uxPortSchedTraceGetQueueStats(SchedTraceQueueStats_t *pxStats, UBaseType_t uxMaxQueues);
+
+/**
+ * @brief Writes the scheduler trace and the statistics to a file in the Chrome trace event format (JSON)
+ *
+ * The events are removed from the trace. Each task is a thread, whose running and blocked times are slices. The
+ * statistics are written in the "freertosStats" member of the JSON object.
+ *
+ * @param pxFile File to write to
+ */
+void vPortSchedTraceWriteJson(FILE *pxFile);
+
+/* Called from the trace macros, see FreeRTOSConfig_arch.h */
+void vPortSchedTraceSwitchedIn(void);
+void vPortSchedTraceTickJump(TickType_t xTicks);
+void vPortSchedTraceBlocking(void *pvQueue);
+void vPortSchedTraceTaskDelete(void *pvTask);
+void vPortSchedTraceQueueDelete(void *pvQueue);
+
+/* Called from the port, see vPortEnterCritical() and vPortExitCritical() */
+void vPortSchedTraceCriticalEnter(void);
+void vPortSchedTraceCriticalExit(void);
+#endif /* CONFIG_FREERTOS_LINUX_SCHED_TRACE */
+
 #if CONFIG_FREERTOS_ENABLE_STATIC_TASK_CLEAN_UP
 /* If enabled, users must provide an implementation of vPortCleanUpTCB() */
 extern void vPortCleanUpTCB ( void *pxTCB );
@@ -62,6 +62,7 @@
 #include <sys/time.h>
 #include <sys/times.h>
 #include <time.h>
+#include <unistd.h>
 
 /* Scheduler includes. */
 #include "FreeRTOS.h"
@@ -252,6 +253,9 @@ void vPortEnterCritical( void )
     if ( uxCriticalNesting == 0 )
     {
         vPortDisableInterrupts();
+#if CONFIG_FREERTOS_LINUX_SCHED_TRACE_CRITICAL
+        vPortSchedTraceCriticalEnter();
+#endif
     }
     uxCriticalNesting++;
 }
@@ -264,6 +268,9 @@ void vPortExitCritical( void )
     /* If we have reached 0 then re-enable the interrupts. */
     if( uxCriticalNesting == 0 )
     {
+#if CONFIG_FREERTOS_LINUX_SCHED_TRACE_CRITICAL
+        vPortSchedTraceCriticalExit();
+#endif
         vPortEnableInterrupts();
     }
 }
@@ -339,6 +346,10 @@ static uint64_t prvStartTimeNs;
  */
 void prvSetupTimerInterrupt( void )
 {
+#if CONFIG_FREERTOS_LINUX_VIRTUAL_TIME
+    /* No timer in virtual time, the ticks are generated by the Idle task
+     * (see vPortVirtualTimeTick() and vPortSuppressTicksAndSleep()). */
+#else
     struct itimerval itimer;
     int iRet;
 
@@ -363,11 +374,64 @@ void prvSetupTimerInterrupt( void )
     {
         prvFatalError( "setitimer", errno );
     }
+#endif /* CONFIG_FREERTOS_LINUX_VIRTUAL_TIME */
 
     prvStartTimeNs = prvGetTimeNs();
 }
 /*-----------------------------------------------------------*/
 
+#if CONFIG_FREERTOS_LINUX_VIRTUAL_TIME
+
+void vPortVirtualTimeTick( void )
+{
+    /* Same as the tick interrupt, which would interrupt the Idle task as
+     * no other task is ready. */
+    vPortEnterCritical();
+
+    if ( xTaskIncrementTick() != pdFALSE )
+    {
+        vPortYieldFromISR();
+    }
+
+    vPortExitCritical();
+}
+/*-----------------------------------------------------------*/
+
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+    eSleepModeStatus eSleepStatus;
+
+    /* Called by the Idle task with the scheduler suspended. */
+    eSleepStatus = eTaskConfirmSleepModeStatus();
+
+    if ( eSleepStatus == eAbortSleep )
+    {
+        return;
+    }
+
+    if ( ( eSleepStatus == eNoTasksWaitingTimeout ) ||
+         ( xExpectedIdleTime == portMAX_DELAY - xTaskGetTickCount() ) )
+    {
+        /* No task waits for a timeout, there is no time to jump to. Only
+         * a thread outside of the scheduler can unblock a task, let the time
+         * pass at the pace of the host meanwhile. */
+        usleep( portTICK_RATE_MICROSECONDS );
+        return;
+    }
+
+    /* Jump to the tick before the next unblock time. The last tick is
+     * pended and unblocks the tasks when the scheduler is resumed, the same
+     * way as a tick interrupt received while the scheduler is suspended. */
+    vTaskStepTick( xExpectedIdleTime - 1 );
+
+    vPortEnterCritical();
+    ( void ) xTaskIncrementTick();
+    vPortExitCritical();
+}
+/*-----------------------------------------------------------*/
+
+#endif /* CONFIG_FREERTOS_LINUX_VIRTUAL_TIME */
+
 static void vPortSystemTickHandler( int sig )
 {
     Thread_t *pxThreadToSuspend;
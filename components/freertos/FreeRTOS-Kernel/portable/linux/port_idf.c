@@ -80,8 +80,12 @@ void esp_vApplicationIdleHook(void)
      * because it is the responsibility of the idle task to clean up memory
      * allocated by the kernel to any task that has since deleted itself. */
 
-
+#if CONFIG_FREERTOS_LINUX_VIRTUAL_TIME
+    /* There is no tick interrupt in virtual time, the time passes while the Idle task runs. */
+    vPortVirtualTimeTick();
+#else
     usleep( 15000 );
+#endif
 }
 
 void esp_vApplicationTickHook( void ) { }
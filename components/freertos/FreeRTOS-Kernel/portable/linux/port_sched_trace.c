@@ -0,0 +1,448 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Trace of the scheduler of the Linux simulator (CONFIG_FREERTOS_LINUX_SCHED_TRACE).
+ *
+ * The events are recorded by the trace macros of the kernel and by the critical sections of the port, which are always
+ * called with the interrupts (signals) disabled. Only one task runs at a time, so only reading the trace and the
+ * statistics needs a critical section.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#define TRACE_LEN   CONFIG_FREERTOS_LINUX_SCHED_TRACE_LEN
+#define MAX_TASKS   CONFIG_FREERTOS_LINUX_SCHED_TRACE_MAX_TASKS
+#define MAX_QUEUES  CONFIG_FREERTOS_LINUX_SCHED_TRACE_MAX_QUEUES
+
+typedef struct {
+    SchedTraceQueueStats_t stats;
+    void *pvQueue;                  // Handle of the queue, also kept once deleted
+} QueueEntry_t;
+
+typedef struct {
+    SchedTraceTaskStats_t stats;
+    void *pvTask;                   // Handle of the task, also kept once deleted
+    QueueEntry_t *pxBlockedOn;      // Queue the task is blocked on
+    uint64_t ullBlockedSinceNs;
+    BaseType_t xInCritical;         // The task is in a critical section
+    uint64_t ullCriticalSinceNs;    // Time the task entered the critical section, or was switched in since
+    uint64_t ullCriticalNs;         // Time spent in the critical section before being switched out
+} TaskEntry_t;
+
+static SchedTraceEvent_t s_events[TRACE_LEN];
+static UBaseType_t s_first;         // Index of the oldest event
+static UBaseType_t s_num;
+
+static TaskEntry_t s_tasks[MAX_TASKS];
+static UBaseType_t s_tasks_num;
+static QueueEntry_t s_queues[MAX_QUEUES];
+static UBaseType_t s_queues_num;
+
+static void *s_last_task;           // Task of the last eSchedTraceSwitchIn event
+static TaskEntry_t *s_current;      // Entry of the running task, NULL if the statistics are full
+static uint64_t s_switched_in_ns;   // Time the running task was switched in
+
+static uint64_t prvGetTimeNs(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static TaskEntry_t *prvGetTaskEntry(void *pvTask)
+{
+    TaskEntry_t *entry;
+
+    for (UBaseType_t i = 0; i < s_tasks_num; i++) {
+        if (s_tasks[i].pvTask == pvTask && s_tasks[i].stats.pvTask != NULL) {
+            return &s_tasks[i];
+        }
+    }
+    if (s_tasks_num == MAX_TASKS) {
+        return NULL;
+    }
+
+    entry = &s_tasks[s_tasks_num++];
+    entry->pvTask = pvTask;
+    entry->stats.uxTaskId = s_tasks_num;
+    entry->stats.pvTask = pvTask;
+    strncpy(entry->stats.pcTaskName, pcTaskGetName(pvTask), configMAX_TASK_NAME_LEN - 1);
+
+    return entry;
+}
+
+static QueueEntry_t *prvGetQueueEntry(void *pvQueue)
+{
+    QueueEntry_t *entry;
+
+    for (UBaseType_t i = 0; i < s_queues_num; i++) {
+        if (s_queues[i].pvQueue == pvQueue && s_queues[i].stats.pvQueue != NULL) {
+            return &s_queues[i];
+        }
+    }
+    if (s_queues_num == MAX_QUEUES) {
+        return NULL;
+    }
+
+    entry = &s_queues[s_queues_num++];
+    entry->pvQueue = pvQueue;
+    entry->stats.pvQueue = pvQueue;
+    entry->stats.ucQueueType = ucQueueGetQueueType(pvQueue);
+
+    return entry;
+}
+
+static void prvAddEvent(eSchedTraceEventType eType, uint64_t ullTimeNs, TickType_t xTicks, void *pvObject)
+{
+    SchedTraceEvent_t *event;
+
+    if (s_num == TRACE_LEN) {
+        s_first = (s_first + 1) % TRACE_LEN;
+    } else {
+        s_num++;
+    }
+    event = &s_events[(s_first + s_num - 1) % TRACE_LEN];
+
+    event->eType = eType;
+    event->xTickCount = xTaskGetTickCount();
+    event->xTicks = xTicks;
+    event->ullTimeNs = ullTimeNs;
+    event->pvTask = s_last_task;
+    event->uxTaskId = s_current ? s_current->stats.uxTaskId : 0;
+    strncpy(event->pcTaskName, pcTaskGetName(s_last_task), configMAX_TASK_NAME_LEN - 1);
+    event->pcTaskName[configMAX_TASK_NAME_LEN - 1] = '\0';
+    event->pvObject = pvObject;
+}
+
+void vPortSchedTraceSwitchedIn(void)
+{
+    void *pvTask = xTaskGetCurrentTaskHandle();
+    uint64_t now = prvGetTimeNs();
+    TaskEntry_t *entry;
+
+    /* The scheduler is also called on each tick, which mostly selects the same task again */
+    if (pvTask == s_last_task) {
+        entry = s_current;
+    } else {
+        if (s_current) {
+            s_current->stats.ullRunTimeNs += now - s_switched_in_ns;
+            if (s_current->xInCritical) {
+                s_current->ullCriticalNs += now - s_current->ullCriticalSinceNs;
+            }
+        }
+
+        entry = prvGetTaskEntry(pvTask);
+        s_last_task = pvTask;
+        s_current = entry;
+        s_switched_in_ns = now;
+        if (entry) {
+            entry->stats.ulSwitchIns++;
+            if (entry->xInCritical) {
+                entry->ullCriticalSinceNs = now;
+            }
+        }
+        prvAddEvent(eSchedTraceSwitchIn, now, 0, NULL);
+    }
+
+    /* Selected again, the task is not blocked anymore */
+    if (entry && entry->pxBlockedOn) {
+        uint64_t blocked_ns = now - entry->ullBlockedSinceNs;
+
+        entry->stats.ullBlockedTimeNs += blocked_ns;
+        entry->pxBlockedOn->stats.ulBlocks++;
+        entry->pxBlockedOn->stats.ullBlockedTimeNs += blocked_ns;
+        if (blocked_ns > entry->pxBlockedOn->stats.ullMaxBlockedTimeNs) {
+            entry->pxBlockedOn->stats.ullMaxBlockedTimeNs = blocked_ns;
+        }
+        entry->pxBlockedOn = NULL;
+    }
+}
+
+void vPortSchedTraceTickJump(TickType_t xTicks)
+{
+    prvAddEvent(eSchedTraceTickJump, prvGetTimeNs(), xTicks, NULL);
+}
+
+void vPortSchedTraceBlocking(void *pvQueue)
+{
+    uint64_t now = prvGetTimeNs();
+
+    if (s_current) {
+        s_current->pxBlockedOn = prvGetQueueEntry(pvQueue);
+        s_current->ullBlockedSinceNs = now;
+    }
+    prvAddEvent(eSchedTraceBlock, now, 0, pvQueue);
+}
+
+void vPortSchedTraceTaskDelete(void *pvTask)
+{
+    for (UBaseType_t i = 0; i < s_tasks_num; i++) {
+        if (s_tasks[i].pvTask == pvTask) {
+            s_tasks[i].stats.pvTask = NULL;
+        }
+    }
+}
+
+void vPortSchedTraceQueueDelete(void *pvQueue)
+{
+    for (UBaseType_t i = 0; i < s_queues_num; i++) {
+        if (s_queues[i].pvQueue == pvQueue) {
+            s_queues[i].stats.pvQueue = NULL;
+        }
+    }
+}
+
+void vPortSchedTraceCriticalEnter(void)
+{
+    if (s_current) {
+        s_current->xInCritical = pdTRUE;
+        s_current->ullCriticalSinceNs = prvGetTimeNs();
+        s_current->ullCriticalNs = 0;
+    }
+}
+
+void vPortSchedTraceCriticalExit(void)
+{
+    if (s_current && s_current->xInCritical) {
+        uint64_t critical_ns = s_current->ullCriticalNs + prvGetTimeNs() - s_current->ullCriticalSinceNs;
+
+        s_current->xInCritical = pdFALSE;
+        s_current->stats.ulCriticalSections++;
+        s_current->stats.ullCriticalTimeNs += critical_ns;
+        if (critical_ns > s_current->stats.ullCriticalMaxNs) {
+            s_current->stats.ullCriticalMaxNs = critical_ns;
+        }
+    }
+}
+
+UBaseType_t uxPortSchedTraceRead(SchedTraceEvent_t *pxEvents, UBaseType_t uxMaxEvents)
+{
+    UBaseType_t uxNum = 0;
+
+    vPortEnterCritical();
+    while (uxNum < uxMaxEvents && s_num > 0) {
+        pxEvents[uxNum++] = s_events[s_first];
+        s_first = (s_first + 1) % TRACE_LEN;
+        s_num--;
+    }
+    vPortExitCritical();
+
+    return uxNum;
+}
+
+void vPortSchedTraceDump(FILE *pxFile)
+{
+    SchedTraceEvent_t event;
+
+    /* One event at a time, the trace can be too large for the stack of the task */
+    while (uxPortSchedTraceRead(&event, 1) == 1) {
+        if (event.eType == eSchedTraceTickJump) {
+            fprintf(pxFile, "%llu %lu jump %lu\n", (unsigned long long)event.ullTimeNs,
+                    (unsigned long)event.xTickCount, (unsigned long)event.xTicks);
+        } else if (event.eType == eSchedTraceBlock) {
+            fprintf(pxFile, "%llu %lu block %p\n", (unsigned long long)event.ullTimeNs,
+                    (unsigned long)event.xTickCount, event.pvObject);
+        } else {
+            fprintf(pxFile, "%llu %lu switch %s\n", (unsigned long long)event.ullTimeNs,
+                    (unsigned long)event.xTickCount, event.pcTaskName);
+        }
+    }
+}
+
+UBaseType_t uxPortSchedTraceGetTaskStats(SchedTraceTaskStats_t *pxStats, UBaseType_t uxMaxTasks)
+{
+    UBaseType_t uxNum = 0;
+
+    vPortEnterCritical();
+    while (uxNum < uxMaxTasks && uxNum < s_tasks_num) {
+        pxStats[uxNum] = s_tasks[uxNum].stats;
+        if (&s_tasks[uxNum] == s_current) {
+            /* Count the time since the running task was switched in */
+            pxStats[uxNum].ullRunTimeNs += prvGetTimeNs() - s_switched_in_ns;
+        }
+        uxNum++;
+    }
+    vPortExitCritical();
+
+    return uxNum;
+}
+
+UBaseType_t uxPortSchedTraceGetQueueStats(SchedTraceQueueStats_t *pxStats, UBaseType_t uxMaxQueues)
+{
+    UBaseType_t uxNum = 0;
+
+    vPortEnterCritical();
+    while (uxNum < uxMaxQueues && uxNum < s_queues_num) {
+        pxStats[uxNum] = s_queues[uxNum].stats;
+        uxNum++;
+    }
+    vPortExitCritical();
+
+    return uxNum;
+}
+
+static const char *prvGetQueueTypeName(uint8_t ucQueueType)
+{
+    switch (ucQueueType) {
+    case queueQUEUE_TYPE_MUTEX:
+        return "mutex";
+    case queueQUEUE_TYPE_COUNTING_SEMAPHORE:
+        return "counting semaphore";
+    case queueQUEUE_TYPE_BINARY_SEMAPHORE:
+        return "binary semaphore";
+    case queueQUEUE_TYPE_RECURSIVE_MUTEX:
+        return "recursive mutex";
+    default:
+        return "queue";
+    }
+}
+
+/* Longest JSON string of a task name: each character may be written as \u00XX */
+#define JSON_NAME_LEN   (configMAX_TASK_NAME_LEN * 6)
+
+/* Escapes a task name, which may contain any character, to be written in a JSON string */
+static const char *prvJsonEscape(char *pcBuf, const char *pcName)
+{
+    char *pos = pcBuf;
+
+    for (const char *c = pcName; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            *pos++ = '\\';
+            *pos++ = *c;
+        } else if ((unsigned char)*c < 0x20) {
+            pos += sprintf(pos, "\\u%04x", (unsigned char)*c);
+        } else {
+            *pos++ = *c;
+        }
+    }
+    *pos = '\0';
+
+    return pcBuf;
+}
+
+/* Time in microseconds since the first event, the unit of the Chrome trace event format */
+#define JSON_TS(ns)  ((double)((ns) - start_ns) / 1000.0)
+
+static void prvWriteJsonEvents(FILE *pxFile, const char *sep)
+{
+    /* Block event of each task (by uxTaskId), written as a slice once the task runs again */
+    static SchedTraceEvent_t blocks[MAX_TASKS + 1];
+    SchedTraceEvent_t running = { .ullTimeNs = 0 };
+    SchedTraceEvent_t event;
+    char name[JSON_NAME_LEN];
+    uint64_t start_ns = 0;
+    uint64_t end_ns = prvGetTimeNs();
+
+    memset(blocks, 0, sizeof(blocks));
+    while (uxPortSchedTraceRead(&event, 1) == 1) {
+        if (start_ns == 0) {
+            start_ns = event.ullTimeNs;
+        }
+
+        if (event.eType == eSchedTraceSwitchIn) {
+            if (running.ullTimeNs != 0) {
+                fprintf(pxFile, "%s\n{\"name\":\"%s\",\"cat\":\"running\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,"
+                        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tick\":%lu}}", sep,
+                        prvJsonEscape(name, running.pcTaskName), (unsigned long)running.uxTaskId,
+                        JSON_TS(running.ullTimeNs), (event.ullTimeNs - running.ullTimeNs) / 1000.0,
+                        (unsigned long)running.xTickCount);
+                sep = ",";
+            }
+            running = event;
+
+            SchedTraceEvent_t *block = &blocks[event.uxTaskId];
+            if (block->ullTimeNs != 0) {
+                fprintf(pxFile, "%s\n{\"name\":\"blocked\",\"cat\":\"blocked\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,"
+                        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"queue\":\"%p\",\"tick\":%lu}}", sep,
+                        (unsigned long)block->uxTaskId, JSON_TS(block->ullTimeNs),
+                        (event.ullTimeNs - block->ullTimeNs) / 1000.0, block->pvObject,
+                        (unsigned long)block->xTickCount);
+                sep = ",";
+                block->ullTimeNs = 0;
+            }
+        } else if (event.eType == eSchedTraceBlock) {
+            blocks[event.uxTaskId] = event;
+        } else {
+            fprintf(pxFile, "%s\n{\"name\":\"tick jump\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,"
+                    "\"args\":{\"tick\":%lu,\"ticks\":%lu}}", sep, (unsigned long)event.uxTaskId,
+                    JSON_TS(event.ullTimeNs), (unsigned long)event.xTickCount, (unsigned long)event.xTicks);
+            sep = ",";
+        }
+    }
+
+    /* The last task is still running */
+    if (running.ullTimeNs != 0) {
+        fprintf(pxFile, "%s\n{\"name\":\"%s\",\"cat\":\"running\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tick\":%lu}}", sep,
+                prvJsonEscape(name, running.pcTaskName), (unsigned long)running.uxTaskId,
+                JSON_TS(running.ullTimeNs), (end_ns - running.ullTimeNs) / 1000.0, (unsigned long)running.xTickCount);
+    }
+}
+
+void vPortSchedTraceWriteJson(FILE *pxFile)
+{
+    SchedTraceTaskStats_t tasks[MAX_TASKS];
+    SchedTraceQueueStats_t queues[MAX_QUEUES];
+    UBaseType_t tasks_num = uxPortSchedTraceGetTaskStats(tasks, MAX_TASKS);
+    UBaseType_t queues_num = uxPortSchedTraceGetQueueStats(queues, MAX_QUEUES);
+    char name[JSON_NAME_LEN];
+
+    /* Each task is a thread of the same process */
+    fprintf(pxFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (UBaseType_t i = 0; i < tasks_num; i++) {
+        fprintf(pxFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                i == 0 ? "" : ",", (unsigned long)tasks[i].uxTaskId, prvJsonEscape(name, tasks[i].pcTaskName));
+    }
+    prvWriteJsonEvents(pxFile, tasks_num == 0 ? "" : ",");
+
+    fprintf(pxFile, "\n],\n\"freertosStats\":{\"tasks\":[");
+    for (UBaseType_t i = 0; i < tasks_num; i++) {
+        fprintf(pxFile, "%s\n{\"id\":%lu,\"name\":\"%s\",\"deleted\":%s,\"run_time_ns\":%llu,\"switch_ins\":%lu,"
+                "\"blocked_time_ns\":%llu,\"critical_sections\":%lu,\"critical_time_ns\":%llu,\"critical_max_ns\":%llu}",
+                i == 0 ? "" : ",", (unsigned long)tasks[i].uxTaskId, prvJsonEscape(name, tasks[i].pcTaskName),
+                tasks[i].pvTask ? "false" : "true", (unsigned long long)tasks[i].ullRunTimeNs,
+                (unsigned long)tasks[i].ulSwitchIns, (unsigned long long)tasks[i].ullBlockedTimeNs,
+                (unsigned long)tasks[i].ulCriticalSections, (unsigned long long)tasks[i].ullCriticalTimeNs,
+                (unsigned long long)tasks[i].ullCriticalMaxNs);
+    }
+    fprintf(pxFile, "\n],\"queues\":[");
+    for (UBaseType_t i = 0; i < queues_num; i++) {
+        fprintf(pxFile, "%s\n{\"handle\":\"%p\",\"type\":\"%s\",\"deleted\":%s,\"blocks\":%lu,\"blocked_time_ns\":%llu,"
+                "\"max_blocked_time_ns\":%llu}", i == 0 ? "" : ",", s_queues[i].pvQueue,
+                prvGetQueueTypeName(queues[i].ucQueueType), queues[i].pvQueue ? "false" : "true",
+                (unsigned long)queues[i].ulBlocks, (unsigned long long)queues[i].ullBlockedTimeNs,
+                (unsigned long long)queues[i].ullMaxBlockedTimeNs);
+    }
+    fprintf(pxFile, "\n]}}\n");
+}
+
+static void prvWriteJsonAtExit(void)
+{
+    FILE *pxFile = fopen(CONFIG_FREERTOS_LINUX_SCHED_TRACE_FILE, "w");
+
+    if (pxFile == NULL) {
+        fprintf(stderr, "Cannot write the scheduler trace to %s\n", CONFIG_FREERTOS_LINUX_SCHED_TRACE_FILE);
+        return;
+    }
+    vPortSchedTraceWriteJson(pxFile);
+    fclose(pxFile);
+}
+
+__attribute__((constructor)) static void prvRegisterWriteJsonAtExit(void)
+{
+    if (strlen(CONFIG_FREERTOS_LINUX_SCHED_TRACE_FILE) > 0) {
+        atexit(prvWriteJsonAtExit);
+    }
+}
@@ -59,3 +59,15 @@
 /* ------------------------------------------------ ESP-IDF Additions --------------------------------------------------
  *
  * ------------------------------------------------------------------------------------------------------------------ */
+
+/* -------------------- Trace Macros ----------------------- */
+
+#if CONFIG_FREERTOS_LINUX_SCHED_TRACE
+    #define traceTASK_SWITCHED_IN()                     vPortSchedTraceSwitchedIn()
+    #define traceINCREASE_TICK_COUNT( x )               vPortSchedTraceTickJump( x )
+    #define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )   vPortSchedTraceBlocking( pxQueue )
+    #define traceBLOCKING_ON_QUEUE_PEEK( pxQueue )      vPortSchedTraceBlocking( pxQueue )
+    #define traceBLOCKING_ON_QUEUE_SEND( pxQueue )      vPortSchedTraceBlocking( pxQueue )
+    #define traceQUEUE_DELETE( pxQueue )                vPortSchedTraceQueueDelete( pxQueue )
+    #define traceTASK_DELETE( pxTaskToDelete )          vPortSchedTraceTaskDelete( pxTaskToDelete )
+#endif /* CONFIG_FREERTOS_LINUX_SCHED_TRACE */
@@ -0,0 +1,25 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/* The parser scanning one byte at a time, reference of the fast scanning in the tests.
+ * Its public functions are renamed to not clash with the ones of the http_parser component. */
+#define HTTP_PARSER_FAST_SCAN 0
+
+#define http_parser_version         http_parser_version_scalar
+#define http_parser_init            http_parser_init_scalar
+#define http_parser_settings_init   http_parser_settings_init_scalar
+#define http_parser_execute         http_parser_execute_scalar
+#define http_should_keep_alive      http_should_keep_alive_scalar
+#define http_message_needs_eof      http_message_needs_eof_scalar
+#define http_method_str             http_method_str_scalar
+#define http_errno_name             http_errno_name_scalar
+#define http_errno_description      http_errno_description_scalar
+#define http_parser_url_init        http_parser_url_init_scalar
+#define http_parser_parse_url       http_parser_parse_url_scalar
+#define http_parser_pause           http_parser_pause_scalar
+#define http_body_is_final          http_body_is_final_scalar
+
+#include "http_parser.c"
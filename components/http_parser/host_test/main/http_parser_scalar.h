@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#pragma once
+
+#include "http_parser.h"
+
+/* http_parser_execute() built with HTTP_PARSER_FAST_SCAN=0 */
+size_t http_parser_execute_scalar(http_parser *parser,
+                                  const http_parser_settings *settings,
+                                  const char *data,
+                                  size_t len);
@@ -445,6 +445,99 @@ enum http_host_state
 #define IS_HEADER_CHAR(ch)                                                     \
   (ch == CR || ch == LF || ch == 9 || ((unsigned char)ch > 31 && ch != 127))
 
+#if HTTP_PARSER_FAST_SCAN
+/* Word-at-a-time scanning: a word is tested for any byte which may stop the
+ * scan, then the bytes of the first word which may are checked one by one.
+ * The word tests may report bytes which do not stop the scan, but never miss
+ * one, so the result does not depend on the endianness.
+ */
+typedef size_t scan_word_t;
+
+/* On hosts (linux target), 16 bytes at a time */
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define SCAN_SSE2 1
+#else
+# define SCAN_SSE2 0
+#endif
+
+#define SCAN_ONES           ((scan_word_t) -1 / 0xff)
+#define SCAN_HIGHS          (SCAN_ONES * 0x80)
+/* Whether a byte of w is lower than n (n <= 0x80) */
+#define SCAN_HAS_LESS(w, n) (((w) - SCAN_ONES * (n)) & ~(w) & SCAN_HIGHS)
+/* Whether a byte of w is equal to b */
+#define SCAN_HAS_BYTE(w, b) SCAN_HAS_LESS((w) ^ (SCAN_ONES * (b)), 1)
+
+static inline scan_word_t
+scan_load(const char *p)
+{
+  scan_word_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+/* Returns the first byte of [p, end) which is not a URL char */
+static const char *
+scan_url_chars(const char *p, const char *end)
+{
+#if SCAN_SSE2
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    /* Signed comparison: bytes >= 0x80 are also lower than '!' */
+    __m128i stop = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8('!')),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('#')),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('?')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8(127)))));
+    if (_mm_movemask_epi8(stop)) {
+      break;
+    }
+  }
+#endif
+  for (; end - p >= (ptrdiff_t) sizeof(scan_word_t); p += sizeof(scan_word_t)) {
+    scan_word_t w = scan_load(p);
+#if HTTP_PARSER_STRICT
+    /* Bytes >= 0x7f */
+    scan_word_t high = (w | (w + SCAN_ONES)) & SCAN_HIGHS;
+#else
+    scan_word_t high = SCAN_HAS_BYTE(w, 127);
+#endif
+    if (SCAN_HAS_LESS(w, '!') | SCAN_HAS_BYTE(w, '#') | SCAN_HAS_BYTE(w, '?') | high) {
+      break;
+    }
+  }
+  while (p != end && IS_URL_CHAR(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/* Returns the first CR or LF of [p, end), or end */
+static const char *
+scan_crlf(const char *p, const char *end)
+{
+#if SCAN_SSE2
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    int stop = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(CR)),
+                                              _mm_cmpeq_epi8(v, _mm_set1_epi8(LF))));
+    if (stop) {
+      return p + __builtin_ctz(stop);
+    }
+  }
+#endif
+  for (; end - p >= (ptrdiff_t) sizeof(scan_word_t); p += sizeof(scan_word_t)) {
+    scan_word_t w = scan_load(p);
+    if (SCAN_HAS_BYTE(w, CR) | SCAN_HAS_BYTE(w, LF)) {
+      break;
+    }
+  }
+  while (p != end && *p != CR && *p != LF) {
+    p++;
+  }
+  return p;
+}
+#endif /* HTTP_PARSER_FAST_SCAN */
+
 #define start_state (parser->type == HTTP_REQUEST ? s_start_req : s_start_res)
 
 
@@ -1144,6 +1237,21 @@ reexecute:
               SET_ERRNO(HPE_INVALID_URL);
               goto error;
             }
+#if HTTP_PARSER_FAST_SCAN
+            /* The URL chars do not change these states, skip them. The
+             * header size limit is reached by the byte loop, as usual.
+             */
+            if (CURRENT_STATE() == s_req_path ||
+                CURRENT_STATE() == s_req_query_string ||
+                CURRENT_STATE() == s_req_fragment) {
+              const char* end = p + 1 + MIN((size_t) (data + len - (p + 1)),
+                                            HTTP_MAX_HEADER_SIZE - parser->nread);
+              const char* run_end = scan_url_chars(p + 1, end);
+
+              COUNT_HEADER_SIZE(run_end - (p + 1));
+              p = run_end - 1;
+            }
+#endif
         }
         break;
       }
@@ -1332,6 +1440,12 @@ reexecute:
 
           switch (parser->header_state) {
             case h_general:
+#if HTTP_PARSER_FAST_SCAN
+              /* Nothing to match in the rest of the field name */
+              while (p + 1 != data + len && TOKEN(p[1])) {
+                p++;
+              }
+#endif
               break;
 
             case h_C:
@@ -1558,12 +1672,19 @@ reexecute:
           switch (h_state) {
             case h_general:
             {
-              const char* p_cr;
-              const char* p_lf;
               size_t limit = data + len - p;
 
               limit = MIN(limit, HTTP_MAX_HEADER_SIZE);
 
+#if HTTP_PARSER_FAST_SCAN
+              /* One pass for both CR and LF */
+              const char* p_crlf = scan_crlf(p, p + limit);
+
+              p = (p_crlf != p + limit) ? p_crlf : data + len;
+#else
+              const char* p_cr;
+              const char* p_lf;
+
               p_cr = (const char*) memchr(p, CR, limit);
               p_lf = (const char*) memchr(p, LF, limit);
               if (p_cr != NULL) {
@@ -1576,6 +1697,7 @@ reexecute:
               } else {
                 p = data + len;
               }
+#endif
               --p;
 
               break;
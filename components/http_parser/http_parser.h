@@ -53,6 +53,13 @@ typedef unsigned __int64 uint64_t;
 # define HTTP_PARSER_STRICT 1
 #endif
 
+/* Compile with -DHTTP_PARSER_FAST_SCAN=0 to parse the URL and the header
+ * values one byte at a time, instead of one word at a time
+ */
+#ifndef HTTP_PARSER_FAST_SCAN
+# define HTTP_PARSER_FAST_SCAN 1
+#endif
+
 /* Maximium header size allowed. If the macro is not defined
  * before including this header then the default is used. To
  * change the maximum header size, define the macro in the build
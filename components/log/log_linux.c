@@ -44,3 +44,8 @@ uint32_t esp_log_timestamp(void)
     uint32_t milliseconds = current_time.tv_sec * 1000 + current_time.tv_nsec / 1000000;
     return milliseconds;
 }
+
+uint32_t esp_log_early_timestamp(void)
+{
+    return esp_log_timestamp();
+}
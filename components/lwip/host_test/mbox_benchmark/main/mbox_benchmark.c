@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sys.h"
+
+#define MBOX_SIZE               32
+#define PRODUCER_COUNT          4
+#define PRODUCER_MESSAGES       200000
+#define PRODUCER_PRIORITY       4
+#define CONSUMER_PRIORITY       5
+#define PRODUCER_YIELD_MASK     63
+#define BATCH_SIZE              16
+#define BATCH_COUNT             100000
+
+/* A message carries the producer ID in its top byte and a sequence number starting at 1 below it */
+#define MSG_ID_SHIFT            24
+#define MSG_SEQ_MASK            ((1 << MSG_ID_SHIFT) - 1)
+
+static sys_mbox_t s_mbox;
+
+static int64_t get_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_result(const char *pattern, uint32_t messages, int64_t time_us)
+{
+    printf("RESULT %s: %" PRIu32 " messages in %" PRId64 " us, %" PRId64 " ns/message\n",
+           pattern, messages, time_us, time_us * 1000 / messages);
+}
+
+static void producer_task(void *arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+
+    for (uintptr_t seq = 1; seq <= PRODUCER_MESSAGES; seq++) {
+        sys_mbox_post(&s_mbox, (void *)((id << MSG_ID_SHIFT) | seq));
+        // Let the other producers of the same priority run, as several application tasks would
+        if ((seq & PRODUCER_YIELD_MASK) == 0) {
+            taskYIELD();
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/* Several producers post to a mailbox which is drained by a consumer with a higher priority */
+static void benchmark_producers(void)
+{
+    uint32_t last_seq[PRODUCER_COUNT] = { 0 };
+    const uint32_t total = PRODUCER_COUNT * PRODUCER_MESSAGES;
+    void *msg;
+
+    int64_t start = get_time_us();
+    for (uintptr_t id = 0; id < PRODUCER_COUNT; id++) {
+        if (xTaskCreate(producer_task, "producer", 4096, (void *)id, PRODUCER_PRIORITY, NULL) != pdPASS) {
+            printf("Failed to create producer task\n");
+            abort();
+        }
+    }
+    for (uint32_t i = 0; i < total; i++) {
+        if (sys_arch_mbox_fetch(&s_mbox, &msg, 0) == SYS_ARCH_TIMEOUT) {
+            printf("Fetching without timeout timed out\n");
+            abort();
+        }
+        uintptr_t id = (uintptr_t)msg >> MSG_ID_SHIFT;
+        uint32_t seq = (uintptr_t)msg & MSG_SEQ_MASK;
+        if (id >= PRODUCER_COUNT || seq != last_seq[id] + 1) {
+            printf("Message %" PRIu32 " of producer %u received out of order\n", seq, (unsigned)id);
+            abort();
+        }
+        last_seq[id] = seq;
+    }
+    print_result("producers", total, get_time_us() - start);
+
+    if (sys_arch_mbox_tryfetch(&s_mbox, &msg) != SYS_MBOX_EMPTY) {
+        printf("Mailbox not empty after all messages were fetched\n");
+        abort();
+    }
+}
+
+/* A single task posts a batch of messages and fetches them again, without any context switch */
+static void benchmark_batch(void)
+{
+    void *msg;
+
+    int64_t start = get_time_us();
+    for (uint32_t i = 0; i < BATCH_COUNT; i++) {
+        for (uintptr_t j = 1; j <= BATCH_SIZE; j++) {
+            sys_mbox_post(&s_mbox, (void *)j);
+        }
+        for (uintptr_t j = 1; j <= BATCH_SIZE; j++) {
+            if (sys_arch_mbox_fetch(&s_mbox, &msg, 0) == SYS_ARCH_TIMEOUT || msg != (void *)j) {
+                printf("Message %u of the batch not received\n", (unsigned)j);
+                abort();
+            }
+        }
+    }
+    print_result("batch", BATCH_SIZE * BATCH_COUNT, get_time_us() - start);
+}
+
+void app_main(void)
+{
+    void *msg;
+
+    vTaskPrioritySet(NULL, CONSUMER_PRIORITY);
+    if (sys_mbox_new(&s_mbox, MBOX_SIZE) != ERR_OK) {
+        printf("Failed to create the mailbox\n");
+        abort();
+    }
+
+    // Fetching from an empty mailbox times out, or fails at once without a timeout
+    if (sys_arch_mbox_fetch(&s_mbox, &msg, 20) != SYS_ARCH_TIMEOUT || msg != NULL ||
+            sys_arch_mbox_tryfetch(&s_mbox, &msg) != SYS_MBOX_EMPTY) {
+        printf("Fetching from an empty mailbox did not fail\n");
+        abort();
+    }
+
+    benchmark_producers();
+    benchmark_batch();
+
+    sys_mbox_free(&s_mbox);
+    printf("Benchmark done\n");
+    exit(0);
+}
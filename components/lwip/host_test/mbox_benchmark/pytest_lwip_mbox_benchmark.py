@@ -0,0 +1,19 @@
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+import logging
+
+import pytest
+from pytest_embedded import Dut
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+@pytest.mark.parametrize('config', [
+    'queue',
+    'lock_free',
+], indirect=True)
+def test_lwip_mbox_benchmark(dut: Dut) -> None:
+    for _ in range(2):
+        match = dut.expect(r'RESULT ([\w ]+): (\d+) messages in (\d+) us, (\d+) ns/message', timeout=120)
+        logging.info('%s: %s ns/message', match.group(1).decode(), match.group(4).decode())
+    dut.expect_exact('Benchmark done', timeout=5)
@@ -100,6 +100,8 @@ void esp_vfs_lwip_sockets_register(void)
         .stop_socket_select = &lwip_stop_socket_select,
         .stop_socket_select_isr = &lwip_stop_socket_select_isr,
 #endif // CONFIG_VFS_SUPPORT_SELECT
+        .readv = &lwip_readv,
+        .writev = &lwip_writev,
     };
     /* Non-LWIP file descriptors are from 0 to (LWIP_SOCKET_OFFSET-1). LWIP
      * file descriptors are registered from LWIP_SOCKET_OFFSET to
@@ -3,7 +3,7 @@
  *
  * SPDX-License-Identifier: BSD-3-Clause
  *
- * SPDX-FileContributor: 2018-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileContributor: 2018-2023 Espressif Systems (Shanghai) CO LTD
  */
 #ifndef __SYS_ARCH_H__
 #define __SYS_ARCH_H__
@@ -22,10 +22,8 @@ typedef SemaphoreHandle_t sys_sem_t;
 typedef SemaphoreHandle_t sys_mutex_t;
 typedef TaskHandle_t sys_thread_t;
 
-typedef struct sys_mbox_s {
-  QueueHandle_t os_mbox;
-  void *owner;
-}* sys_mbox_t;
+/* Mailbox internals depend on CONFIG_LWIP_MBOX_LOCK_FREE and are private to sys_arch.c */
+typedef struct sys_mbox_s* sys_mbox_t;
 
 /** This is returned by _fromisr() sys functions to tell the outermost function
  * that a higher priority task was woken and the scheduler needs to be invoked.
@@ -3,12 +3,13 @@
  *
  * SPDX-License-Identifier: BSD-3-Clause
  *
- * SPDX-FileContributor: 2018-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileContributor: 2018-2023 Espressif Systems (Shanghai) CO LTD
  */
 
 /* lwIP includes. */
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -195,6 +196,13 @@ sys_sem_free(sys_sem_t *sem)
   *sem = NULL;
 }
 
+#if !CONFIG_LWIP_MBOX_LOCK_FREE
+
+struct sys_mbox_s {
+  QueueHandle_t os_mbox;
+  void *owner;
+};
+
 /**
  * @brief Create an empty mailbox.
  *
@@ -352,15 +360,339 @@ sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
   return 0;
 }
 
+/**
+ * @brief Delete a mailbox
+ *
+ * @param mbox pointer of the mailbox to delete
+ */
 void
-sys_mbox_set_owner(sys_mbox_t *mbox, void* owner)
+sys_mbox_free(sys_mbox_t *mbox)
 {
-  if (mbox && *mbox) {
-    (*mbox)->owner = owner;
-    LWIP_DEBUGF(ESP_THREAD_SAFE_DEBUG, ("set mbox=%p owner=%p", *mbox, owner));
+  if ((NULL == mbox) || (NULL == *mbox)) {
+    return;
+  }
+  UBaseType_t msgs_waiting = uxQueueMessagesWaiting((*mbox)->os_mbox);
+  LWIP_ASSERT("mbox quence not empty", msgs_waiting == 0);
+
+  vQueueDelete((*mbox)->os_mbox);
+  free(*mbox);
+  *mbox = NULL;
+
+  (void)msgs_waiting;
+}
+
+#else /* CONFIG_LWIP_MBOX_LOCK_FREE */
+
+/* Lock-free mailbox
+ *
+ * Messages are kept in a bounded ring buffer where every slot has a sequence number telling whether it holds a
+ * message for the current round (seq == pos + 1) or is free for it (seq == pos). Producers and consumers claim
+ * positions with a compare-and-swap on tail and head respectively, so posting never blocks on a lock held by the
+ * fetching task and vice versa.
+ *
+ * A task which finds the mailbox empty registers itself as the waiter and sleeps on a task notification. Producers
+ * only notify when a waiter is registered, so a task which is busy processing messages is not woken up for every
+ * message, it fetches everything posted meanwhile on its own. Only one task can be registered at a time; if others
+ * wait on the same mailbox simultaneously, they poll it once per tick.
+ *
+ * Tasks posting to a full mailbox block on a counting semaphore, which is only given while such tasks exist.
+ */
+#define MBOX_NOTIFY_INDEX (configTASK_NOTIFICATION_ARRAY_ENTRIES - 1)
+
+typedef struct {
+  atomic_uint_fast32_t seq;
+  void *msg;
+} sys_mbox_slot_t;
+
+struct sys_mbox_s {
+  atomic_uint_fast32_t head;       /* next position to fetch from */
+  atomic_uint_fast32_t tail;       /* next position to post to */
+  _Atomic(TaskHandle_t) waiter;    /* task waiting for a message, if any */
+  atomic_int full_waiters;         /* number of tasks waiting for a free slot */
+  SemaphoreHandle_t not_full;      /* given for each fetched message while full_waiters > 0 */
+  uint32_t mask;                   /* number of slots - 1, the number of slots is a power of 2 */
+  void *owner;
+  sys_mbox_slot_t slots[];
+};
+
+static bool
+mbox_put(struct sys_mbox_s *mb, void *msg)
+{
+  uint_fast32_t pos = atomic_load_explicit(&mb->tail, memory_order_relaxed);
+  sys_mbox_slot_t *slot;
+
+  while (1) {
+    slot = &mb->slots[pos & mb->mask];
+    int32_t diff = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&mb->tail, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* the slot still holds the message from the previous round */
+      return false;
+    } else {
+      pos = atomic_load_explicit(&mb->tail, memory_order_relaxed);
+    }
+  }
+  slot->msg = msg;
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+  return true;
+}
+
+static bool
+mbox_get(struct sys_mbox_s *mb, void **msg)
+{
+  uint_fast32_t pos = atomic_load_explicit(&mb->head, memory_order_relaxed);
+  sys_mbox_slot_t *slot;
+
+  while (1) {
+    slot = &mb->slots[pos & mb->mask];
+    int32_t diff = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - (pos + 1));
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&mb->head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* no message posted to this slot yet */
+      return false;
+    } else {
+      pos = atomic_load_explicit(&mb->head, memory_order_relaxed);
+    }
+  }
+  *msg = slot->msg;
+  atomic_store_explicit(&slot->seq, pos + mb->mask + 1, memory_order_release);
+
+  /* Pairs with the fence in sys_mbox_post() */
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&mb->full_waiters, memory_order_relaxed) > 0) {
+    xSemaphoreGive(mb->not_full);
+  }
+  return true;
+}
+
+/* Returns the task to notify after a message has been posted, NULL if none is waiting */
+static TaskHandle_t
+mbox_take_waiter(struct sys_mbox_s *mb)
+{
+  /* Pairs with the fence in sys_arch_mbox_fetch(): either the waiter sees the message or we see the waiter */
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&mb->waiter, memory_order_relaxed) == NULL) {
+    return NULL;
+  }
+  return atomic_exchange(&mb->waiter, NULL);
+}
+
+/**
+ * @brief Create an empty mailbox.
+ *
+ * @param mbox pointer of the mailbox
+ * @param size size of the mailbox
+ * @return ERR_OK on success, ERR_MEM when out of memory
+ */
+err_t
+sys_mbox_new(sys_mbox_t *mbox, int size)
+{
+  uint32_t slots = 1;
+  while ((int)slots < size) {
+    slots <<= 1;
+  }
+
+  *mbox = mem_malloc(sizeof(struct sys_mbox_s) + slots * sizeof(sys_mbox_slot_t));
+  if (*mbox == NULL){
+    LWIP_DEBUGF(ESP_THREAD_SAFE_DEBUG, ("fail to new *mbox\n"));
+    return ERR_MEM;
+  }
+
+  atomic_init(&(*mbox)->head, 0);
+  atomic_init(&(*mbox)->tail, 0);
+  atomic_init(&(*mbox)->waiter, NULL);
+  atomic_init(&(*mbox)->full_waiters, 0);
+  (*mbox)->not_full = xSemaphoreCreateCounting(slots, 0);
+  if ((*mbox)->not_full == NULL) {
+    LWIP_DEBUGF(ESP_THREAD_SAFE_DEBUG, ("fail to new (*mbox)->not_full\n"));
+    free(*mbox);
+    *mbox = NULL;
+    return ERR_MEM;
+  }
+  (*mbox)->mask = slots - 1;
+  for (uint32_t i = 0; i < slots; i++) {
+    atomic_init(&(*mbox)->slots[i].seq, i);
+    (*mbox)->slots[i].msg = NULL;
+  }
+  (*mbox)->owner = NULL;
+
+  LWIP_DEBUGF(ESP_THREAD_SAFE_DEBUG, ("new *mbox ok mbox=%p slots=%d\n", *mbox, slots));
+  return ERR_OK;
+}
+
+/**
+ * @brief Send message to mailbox
+ *
+ * @param mbox pointer of the mailbox
+ * @param msg pointer of the message to send
+ */
+void
+sys_mbox_post(sys_mbox_t *mbox, void *msg)
+{
+  struct sys_mbox_s *mb = *mbox;
+
+  while (!mbox_put(mb, msg)) {
+    /* mailbox full, wait for the receiving task to catch up */
+    atomic_fetch_add(&mb->full_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!mbox_put(mb, msg)) {
+      xSemaphoreTake(mb->not_full, portMAX_DELAY);
+      atomic_fetch_sub(&mb->full_waiters, 1);
+      continue;
+    }
+    atomic_fetch_sub(&mb->full_waiters, 1);
+    break;
+  }
+
+  TaskHandle_t waiter = mbox_take_waiter(mb);
+  if (waiter != NULL) {
+    xTaskNotifyGiveIndexed(waiter, MBOX_NOTIFY_INDEX);
+  }
+}
+
+/**
+ * @brief Try to post a message to mailbox
+ *
+ * @param mbox pointer of the mailbox
+ * @param msg pointer of the message to send
+ * @return ERR_OK on success, ERR_MEM when mailbox is full
+ */
+err_t
+sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
+{
+  if (!mbox_put(*mbox, msg)) {
+    LWIP_DEBUGF(ESP_THREAD_SAFE_DEBUG, ("trypost mbox=%p fail\n", *mbox));
+    return ERR_MEM;
+  }
+
+  TaskHandle_t waiter = mbox_take_waiter(*mbox);
+  if (waiter != NULL) {
+    xTaskNotifyGiveIndexed(waiter, MBOX_NOTIFY_INDEX);
+  }
+  return ERR_OK;
+}
+
+/**
+ * @brief Try to post a message to mailbox from ISR
+ *
+ * @param mbox pointer of the mailbox
+ * @param msg pointer of the message to send
+ * @return  ERR_OK on success
+ *          ERR_MEM when mailbox is full
+ *          ERR_NEED_SCHED when high priority task wakes up
+ */
+err_t
+sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg)
+{
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+  if (!mbox_put(*mbox, msg)) {
+    return ERR_MEM;
+  }
+
+  TaskHandle_t waiter = mbox_take_waiter(*mbox);
+  if (waiter != NULL) {
+    vTaskNotifyGiveIndexedFromISR(waiter, MBOX_NOTIFY_INDEX, &xHigherPriorityTaskWoken);
+    if (xHigherPriorityTaskWoken == pdTRUE) {
+      return ERR_NEED_SCHED;
+    }
+  }
+  return ERR_OK;
+}
+
+/**
+ * @brief Fetch message from mailbox
+ *
+ * @param mbox pointer of mailbox
+ * @param msg pointer of the received message, could be NULL to indicate the message should be dropped
+ * @param timeout if zero, will wait infinitely; or will wait milliseconds specify by this argument
+ * @return SYS_ARCH_TIMEOUT when timeout, 0 otherwise
+ */
+u32_t
+sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
+{
+  struct sys_mbox_s *mb = *mbox;
+  void *msg_dummy;
+
+  if (msg == NULL) {
+    msg = &msg_dummy;
+  }
+
+  if (mbox_get(mb, msg)) {
+    return 0;
+  }
+
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  const TickType_t timeout_ticks = timeout / portTICK_PERIOD_MS;
+  const TickType_t start = xTaskGetTickCount();
+
+  while (1) {
+    /* Still registered if the last wakeup was caused by the notification for an earlier message */
+    TaskHandle_t expected = NULL;
+    bool registered = atomic_compare_exchange_strong(&mb->waiter, &expected, self) || expected == self;
+    atomic_thread_fence(memory_order_seq_cst);
+
+    bool received = mbox_get(mb, msg);
+    TickType_t wait_ticks = portMAX_DELAY;
+    if (!received && timeout != 0) {
+      TickType_t elapsed = xTaskGetTickCount() - start;
+      wait_ticks = (elapsed < timeout_ticks) ? timeout_ticks - elapsed : 0;
+    }
+
+    if (received || wait_ticks == 0) {
+      if (registered) {
+        /* If a producer has already taken us as waiter, its notification only causes a spurious wakeup later */
+        expected = self;
+        atomic_compare_exchange_strong(&mb->waiter, &expected, NULL);
+      }
+      if (!received) {
+        /* timed out */
+        *msg = NULL;
+        return SYS_ARCH_TIMEOUT;
+      }
+      return 0;
+    }
+
+    if (registered) {
+      ulTaskNotifyTakeIndexed(MBOX_NOTIFY_INDEX, pdTRUE, wait_ticks);
+    } else {
+      /* another task is waiting on this mailbox */
+      vTaskDelay(1);
+    }
   }
 }
 
+/**
+ * @brief try to fetch message from mailbox
+ *
+ * @param mbox pointer of mailbox
+ * @param msg pointer of the received message
+ * @return SYS_MBOX_EMPTY if mailbox is empty, 1 otherwise
+ */
+u32_t
+sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
+{
+  void *msg_dummy;
+
+  if (msg == NULL) {
+    msg = &msg_dummy;
+  }
+  if (!mbox_get(*mbox, msg)) {
+    *msg = NULL;
+    return SYS_MBOX_EMPTY;
+  }
+
+  return 0;
+}
+
 /**
  * @brief Delete a mailbox
  *
@@ -372,16 +704,27 @@ sys_mbox_free(sys_mbox_t *mbox)
   if ((NULL == mbox) || (NULL == *mbox)) {
     return;
   }
-  UBaseType_t msgs_waiting = uxQueueMessagesWaiting((*mbox)->os_mbox);
+  uint_fast32_t msgs_waiting = atomic_load(&(*mbox)->tail) - atomic_load(&(*mbox)->head);
   LWIP_ASSERT("mbox quence not empty", msgs_waiting == 0);
 
-  vQueueDelete((*mbox)->os_mbox);
+  vSemaphoreDelete((*mbox)->not_full);
   free(*mbox);
   *mbox = NULL;
 
   (void)msgs_waiting;
 }
 
+#endif /* CONFIG_LWIP_MBOX_LOCK_FREE */
+
+void
+sys_mbox_set_owner(sys_mbox_t *mbox, void* owner)
+{
+  if (mbox && *mbox) {
+    (*mbox)->owner = owner;
+    LWIP_DEBUGF(ESP_THREAD_SAFE_DEBUG, ("set mbox=%p owner=%p", *mbox, owner));
+  }
+}
+
 /**
  * @brief Create a new thread
  *
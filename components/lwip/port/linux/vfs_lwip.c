@@ -11,6 +11,8 @@ extern int __real_fcntl(int s, int cmd, ...);
 extern int __real_close(int s);
 extern ssize_t __real_write (int fd, const void *buf, size_t n);
 extern ssize_t __real_read (int fd, void *buf, size_t n);
+extern ssize_t __real_readv (int fd, const struct iovec *iov, int iovcnt);
+extern ssize_t __real_writev (int fd, const struct iovec *iov, int iovcnt);
 extern int __real_select (int fd, fd_set * rfds, fd_set * wfds, fd_set *efds, struct timeval *tval);
 
 ssize_t __wrap_write (int fd, const void *buf, size_t n)
@@ -31,6 +33,24 @@ ssize_t __wrap_read (int fd, void *buf, size_t n)
     return __real_read(fd, buf, n);
 }
 
+ssize_t __wrap_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+    if (fd >= LWIP_SOCKET_OFFSET)
+        return lwip_readv(fd, iov, iovcnt);
+#endif
+    return __real_readv(fd, iov, iovcnt);
+}
+
+ssize_t __wrap_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+    if (fd >= LWIP_SOCKET_OFFSET)
+        return lwip_writev(fd, iov, iovcnt);
+#endif
+    return __real_writev(fd, iov, iovcnt);
+}
+
 int __wrap_select (int fd, fd_set * rds, fd_set * wfds, fd_set *efds, struct timeval *tval)
 {
 #ifdef CONFIG_LWIP_MAX_SOCKETS
@@ -19,11 +19,13 @@
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
 #include "lwip/tcpip.h"
+#include "lwip/sys.h"
 #include "lwip/prot/iana.h"
 #include "ping/ping_sock.h"
 #include "dhcpserver/dhcpserver.h"
 #include "dhcpserver/dhcpserver_options.h"
 #include "esp_sntp.h"
+#include "esp_timer.h"
 
 #define ETH_PING_END_BIT BIT(1)
 #define ETH_PING_DURATION_MS (5000)
@@ -303,6 +305,57 @@ TEST(lwip, sntp_client_time_2048)
     test_sntp_timestamps(2048, false); // NTP timestamp MSB is cleared for time after 2036
 }
 
+#define MBOX_TEST_PRODUCERS    3
+#define MBOX_TEST_MSGS         5000
+#define MBOX_TEST_SIZE         CONFIG_LWIP_TCPIP_RECVMBOX_SIZE
+
+static sys_mbox_t s_test_mbox;
+
+static void mbox_producer_task(void *arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+    for (uintptr_t i = 1; i <= MBOX_TEST_MSGS; i++) {
+        sys_mbox_post(&s_test_mbox, (void *)((id << 16) | i));
+    }
+    vTaskDelete(NULL);
+}
+
+TEST(lwip, sys_mbox_multiple_producers)
+{
+    void *msg;
+    uint32_t last[MBOX_TEST_PRODUCERS] = { 0 };
+
+    TEST_ASSERT_EQUAL(ERR_OK, sys_mbox_new(&s_test_mbox, MBOX_TEST_SIZE));
+    TEST_ASSERT_EQUAL(SYS_MBOX_EMPTY, sys_arch_mbox_tryfetch(&s_test_mbox, &msg));
+    TEST_ASSERT_EQUAL(SYS_ARCH_TIMEOUT, sys_arch_mbox_fetch(&s_test_mbox, &msg, 20));
+    TEST_ASSERT_NULL(msg);
+
+    // The receiving task has the higher priority, as the TCPIP task does
+    const UBaseType_t prio = uxTaskPriorityGet(NULL);
+    vTaskPrioritySet(NULL, 5);
+    const int64_t start = esp_timer_get_time();
+    for (uintptr_t i = 0; i < MBOX_TEST_PRODUCERS; i++) {
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(mbox_producer_task, "mbox_prod", 2048, (void *)i,
+                                                          4, NULL, i % portNUM_PROCESSORS));
+    }
+    for (int i = 0; i < MBOX_TEST_PRODUCERS * MBOX_TEST_MSGS; i++) {
+        TEST_ASSERT_EQUAL(0, sys_arch_mbox_fetch(&s_test_mbox, &msg, 1000));
+        uintptr_t id = (uintptr_t)msg >> 16;
+        uint32_t seq = (uintptr_t)msg & 0xffff;
+        TEST_ASSERT_LESS_THAN(MBOX_TEST_PRODUCERS, id);
+        // messages of one producer arrive in order
+        TEST_ASSERT_EQUAL(last[id] + 1, seq);
+        last[id] = seq;
+    }
+    const int64_t duration = esp_timer_get_time() - start;
+    printf("%d messages passed in %" PRId64 " us\n", MBOX_TEST_PRODUCERS * MBOX_TEST_MSGS, duration);
+
+    TEST_ASSERT_EQUAL(SYS_MBOX_EMPTY, sys_arch_mbox_tryfetch(&s_test_mbox, &msg));
+    vTaskPrioritySet(NULL, prio);
+    vTaskDelay(2); // let the producers finish deleting themselves
+    sys_mbox_free(&s_test_mbox);
+}
+
 TEST_GROUP_RUNNER(lwip)
 {
     RUN_TEST_CASE(lwip, localhost_ping_test)
@@ -310,6 +363,7 @@ TEST_GROUP_RUNNER(lwip)
     RUN_TEST_CASE(lwip, dhcp_server_start_stop_localhost)
     RUN_TEST_CASE(lwip, sntp_client_time_2015)
     RUN_TEST_CASE(lwip, sntp_client_time_2048)
+    RUN_TEST_CASE(lwip, sys_mbox_multiple_producers)
 }
 
 void app_main(void)
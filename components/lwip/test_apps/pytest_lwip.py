@@ -7,5 +7,9 @@ from pytest_embedded import Dut
 
 @pytest.mark.esp32
 @pytest.mark.generic
+@pytest.mark.parametrize('config', [
+    'default',
+    'mbox_lock_free',
+], indirect=True)
 def test_lwip(dut: Dut) -> None:
     dut.expect_unity_test_output()
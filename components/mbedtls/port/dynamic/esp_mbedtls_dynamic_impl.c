@@ -31,7 +31,11 @@ void esp_mbedtls_free_buf(unsigned char *buf)
 {
     struct esp_mbedtls_ssl_buf *temp = __containerof(buf, struct esp_mbedtls_ssl_buf, buf[0]);
     ESP_LOGV(TAG, "free buffer @ %p", temp);
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+    esp_mbedtls_pool_free(temp);
+#else
     mbedtls_free(temp);
+#endif
 }
 
 static void esp_mbedtls_init_ssl_buf(struct esp_mbedtls_ssl_buf *buf, unsigned int len)
@@ -42,6 +46,32 @@ static void esp_mbedtls_init_ssl_buf(struct esp_mbedtls_ssl_buf *buf, unsigned i
     }
 }
 
+static struct esp_mbedtls_ssl_buf *esp_mbedtls_alloc_record_buf(size_t len)
+{
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+    return esp_mbedtls_pool_alloc(len);
+#else
+    return mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + len);
+#endif
+}
+
+/**
+ * Small buffers only keeping the record counter and IV between records
+ * are always allocated from the heap.
+ */
+static struct esp_mbedtls_ssl_buf *esp_mbedtls_alloc_idle_buf(size_t len)
+{
+    struct esp_mbedtls_ssl_buf *buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + len);
+
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+    if (buf) {
+        buf->pool_class = -1;
+    }
+#endif
+
+    return buf;
+}
+
 static void esp_mbedtls_parse_record_header(mbedtls_ssl_context *ssl)
 {
     ssl->MBEDTLS_PRIVATE(in_msgtype) =  ssl->MBEDTLS_PRIVATE(in_hdr)[0];
@@ -53,13 +83,27 @@ static int tx_buffer_len(mbedtls_ssl_context *ssl, int len)
     (void)ssl;
 
     if (!len) {
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+        /**
+         * Once the handshake is over, the records sent are not longer than the negotiated
+         * maximum fragment length, so a smaller buffer of the pool can be used. This does not
+         * hold if a renegotiation can start, as its handshake messages reuse the buffer.
+         */
+        if (mbedtls_ssl_is_handshake_over(ssl)
+#if defined(MBEDTLS_SSL_RENEGOTIATION)
+            && ssl->MBEDTLS_PRIVATE(conf)->MBEDTLS_PRIVATE(disable_renegotiation) == MBEDTLS_SSL_RENEGOTIATION_DISABLED
+#endif
+           ) {
+            int max_len = mbedtls_ssl_get_max_out_record_payload(ssl);
+
+            if (max_len > 0 && ESP_MBEDTLS_RECORD_BUF_LEN(max_len) < MBEDTLS_SSL_OUT_BUFFER_LEN) {
+                return ESP_MBEDTLS_RECORD_BUF_LEN(max_len);
+            }
+        }
+#endif
         return MBEDTLS_SSL_OUT_BUFFER_LEN;
     } else {
-        return len + MBEDTLS_SSL_HEADER_LEN
-                   + MBEDTLS_MAX_IV_LENGTH
-                   + MBEDTLS_SSL_MAC_ADD
-                   + MBEDTLS_SSL_PADDING_ADD
-                   + MBEDTLS_SSL_MAX_CID_EXPANSION;
+        return ESP_MBEDTLS_RECORD_BUF_LEN(len);
     }
 }
 
@@ -144,7 +188,12 @@ static int esp_mbedtls_alloc_tx_buf(mbedtls_ssl_context *ssl, int len)
         ssl->MBEDTLS_PRIVATE(out_buf) = NULL;
     }
 
-    esp_buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + len);
+    /* The idle TX buffer only keeps the record counter and IV */
+    if (len > TX_IDLE_BUFFER_SIZE) {
+        esp_buf = esp_mbedtls_alloc_record_buf(len);
+    } else {
+        esp_buf = esp_mbedtls_alloc_idle_buf(len);
+    }
     if (!esp_buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", SSL_BUF_HEAD_OFFSET_SIZE + len);
         return MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -205,7 +254,7 @@ int esp_mbedtls_reset_add_rx_buffer(mbedtls_ssl_context *ssl)
         ssl->MBEDTLS_PRIVATE(in_buf) = NULL;
     }
 
-    esp_buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + MBEDTLS_SSL_IN_BUFFER_LEN);
+    esp_buf = esp_mbedtls_alloc_record_buf(MBEDTLS_SSL_IN_BUFFER_LEN);
     if (!esp_buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", SSL_BUF_HEAD_OFFSET_SIZE + MBEDTLS_SSL_IN_BUFFER_LEN);
         return MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -256,7 +305,7 @@ int esp_mbedtls_add_tx_buffer(mbedtls_ssl_context *ssl, size_t buffer_len)
 
     buffer_len = tx_buffer_len(ssl, buffer_len);
 
-    esp_buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + buffer_len);
+    esp_buf = esp_mbedtls_alloc_record_buf(buffer_len);
     if (!esp_buf) {
         ESP_LOGE(TAG, "alloc(%zu bytes) failed", SSL_BUF_HEAD_OFFSET_SIZE + buffer_len);
         ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -301,7 +350,7 @@ int esp_mbedtls_free_tx_buffer(mbedtls_ssl_context *ssl)
     esp_mbedtls_free_buf(ssl->MBEDTLS_PRIVATE(out_buf));
     init_tx_buffer(ssl, NULL);
 
-    esp_buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + TX_IDLE_BUFFER_SIZE);
+    esp_buf = esp_mbedtls_alloc_idle_buf(TX_IDLE_BUFFER_SIZE);
     if (!esp_buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", SSL_BUF_HEAD_OFFSET_SIZE + TX_IDLE_BUFFER_SIZE);
         return MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -369,7 +418,7 @@ int esp_mbedtls_add_rx_buffer(mbedtls_ssl_context *ssl)
         init_rx_buffer(ssl, NULL);
     }
 
-    esp_buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + buffer_len);
+    esp_buf = esp_mbedtls_alloc_record_buf(buffer_len);
     if (!esp_buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", SSL_BUF_HEAD_OFFSET_SIZE + buffer_len);
         ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -435,7 +484,7 @@ int esp_mbedtls_free_rx_buffer(mbedtls_ssl_context *ssl)
     esp_mbedtls_free_buf(ssl->MBEDTLS_PRIVATE(in_buf));
     init_rx_buffer(ssl, NULL);
 
-    esp_buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + 16);
+    esp_buf = esp_mbedtls_alloc_idle_buf(16);
     if (!esp_buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", SSL_BUF_HEAD_OFFSET_SIZE + 16);
         ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -9,6 +9,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
+#include "sdkconfig.h"
 
 /* TODO: Remove this once the appropriate solution is found
  *
@@ -54,11 +55,21 @@ typedef enum {
 struct esp_mbedtls_ssl_buf {
     esp_mbedtls_ssl_buf_states state;
     unsigned int len;
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+    int pool_class;     /* Size class of the pool the buffer belongs to, -1 if it does not */
+#endif
     unsigned char buf[];
 };
 
 #define SSL_BUF_HEAD_OFFSET_SIZE ((int)offsetof(struct esp_mbedtls_ssl_buf, buf))
 
+/* Length of the buffer holding a record of "len" bytes of content, with its header and encryption overhead */
+#define ESP_MBEDTLS_RECORD_BUF_LEN(len) ((len) + MBEDTLS_SSL_HEADER_LEN \
+                                         + MBEDTLS_MAX_IV_LENGTH \
+                                         + MBEDTLS_SSL_MAC_ADD \
+                                         + MBEDTLS_SSL_PADDING_ADD \
+                                         + MBEDTLS_SSL_MAX_CID_EXPANSION)
+
 void esp_mbedtls_free_buf(unsigned char *buf);
 
 int esp_mbedtls_setup_tx_buffer(mbedtls_ssl_context *ssl);
@@ -83,6 +94,21 @@ int esp_mbedtls_free_rx_buffer(mbedtls_ssl_context *ssl);
 
 size_t esp_mbedtls_get_crt_size(mbedtls_x509_crt *cert, size_t *num);
 
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+/**
+ * Take a zeroed buffer of at least "len" bytes from the pool,
+ * allocate it if the pool has no idle buffer of this size.
+ * The "state" and "len" fields are to be initialized by the caller.
+ */
+struct esp_mbedtls_ssl_buf *esp_mbedtls_pool_alloc(size_t len);
+
+/**
+ * Give a buffer back to the pool after zeroing it,
+ * free it if it was allocated from the heap.
+ */
+void esp_mbedtls_pool_free(struct esp_mbedtls_ssl_buf *buf);
+#endif
+
 #ifdef CONFIG_MBEDTLS_DYNAMIC_FREE_CONFIG_DATA
 void esp_mbedtls_free_dhm(mbedtls_ssl_context *ssl);
 
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/esp_dynamic_buffer.h"
+#include "esp_mbedtls_dynamic_impl.h"
+
+#define POOL_SIZE CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SIZE
+
+/* Room for a received or sent record of "len" bytes of content, whatever the cipher is */
+#define POOL_CLASS_LEN(len) ESP_MBEDTLS_RECORD_BUF_LEN((len) + MBEDTLS_SSL_PAYLOAD_OVERHEAD)
+
+/* Size of a buffer in the pool memory, with its header */
+#define POOL_BUF_SIZE(len) ((SSL_BUF_HEAD_OFFSET_SIZE + (len) + 7) & ~7)
+
+/**
+ * Buffer lengths of the pool: the maximum fragment lengths of RFC 6066,
+ * then the maximum content length.
+ */
+static const size_t s_class_len[] = {
+    POOL_CLASS_LEN(512),
+    POOL_CLASS_LEN(1024),
+    POOL_CLASS_LEN(2048),
+    POOL_CLASS_LEN(4096),
+    POOL_CLASS_LEN(MAX(MBEDTLS_SSL_IN_CONTENT_LEN, MBEDTLS_SSL_OUT_CONTENT_LEN)),
+};
+
+#define POOL_CLASS_NUM ((int)(sizeof(s_class_len) / sizeof(s_class_len[0])))
+
+static const char *TAG = "Dynamic Pool";
+
+/**
+ * All the buffers are allocated in a single block the first time a buffer is needed,
+ * so that they do not end up scattered in the heap between the allocations of the application.
+ */
+static unsigned char *s_pool_mem;
+static size_t s_pool_mem_size;
+static bool s_pool_alloc_failed;
+static struct esp_mbedtls_ssl_buf *s_idle[POOL_CLASS_NUM][POOL_SIZE];
+static int s_idle_num[POOL_CLASS_NUM];
+static uint32_t s_hits;
+static uint32_t s_misses;
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void esp_mbedtls_pool_mem_alloc(void)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < POOL_CLASS_NUM; i++) {
+        size += POOL_SIZE * POOL_BUF_SIZE(s_class_len[i]);
+    }
+
+    unsigned char *mem = mbedtls_calloc(1, size);
+    if (!mem) {
+        /* Not tried again until the pool is released, the buffers are allocated from the heap */
+        ESP_LOGW(TAG, "alloc(%zu bytes) failed, the pool is not used", size);
+    }
+
+    portENTER_CRITICAL(&s_pool_lock);
+    if (s_pool_mem || s_pool_alloc_failed) {
+        /* Allocated by another task in the meantime */
+        portEXIT_CRITICAL(&s_pool_lock);
+        mbedtls_free(mem);
+        return;
+    }
+    if (!mem) {
+        s_pool_alloc_failed = true;
+    } else {
+        s_pool_mem = mem;
+        s_pool_mem_size = size;
+        for (int i = 0; i < POOL_CLASS_NUM; i++) {
+            for (int j = 0; j < POOL_SIZE; j++) {
+                s_idle[i][s_idle_num[i]++] = (struct esp_mbedtls_ssl_buf *)mem;
+                mem += POOL_BUF_SIZE(s_class_len[i]);
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+}
+
+struct esp_mbedtls_ssl_buf *esp_mbedtls_pool_alloc(size_t len)
+{
+    struct esp_mbedtls_ssl_buf *buf = NULL;
+    int size_class = 0;
+
+    if (!s_pool_mem && !s_pool_alloc_failed) {
+        esp_mbedtls_pool_mem_alloc();
+    }
+
+    while (size_class < POOL_CLASS_NUM && s_class_len[size_class] < len) {
+        size_class++;
+    }
+
+    /* An idle buffer of a larger size is better than an allocation from the heap */
+    portENTER_CRITICAL(&s_pool_lock);
+    for (int i = size_class; i < POOL_CLASS_NUM; i++) {
+        if (s_idle_num[i]) {
+            buf = s_idle[i][--s_idle_num[i]];
+            size_class = i;
+            break;
+        }
+    }
+    if (buf) {
+        s_hits++;
+    } else {
+        s_misses++;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+
+    if (!buf) {
+        ESP_LOGD(TAG, "no idle buffer of %zu bytes", len);
+        buf = mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + len);
+        if (buf) {
+            buf->pool_class = -1;
+        }
+        return buf;
+    }
+
+    ESP_LOGV(TAG, "take %zu bytes buffer @ %p for %zu bytes", s_class_len[size_class], buf, len);
+    buf->pool_class = size_class;
+
+    return buf;
+}
+
+void esp_mbedtls_pool_free(struct esp_mbedtls_ssl_buf *buf)
+{
+    const int size_class = buf->pool_class;
+
+    if (size_class < 0) {
+        mbedtls_free(buf);
+        return;
+    }
+
+    /**
+     * The buffer may hold plaintext and the next user expects a zeroed buffer as returned by calloc().
+     * Only "len" bytes have been used, the rest was already zeroed.
+     */
+    mbedtls_platform_zeroize(buf->buf, buf->len);
+
+    portENTER_CRITICAL(&s_pool_lock);
+    s_idle[size_class][s_idle_num[size_class]++] = buf;
+    portEXIT_CRITICAL(&s_pool_lock);
+}
+
+void esp_mbedtls_dynamic_buffer_pool_get_stats(esp_mbedtls_dynamic_buffer_pool_stats_t *stats)
+{
+    assert(stats);
+
+    memset(stats, 0, sizeof(*stats));
+
+    portENTER_CRITICAL(&s_pool_lock);
+    stats->size = s_pool_mem_size;
+    for (int i = 0; i < POOL_CLASS_NUM; i++) {
+        stats->idle_num += s_idle_num[i];
+    }
+    stats->hits = s_hits;
+    stats->misses = s_misses;
+    portEXIT_CRITICAL(&s_pool_lock);
+}
+
+esp_err_t esp_mbedtls_dynamic_buffer_pool_release(void)
+{
+    unsigned char *mem;
+
+    portENTER_CRITICAL(&s_pool_lock);
+    for (int i = 0; i < POOL_CLASS_NUM; i++) {
+        if (s_pool_mem && s_idle_num[i] != POOL_SIZE) {
+            portEXIT_CRITICAL(&s_pool_lock);
+            ESP_LOGE(TAG, "buffers of the pool are in use");
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    mem = s_pool_mem;
+    s_pool_mem = NULL;
+    s_pool_mem_size = 0;
+    s_pool_alloc_failed = false;
+    memset(s_idle_num, 0, sizeof(s_idle_num));
+    portEXIT_CRITICAL(&s_pool_lock);
+
+    mbedtls_free(mem);
+
+    return ESP_OK;
+}
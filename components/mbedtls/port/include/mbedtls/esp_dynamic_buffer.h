@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+
+/**
+ * @brief Statistics of the pool of dynamic TX/RX buffers
+ */
+typedef struct {
+    size_t size;        /*!< Memory allocated for the pool, in bytes, 0 if it is not allocated */
+    size_t idle_num;    /*!< Number of buffers of the pool which are not used */
+    uint32_t hits;      /*!< Number of buffers taken from the pool */
+    uint32_t misses;    /*!< Number of buffers allocated from the heap because the pool had no idle buffer large enough */
+} esp_mbedtls_dynamic_buffer_pool_stats_t;
+
+/**
+ * @brief Get the statistics of the pool of dynamic TX/RX buffers
+ *
+ * @param[out] stats Statistics of the pool
+ */
+void esp_mbedtls_dynamic_buffer_pool_get_stats(esp_mbedtls_dynamic_buffer_pool_stats_t *stats);
+
+/**
+ * @brief Free the memory of the pool of dynamic TX/RX buffers
+ *
+ * The pool is allocated again the next time a TLS connection needs a buffer.
+ *
+ * @return
+ *      - ESP_OK if the memory has been freed, or if the pool was not allocated
+ *      - ESP_ERR_INVALID_STATE if buffers of the pool are used by TLS connections
+ */
+esp_err_t esp_mbedtls_dynamic_buffer_pool_release(void);
+
+#endif /* CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL */
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,7 @@
 #include "freertos/task.h"
 #include "unity.h"
 #include "memory_checks.h"
+#include "mbedtls/esp_dynamic_buffer.h"
 
 /* setUp runs before every test */
 void setUp(void)
@@ -26,6 +27,11 @@ void tearDown(void)
     /* clean up some of the newlib's lazy allocations */
     esp_reent_cleanup();
 
+#if CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+    /* the pool of TLS buffers is allocated by the first TLS connection */
+    TEST_ASSERT_EQUAL_MESSAGE(ESP_OK, esp_mbedtls_dynamic_buffer_pool_release(), "The test has not freed the TLS buffers");
+#endif
+
     /* check if unit test has caused heap corruption in any heap */
     TEST_ASSERT_MESSAGE( heap_caps_check_integrity(MALLOC_CAP_INVALID, true), "The test has corrupted the heap");
 
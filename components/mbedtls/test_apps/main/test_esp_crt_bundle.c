@@ -8,8 +8,12 @@
  *
  * SPDX-FileContributor: 2019-2022 Espressif Systems (Shanghai) CO LTD
  */
+#include <inttypes.h>
+#include <sys/param.h>
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -24,6 +28,7 @@
 #include "mbedtls/error.h"
 #include "mbedtls/debug.h"
 #include "mbedtls/esp_debug.h"
+#include "mbedtls/esp_dynamic_buffer.h"
 
 #include "esp_crt_bundle.h"
 #include "esp_random.h"
@@ -54,6 +59,9 @@ extern const uint8_t correct_sig_crt_pem_start[] asm("_binary_correct_sig_crt_es
 extern const uint8_t correct_sig_crt_pem_end[]   asm("_binary_correct_sig_crt_esp32_com_pem_end");
 
 #define SEM_TIMEOUT 10000
+#define HANDSHAKE_TEST_NUM 10
+#define HANDSHAKE_SETTLE_MS 100
+#define HANDSHAKE_HEAP_TOLERANCE 512
 typedef struct {
     mbedtls_ssl_context ssl;
     mbedtls_net_context listen_fd;
@@ -393,6 +401,117 @@ TEST_CASE("custom certificate bundle", "[mbedtls]")
    vSemaphoreDelete(signal_sem);
 }
 
+static void client_handshakes_task(void *pvParameters)
+{
+    SemaphoreHandle_t *client_signal_sem = (SemaphoreHandle_t *) pvParameters;
+    int ret;
+    int handshakes = 0;
+    mbedtls_endpoint_t client;
+
+    if (client_setup(&client) != ESP_OK) {
+        ESP_LOGE(TAG, "SSL client setup failed");
+        goto exit;
+    }
+
+    esp_crt_bundle_attach(&client.conf);
+    esp_crt_bundle_set(server_cert_bundle_start, server_cert_bundle_end - server_cert_bundle_start);
+
+    size_t min_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t first_free = 0;
+    int64_t handshake_time = 0;
+
+    for (int i = 0; i < HANDSHAKE_TEST_NUM; i++) {
+        if ((ret = mbedtls_net_connect(&client.client_fd, SERVER_ADDRESS, SERVER_PORT, MBEDTLS_NET_PROTO_TCP)) != 0) {
+            ESP_LOGE(TAG, "mbedtls_net_connect returned -%x", -ret);
+            break;
+        }
+        mbedtls_ssl_set_bio(&client.ssl, &client.client_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+        int64_t start = esp_timer_get_time();
+        while ( ( ret = mbedtls_ssl_handshake( &client.ssl ) ) != 0 ) {
+            if ( ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE ) {
+                printf( "mbedtls_ssl_handshake failed with -0x%x\n", -ret );
+                break;
+            }
+        }
+        handshake_time += esp_timer_get_time() - start;
+        if (ret == 0) {
+            handshakes++;
+        }
+        min_free = MIN(min_free, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+
+        mbedtls_ssl_close_notify(&client.ssl);
+        mbedtls_ssl_session_reset(&client.ssl);
+        mbedtls_net_free( &client.client_fd);
+
+        /* Let the server reset its side of the connection before looking at the heap */
+        vTaskDelay(HANDSHAKE_SETTLE_MS / portTICK_PERIOD_MS);
+        if (i == 0) {
+            first_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        }
+    }
+
+    size_t last_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    printf("%d handshakes, %lld ms per handshake (including server polling), minimum free heap %zu bytes, "
+           "largest free block %zu bytes, free heap after the first handshake %zu bytes, after the last one %zu bytes\n",
+           handshakes, handshake_time / 1000 / MAX(handshakes, 1), min_free, heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+           first_free, last_free);
+    TEST_ASSERT_EQUAL(HANDSHAKE_TEST_NUM, handshakes);
+    /* The handshakes do not leave anything allocated, but the PCBs of the connections in TIME_WAIT state */
+    TEST_ASSERT_GREATER_OR_EQUAL(first_free - (HANDSHAKE_TEST_NUM - 1) * HANDSHAKE_HEAP_TOLERANCE, last_free);
+#if CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+    esp_mbedtls_dynamic_buffer_pool_stats_t stats;
+    esp_mbedtls_dynamic_buffer_pool_get_stats(&stats);
+    printf("TLS buffer pool: %zu bytes, %"PRIu32" buffers taken from the pool, %"PRIu32" from the heap\n",
+           stats.size, stats.hits, stats.misses);
+    /* The pool is allocated once, and most of the record buffers of the client and the server are taken from it */
+    TEST_ASSERT_NOT_EQUAL(0, stats.size);
+    TEST_ASSERT_GREATER_THAN(stats.misses, stats.hits);
+#endif
+
+exit:
+    esp_crt_bundle_detach(&client.conf);
+    endpoint_teardown(&client);
+    xSemaphoreGive(*client_signal_sem);
+    vTaskSuspend(NULL);
+}
+
+TEST_CASE("consecutive handshakes heap usage and time", "[mbedtls]")
+{
+    test_case_uses_tcpip();
+
+    SemaphoreHandle_t signal_sem = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(signal_sem);
+
+    exit_flag = false;
+    TaskHandle_t server_task_handle;
+    xTaskCreate(server_task, "server task", 8192, &signal_sem, 10, &server_task_handle);
+
+    if (!xSemaphoreTake(signal_sem, SEM_TIMEOUT / portTICK_PERIOD_MS)) {
+        TEST_FAIL_MESSAGE("signal_sem not released, server start failed");
+    }
+
+    SemaphoreHandle_t client_signal_sem = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(client_signal_sem);
+
+    TaskHandle_t client_task_handle;
+    xTaskCreate(client_handshakes_task, "client task", 8192, &client_signal_sem, 10, &client_task_handle);
+
+    if (!xSemaphoreTake(client_signal_sem, HANDSHAKE_TEST_NUM * SEM_TIMEOUT / portTICK_PERIOD_MS)) {
+        TEST_FAIL_MESSAGE("client_signal_sem not released, client exit failed");
+    }
+    unity_utils_task_delete(client_task_handle);
+
+    exit_flag = true;
+
+    if (!xSemaphoreTake(signal_sem, SEM_TIMEOUT / portTICK_PERIOD_MS)) {
+        TEST_FAIL_MESSAGE("signal_sem not released, server exit failed");
+    }
+    unity_utils_task_delete(server_task_handle);
+    vSemaphoreDelete(client_signal_sem);
+    vSemaphoreDelete(signal_sem);
+}
+
 TEST_CASE("custom certificate bundle - weak hash", "[mbedtls]")
 {
     /* A weak signature hash on the trusted certificate should not stop
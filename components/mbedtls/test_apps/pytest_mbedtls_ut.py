@@ -24,6 +24,20 @@ def test_mbedtls_esp32_compiler_perf_opt(dut: Dut) -> None:
     dut.run_all_single_board_cases()
 
 
+@pytest.mark.esp32
+@pytest.mark.esp32c3
+@pytest.mark.generic
+@pytest.mark.parametrize(
+    'config',
+    [
+        'dynamic_buffer',
+    ],
+    indirect=True,
+)
+def test_mbedtls_dynamic_buffer(dut: Dut) -> None:
+    dut.run_all_single_board_cases()
+
+
 @pytest.mark.esp32
 @pytest.mark.esp32s2
 @pytest.mark.esp32s3
@@ -0,0 +1,11 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#define ESP_LOGE(tag, ...)   ((void)(tag))
+#define ESP_LOGW(tag, ...)   ((void)(tag))
+#define ESP_LOGD(tag, ...)   ((void)(tag))
+#define ESP_LOGV(tag, ...)   ((void)(tag))
@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Implemented by the test, on top of a simulated heap */
+void *mbedtls_calloc(size_t n, size_t size);
+void mbedtls_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
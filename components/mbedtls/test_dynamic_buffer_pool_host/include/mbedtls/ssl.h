@@ -0,0 +1,9 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+typedef struct mbedtls_ssl_context mbedtls_ssl_context;
+typedef struct mbedtls_x509_crt mbedtls_x509_crt;
@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER 1
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL 1
+#ifndef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SIZE
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SIZE 2
+#endif
+#define CONFIG_MBEDTLS_ASYMMETRIC_CONTENT_LEN 1
+#define CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN 16384
+#define CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN 4096
@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+/* Record lengths of mbedtls/library/ssl_misc.h, with the default configuration of ESP-IDF */
+#define MBEDTLS_SSL_IN_CONTENT_LEN      CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN
+#define MBEDTLS_SSL_OUT_CONTENT_LEN     CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN
+#define MBEDTLS_SSL_HEADER_LEN          13
+#define MBEDTLS_MAX_IV_LENGTH           16
+#define MBEDTLS_SSL_MAC_ADD             48
+#define MBEDTLS_SSL_PADDING_ADD         256
+#define MBEDTLS_SSL_MAX_CID_EXPANSION   0
+#define MBEDTLS_SSL_PAYLOAD_OVERHEAD    (MBEDTLS_MAX_IV_LENGTH + MBEDTLS_SSL_MAC_ADD + \
+                                         MBEDTLS_SSL_PADDING_ADD + MBEDTLS_SSL_MAX_CID_EXPANSION)
+#define MBEDTLS_SSL_IN_BUFFER_LEN       (MBEDTLS_SSL_HEADER_LEN + MBEDTLS_SSL_IN_CONTENT_LEN + MBEDTLS_SSL_PAYLOAD_OVERHEAD)
+#define MBEDTLS_SSL_OUT_BUFFER_LEN      (MBEDTLS_SSL_HEADER_LEN + MBEDTLS_SSL_OUT_CONTENT_LEN + MBEDTLS_SSL_PAYLOAD_OVERHEAD)
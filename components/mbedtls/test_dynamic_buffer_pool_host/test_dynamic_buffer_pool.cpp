@@ -0,0 +1,398 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
+#include "catch.hpp"
+
+extern "C" {
+#include "esp_mbedtls_dynamic_impl.h"
+#include "mbedtls/esp_dynamic_buffer.h"
+}
+
+#define POOL_SIZE CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SIZE
+#define POOL_CLASS_NUM 5
+
+/*
+ * First-fit heap with coalescing of the free blocks, standing in for the heap of the target,
+ * so that the fragmentation caused by the TLS buffers can be measured.
+ */
+#define HEAP_SIZE (160 * 1024)
+#define HEAP_ALIGN 8
+
+typedef struct heap_block {
+    size_t size;
+    bool used;
+    struct heap_block *next;
+} heap_block_t;
+
+static uint8_t s_heap[HEAP_SIZE] __attribute__((aligned(HEAP_ALIGN)));
+static heap_block_t *s_heap_head;
+static size_t s_heap_used;
+static size_t s_heap_peak;
+static size_t s_heap_calls;
+static int s_heap_fail_next;
+
+static void heap_init(void)
+{
+    s_heap_head = (heap_block_t *)s_heap;
+    s_heap_head->size = HEAP_SIZE - sizeof(heap_block_t);
+    s_heap_head->used = false;
+    s_heap_head->next = NULL;
+    s_heap_used = 0;
+    s_heap_peak = 0;
+    s_heap_calls = 0;
+    s_heap_fail_next = 0;
+}
+
+extern "C" void *mbedtls_calloc(size_t n, size_t size)
+{
+    size_t len = (n * size + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+
+    s_heap_calls++;
+    if (s_heap_fail_next) {
+        s_heap_fail_next--;
+        return NULL;
+    }
+    for (heap_block_t *b = s_heap_head; b; b = b->next) {
+        if (b->used || b->size < len) {
+            continue;
+        }
+        if (b->size >= len + sizeof(heap_block_t) + HEAP_ALIGN) {
+            heap_block_t *rest = (heap_block_t *)((uint8_t *)(b + 1) + len);
+            rest->size = b->size - len - sizeof(heap_block_t);
+            rest->used = false;
+            rest->next = b->next;
+            b->next = rest;
+            b->size = len;
+        }
+        b->used = true;
+        s_heap_used += b->size;
+        if (s_heap_used > s_heap_peak) {
+            s_heap_peak = s_heap_used;
+        }
+        memset(b + 1, 0, b->size);
+        return b + 1;
+    }
+    return NULL;
+}
+
+extern "C" void mbedtls_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    heap_block_t *b = (heap_block_t *)ptr - 1;
+    b->used = false;
+    s_heap_used -= b->size;
+    for (heap_block_t *x = s_heap_head; x; x = x->next) {
+        while (!x->used && x->next && !x->next->used) {
+            x->size += sizeof(heap_block_t) + x->next->size;
+            x->next = x->next->next;
+        }
+    }
+}
+
+static size_t heap_free_size(void)
+{
+    size_t size = 0;
+    for (heap_block_t *b = s_heap_head; b; b = b->next) {
+        size += b->used ? 0 : b->size;
+    }
+    return size;
+}
+
+static size_t heap_largest_free_block(void)
+{
+    size_t size = 0;
+    for (heap_block_t *b = s_heap_head; b; b = b->next) {
+        if (!b->used && b->size > size) {
+            size = b->size;
+        }
+    }
+    return size;
+}
+
+static bool buf_is_zeroed(const struct esp_mbedtls_ssl_buf *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (buf->buf[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Marks the buffer as used for "len" bytes, as esp_mbedtls_add_tx_buffer() and esp_mbedtls_add_rx_buffer() do */
+static struct esp_mbedtls_ssl_buf *pool_get(size_t len)
+{
+    struct esp_mbedtls_ssl_buf *buf = esp_mbedtls_pool_alloc(len);
+    if (buf) {
+        buf->len = len;
+        memset(buf->buf, 0xa5, len);
+    }
+    return buf;
+}
+
+TEST_CASE("buffers are taken from the smallest size class and zeroed", "[dynamic_buffer_pool]")
+{
+    heap_init();
+
+    struct esp_mbedtls_ssl_buf *small = pool_get(100);
+    REQUIRE(small != NULL);
+    CHECK(small->pool_class == 0);
+    struct esp_mbedtls_ssl_buf *large = pool_get(MBEDTLS_SSL_IN_BUFFER_LEN);
+    REQUIRE(large != NULL);
+    CHECK(large->pool_class == POOL_CLASS_NUM - 1);
+    /* The pool is allocated at once */
+    CHECK(s_heap_calls == 1);
+
+    esp_mbedtls_pool_free(small);
+    struct esp_mbedtls_ssl_buf *again = esp_mbedtls_pool_alloc(100);
+    CHECK(again == small);
+    CHECK(buf_is_zeroed(again, 100));
+    esp_mbedtls_pool_free(again);
+    esp_mbedtls_pool_free(large);
+
+    esp_mbedtls_dynamic_buffer_pool_stats_t stats;
+    esp_mbedtls_dynamic_buffer_pool_get_stats(&stats);
+    CHECK(stats.size > 0);
+    CHECK(stats.idle_num == POOL_SIZE * POOL_CLASS_NUM);
+    CHECK(stats.hits == 3);
+    CHECK(stats.misses == 0);
+
+    REQUIRE(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+    CHECK(s_heap_used == 0);
+}
+
+TEST_CASE("larger idle buffers are used before the heap", "[dynamic_buffer_pool]")
+{
+    struct esp_mbedtls_ssl_buf *bufs[POOL_SIZE * POOL_CLASS_NUM];
+
+    heap_init();
+
+    /* Once the buffers of its size are used, a request takes the next larger idle buffer */
+    for (int i = 0; i < POOL_SIZE * POOL_CLASS_NUM; i++) {
+        bufs[i] = pool_get(100);
+        REQUIRE(bufs[i] != NULL);
+        CHECK(bufs[i]->pool_class == i / POOL_SIZE);
+    }
+    size_t calls = s_heap_calls;
+    struct esp_mbedtls_ssl_buf *heap_buf = pool_get(100);
+    REQUIRE(heap_buf != NULL);
+    CHECK(heap_buf->pool_class == -1);
+    CHECK(s_heap_calls == calls + 1);
+
+    esp_mbedtls_dynamic_buffer_pool_stats_t stats;
+    esp_mbedtls_dynamic_buffer_pool_get_stats(&stats);
+    CHECK(stats.idle_num == 0);
+    CHECK(stats.misses == 1);
+
+    /* Buffers allocated from the heap are freed, not added to the pool */
+    esp_mbedtls_pool_free(heap_buf);
+    for (int i = 0; i < POOL_SIZE * POOL_CLASS_NUM; i++) {
+        esp_mbedtls_pool_free(bufs[i]);
+    }
+    esp_mbedtls_dynamic_buffer_pool_get_stats(&stats);
+    CHECK(stats.idle_num == POOL_SIZE * POOL_CLASS_NUM);
+
+    REQUIRE(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+    CHECK(s_heap_used == 0);
+}
+
+TEST_CASE("pool is not released while a buffer is used", "[dynamic_buffer_pool]")
+{
+    heap_init();
+
+    struct esp_mbedtls_ssl_buf *buf = pool_get(100);
+    REQUIRE(buf != NULL);
+    CHECK(esp_mbedtls_dynamic_buffer_pool_release() == ESP_ERR_INVALID_STATE);
+    esp_mbedtls_pool_free(buf);
+    REQUIRE(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+
+    esp_mbedtls_dynamic_buffer_pool_stats_t stats;
+    esp_mbedtls_dynamic_buffer_pool_get_stats(&stats);
+    CHECK(stats.size == 0);
+    CHECK(stats.idle_num == 0);
+    CHECK(s_heap_used == 0);
+
+    /* Nothing to release */
+    CHECK(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+}
+
+TEST_CASE("buffers are allocated from the heap if the pool cannot be allocated", "[dynamic_buffer_pool]")
+{
+    heap_init();
+
+    s_heap_fail_next = 1;
+    struct esp_mbedtls_ssl_buf *buf = pool_get(100);
+    REQUIRE(buf != NULL);
+    CHECK(buf->pool_class == -1);
+    esp_mbedtls_pool_free(buf);
+
+    /* The allocation of the pool is not tried again until it is released */
+    buf = pool_get(100);
+    REQUIRE(buf != NULL);
+    CHECK(buf->pool_class == -1);
+    esp_mbedtls_pool_free(buf);
+    CHECK(s_heap_used == 0);
+
+    REQUIRE(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+    buf = pool_get(100);
+    REQUIRE(buf != NULL);
+    CHECK(buf->pool_class == 0);
+    esp_mbedtls_pool_free(buf);
+    REQUIRE(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+}
+
+/*
+ * Simulation of several TLS 1.2 client connections which take their record buffers from the heap
+ * or from the pool, as with CONFIG_MBEDTLS_DYNAMIC_BUFFER.
+ */
+#define SIM_CONNECTIONS 4
+#define SIM_ROUNDS 3000
+#define SIM_APP_ALLOCS 64
+
+#define REC(len) ESP_MBEDTLS_RECORD_BUF_LEN(len)
+
+/* Buffers of the records of an ECDHE-RSA handshake, alternately sent and received, then application data */
+static const size_t s_handshake_records[] = {
+    REC(220), REC(90), REC(2600), REC(340), REC(60), REC(80),
+    REC(110), REC(70), REC(6), REC(64), REC(6), REC(64),
+};
+
+#define SIM_HANDSHAKE_RECORDS ((int)(sizeof(s_handshake_records) / sizeof(s_handshake_records[0])))
+#define SIM_CYCLE_RECORDS 40
+
+typedef struct {
+    size_t heap_calls;
+    size_t heap_peak;
+    size_t min_largest_free_block;
+    double max_fragmentation;   /* 1 - largest free block / free size */
+    double ns_per_record;
+    int handshakes;
+} sim_result_t;
+
+static bool s_sim_use_pool;
+
+static struct esp_mbedtls_ssl_buf *sim_get(size_t len)
+{
+    struct esp_mbedtls_ssl_buf *buf;
+
+    if (s_sim_use_pool) {
+        buf = esp_mbedtls_pool_alloc(len);
+    } else {
+        buf = (struct esp_mbedtls_ssl_buf *)mbedtls_calloc(1, SSL_BUF_HEAD_OFFSET_SIZE + len);
+    }
+    REQUIRE(buf != NULL);
+    buf->len = len;
+    memset(buf->buf, 0xa5, len);
+    return buf;
+}
+
+static void sim_put(struct esp_mbedtls_ssl_buf **buf)
+{
+    if (!*buf) {
+        return;
+    }
+    if (s_sim_use_pool) {
+        esp_mbedtls_pool_free(*buf);
+    } else {
+        mbedtls_free(*buf);
+    }
+    *buf = NULL;
+}
+
+static sim_result_t simulate(bool use_pool, bool app_allocs)
+{
+    struct esp_mbedtls_ssl_buf *rx[SIM_CONNECTIONS] = { 0 };
+    struct esp_mbedtls_ssl_buf *tx[SIM_CONNECTIONS] = { 0 };
+    void *app[SIM_APP_ALLOCS] = { 0 };
+    sim_result_t result = { 0 };
+    struct timespec start, end;
+
+    heap_init();
+    srand(1);
+    s_sim_use_pool = use_pool;
+    result.min_largest_free_block = HEAP_SIZE;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < SIM_ROUNDS; round++) {
+        for (int c = 0; c < SIM_CONNECTIONS; c++) {
+            const int record = (round + c * 7) % SIM_CYCLE_RECORDS;
+
+            if (app_allocs) {
+                /* Allocations of the application living across the records */
+                const int i = rand() % SIM_APP_ALLOCS;
+                mbedtls_free(app[i]);
+                app[i] = mbedtls_calloc(1, 16 + rand() % 500);
+            }
+            if (record < SIM_HANDSHAKE_RECORDS) {
+                struct esp_mbedtls_ssl_buf **buf = (record % 2) ? &rx[c] : &tx[c];
+                sim_put(buf);
+                *buf = sim_get(s_handshake_records[record]);
+                result.handshakes += record == SIM_HANDSHAKE_RECORDS - 1;
+            } else if (record % 3 == 0) {
+                sim_put(&tx[c]);
+                tx[c] = sim_get(MBEDTLS_SSL_OUT_BUFFER_LEN);
+            } else {
+                sim_put(&rx[c]);
+                rx[c] = sim_get(REC(1024 + rand() % (MBEDTLS_SSL_IN_CONTENT_LEN - 1024)));
+            }
+            /* Buffers are freed once their record has been sent or read */
+            if (rand() % 2) {
+                sim_put(&rx[c]);
+            }
+            if (rand() % 2) {
+                sim_put(&tx[c]);
+            }
+
+            const size_t largest = heap_largest_free_block();
+            const double fragmentation = 1.0 - (double)largest / heap_free_size();
+            result.min_largest_free_block = MIN(result.min_largest_free_block, largest);
+            result.max_fragmentation = MAX(result.max_fragmentation, fragmentation);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int c = 0; c < SIM_CONNECTIONS; c++) {
+        sim_put(&rx[c]);
+        sim_put(&tx[c]);
+    }
+    for (int i = 0; i < SIM_APP_ALLOCS; i++) {
+        mbedtls_free(app[i]);
+    }
+    REQUIRE(esp_mbedtls_dynamic_buffer_pool_release() == ESP_OK);
+    CHECK(s_heap_used == 0);
+
+    result.heap_calls = s_heap_calls;
+    result.heap_peak = s_heap_peak;
+    result.ns_per_record = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (SIM_ROUNDS * SIM_CONNECTIONS);
+    printf("%s, %s application allocations: %zu heap calls, peak heap %zu bytes, "
+           "minimum largest free block %zu bytes, maximum fragmentation %.0f%%, %.0f ns per record\n",
+           use_pool ? "pool" : "heap", app_allocs ? "with" : "without", result.heap_calls, result.heap_peak,
+           result.min_largest_free_block, result.max_fragmentation * 100, result.ns_per_record);
+    return result;
+}
+
+TEST_CASE("pool reduces the heap allocations and the fragmentation of TLS connections", "[dynamic_buffer_pool]")
+{
+    const sim_result_t heap = simulate(false, false);
+    const sim_result_t pool = simulate(true, false);
+
+    CHECK(heap.handshakes == pool.handshakes);
+    CHECK(pool.heap_calls * 10 < heap.heap_calls);
+    CHECK(pool.max_fragmentation < heap.max_fragmentation);
+    /* The pool memory is allocated even when it is not used */
+    CHECK(pool.heap_peak > heap.heap_peak);
+
+    /* The figures depend on the allocations of the application, they are only reported */
+    simulate(false, true);
+    simulate(true, true);
+}
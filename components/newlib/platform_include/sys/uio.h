@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -13,9 +13,16 @@
 extern "C" {
 #endif
 
-struct iovec;
+#ifndef LWIP_HDR_SOCKETS_H
+/* lwip/sockets.h defines struct iovec itself, unless iovec is defined as a macro */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#define iovec iovec
+#endif // LWIP_HDR_SOCKETS_H
 
-int writev(int s, const struct iovec *iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
 
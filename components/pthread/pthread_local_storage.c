@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2017-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2017-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -11,7 +11,6 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "sys/lock.h"
-#include "sys/queue.h"
 
 #include "pthread_internal.h"
 
@@ -24,65 +23,116 @@
 
 typedef void (*pthread_destructor_t)(void*);
 
-/* This is a very naive implementation of key-indexed thread local storage, using two linked lists
-   (one is a global list of registered keys, one per thread for thread local storage values).
+/* Keys are indexes into an array of key slots, combined with a generation count which is incremented each
+   time a slot is freed, so that a key cannot be mistaken for a later key reusing its slot:
 
-   It won't work well if lots of keys & thread-local values are stored (O(n) lookup for both),
-   but it should work for small amounts of data.
+   key = (generation << PTHREAD_KEY_INDEX_BITS) | index
+
+   Each thread keeps its values in an array indexed the same way, which grows on demand. Every value is stored
+   together with the key it was set for, so pthread_getspecific() only needs to compare the key to find out if
+   the value is still valid, without looking at the global key slots or taking any lock.
 */
-typedef struct key_entry_t_ {
-    pthread_key_t key;
+#define PTHREAD_KEY_INDEX_BITS  16
+#define PTHREAD_KEY_INDEX_MASK  ((1 << PTHREAD_KEY_INDEX_BITS) - 1)
+#define PTHREAD_KEY_GEN_MAX     (UINT32_MAX >> PTHREAD_KEY_INDEX_BITS)
+#define PTHREAD_KEY_INDEX(key)  ((key) & PTHREAD_KEY_INDEX_MASK)
+#define PTHREAD_KEY_GEN(key)    ((key) >> PTHREAD_KEY_INDEX_BITS)
+#define PTHREAD_KEYS_MIN_ALLOC  8
+
+typedef struct {
+    uint32_t gen;                       // Generation of the current or, if !in_use, the next key of this slot
+    bool in_use;
     pthread_destructor_t destructor;
-    SLIST_ENTRY(key_entry_t_) next;
-} key_entry_t;
+} key_slot_t;
 
-// List of all keys created with pthread_key_create()
-SLIST_HEAD(key_list_t, key_entry_t_) s_keys = SLIST_HEAD_INITIALIZER(s_keys);
+// Slots of all keys created with pthread_key_create(), indexed by PTHREAD_KEY_INDEX(key)
+static key_slot_t *s_keys;
+static size_t s_keys_count;
 
 static portMUX_TYPE s_keys_lock = portMUX_INITIALIZER_UNLOCKED;
 
-// List of all value entries associated with a thread via pthread_setspecific()
-typedef struct value_entry_t_ {
-    pthread_key_t key;
+// Value associated with a key via pthread_setspecific()
+typedef struct {
+    pthread_key_t key;                  // Key the value was set for, 0 if none
     void *value;
-    SLIST_ENTRY(value_entry_t_) next;
 } value_entry_t;
 
-// Type for the head of the list, as saved as a FreeRTOS thread local storage pointer
-SLIST_HEAD(values_list_t_, value_entry_t_);
-typedef struct values_list_t_ values_list_t;
+// Values of one thread, as saved as a FreeRTOS thread local storage pointer
+typedef struct {
+    size_t count;
+    value_entry_t *values;              // indexed by PTHREAD_KEY_INDEX(key)
+} values_list_t;
+
+static inline pthread_key_t make_key(size_t index, uint32_t gen)
+{
+    return (gen << PTHREAD_KEY_INDEX_BITS) | index;
+}
 
 int pthread_key_create(pthread_key_t *key, pthread_destructor_t destructor)
 {
-    key_entry_t *new_key = malloc(sizeof(key_entry_t));
-    if (new_key == NULL) {
-        return ENOMEM;
-    }
+    key_slot_t *new_keys = NULL;
+    size_t new_count = 0;
 
-    portENTER_CRITICAL(&s_keys_lock);
+    while (1) {
+        key_slot_t *old_keys = NULL;
+
+        portENTER_CRITICAL(&s_keys_lock);
+
+        if (new_keys != NULL && s_keys_count < new_count) {
+            // Install the larger array allocated below, unless another thread has already done it
+            memcpy(new_keys, s_keys, s_keys_count * sizeof(key_slot_t));
+            memset(new_keys + s_keys_count, 0, (new_count - s_keys_count) * sizeof(key_slot_t));
+            old_keys = s_keys;
+            s_keys = new_keys;
+            s_keys_count = new_count;
+            new_keys = NULL;
+        }
 
-    const key_entry_t *head = SLIST_FIRST(&s_keys);
-    new_key->key = (head == NULL) ? 1 : (head->key + 1);
-    new_key->destructor = destructor;
-    *key = new_key->key;
+        for (size_t i = 0; i < s_keys_count; i++) {
+            key_slot_t *slot = &s_keys[i];
+            if (!slot->in_use) {
+                if (slot->gen == 0) {
+                    slot->gen = 1;
+                }
+                slot->in_use = true;
+                slot->destructor = destructor;
+                *key = make_key(i, slot->gen);
+                portEXIT_CRITICAL(&s_keys_lock);
+                free(old_keys);
+                free(new_keys);
+                return 0;
+            }
+        }
+        const size_t count = s_keys_count;
 
-    SLIST_INSERT_HEAD(&s_keys, new_key, next);
+        portEXIT_CRITICAL(&s_keys_lock);
 
-    portEXIT_CRITICAL(&s_keys_lock);
-    return 0;
+        // All slots are in use, memory can't be allocated in a critical section so do it here and retry
+        free(old_keys);
+        free(new_keys);
+        new_count = (count == 0) ? PTHREAD_KEYS_MIN_ALLOC : count * 2;
+        if (new_count > PTHREAD_KEY_INDEX_MASK + 1) {
+            return EAGAIN;
+        }
+        new_keys = malloc(new_count * sizeof(key_slot_t));
+        if (new_keys == NULL) {
+            return ENOMEM;
+        }
+    }
 }
 
-static key_entry_t *find_key(pthread_key_t key)
+/* Returns the slot of the key or NULL if the key is not valid. Has to be called in a critical section. */
+static key_slot_t *find_key(pthread_key_t key)
 {
-    portENTER_CRITICAL(&s_keys_lock);
-    key_entry_t *result = NULL;;
-    SLIST_FOREACH(result, &s_keys, next) {
-        if(result->key == key) {
-            break;
-        }
+    const size_t index = PTHREAD_KEY_INDEX(key);
+    if (index >= s_keys_count) {
+        return NULL;
     }
-    portEXIT_CRITICAL(&s_keys_lock);
-    return result;
+    key_slot_t *slot = &s_keys[index];
+    if (!slot->in_use || slot->gen != PTHREAD_KEY_GEN(key)) {
+        return NULL;
+    }
+    return slot;
 }
 
 int pthread_key_delete(pthread_key_t key)
@@ -90,14 +140,15 @@ int pthread_key_delete(pthread_key_t key)
 
     portENTER_CRITICAL(&s_keys_lock);
 
-    /* Ideally, we would also walk all tasks' thread local storage value_list here
-       and delete any values associated with this key. We do not do this...
+    /* Values of this key which are still held by threads are not deleted here. They are ignored from
+       now on, because the next key using this slot gets a different generation.
     */
 
-    key_entry_t *entry = find_key(key);
-    if (entry != NULL) {
-        SLIST_REMOVE(&s_keys, entry, key_entry_t_, next);
-        free(entry);
+    key_slot_t *slot = find_key(key);
+    if (slot != NULL) {
+        slot->in_use = false;
+        slot->destructor = NULL;
+        slot->gen = (slot->gen == PTHREAD_KEY_GEN_MAX) ? 1 : slot->gen + 1;
     }
 
     portEXIT_CRITICAL(&s_keys_lock);
@@ -127,23 +178,43 @@ static void pthread_cleanup_thread_specific_data_callback(int index, void *v_tls
     values_list_t *tls = (values_list_t *)v_tls;
     assert(tls != NULL);
 
-    /* Walk the list, freeing all entries and calling destructors if they are registered */
+    /* Walk the values round-robin, clearing them and calling destructors if they are registered, until none are left.
+       A destructor may call pthread_setspecific() to set a new non-NULL value. Continuing after the last cleared
+       value makes sure that the other values are processed before the same key is visited again. The values array
+       can be reallocated by such a call, so it's accessed by index only.
+    */
+    size_t next = 0;
     while (1) {
-        value_entry_t *entry = SLIST_FIRST(tls);
-        if (entry == NULL) {
+        size_t i;
+        size_t n;
+        for (n = 0; n < tls->count; n++) {
+            i = (next + n) % tls->count;
+            if (tls->values[i].key != 0) {
+                break;
+            }
+        }
+        if (n == tls->count) {
             break;
         }
-        SLIST_REMOVE_HEAD(tls, next);
-
-        // This is a little slow, walking the linked list of keys once per value,
-        // but assumes that the thread's value list will have less entries
-        // than the keys list
-        key_entry_t *key = find_key(entry->key);
-        if (key != NULL && key->destructor != NULL) {
-            key->destructor(entry->value);
+        next = i + 1;
+
+        const pthread_key_t key = tls->values[i].key;
+        void *value = tls->values[i].value;
+        tls->values[i].key = 0;
+        tls->values[i].value = NULL;
+
+        pthread_destructor_t destructor = NULL;
+        portENTER_CRITICAL(&s_keys_lock);
+        const key_slot_t *slot = find_key(key);
+        if (slot != NULL) {
+            destructor = slot->destructor;
+        }
+        portEXIT_CRITICAL(&s_keys_lock);
+        if (destructor != NULL) {
+            destructor(value);
         }
-        free(entry);
     }
+    free(tls->values);
     free(tls);
 }
 
@@ -167,17 +238,6 @@ void pthread_internal_local_storage_destructor_callback(TaskHandle_t handle)
     }
 }
 
-static value_entry_t *find_value(const values_list_t *list, pthread_key_t key)
-{
-    value_entry_t *result = NULL;;
-    SLIST_FOREACH(result, list, next) {
-        if(result->key == key) {
-            break;
-        }
-    }
-    return result;
-}
-
 void *pthread_getspecific(pthread_key_t key)
 {
     values_list_t *tls = (values_list_t *) pvTaskGetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX);
@@ -185,22 +245,27 @@ void *pthread_getspecific(pthread_key_t key)
         return NULL;
     }
 
-    value_entry_t *entry = find_value(tls, key);
-    if(entry != NULL) {
-        return entry->value;
+    const size_t index = PTHREAD_KEY_INDEX(key);
+    if (index < tls->count && tls->values[index].key == key) {
+        return tls->values[index].value;
     }
     return NULL;
 }
 
 int pthread_setspecific(pthread_key_t key, const void *value)
 {
-    key_entry_t *key_entry = find_key(key);
-    if (key_entry == NULL) {
+    portENTER_CRITICAL(&s_keys_lock);
+    const key_slot_t *slot = find_key(key);
+    portEXIT_CRITICAL(&s_keys_lock);
+    if (slot == NULL) {
         return ENOENT; // this situation is undefined by pthreads standard
     }
 
     values_list_t *tls = pvTaskGetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX);
     if (tls == NULL) {
+        if (value == NULL) {
+            return 0;
+        }
         tls = calloc(1, sizeof(values_list_t));
         if (tls == NULL) {
             return ENOMEM;
@@ -215,39 +280,33 @@ int pthread_setspecific(pthread_key_t key, const void *value)
 #endif /* CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS */
     }
 
-    value_entry_t *entry = find_value(tls, key);
-    if (entry != NULL) {
-        if (value != NULL) {
-            // cast on next line is necessary as pthreads API uses
-            // 'const void *' here but elsewhere uses 'void *'
-            entry->value = (void *) value;
-        } else { // value == NULL, remove the entry
-            SLIST_REMOVE(tls, entry, value_entry_t_, next);
-            free(entry);
+    const size_t index = PTHREAD_KEY_INDEX(key);
+    if (index >= tls->count) {
+        if (value == NULL) {
+            return 0;
+        }
+        size_t new_count = (tls->count == 0) ? PTHREAD_KEYS_MIN_ALLOC : tls->count;
+        while (new_count <= index) {
+            new_count *= 2;
         }
-    } else if (value != NULL) {
-        entry = malloc(sizeof(value_entry_t));
-        if (entry == NULL) {
+        value_entry_t *values = realloc(tls->values, new_count * sizeof(value_entry_t));
+        if (values == NULL) {
             return ENOMEM;
         }
+        memset(values + tls->count, 0, (new_count - tls->count) * sizeof(value_entry_t));
+        tls->values = values;
+        tls->count = new_count;
+    }
+
+    value_entry_t *entry = &tls->values[index];
+    if (value != NULL) {
         entry->key = key;
-        entry->value = (void *) value; // see note above about cast
-
-        // insert the new entry at the end of the list. this is important because
-        // a destructor may call pthread_setspecific() to add a new non-NULL value
-        // to the list, and this should be processed after all other entries.
-        //
-        // See pthread_cleanup_thread_specific_data_callback()
-        value_entry_t *last_entry = NULL;
-        value_entry_t *it;
-        SLIST_FOREACH(it, tls, next) {
-            last_entry = it;
-        }
-        if (last_entry == NULL) {
-            SLIST_INSERT_HEAD(tls, entry, next);
-        } else {
-            SLIST_INSERT_AFTER(last_entry, entry, next);
-        }
+        // cast on next line is necessary as pthreads API uses
+        // 'const void *' here but elsewhere uses 'void *'
+        entry->value = (void *) value;
+    } else if (entry->key == key) { // value == NULL, remove the entry
+        entry->key = 0;
+        entry->value = NULL;
     }
 
     return 0;
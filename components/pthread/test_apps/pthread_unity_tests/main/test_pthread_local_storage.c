@@ -1,16 +1,18 @@
 /*
- * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
 // Test pthread_create_key, pthread_delete_key, pthread_setspecific, pthread_getspecific
 #include <pthread.h>
 #include <inttypes.h>
+#include <errno.h>
 #include "unity.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "test_utils.h"
 #include "esp_random.h"
+#include "esp_cpu.h"
 
 TEST_CASE("pthread local storage basics", "[thread-specific]")
 {
@@ -256,3 +258,78 @@ static void *s_test_repeat_destructor_thread(void *vp_state)
     }
     pthread_exit(NULL);
 }
+
+#define PERF_NUM_KEYS 32
+#define PERF_NUMITER 10000
+
+static uint32_t measure_getspecific_cycles(pthread_key_t key)
+{
+    void *volatile value;
+    const uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < PERF_NUMITER; i++) {
+        value = pthread_getspecific(key);
+    }
+    const uint32_t cycles = (esp_cpu_get_cycle_count() - start) / PERF_NUMITER;
+    (void) value;
+    return cycles;
+}
+
+static uint32_t measure_setspecific_cycles(pthread_key_t key)
+{
+    const uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < PERF_NUMITER; i++) {
+        pthread_setspecific(key, &key);
+    }
+    return (esp_cpu_get_cycle_count() - start) / PERF_NUMITER;
+}
+
+// Lookup cost must not depend on the number of keys in use
+TEST_CASE("pthread local storage performance", "[thread-specific]")
+{
+    pthread_key_t keys[PERF_NUM_KEYS];
+
+    for (int i = 0; i < PERF_NUM_KEYS; i++) {
+        TEST_ASSERT_EQUAL(0, pthread_key_create(&keys[i], NULL));
+        TEST_ASSERT_EQUAL(0, pthread_setspecific(keys[i], &keys[i]));
+    }
+
+    // Warm up the cache before measuring
+    measure_getspecific_cycles(keys[0]);
+
+    const uint32_t get_first = measure_getspecific_cycles(keys[0]);
+    const uint32_t get_last = measure_getspecific_cycles(keys[PERF_NUM_KEYS - 1]);
+    const uint32_t set_first = measure_setspecific_cycles(keys[0]);
+    const uint32_t set_last = measure_setspecific_cycles(keys[PERF_NUM_KEYS - 1]);
+
+    IDF_LOG_PERFORMANCE("pthread_getspecific", "%"PRIu32" cycles (first key), %"PRIu32" cycles (key %d)",
+                        get_first, get_last, PERF_NUM_KEYS);
+    IDF_LOG_PERFORMANCE("pthread_setspecific", "%"PRIu32" cycles (first key), %"PRIu32" cycles (key %d)",
+                        set_first, set_last, PERF_NUM_KEYS);
+    TEST_ASSERT_LESS_THAN(get_first * 2 + 10, get_last);
+    TEST_ASSERT_LESS_THAN(set_first * 2 + 10, set_last);
+
+    for (int i = 0; i < PERF_NUM_KEYS; i++) {
+        TEST_ASSERT_EQUAL(0, pthread_setspecific(keys[i], NULL));
+        TEST_ASSERT_NULL(pthread_getspecific(keys[i]));
+        TEST_ASSERT_EQUAL(0, pthread_key_delete(keys[i]));
+    }
+}
+
+TEST_CASE("pthread local storage deleted key is not reused", "[thread-specific]")
+{
+    pthread_key_t key;
+    pthread_key_t new_key;
+    int val = 3;
+
+    TEST_ASSERT_EQUAL(0, pthread_key_create(&key, NULL));
+    TEST_ASSERT_EQUAL(0, pthread_setspecific(key, &val));
+    TEST_ASSERT_EQUAL(0, pthread_key_delete(key));
+
+    // A new key may take the place of the deleted one, but must not see its value
+    TEST_ASSERT_EQUAL(0, pthread_key_create(&new_key, NULL));
+    TEST_ASSERT_NOT_EQUAL(key, new_key);
+    TEST_ASSERT_NULL(pthread_getspecific(new_key));
+    TEST_ASSERT_EQUAL(ENOENT, pthread_setspecific(key, &val));
+
+    TEST_ASSERT_EQUAL(0, pthread_key_delete(new_key));
+}
@@ -22,6 +22,7 @@
 #include "esp_vfs.h"
 #include "esp_err.h"
 #include "esp_rom_spiflash.h"
+#include "esp_timer.h"
 
 #include "spiffs_api.h"
 
@@ -58,6 +59,7 @@ static ssize_t vfs_spiffs_read(void* ctx, int fd, void * dst, size_t size);
 static int vfs_spiffs_close(void* ctx, int fd);
 static off_t vfs_spiffs_lseek(void* ctx, int fd, off_t offset, int mode);
 static int vfs_spiffs_fstat(void* ctx, int fd, struct stat * st);
+static int vfs_spiffs_fsync(void* ctx, int fd);
 #ifdef CONFIG_VFS_SUPPORT_DIR
 static int vfs_spiffs_stat(void* ctx, const char * path, struct stat * st);
 static int vfs_spiffs_unlink(void* ctx, const char *path);
@@ -83,6 +85,75 @@ static time_t vfs_spiffs_get_mtime(const spiffs_stat* s);
 
 static esp_spiffs_t * _efs[CONFIG_SPIFFS_MAX_PARTITIONS];
 
+#define SPIFFS_GC_DEFAULT_INTERVAL_MS 1000
+
+static void esp_spiffs_gc_task(void *arg)
+{
+    esp_spiffs_t *efs = (esp_spiffs_t *)arg;
+    while (!efs->gc_task_stop) {
+        /* Woken up early only to exit */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(efs->gc_interval_ms));
+        if (efs->gc_task_stop) {
+            break;
+        }
+        uint32_t reclaimed = 0;
+        const int64_t start = esp_timer_get_time();
+        s32_t res = spiffs_api_gc_step(efs->fs, efs->gc_free_watermark, efs->gc_budget, &reclaimed);
+        const uint32_t time_us = (uint32_t)(esp_timer_get_time() - start);
+
+        xSemaphoreTake(efs->lock, portMAX_DELAY);
+        if (res != SPIFFS_OK) {
+            efs->gc_stats.failed_runs++;
+        } else if (reclaimed > 0) {
+            efs->gc_stats.runs++;
+            efs->gc_stats.reclaimed_bytes += reclaimed;
+            efs->gc_stats.total_time_us += time_us;
+        }
+        if (time_us > efs->gc_stats.max_time_us) {
+            efs->gc_stats.max_time_us = time_us;
+        }
+        xSemaphoreGive(efs->lock);
+        if (res != SPIFFS_OK) {
+            ESP_LOGW(TAG, "background GC failed (%" PRId32 ")", res);
+        } else if (reclaimed > 0) {
+            ESP_LOGD(TAG, "background GC reclaimed %" PRIu32 " bytes in %" PRIu32 " us", reclaimed, time_us);
+        }
+    }
+    xSemaphoreGive(efs->gc_task_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t esp_spiffs_gc_task_start(esp_spiffs_t *efs, const esp_vfs_spiffs_conf_t *conf)
+{
+    efs->gc_free_watermark = conf->gc_free_watermark;
+    efs->gc_interval_ms = conf->gc_interval_ms ? conf->gc_interval_ms : SPIFFS_GC_DEFAULT_INTERVAL_MS;
+    efs->gc_budget = conf->gc_budget ? conf->gc_budget : efs->cfg.phys_erase_block;
+    efs->gc_task_done = xSemaphoreCreateBinary();
+    if (efs->gc_task_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(esp_spiffs_gc_task, "spiffs_gc", CONFIG_SPIFFS_GC_TASK_STACK_SIZE, efs,
+                    CONFIG_SPIFFS_GC_TASK_PRIORITY, &efs->gc_task) != pdPASS) {
+        efs->gc_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void esp_spiffs_gc_task_stop(esp_spiffs_t *efs)
+{
+    if (efs->gc_task) {
+        efs->gc_task_stop = true;
+        xTaskNotifyGive(efs->gc_task);
+        xSemaphoreTake(efs->gc_task_done, portMAX_DELAY);
+        efs->gc_task = NULL;
+    }
+    if (efs->gc_task_done) {
+        vSemaphoreDelete(efs->gc_task_done);
+        efs->gc_task_done = NULL;
+    }
+}
+
 static void esp_spiffs_free(esp_spiffs_t ** efs)
 {
     esp_spiffs_t * e = *efs;
@@ -91,11 +162,22 @@ static void esp_spiffs_free(esp_spiffs_t ** efs)
     }
     *efs = NULL;
 
+    esp_spiffs_gc_task_stop(e);
+
     if (e->fs) {
         SPIFFS_unmount(e->fs);
         free(e->fs);
     }
     vSemaphoreDelete(e->lock);
+    if (e->fd_bufs) {
+        for (uint32_t i = 0; i < e->fd_buf_count; i++) {
+            free(e->fd_bufs[i].data);
+        }
+        free(e->fd_bufs);
+    }
+    if (e->fd_buf_lock) {
+        vSemaphoreDelete(e->fd_buf_lock);
+    }
     free(e->fds);
     free(e->cache);
     free(e->work);
@@ -235,6 +317,18 @@ static esp_err_t esp_spiffs_init(const esp_vfs_spiffs_conf_t* conf)
         return ESP_ERR_NO_MEM;
     }
 
+    if (conf->fd_buffer_size > 0) {
+        efs->fd_buf_count = conf->max_files;
+        efs->fd_buf_size = conf->fd_buffer_size;
+        efs->fd_bufs = calloc(efs->fd_buf_count, sizeof(spiffs_fd_buf_t));
+        efs->fd_buf_lock = xSemaphoreCreateMutex();
+        if (efs->fd_bufs == NULL || efs->fd_buf_lock == NULL) {
+            ESP_LOGE(TAG, "file buffers could not be allocated");
+            esp_spiffs_free(&efs);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
 #if SPIFFS_CACHE
     efs->cache_sz = sizeof(spiffs_cache) + conf->max_files * (sizeof(spiffs_cache_page)
                           + efs->cfg.log_page_size);
@@ -399,6 +493,21 @@ esp_err_t esp_spiffs_gc(const char* partition_label, size_t size_to_gc)
     return ESP_OK;
 }
 
+esp_err_t esp_spiffs_gc_get_stats(const char* partition_label, esp_spiffs_gc_stats_t *stats)
+{
+    int index;
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (esp_spiffs_by_label(partition_label, &index) != ESP_OK || _efs[index]->gc_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(_efs[index]->lock, portMAX_DELAY);
+    *stats = _efs[index]->gc_stats;
+    xSemaphoreGive(_efs[index]->lock);
+    return ESP_OK;
+}
+
 esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t * conf)
 {
     assert(conf->base_path);
@@ -410,6 +519,7 @@ esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t * conf)
         .open_p = &vfs_spiffs_open,
         .close_p = &vfs_spiffs_close,
         .fstat_p = &vfs_spiffs_fstat,
+        .fsync_p = &vfs_spiffs_fsync,
 #ifdef CONFIG_VFS_SUPPORT_DIR
         .stat_p = &vfs_spiffs_stat,
         .link_p = &vfs_spiffs_link,
@@ -450,6 +560,16 @@ esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t * conf)
         return err;
     }
 
+    if (conf->gc_free_watermark > 0) {
+        err = esp_spiffs_gc_task_start(_efs[index], conf);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "background GC task could not be created");
+            esp_vfs_unregister(conf->base_path);
+            esp_spiffs_free(&_efs[index]);
+            return err;
+        }
+    }
+
     return ESP_OK;
 }
 
@@ -526,6 +646,29 @@ static int spiffs_mode_conv(int m)
     return res;
 }
 
+/* Returns the buffer of an open file, or NULL if the file is not buffered */
+static spiffs_fd_buf_t *vfs_spiffs_get_fd_buf(esp_spiffs_t *efs, int fd)
+{
+    if (efs->fd_bufs == NULL || fd < 1 || (uint32_t)fd > efs->fd_buf_count) {
+        return NULL;
+    }
+    spiffs_fd_buf_t *buf = &efs->fd_bufs[fd - 1];
+    return buf->data ? buf : NULL;
+}
+
+/* Passes the buffered state of the file to SPIFFS, before operations which bypass the buffer */
+static s32_t vfs_spiffs_flush_fd_buf(esp_spiffs_t *efs, int fd)
+{
+    spiffs_fd_buf_t *buf = vfs_spiffs_get_fd_buf(efs, fd);
+    if (buf == NULL) {
+        return SPIFFS_OK;
+    }
+    xSemaphoreTake(efs->fd_buf_lock, portMAX_DELAY);
+    s32_t res = spiffs_fd_buf_flush(efs->fs, fd, buf);
+    xSemaphoreGive(efs->fd_buf_lock);
+    return res;
+}
+
 static int vfs_spiffs_open(void* ctx, const char * path, int flags, int mode)
 {
     assert(path);
@@ -540,13 +683,30 @@ static int vfs_spiffs_open(void* ctx, const char * path, int flags, int mode)
     if (!(spiffs_flags & SPIFFS_RDONLY)) {
         vfs_spiffs_update_mtime(efs->fs, fd);
     }
+    if (efs->fd_bufs && fd >= 1 && (uint32_t)fd <= efs->fd_buf_count) {
+        /* Left over if the file system was formatted while the file was open */
+        free(efs->fd_bufs[fd - 1].data);
+        uint8_t *data = malloc(efs->fd_buf_size);
+        if (data == NULL) {
+            ESP_LOGW(TAG, "no memory for the buffer of %s, access is unbuffered", path);
+        }
+        spiffs_fd_buf_init(&efs->fd_bufs[fd - 1], data, efs->fd_buf_size);
+    }
     return fd;
 }
 
 static ssize_t vfs_spiffs_write(void* ctx, int fd, const void * data, size_t size)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    ssize_t res = SPIFFS_write(efs->fs, fd, (void *)data, size);
+    spiffs_fd_buf_t *buf = vfs_spiffs_get_fd_buf(efs, fd);
+    ssize_t res;
+    if (buf) {
+        xSemaphoreTake(efs->fd_buf_lock, portMAX_DELAY);
+        res = spiffs_fd_buf_write(efs->fs, fd, buf, data, size);
+        xSemaphoreGive(efs->fd_buf_lock);
+    } else {
+        res = SPIFFS_write(efs->fs, fd, (void *)data, size);
+    }
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -558,7 +718,15 @@ static ssize_t vfs_spiffs_write(void* ctx, int fd, const void * data, size_t siz
 static ssize_t vfs_spiffs_read(void* ctx, int fd, void * dst, size_t size)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    ssize_t res = SPIFFS_read(efs->fs, fd, dst, size);
+    spiffs_fd_buf_t *buf = vfs_spiffs_get_fd_buf(efs, fd);
+    ssize_t res;
+    if (buf) {
+        xSemaphoreTake(efs->fd_buf_lock, portMAX_DELAY);
+        res = spiffs_fd_buf_read(efs->fs, fd, buf, dst, size);
+        xSemaphoreGive(efs->fd_buf_lock);
+    } else {
+        res = SPIFFS_read(efs->fs, fd, dst, size);
+    }
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -570,6 +738,21 @@ static ssize_t vfs_spiffs_read(void* ctx, int fd, void * dst, size_t size)
 static int vfs_spiffs_close(void* ctx, int fd)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
+    spiffs_fd_buf_t *buf = vfs_spiffs_get_fd_buf(efs, fd);
+    if (buf) {
+        xSemaphoreTake(efs->fd_buf_lock, portMAX_DELAY);
+        s32_t flush_res = spiffs_fd_buf_flush(efs->fs, fd, buf);
+        free(buf->data);
+        buf->data = NULL;
+        xSemaphoreGive(efs->fd_buf_lock);
+        if (flush_res < 0) {
+            /* The file is closed anyway, report the error of the buffered data */
+            errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
+            SPIFFS_clearerr(efs->fs);
+            (void)SPIFFS_close(efs->fs, fd);
+            return -1;
+        }
+    }
     int res = SPIFFS_close(efs->fs, fd);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
@@ -582,7 +765,15 @@ static int vfs_spiffs_close(void* ctx, int fd)
 static off_t vfs_spiffs_lseek(void* ctx, int fd, off_t offset, int mode)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    off_t res = SPIFFS_lseek(efs->fs, fd, offset, mode);
+    spiffs_fd_buf_t *buf = vfs_spiffs_get_fd_buf(efs, fd);
+    off_t res;
+    if (buf) {
+        xSemaphoreTake(efs->fd_buf_lock, portMAX_DELAY);
+        res = spiffs_fd_buf_lseek(efs->fs, fd, buf, offset, mode);
+        xSemaphoreGive(efs->fd_buf_lock);
+    } else {
+        res = SPIFFS_lseek(efs->fs, fd, offset, mode);
+    }
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -596,7 +787,10 @@ static int vfs_spiffs_fstat(void* ctx, int fd, struct stat * st)
     assert(st);
     spiffs_stat s;
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    off_t res = SPIFFS_fstat(efs->fs, fd, &s);
+    off_t res = vfs_spiffs_flush_fd_buf(efs, fd);
+    if (res >= 0) {
+        res = SPIFFS_fstat(efs->fs, fd, &s);
+    }
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -611,6 +805,21 @@ static int vfs_spiffs_fstat(void* ctx, int fd, struct stat * st)
     return res;
 }
 
+static int vfs_spiffs_fsync(void* ctx, int fd)
+{
+    esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
+    int res = vfs_spiffs_flush_fd_buf(efs, fd);
+    if (res >= 0) {
+        res = SPIFFS_fflush(efs->fs, fd);
+    }
+    if (res < 0) {
+        errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
+        SPIFFS_clearerr(efs->fs);
+        return -1;
+    }
+    return 0;
+}
+
 #ifdef CONFIG_VFS_SUPPORT_DIR
 
 static int vfs_spiffs_stat(void* ctx, const char * path, struct stat * st)
@@ -827,7 +1036,10 @@ err:
 static int vfs_spiffs_ftruncate(void* ctx, int fd, off_t length)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    int res = SPIFFS_ftruncate(efs->fs, fd, length);
+    int res = vfs_spiffs_flush_fd_buf(efs, fd);
+    if (res >= 0) {
+        res = SPIFFS_ftruncate(efs->fs, fd, length);
+    }
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
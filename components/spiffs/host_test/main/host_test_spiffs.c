@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -17,9 +18,11 @@
 #include "Mockqueue.h"
 
 #include "esp_partition.h"
+#include "esp_private/partition_linux.h"
 #include "spiffs.h"
 #include "spiffs_nucleus.h"
 #include "spiffs_api.h"
+#include "spiffs_fd_buf.h"
 
 #include "unity.h"
 #include "unity_fixture.h"
@@ -273,10 +276,193 @@ TEST(spiffs, can_read_spiffs_image)
     deinit_spiffs(&fs);
 }
 
+#define TEST_FILE_SIZE      (32 * 1024)
+#define TEST_CHUNK_SIZE     16
+#define TEST_FD_BUF_SIZE    4096
+
+/* Writes the file in small chunks, through buf if it is not NULL */
+static void write_in_chunks(spiffs *fs, const char *name, const uint8_t *data, spiffs_fd_buf_t *buf)
+{
+    spiffs_file fd = SPIFFS_open(fs, name, SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR, 0);
+    TEST_ASSERT_TRUE(fd >= SPIFFS_OK);
+    for (size_t pos = 0; pos < TEST_FILE_SIZE; pos += TEST_CHUNK_SIZE) {
+        s32_t res = buf ? spiffs_fd_buf_write(fs, fd, buf, data + pos, TEST_CHUNK_SIZE)
+                    : SPIFFS_write(fs, fd, (void *)(data + pos), TEST_CHUNK_SIZE);
+        TEST_ASSERT_EQUAL(TEST_CHUNK_SIZE, res);
+    }
+    if (buf) {
+        TEST_ASSERT_EQUAL(SPIFFS_OK, spiffs_fd_buf_flush(fs, fd, buf));
+    }
+    TEST_ASSERT_EQUAL(SPIFFS_OK, SPIFFS_close(fs, fd));
+}
+
+/* Reads the file in small chunks, through buf if it is not NULL, and compares it to data */
+static void read_in_chunks(spiffs *fs, const char *name, const uint8_t *data, spiffs_fd_buf_t *buf)
+{
+    uint8_t chunk[TEST_CHUNK_SIZE];
+    spiffs_file fd = SPIFFS_open(fs, name, SPIFFS_O_RDONLY, 0);
+    TEST_ASSERT_TRUE(fd >= SPIFFS_OK);
+    for (size_t pos = 0; pos < TEST_FILE_SIZE; pos += TEST_CHUNK_SIZE) {
+        s32_t res = buf ? spiffs_fd_buf_read(fs, fd, buf, chunk, TEST_CHUNK_SIZE)
+                    : SPIFFS_read(fs, fd, chunk, TEST_CHUNK_SIZE);
+        TEST_ASSERT_EQUAL(TEST_CHUNK_SIZE, res);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(data + pos, chunk, TEST_CHUNK_SIZE);
+    }
+    s32_t res = buf ? spiffs_fd_buf_read(fs, fd, buf, chunk, TEST_CHUNK_SIZE)
+                : SPIFFS_read(fs, fd, chunk, TEST_CHUNK_SIZE);
+    TEST_ASSERT_EQUAL(0, res);
+    if (buf) {
+        TEST_ASSERT_EQUAL(SPIFFS_OK, spiffs_fd_buf_flush(fs, fd, buf));
+    }
+    TEST_ASSERT_EQUAL(SPIFFS_OK, SPIFFS_close(fs, fd));
+}
+
+TEST(spiffs, fd_buffer_reduces_flash_operations)
+{
+    spiffs fs;
+    init_spiffs(&fs, 5);
+
+    uint8_t *data = (uint8_t *) malloc(TEST_FILE_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    for (size_t i = 0; i < TEST_FILE_SIZE; i++) {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    spiffs_fd_buf_t buf;
+    uint8_t *buf_mem = (uint8_t *) malloc(TEST_FD_BUF_SIZE);
+    TEST_ASSERT_NOT_NULL(buf_mem);
+    spiffs_fd_buf_init(&buf, buf_mem, TEST_FD_BUF_SIZE);
+
+    esp_partition_clear_stats();
+    write_in_chunks(&fs, "unbuffered.bin", data, NULL);
+    size_t unbuffered_write_ops = esp_partition_get_read_ops() + esp_partition_get_write_ops();
+
+    esp_partition_clear_stats();
+    write_in_chunks(&fs, "buffered.bin", data, &buf);
+    size_t buffered_write_ops = esp_partition_get_read_ops() + esp_partition_get_write_ops();
+
+    esp_partition_clear_stats();
+    read_in_chunks(&fs, "unbuffered.bin", data, NULL);
+    size_t unbuffered_read_ops = esp_partition_get_read_ops();
+
+    esp_partition_clear_stats();
+    read_in_chunks(&fs, "buffered.bin", data, &buf);
+    size_t buffered_read_ops = esp_partition_get_read_ops();
+
+    printf("%d bytes in %d byte chunks, flash operations unbuffered/buffered: write %zu/%zu, read %zu/%zu\n",
+           TEST_FILE_SIZE, TEST_CHUNK_SIZE, unbuffered_write_ops, buffered_write_ops,
+           unbuffered_read_ops, buffered_read_ops);
+    TEST_ASSERT_LESS_THAN(unbuffered_write_ops, buffered_write_ops);
+    TEST_ASSERT_LESS_THAN(unbuffered_read_ops, buffered_read_ops);
+
+    free(buf_mem);
+    free(data);
+    deinit_spiffs(&fs);
+}
+
+TEST(spiffs, fd_buffer_keeps_file_position)
+{
+    spiffs fs;
+    init_spiffs(&fs, 5);
+
+    uint8_t buf_mem[64];
+    spiffs_fd_buf_t buf;
+    spiffs_fd_buf_init(&buf, buf_mem, sizeof(buf_mem));
+    char out[16] = { 0 };
+
+    spiffs_file fd = SPIFFS_open(&fs, "position.txt", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR, 0);
+    TEST_ASSERT_TRUE(fd >= SPIFFS_OK);
+    TEST_ASSERT_EQUAL(10, spiffs_fd_buf_write(&fs, fd, &buf, "0123456789", 10));
+    TEST_ASSERT_EQUAL(6, spiffs_fd_buf_write(&fs, fd, &buf, "abcdef", 6));
+
+    // pending writes are flushed before seeking, the file position follows the buffered data
+    TEST_ASSERT_EQUAL(2, spiffs_fd_buf_lseek(&fs, fd, &buf, 2, SPIFFS_SEEK_SET));
+    TEST_ASSERT_EQUAL(4, spiffs_fd_buf_read(&fs, fd, &buf, out, 4));
+    TEST_ASSERT_EQUAL_STRING_LEN("2345", out, 4);
+
+    // seeks inside the read-ahead data
+    TEST_ASSERT_EQUAL(12, spiffs_fd_buf_lseek(&fs, fd, &buf, 6, SPIFFS_SEEK_CUR));
+    TEST_ASSERT_EQUAL(2, spiffs_fd_buf_read(&fs, fd, &buf, out, 2));
+    TEST_ASSERT_EQUAL_STRING_LEN("cd", out, 2);
+    TEST_ASSERT_EQUAL(0, spiffs_fd_buf_lseek(&fs, fd, &buf, 0, SPIFFS_SEEK_SET));
+    TEST_ASSERT_EQUAL(1, spiffs_fd_buf_read(&fs, fd, &buf, out, 1));
+    TEST_ASSERT_EQUAL('0', out[0]);
+
+    // a write after reading ahead goes to the application's position
+    TEST_ASSERT_EQUAL(2, spiffs_fd_buf_write(&fs, fd, &buf, "XY", 2));
+    TEST_ASSERT_EQUAL(SPIFFS_OK, spiffs_fd_buf_flush(&fs, fd, &buf));
+    TEST_ASSERT_EQUAL(3, SPIFFS_tell(&fs, fd));
+    TEST_ASSERT_EQUAL(16, spiffs_fd_buf_lseek(&fs, fd, &buf, 0, SPIFFS_SEEK_END));
+    TEST_ASSERT_EQUAL(0, spiffs_fd_buf_lseek(&fs, fd, &buf, 0, SPIFFS_SEEK_SET));
+    TEST_ASSERT_EQUAL(16, spiffs_fd_buf_read(&fs, fd, &buf, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING_LEN("0XY3456789abcdef", out, 16);
+
+    TEST_ASSERT_EQUAL(SPIFFS_OK, spiffs_fd_buf_flush(&fs, fd, &buf));
+    TEST_ASSERT_EQUAL(SPIFFS_OK, SPIFFS_close(&fs, fd));
+    deinit_spiffs(&fs);
+}
+
+static void write_file(spiffs *fs, const char *name, size_t size)
+{
+    static uint8_t chunk[4096];
+    memset(chunk, 0x5A, sizeof(chunk));
+    spiffs_file fd = SPIFFS_open(fs, name, SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR, 0);
+    TEST_ASSERT_TRUE(fd >= SPIFFS_OK);
+    for (size_t pos = 0; pos < size; pos += sizeof(chunk)) {
+        TEST_ASSERT_EQUAL(sizeof(chunk), SPIFFS_write(fs, fd, chunk, sizeof(chunk)));
+    }
+    TEST_ASSERT_EQUAL(SPIFFS_OK, SPIFFS_close(fs, fd));
+}
+
+TEST(spiffs, gc_step_reclaims_deleted_space_ahead_of_writes)
+{
+    spiffs fs;
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "storage");
+    TEST_ASSERT_NOT_NULL(partition);
+    TEST_ESP_OK(esp_partition_erase_range(partition, 0, partition->size));
+    init_spiffs(&fs, 5);
+
+    // A log file which has been rotated away leaves deleted pages behind
+    write_file(&fs, "old.log", 1024 * 1024);
+    write_file(&fs, "keep.log", 256 * 1024);
+    TEST_ASSERT_EQUAL(SPIFFS_OK, SPIFFS_remove(&fs, "old.log"));
+
+    const uint32_t watermark = 1200 * 1024;
+    const uint32_t free_before = spiffs_api_free_bytes(&fs);
+    TEST_ASSERT_LESS_THAN(watermark, free_before);
+
+    // Steps run until the watermark is reached, then do nothing
+    uint32_t reclaimed_total = 0;
+    int steps = 0;
+    esp_partition_clear_stats();
+    for (; steps < 1000; steps++) {
+        uint32_t reclaimed;
+        TEST_ASSERT_EQUAL(SPIFFS_OK, spiffs_api_gc_step(&fs, watermark, 4096, &reclaimed));
+        if (reclaimed == 0) {
+            break;
+        }
+        reclaimed_total += reclaimed;
+    }
+    const uint32_t gc_erase_ops = esp_partition_get_erase_ops();
+    TEST_ASSERT_GREATER_OR_EQUAL(watermark, spiffs_api_free_bytes(&fs));
+    TEST_ASSERT_EQUAL(spiffs_api_free_bytes(&fs) - free_before, reclaimed_total);
+
+    // Writes up to the reclaimed space don't have to collect garbage themselves
+    esp_partition_clear_stats();
+    write_file(&fs, "new.log", 768 * 1024);
+    printf("background GC: %d steps reclaimed %" PRIu32 " bytes with %zu erases, following write: %zu erases\n",
+           steps, reclaimed_total, (size_t)gc_erase_ops, (size_t)esp_partition_get_erase_ops());
+    TEST_ASSERT_EQUAL(0, esp_partition_get_erase_ops());
+
+    deinit_spiffs(&fs);
+}
+
 TEST_GROUP_RUNNER(spiffs)
 {
     RUN_TEST_CASE(spiffs, format_disk_open_file_write_and_read_file);
     RUN_TEST_CASE(spiffs, can_read_spiffs_image);
+    RUN_TEST_CASE(spiffs, fd_buffer_reduces_flash_operations);
+    RUN_TEST_CASE(spiffs, fd_buffer_keeps_file_position);
+    RUN_TEST_CASE(spiffs, gc_step_reclaims_deleted_space_ahead_of_writes);
 }
 
 static void run_all_tests(void)
@@ -22,8 +22,34 @@ typedef struct {
         const char* partition_label;    /*!< Optional, label of SPIFFS partition to use. If set to NULL, first partition with subtype=spiffs will be used. */
         size_t max_files;               /*!< Maximum files that could be open at the same time. */
         bool format_if_mount_failed;    /*!< If true, it will format the file system if it fails to mount. */
+        size_t fd_buffer_size;          /*!< Optional, size of the read-ahead and write-coalescing buffer allocated for
+                                             each open file. Small reads are then served from data read ahead, and small
+                                             writes are passed to SPIFFS only when the buffer is full, or on fsync(),
+                                             close() and other operations on the file. Errors of buffered writes are
+                                             reported by these calls. 0 disables buffering. */
+        size_t gc_free_watermark;       /*!< Optional, enables background garbage collection. A low priority task
+                                             reclaims the space of deleted data while less than this number of bytes
+                                             can be written without garbage collection, so that writes rarely have to
+                                             collect garbage themselves. 0 disables the task. */
+        uint32_t gc_interval_ms;        /*!< Background GC: minimum time between two runs in milliseconds.
+                                             0 selects 1000 ms. */
+        size_t gc_budget;               /*!< Background GC: maximum number of bytes reclaimed by one run. Each run also
+                                             stops after CONFIG_SPIFFS_GC_MAX_RUNS erased blocks. 0 selects one
+                                             flash sector. */
 } esp_vfs_spiffs_conf_t;
 
+/**
+ * @brief Statistics of the background garbage collection
+ */
+typedef struct {
+        uint32_t runs;                  /*!< Number of background runs which reclaimed space */
+        uint32_t failed_runs;           /*!< Number of background runs which failed */
+        uint64_t reclaimed_bytes;       /*!< Free space gained by background runs */
+        uint64_t total_time_us;         /*!< Time spent in background runs which reclaimed space */
+        uint32_t max_time_us;           /*!< Longest background run */
+        uint32_t foreground_erased_blocks;  /*!< Blocks erased by other tasks, mostly by garbage collection inside writes */
+} esp_spiffs_gc_stats_t;
+
 /**
  * Register and mount SPIFFS to VFS with given path prefix.
  *
@@ -124,6 +150,19 @@ esp_err_t esp_spiffs_check(const char* partition_label);
  */
 esp_err_t esp_spiffs_gc(const char* partition_label, size_t size_to_gc);
 
+/**
+ * @brief Get the statistics of the background garbage collection
+ *
+ * @param partition_label  Label of the partition, the partition must be mounted with
+ *                         esp_vfs_spiffs_register and esp_vfs_spiffs_conf_t::gc_free_watermark set
+ * @param[out] stats       Statistics since the partition was mounted
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_INVALID_ARG if stats is NULL
+ *          - ESP_ERR_INVALID_STATE if the partition is not mounted or background GC is disabled
+ */
+esp_err_t esp_spiffs_gc_get_stats(const char* partition_label, esp_spiffs_gc_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,6 +9,7 @@
 #include "esp_partition.h"
 #include "esp_spiffs.h"
 #include "spiffs_api.h"
+#include "spiffs_nucleus.h"
 
 static const char* TAG = "SPIFFS";
 
@@ -46,6 +47,10 @@ s32_t spiffs_api_write(spiffs *fs, uint32_t addr, uint32_t size, uint8_t *src)
 
 s32_t spiffs_api_erase(spiffs *fs, uint32_t addr, uint32_t size)
 {
+    esp_spiffs_t *efs = (esp_spiffs_t *)(fs->user_data);
+    if (efs->gc_task != NULL && xTaskGetCurrentTaskHandle() != efs->gc_task) {
+        efs->gc_stats.foreground_erased_blocks += size / efs->cfg.phys_erase_block;
+    }
     esp_err_t err = esp_partition_erase_range(((esp_spiffs_t *)(fs->user_data))->partition,
                                         addr, size);
     if (err) {
@@ -82,3 +87,49 @@ void spiffs_api_check(spiffs *fs, spiffs_check_type type,
                               spiffs_check_report_str[report], arg1, arg2);
     }
 }
+
+uint32_t spiffs_api_free_bytes(spiffs *fs)
+{
+    spiffs_api_lock(fs);
+    const int32_t free_pages = (SPIFFS_PAGES_PER_BLOCK(fs) - SPIFFS_OBJ_LOOKUP_PAGES(fs)) * (fs->block_count - 2)
+                               - fs->stats_p_allocated - fs->stats_p_deleted;
+    spiffs_api_unlock(fs);
+    return (free_pages > 0) ? free_pages * SPIFFS_DATA_PAGE_SIZE(fs) : 0;
+}
+
+s32_t spiffs_api_gc_step(spiffs *fs, uint32_t free_watermark, uint32_t budget, uint32_t *reclaimed)
+{
+    *reclaimed = 0;
+    if (!SPIFFS_mounted(fs)) {
+        return SPIFFS_OK;
+    }
+    spiffs_api_lock(fs);
+    const uint32_t deleted_bytes = fs->stats_p_deleted * SPIFFS_DATA_PAGE_SIZE(fs);
+    spiffs_api_unlock(fs);
+    const uint32_t free_before = spiffs_api_free_bytes(fs);
+    if (free_before >= free_watermark || deleted_bytes == 0) {
+        return SPIFFS_OK;
+    }
+
+    // Cheap case first: a block with nothing but deleted pages only has to be erased
+    s32_t res = SPIFFS_gc_quick(fs, 0);
+    if (res == SPIFFS_ERR_NO_DELETED_BLOCKS) {
+        SPIFFS_clearerr(fs);
+        /* SPIFFS_gc() collects until the requested size is free. Ask for no more than the deleted
+         * data, as further runs would only move used pages around. */
+        const uint32_t to_reclaim = (budget < deleted_bytes) ? budget : deleted_bytes;
+        res = SPIFFS_gc(fs, free_before + to_reclaim);
+        if (res == SPIFFS_ERR_FULL) {
+            // Could not reclaim everything within CONFIG_SPIFFS_GC_MAX_RUNS, the next step continues
+            SPIFFS_clearerr(fs);
+            res = SPIFFS_OK;
+        }
+    }
+    if (res != SPIFFS_OK) {
+        SPIFFS_clearerr(fs);
+        return res;
+    }
+    const uint32_t free_after = spiffs_api_free_bytes(fs);
+    *reclaimed = (free_after > free_before) ? free_after - free_before : 0;
+    return SPIFFS_OK;
+}
@@ -12,6 +12,8 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "spiffs.h"
+#include "spiffs_fd_buf.h"
+#include "esp_spiffs.h"
 #include "esp_compiler.h"
 
 #ifdef __cplusplus
@@ -35,6 +37,17 @@ typedef struct {
     uint32_t fds_sz;                        /*!< File Descriptor Buffer Length */
     uint8_t *cache;                         /*!< Cache Buffer */
     uint32_t cache_sz;                      /*!< Cache Buffer Length */
+    spiffs_fd_buf_t *fd_bufs;               /*!< Read-ahead and write buffers, one per file handle, NULL if disabled */
+    uint32_t fd_buf_count;                  /*!< Number of elements in fd_bufs */
+    uint32_t fd_buf_size;                   /*!< Size of the buffer allocated for each open file */
+    SemaphoreHandle_t fd_buf_lock;          /*!< Serializes access to fd_bufs */
+    TaskHandle_t gc_task;                   /*!< Background GC task, NULL if disabled */
+    SemaphoreHandle_t gc_task_done;         /*!< Given by the background GC task when it exits */
+    volatile bool gc_task_stop;             /*!< Requests the background GC task to exit */
+    uint32_t gc_free_watermark;             /*!< Background GC: free space below which garbage is collected */
+    uint32_t gc_interval_ms;                /*!< Background GC: minimum time between runs */
+    uint32_t gc_budget;                     /*!< Background GC: maximum bytes reclaimed per run */
+    esp_spiffs_gc_stats_t gc_stats;         /*!< Background GC statistics */
 } esp_spiffs_t;
 
 s32_t spiffs_api_read(spiffs *fs, uint32_t addr, uint32_t size, uint8_t *dst);
@@ -46,6 +59,30 @@ s32_t spiffs_api_erase(spiffs *fs, uint32_t addr, uint32_t size);
 void spiffs_api_check(spiffs *fs, spiffs_check_type type,
                             spiffs_check_report report, uint32_t arg1, uint32_t arg2);
 
+/**
+ * @brief Space which can be written without garbage collection, in bytes
+ *
+ * Counts the free pages in the file system. Pages of deleted data are not included, they
+ * become free only when the garbage collector erases their blocks.
+ */
+uint32_t spiffs_api_free_bytes(spiffs *fs);
+
+/**
+ * @brief One step of background garbage collection
+ *
+ * Does nothing if at least free_watermark bytes are free, or if there is no deleted data.
+ * Otherwise erases one block which contains only deleted pages if there is such a block.
+ * If not, runs SPIFFS_gc() to reclaim up to budget bytes of deleted pages.
+ *
+ * @param fs             SPIFFS instance
+ * @param free_watermark Free space in bytes below which garbage is collected
+ * @param budget         Maximum number of bytes to reclaim with SPIFFS_gc()
+ * @param[out] reclaimed Free space gained by this step, in bytes
+ *
+ * @return SPIFFS_OK, or SPIFFS error code
+ */
+s32_t spiffs_api_gc_step(spiffs *fs, uint32_t free_watermark, uint32_t budget, uint32_t *reclaimed);
+
 #ifdef __cplusplus
 }
 #endif
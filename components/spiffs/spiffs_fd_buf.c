@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "spiffs_fd_buf.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+void spiffs_fd_buf_init(spiffs_fd_buf_t *buf, uint8_t *data, uint32_t size)
+{
+    memset(buf, 0, sizeof(*buf));
+    buf->data = data;
+    buf->size = size;
+}
+
+static void spiffs_fd_buf_reset(spiffs_fd_buf_t *buf)
+{
+    buf->len = 0;
+    buf->rd_pos = 0;
+    buf->dirty = false;
+}
+
+s32_t spiffs_fd_buf_flush(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf)
+{
+    s32_t res = SPIFFS_OK;
+    if (buf->dirty) {
+        res = SPIFFS_write(fs, fh, buf->data, buf->len);
+    } else if (buf->rd_pos < buf->len) {
+        // SPIFFS is ahead of the application by the unread part of the read-ahead data
+        res = SPIFFS_lseek(fs, fh, buf->file_pos + buf->rd_pos, SPIFFS_SEEK_SET);
+    }
+    // On errors the pending data is dropped, as it would have been by a failed unbuffered write
+    spiffs_fd_buf_reset(buf);
+    return (res < 0) ? res : SPIFFS_OK;
+}
+
+s32_t spiffs_fd_buf_read(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf, void *dst, s32_t len)
+{
+    if (buf->dirty) {
+        s32_t res = spiffs_fd_buf_flush(fs, fh, buf);
+        if (res < 0) {
+            return res;
+        }
+    }
+
+    uint8_t *out = (uint8_t *) dst;
+    s32_t done = 0;
+    while (done < len) {
+        const uint32_t avail = buf->len - buf->rd_pos;
+        if (avail > 0) {
+            const uint32_t n = MIN(avail, (uint32_t)(len - done));
+            memcpy(out + done, buf->data + buf->rd_pos, n);
+            buf->rd_pos += n;
+            done += n;
+            continue;
+        }
+
+        // The buffer is used up, so the SPIFFS file offset is the application's position again
+        spiffs_fd_buf_reset(buf);
+        // Large reads don't benefit from the buffer
+        const bool direct = ((uint32_t)(len - done) >= buf->size);
+        s32_t pos = 0;
+        s32_t res;
+        if (direct) {
+            res = SPIFFS_read(fs, fh, out + done, len - done);
+        } else {
+            pos = SPIFFS_tell(fs, fh);
+            res = (pos < 0) ? pos : SPIFFS_read(fs, fh, buf->data, buf->size);
+        }
+        if (res < 0) {
+            if (done == 0) {
+                return res;
+            }
+            // Report the data read so far, the error shows up again on the next call
+            SPIFFS_clearerr(fs);
+            break;
+        }
+        if (direct) {
+            done += res;
+            break;
+        }
+        if (res == 0) {
+            // end of file
+            break;
+        }
+        buf->file_pos = pos;
+        buf->len = res;
+    }
+    return done;
+}
+
+s32_t spiffs_fd_buf_write(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf, const void *src, s32_t len)
+{
+    if (len == 0) {
+        return 0;
+    }
+    // Drop read-ahead data, or make room for the new data
+    if ((!buf->dirty && buf->len > 0) || buf->len + (uint32_t)len > buf->size) {
+        s32_t res = spiffs_fd_buf_flush(fs, fh, buf);
+        if (res < 0) {
+            return res;
+        }
+    }
+    if ((uint32_t)len >= buf->size) {
+        return SPIFFS_write(fs, fh, (void *) src, len);
+    }
+    memcpy(buf->data + buf->len, src, len);
+    buf->len += len;
+    buf->dirty = true;
+    return len;
+}
+
+s32_t spiffs_fd_buf_lseek(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf, s32_t offs, int whence)
+{
+    if (!buf->dirty && buf->len > 0 && whence != SPIFFS_SEEK_END) {
+        const s32_t cur = buf->file_pos + buf->rd_pos;
+        const s32_t target = (whence == SPIFFS_SEEK_CUR) ? cur + offs : offs;
+        if (target >= (s32_t) buf->file_pos && target <= (s32_t)(buf->file_pos + buf->len)) {
+            buf->rd_pos = target - buf->file_pos;
+            return target;
+        }
+    }
+    s32_t res = spiffs_fd_buf_flush(fs, fh, buf);
+    if (res < 0) {
+        return res;
+    }
+    return SPIFFS_lseek(fs, fh, offs, whence);
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "spiffs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Read-ahead and write-coalescing buffer of one open SPIFFS file
+ *
+ * The buffer either holds data read ahead of the file position, or data written by the
+ * application which has not been passed to SPIFFS yet, never both. While it holds read-ahead
+ * data, the SPIFFS file offset is file_pos + len and the application's file position is
+ * file_pos + rd_pos. While it holds pending writes, the application's file position is the
+ * SPIFFS file offset + len.
+ *
+ * The functions return the same values as the SPIFFS functions they replace; on error,
+ * SPIFFS_errno() is set. Accesses to one buffer have to be serialized by the caller.
+ */
+typedef struct {
+    uint8_t *data;      /*!< Buffer memory */
+    uint32_t size;      /*!< Size of the buffer memory */
+    uint32_t len;       /*!< Number of valid bytes in data */
+    uint32_t rd_pos;    /*!< Read-ahead: offset in data of the next byte to return */
+    uint32_t file_pos;  /*!< Read-ahead: file offset of data[0] */
+    bool dirty;         /*!< data holds pending writes */
+} spiffs_fd_buf_t;
+
+/**
+ * @brief Initialize an empty buffer using the given memory
+ */
+void spiffs_fd_buf_init(spiffs_fd_buf_t *buf, uint8_t *data, uint32_t size);
+
+/**
+ * @brief Read from the file, served from the read-ahead data when possible
+ */
+s32_t spiffs_fd_buf_read(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf, void *dst, s32_t len);
+
+/**
+ * @brief Write to the file, coalescing small writes until the buffer is full
+ */
+s32_t spiffs_fd_buf_write(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf, const void *src, s32_t len);
+
+/**
+ * @brief Move the file position; seeks inside the read-ahead data keep the buffer
+ */
+s32_t spiffs_fd_buf_lseek(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf, s32_t offs, int whence);
+
+/**
+ * @brief Write pending data and drop read-ahead data, so that SPIFFS sees the file as the application does
+ *
+ * Has to be called before any other operation on the file which does not go through the buffer.
+ *
+ * @return SPIFFS_OK or SPIFFS error code
+ */
+s32_t spiffs_fd_buf_flush(spiffs *fs, spiffs_file fh, spiffs_fd_buf_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
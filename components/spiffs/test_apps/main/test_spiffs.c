@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
 #include <time.h>
 #include <fcntl.h>
@@ -574,6 +575,19 @@ static void test_setup(void)
     TEST_ESP_OK(esp_vfs_spiffs_register(&conf));
 }
 
+static void test_setup_buffered(void)
+{
+    esp_vfs_spiffs_conf_t conf = {
+      .base_path = "/spiffs",
+      .partition_label = spiffs_test_partition_label,
+      .max_files = 5,
+      .format_if_mount_failed = true,
+      .fd_buffer_size = 512
+    };
+
+    TEST_ESP_OK(esp_vfs_spiffs_register(&conf));
+}
+
 static void test_teardown(void)
 {
     TEST_ESP_OK(esp_vfs_spiffs_unregister(spiffs_test_partition_label));
@@ -709,6 +723,42 @@ TEST_CASE("ftruncate a file", "[spiffs]")
     test_teardown();
 }
 
+TEST_CASE("buffered file access", "[spiffs]")
+{
+    test_setup_buffered();
+    test_spiffs_overwrite_append("/spiffs/hello.txt");
+    test_spiffs_lseek("/spiffs/seek.txt");
+    test_spiffs_ftruncate("/spiffs/ftrunc.txt");
+
+    /* Small writes stay in the buffer until fsync() */
+    const char* filename = "/spiffs/buffered.txt";
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL(10, write(fd, "0123456789", 10));
+    }
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, stat(filename, &st));
+    TEST_ASSERT_LESS_THAN(1000, st.st_size);
+    TEST_ASSERT_EQUAL(0, fsync(fd));
+    TEST_ASSERT_EQUAL(0, stat(filename, &st));
+    TEST_ASSERT_EQUAL(1000, st.st_size);
+
+    /* Small reads are served from the read-ahead data */
+    TEST_ASSERT_EQUAL(995, lseek(fd, 995, SEEK_SET));
+    char buf[10] = { 0 };
+    TEST_ASSERT_EQUAL(5, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING_LEN("56789", buf, 5);
+    TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_SET));
+    for (int i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL(10, read(fd, buf, 10));
+        TEST_ASSERT_EQUAL_STRING_LEN("0123456789", buf, 10);
+    }
+    TEST_ASSERT_EQUAL(0, read(fd, buf, 10));
+    TEST_ASSERT_EQUAL(0, close(fd));
+    test_teardown();
+}
+
 TEST_CASE("can opendir root directory of FS", "[spiffs]")
 {
     test_setup();
@@ -925,3 +975,55 @@ TEST_CASE("SPIFFS garbage-collect", "[spiffs][timeout=60]")
 
     test_teardown();
 }
+
+TEST_CASE("SPIFFS background garbage collection", "[spiffs][timeout=60]")
+{
+    const esp_partition_t* part = get_partition();
+    esp_partition_erase_range(part, 0, part->size);
+    esp_vfs_spiffs_conf_t conf = {
+      .base_path = "/spiffs",
+      .partition_label = spiffs_test_partition_label,
+      .max_files = 5,
+      .format_if_mount_failed = true,
+      .gc_free_watermark = part->size / 2,
+      .gc_interval_ms = 10,
+    };
+    TEST_ESP_OK(esp_vfs_spiffs_register(&conf));
+
+    esp_spiffs_gc_stats_t stats;
+    TEST_ESP_ERR(ESP_ERR_INVALID_ARG, esp_spiffs_gc_get_stats(spiffs_test_partition_label, NULL));
+    TEST_ESP_OK(esp_spiffs_gc_get_stats(spiffs_test_partition_label, &stats));
+    TEST_ASSERT_EQUAL(0, stats.runs);
+
+    /* Leave deleted data behind, until less than the watermark is free */
+    const size_t buf_size = 4096;
+    void *buf = calloc(1, buf_size);
+    TEST_ASSERT_NOT_NULL(buf);
+    const char* filename = "/spiffs/gc.bin";
+    FILE* f = fopen(filename, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    for (size_t written = 0; written < part->size / 2; written += buf_size) {
+        TEST_ASSERT_EQUAL(buf_size, fwrite(buf, 1, buf_size, f));
+    }
+    TEST_ASSERT_EQUAL(0, fclose(f));
+    TEST_ASSERT_EQUAL(0, unlink(filename));
+
+    /* The background task reclaims the space of the deleted file */
+    for (int i = 0; i < 500 && stats.reclaimed_bytes < part->size / 4; i++) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        TEST_ESP_OK(esp_spiffs_gc_get_stats(spiffs_test_partition_label, &stats));
+    }
+    printf("background GC: %" PRIu32 " runs, %" PRIu64 " bytes reclaimed in %" PRIu64 " us (max %" PRIu32 " us), "
+           "%" PRIu32 " blocks erased by other tasks\n", stats.runs, stats.reclaimed_bytes, stats.total_time_us,
+           stats.max_time_us, stats.foreground_erased_blocks);
+    TEST_ASSERT_GREATER_THAN(0, stats.runs);
+    TEST_ASSERT_EQUAL(0, stats.failed_runs);
+    TEST_ASSERT_GREATER_OR_EQUAL(part->size / 4, stats.reclaimed_bytes);
+
+    free(buf);
+    test_teardown();
+    /* Mounting without the watermark doesn't start the task */
+    test_setup();
+    TEST_ESP_ERR(ESP_ERR_INVALID_STATE, esp_spiffs_gc_get_stats(spiffs_test_partition_label, &stats));
+    test_teardown();
+}
@@ -26,6 +26,7 @@ typedef struct esp_transport_keepalive {
 
 typedef struct esp_transport_list_t* esp_transport_list_handle_t;
 typedef struct esp_transport_item_t* esp_transport_handle_t;
+typedef struct esp_transport_conn* esp_transport_conn_handle_t;
 
 typedef int (*connect_func)(esp_transport_handle_t t, const char *host, int port, int timeout_ms);
 typedef int (*io_func)(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms);
@@ -244,6 +245,15 @@ int esp_transport_poll_write(esp_transport_handle_t t, int timeout_ms);
  */
 int esp_transport_close(esp_transport_handle_t t);
 
+/**
+ * @brief      Close and free a connection detached from a transport
+ *
+ * @note       Connections are detached with esp_transport_tcp_detach_conn() or esp_transport_ssl_detach_conn()
+ *
+ * @param      conn  The connection handle, may be NULL
+ */
+void esp_transport_conn_destroy(esp_transport_conn_handle_t conn);
+
 /**
  * @brief      Get user data context of this transport
  *
@@ -193,6 +193,39 @@ void esp_transport_ssl_set_keep_alive(esp_transport_handle_t t, esp_transport_ke
  */
 void esp_transport_ssl_set_interface_name(esp_transport_handle_t t, struct ifreq *if_name);
 
+/**
+ * @brief      Detach the established connection from the SSL transport
+ *
+ *             The TLS session and its socket are kept open and the transport goes back to the
+ *             disconnected state, as if it was closed. The connection can be attached to another
+ *             SSL transport with esp_transport_ssl_attach_conn(), or closed with esp_transport_conn_destroy().
+ *
+ * @param      t     ssl transport
+ *
+ * @return
+ *      - Connection handle
+ *      - NULL if the transport is not connected or in case of errors
+ */
+esp_transport_conn_handle_t esp_transport_ssl_detach_conn(esp_transport_handle_t t);
+
+/**
+ * @brief      Attach a connection detached from another SSL transport
+ *
+ *             On success, the transport takes ownership of the connection and is in the connected state.
+ *
+ * @note       The server was verified with the configuration of the transport which opened the connection,
+ *             so it should only be attached to a transport with the same configuration.
+ *
+ * @param      t     ssl transport, must not be connected
+ * @param      conn  The connection handle
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the connection was not detached from a SSL transport
+ *      - ESP_ERR_INVALID_STATE if the transport is already connected
+ */
+esp_err_t esp_transport_ssl_attach_conn(esp_transport_handle_t t, esp_transport_conn_handle_t conn);
+
 #ifdef __cplusplus
 }
 #endif
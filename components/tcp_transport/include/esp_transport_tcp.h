@@ -40,6 +40,36 @@ void esp_transport_tcp_set_interface_name(esp_transport_handle_t t, struct ifreq
  */
 esp_transport_handle_t esp_transport_tcp_init(void);
 
+/**
+ * @brief      Detach the established connection from the TCP transport
+ *
+ *             The socket is left open and the transport goes back to the disconnected state,
+ *             as if it was closed. The connection can be attached to another TCP transport
+ *             with esp_transport_tcp_attach_conn(), or closed with esp_transport_conn_destroy().
+ *
+ * @param[in]  t     The transport handle
+ *
+ * @return
+ *      - Connection handle
+ *      - NULL if the transport is not connected or in case of errors
+ */
+esp_transport_conn_handle_t esp_transport_tcp_detach_conn(esp_transport_handle_t t);
+
+/**
+ * @brief      Attach a connection detached from another TCP transport
+ *
+ *             On success, the transport takes ownership of the connection and is in the connected state.
+ *
+ * @param[in]  t     The transport handle, must not be connected
+ * @param[in]  conn  The connection handle
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the connection was not detached from a TCP transport
+ *      - ESP_ERR_INVALID_STATE if the transport is already connected
+ */
+esp_err_t esp_transport_tcp_attach_conn(esp_transport_handle_t t, esp_transport_conn_handle_t conn);
+
 
 #ifdef __cplusplus
 }
@@ -40,6 +40,15 @@ typedef struct transport_esp_tls {
     int                      sockfd;
 } transport_esp_tls_t;
 
+/**
+ *  Connection detached from an esp-tls based transport
+ */
+struct esp_transport_conn {
+    esp_tls_t                *tls;          /*!< esp-tls connection, NULL for plain TCP connections opened synchronously */
+    int                      sockfd;
+    bool                     is_plain_tcp;
+};
+
 /**
  * @brief      Destroys esp-tls transport used in the foundation transport
  *
@@ -524,6 +533,73 @@ esp_transport_handle_t esp_transport_tcp_init(void)
     return tcp_transport;
 }
 
+static esp_transport_conn_handle_t base_detach_conn(esp_transport_handle_t t)
+{
+    transport_esp_tls_t *ssl = ssl_get_context_data(t);
+    if (!ssl || ssl->sockfd < 0 || ssl->conn_state == TRANS_SSL_CONNECTING) {
+        return NULL;
+    }
+    esp_transport_conn_handle_t conn = calloc(1, sizeof(struct esp_transport_conn));
+    ESP_TRANSPORT_MEM_CHECK(TAG, conn, return NULL);
+    conn->tls = ssl->ssl_initialized ? ssl->tls : NULL;
+    conn->sockfd = ssl->sockfd;
+    conn->is_plain_tcp = ssl->cfg.is_plain_tcp;
+    ssl->tls = NULL;
+    ssl->conn_state = TRANS_SSL_INIT;
+    ssl->ssl_initialized = false;
+    ssl->sockfd = INVALID_SOCKET;
+    return conn;
+}
+
+static esp_err_t base_attach_conn(esp_transport_handle_t t, esp_transport_conn_handle_t conn)
+{
+    transport_esp_tls_t *ssl = ssl_get_context_data(t);
+    if (!ssl || !conn || conn->is_plain_tcp != ssl->cfg.is_plain_tcp) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ssl->ssl_initialized || ssl->sockfd >= 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ssl->tls = conn->tls;
+    ssl->ssl_initialized = conn->tls != NULL;
+    ssl->sockfd = conn->sockfd;
+    free(conn);
+    return ESP_OK;
+}
+
+esp_transport_conn_handle_t esp_transport_ssl_detach_conn(esp_transport_handle_t t)
+{
+    return base_detach_conn(t);
+}
+
+esp_err_t esp_transport_ssl_attach_conn(esp_transport_handle_t t, esp_transport_conn_handle_t conn)
+{
+    return base_attach_conn(t, conn);
+}
+
+esp_transport_conn_handle_t esp_transport_tcp_detach_conn(esp_transport_handle_t t)
+{
+    return base_detach_conn(t);
+}
+
+esp_err_t esp_transport_tcp_attach_conn(esp_transport_handle_t t, esp_transport_conn_handle_t conn)
+{
+    return base_attach_conn(t, conn);
+}
+
+void esp_transport_conn_destroy(esp_transport_conn_handle_t conn)
+{
+    if (!conn) {
+        return;
+    }
+    if (conn->tls) {
+        esp_tls_conn_destroy(conn->tls);
+    } else if (conn->sockfd >= 0) {
+        close(conn->sockfd);
+    }
+    free(conn);
+}
+
 void esp_transport_tcp_set_keep_alive(esp_transport_handle_t t, esp_transport_keep_alive_t *keep_alive_cfg)
 {
     return esp_transport_ssl_set_keep_alive(t, keep_alive_cfg);
@@ -22,6 +22,7 @@
 #include <sys/termios.h>
 #include <sys/poll.h>
 #include <sys/dirent.h>
+#include <sys/uio.h>
 #include <string.h>
 #include "sdkconfig.h"
 
@@ -68,6 +69,22 @@ typedef struct
     void *sem;              /*!< semaphore instance */
 } esp_vfs_select_sem_t;
 
+/**
+ * @brief Persistent readiness watch of one FD in a poll set, see esp_vfs_poll.h
+ *
+ * The VFS passes the watch to poll_attach of the driver. Until poll_detach is called, the driver
+ * calls esp_vfs_poll_watch_notify() for the watch whenever the FD may have become ready or was
+ * closed. The driver can use the prev and next members to keep the watches of an FD in a list;
+ * the other members belong to the VFS.
+ */
+typedef struct esp_vfs_poll_watch {
+    struct esp_vfs_poll_watch *prev;        /*!< Driver use: previous watch of the same FD */
+    struct esp_vfs_poll_watch *next;        /*!< Driver use: next watch of the same FD */
+    void *set;                              /*!< Poll set of the watch */
+    struct esp_vfs_poll_watch *next_ready;  /*!< Next watch in the ready list of the poll set */
+    bool queued;                            /*!< The watch is in the ready list of the poll set */
+} esp_vfs_poll_watch_t;
+
 /**
  * @brief VFS definition structure
  *
@@ -247,7 +264,21 @@ typedef struct
     void* (*get_socket_select_semaphore)(void);
     /** get_socket_select_semaphore returns semaphore allocated in the socket driver; set only for the socket driver */
     esp_err_t (*end_select)(void *end_select_args);
+    /** poll_attach is called when an FD of this VFS is added to a poll set; the driver keeps the watch until poll_detach */
+    esp_err_t (*poll_attach)(int fd, esp_vfs_poll_watch_t *watch);
+    /** poll_detach is called when the FD is removed from the poll set */
+    void (*poll_detach)(int fd, esp_vfs_poll_watch_t *watch);
+    /** poll_revents returns the events (POLLIN, POLLOUT, POLLERR, POLLHUP or POLLNVAL) which are currently signalled for the FD */
+    uint32_t (*poll_revents)(int fd);
 #endif // CONFIG_VFS_SUPPORT_SELECT || defined __DOXYGEN__
+    union {
+        ssize_t (*readv_p)(void *ctx, int fd, const struct iovec *iov, int iovcnt);                  /*!< readv with context pointer */
+        ssize_t (*readv)(int fd, const struct iovec *iov, int iovcnt);                               /*!< readv without context pointer */
+    };
+    union {
+        ssize_t (*writev_p)(void *ctx, int fd, const struct iovec *iov, int iovcnt);                 /*!< writev with context pointer */
+        ssize_t (*writev)(int fd, const struct iovec *iov, int iovcnt);                              /*!< writev without context pointer */
+    };
 } esp_vfs_t;
 
 /**
@@ -435,6 +466,24 @@ void esp_vfs_select_triggered(esp_vfs_select_sem_t sem);
  */
 void esp_vfs_select_triggered_isr(esp_vfs_select_sem_t sem, BaseType_t *woken);
 
+/**
+ * @brief Notification from a VFS driver that the FD of a poll set watch may have become ready
+ *
+ * The VFS checks the actual state with poll_revents of the driver in the next wait of the poll set,
+ * so spurious notifications are harmless.
+ *
+ * @param watch watch which was passed to the driver by poll_attach
+ */
+void esp_vfs_poll_watch_notify(esp_vfs_poll_watch_t *watch);
+
+/**
+ * @brief Notification from a VFS driver that the FD of a poll set watch may have become ready, from an ISR
+ *
+ * @param watch watch which was passed to the driver by poll_attach
+ * @param woken is set to pdTRUE if the function wakes up a task with higher priority
+ */
+void esp_vfs_poll_watch_notify_isr(esp_vfs_poll_watch_t *watch, BaseType_t *woken);
+
 /**
  *
  * @brief Implements the VFS layer of POSIX pread()
@@ -463,6 +512,38 @@ ssize_t esp_vfs_pread(int fd, void *dst, size_t size, off_t offset);
  */
 ssize_t esp_vfs_pwrite(int fd, const void *src, size_t size, off_t offset);
 
+/**
+ *
+ * @brief Implements the VFS layer of POSIX readv()
+ *
+ * If the driver does not provide readv, the buffers are filled one by one with its read function,
+ * stopping at the first short read.
+ *
+ * @param fd         File descriptor used for read
+ * @param iov        Array of buffers to fill, in order
+ * @param iovcnt     Number of elements in iov
+ *
+ * @return           A positive return value indicates the number of bytes read. -1 is return on failure and errno is
+ *                   set accordingly.
+ */
+ssize_t esp_vfs_readv(int fd, const struct iovec *iov, int iovcnt);
+
+/**
+ *
+ * @brief Implements the VFS layer of POSIX writev()
+ *
+ * If the driver does not provide writev, the buffers are written one by one with its write function,
+ * stopping at the first short write.
+ *
+ * @param fd         File descriptor used for write
+ * @param iov        Array of buffers to write, in order
+ * @param iovcnt     Number of elements in iov
+ *
+ * @return           A positive return value indicates the number of bytes written. -1 is return on failure and errno is
+ *                   set accordingly.
+ */
+ssize_t esp_vfs_writev(int fd, const struct iovec *iov, int iovcnt);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
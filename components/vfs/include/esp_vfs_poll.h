@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/poll.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file esp_vfs_poll.h
+ *
+ * @brief Poll sets: persistent readiness monitoring of file descriptors
+ *
+ * Unlike select() and poll(), which pass all file descriptors to all drivers on every call,
+ * a poll set keeps the registered file descriptors between waits (similar to epoll on Linux).
+ * Drivers notify the set when a file descriptor may have become ready, so a wait only checks
+ * these file descriptors and reports only ready ones.
+ *
+ * Readiness is level-triggered: a file descriptor is reported by every wait for as long as
+ * it stays ready.
+ *
+ * Supported file descriptors:
+ *  - file descriptors of drivers implementing poll_attach, poll_detach and poll_revents
+ *    (e.g. eventfd)
+ *  - sockets of the socket driver (lwIP). Waits call socket_select of the driver only with
+ *    the sockets of the set, using fd_sets maintained by esp_vfs_poll_set_add() and
+ *    esp_vfs_poll_set_remove(). lwIP does not notify the set about individual sockets, so
+ *    a wait still takes time proportional to the number of sockets in the set.
+ *
+ * File descriptors have to be removed from the set before they are closed.
+ */
+
+/**
+ * @brief Opaque poll set handle
+ */
+typedef struct esp_vfs_poll_set *esp_vfs_poll_set_handle_t;
+
+/**
+ * @brief Ready file descriptor reported by esp_vfs_poll_set_wait()
+ */
+typedef struct {
+    int fd;             /*!< File descriptor */
+    uint32_t revents;   /*!< Signalled events: POLLIN, POLLOUT, and always reported POLLERR, POLLHUP and POLLNVAL */
+    void *user_data;    /*!< User data given to esp_vfs_poll_set_add() or esp_vfs_poll_set_modify() */
+} esp_vfs_poll_event_t;
+
+/**
+ * @brief Create a poll set
+ *
+ * @param[out] out_set Created poll set
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: out_set is NULL
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ *    - ESP_ERR_NOT_SUPPORTED: CONFIG_VFS_SUPPORT_SELECT is disabled
+ */
+esp_err_t esp_vfs_poll_set_create(esp_vfs_poll_set_handle_t *out_set);
+
+/**
+ * @brief Add a file descriptor to the poll set
+ *
+ * @param set Poll set
+ * @param fd File descriptor
+ * @param events Events to wait for, POLLIN and/or POLLOUT
+ * @param user_data Reported together with the events of fd
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid set or fd, or fd is already in the set
+ *    - ESP_ERR_NOT_SUPPORTED: The driver of fd doesn't support poll sets, or CONFIG_VFS_SUPPORT_SELECT is disabled
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ *    - Errors returned by poll_attach of the driver
+ */
+esp_err_t esp_vfs_poll_set_add(esp_vfs_poll_set_handle_t set, int fd, uint32_t events, void *user_data);
+
+/**
+ * @brief Change the events and user data of a file descriptor in the poll set
+ *
+ * @param set Poll set
+ * @param fd File descriptor
+ * @param events Events to wait for, POLLIN and/or POLLOUT
+ * @param user_data Reported together with the events of fd
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid set
+ *    - ESP_ERR_NOT_FOUND: fd is not in the set
+ *    - ESP_ERR_NOT_SUPPORTED: CONFIG_VFS_SUPPORT_SELECT is disabled
+ */
+esp_err_t esp_vfs_poll_set_modify(esp_vfs_poll_set_handle_t set, int fd, uint32_t events, void *user_data);
+
+/**
+ * @brief Remove a file descriptor from the poll set
+ *
+ * @param set Poll set
+ * @param fd File descriptor
+ *
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid set
+ *    - ESP_ERR_NOT_FOUND: fd is not in the set
+ *    - ESP_ERR_NOT_SUPPORTED: CONFIG_VFS_SUPPORT_SELECT is disabled
+ */
+esp_err_t esp_vfs_poll_set_remove(esp_vfs_poll_set_handle_t set, int fd);
+
+/**
+ * @brief Wait until file descriptors of the poll set are ready
+ *
+ * Only one task may wait on a poll set at a time. File descriptors can be added, modified and
+ * removed by other tasks during the wait.
+ *
+ * @param set Poll set
+ * @param[out] events Ready file descriptors
+ * @param max_events Size of events
+ * @param timeout_ms Timeout in milliseconds, 0 to return immediately, -1 to wait forever
+ *
+ * @return Number of ready file descriptors stored in events, 0 on timeout, or -1 with errno set
+ *         (EINVAL for invalid arguments, ENOSYS if CONFIG_VFS_SUPPORT_SELECT is disabled)
+ */
+int esp_vfs_poll_set_wait(esp_vfs_poll_set_handle_t set, esp_vfs_poll_event_t *events, int max_events, int timeout_ms);
+
+/**
+ * @brief Delete the poll set
+ *
+ * The file descriptors in the set are not closed.
+ *
+ * @param set Poll set, may be NULL
+ */
+void esp_vfs_poll_set_delete(esp_vfs_poll_set_handle_t set);
+
+#ifdef __cplusplus
+}
+#endif
@@ -96,6 +96,16 @@ const vfs_entry_t *get_vfs_for_path(const char *path);
  */
 const vfs_entry_t *get_vfs_for_index(int index);
 
+/**
+ * Get vfs entry and local fd of a global fd.
+ *
+ * @param fd Global file descriptor
+ * @param local_fd Set to the file descriptor within the VFS, or -1
+ *
+ * @return Pointer to the `vfs_entry_t` of fd, or NULL if fd is not valid.
+ */
+const vfs_entry_t *get_vfs_for_fd(int fd, int *local_fd);
+
 #ifdef __cplusplus
 }
 #endif
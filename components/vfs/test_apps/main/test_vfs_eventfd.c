@@ -11,6 +11,7 @@
 #include "driver/gptimer.h"
 #include "esp_vfs.h"
 #include "esp_vfs_eventfd.h"
+#include "esp_vfs_poll.h"
 
 TEST_CASE("eventfd create and close", "[vfs][eventfd]")
 {
@@ -349,3 +350,58 @@ TEST_CASE("eventfd multiple selects", "[vfs][eventfd]")
     TEST_ASSERT_EQUAL(0, close(fd));
     TEST_ESP_OK(esp_vfs_eventfd_unregister());
 }
+
+TEST_CASE("eventfd poll set", "[vfs][eventfd]")
+{
+    esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&config));
+
+    int fd0 = eventfd(0, 0);
+    int fd1 = eventfd(0, EFD_SUPPORT_ISR);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd1);
+
+    esp_vfs_poll_set_handle_t set;
+    TEST_ESP_OK(esp_vfs_poll_set_create(&set));
+    TEST_ESP_OK(esp_vfs_poll_set_add(set, fd0, POLLIN, &fd0));
+    TEST_ESP_OK(esp_vfs_poll_set_add(set, fd1, POLLIN, &fd1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_vfs_poll_set_add(set, fd0, POLLIN, NULL));
+
+    esp_vfs_poll_event_t events[2];
+    // nothing is ready
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_set_wait(set, events, 2, 0));
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_set_wait(set, events, 2, 100));
+
+    // signalled by another task during the wait
+    xTaskCreate(signal_task, "signal_task", 2048, &fd0, 5, NULL);
+    TEST_ASSERT_EQUAL(1, esp_vfs_poll_set_wait(set, events, 2, 2000));
+    TEST_ASSERT_EQUAL(fd0, events[0].fd);
+    TEST_ASSERT_EQUAL(POLLIN, events[0].revents);
+    TEST_ASSERT_EQUAL_PTR(&fd0, events[0].user_data);
+
+    // level-triggered: reported again until read
+    TEST_ASSERT_EQUAL(1, esp_vfs_poll_set_wait(set, events, 2, 0));
+    TEST_ASSERT_EQUAL(fd0, events[0].fd);
+    uint64_t val = 1;
+    TEST_ASSERT_EQUAL(sizeof(val), read(fd0, &val, sizeof(val)));
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_set_wait(set, events, 2, 0));
+
+    // POLLOUT is always reported once requested
+    TEST_ESP_OK(esp_vfs_poll_set_modify(set, fd1, POLLIN | POLLOUT, NULL));
+    TEST_ASSERT_EQUAL(1, esp_vfs_poll_set_wait(set, events, 2, 0));
+    TEST_ASSERT_EQUAL(fd1, events[0].fd);
+    TEST_ASSERT_EQUAL(POLLOUT, events[0].revents);
+    TEST_ESP_OK(esp_vfs_poll_set_modify(set, fd1, POLLIN, NULL));
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_set_wait(set, events, 2, 0));
+
+    // removed fds are not reported
+    TEST_ASSERT_EQUAL(sizeof(val), write(fd1, &val, sizeof(val)));
+    TEST_ESP_OK(esp_vfs_poll_set_remove(set, fd1));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, esp_vfs_poll_set_remove(set, fd1));
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_set_wait(set, events, 2, 0));
+
+    esp_vfs_poll_set_delete(set);
+    TEST_ASSERT_EQUAL(0, close(fd0));
+    TEST_ASSERT_EQUAL(0, close(fd1));
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
@@ -9,6 +9,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/fcntl.h>
+#include <sys/uio.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -259,6 +261,130 @@ TEST_CASE("Open & write & close through VFS passes performance test", "[vfs]")
 
 }
 
+/* Accepts at most 8 bytes per call, so that the fallback has to stop at a short write */
+static char s_vector_test_buf[32];
+static size_t s_vector_test_len;
+
+static ssize_t vector_test_vfs_write(int fd, const void *data, size_t size)
+{
+    size = MIN(size, 8);
+    size = MIN(size, sizeof(s_vector_test_buf) - s_vector_test_len);
+    memcpy(s_vector_test_buf + s_vector_test_len, data, size);
+    s_vector_test_len += size;
+    return size;
+}
+
+static ssize_t vector_test_vfs_read(int fd, void *dst, size_t size)
+{
+    size = MIN(size, s_vector_test_len);
+    memcpy(dst, s_vector_test_buf, size);
+    memmove(s_vector_test_buf, s_vector_test_buf + size, s_vector_test_len - size);
+    s_vector_test_len -= size;
+    return size;
+}
+
+TEST_CASE("VFS readv and writev fall back to read and write", "[vfs]")
+{
+    esp_vfs_t desc = {
+        .flags = ESP_VFS_FLAG_DEFAULT,
+        .open = time_test_vfs_open,
+        .close = time_test_vfs_close,
+        .write = vector_test_vfs_write,
+        .read = vector_test_vfs_read,
+    };
+    TEST_ESP_OK( esp_vfs_register(VFS_PREF1, &desc, NULL) );
+    const int fd = open(VFS_PREF1 FILE1, 0, 0);
+    TEST_ASSERT_NOT_EQUAL(fd, -1);
+
+    s_vector_test_len = 0;
+    struct iovec wr_iov[] = {
+        { .iov_base = "head:", .iov_len = 5 },
+        { .iov_base = "", .iov_len = 0 },
+        { .iov_base = "body", .iov_len = 4 },
+    };
+    TEST_ASSERT_EQUAL(9, writev(fd, wr_iov, 3));
+    /* "0123456789" is written only partially, the last buffer is not written */
+    struct iovec short_iov[] = {
+        { .iov_base = "0123456789", .iov_len = 10 },
+        { .iov_base = "xyz", .iov_len = 3 },
+    };
+    TEST_ASSERT_EQUAL(8, writev(fd, short_iov, 2));
+    TEST_ASSERT_EQUAL(17, s_vector_test_len);
+
+    char a[5] = { 0 };
+    char b[16] = { 0 };
+    struct iovec rd_iov[] = {
+        { .iov_base = a, .iov_len = sizeof(a) - 1 },
+        { .iov_base = b, .iov_len = sizeof(b) - 1 },
+    };
+    TEST_ASSERT_EQUAL(17, readv(fd, rd_iov, 2));
+    TEST_ASSERT_EQUAL_STRING("head", a);
+    TEST_ASSERT_EQUAL_STRING(":body01234567", b);
+
+    errno = 0;
+    TEST_ASSERT_EQUAL(-1, writev(fd, wr_iov, -1));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+
+    TEST_ASSERT_NOT_EQUAL(close(fd), -1);
+    TEST_ESP_OK( esp_vfs_unregister(VFS_PREF1) );
+}
+
+static const char *const s_mount_prefixes[] = {
+    "/dev", "/dev/uart", "/dev/console", "/spiffs", "/sdcard", "/data", "/host", "/eventfd", "/log", "/log/archive",
+};
+
+TEST_CASE("VFS path and FD lookup with many mount points", "[vfs]")
+{
+    esp_vfs_t desc = {
+        .flags = ESP_VFS_FLAG_DEFAULT,
+        .open = time_test_vfs_open,
+        .close = time_test_vfs_close,
+        .write = time_test_vfs_write,
+    };
+    const size_t mount_count = sizeof(s_mount_prefixes) / sizeof(s_mount_prefixes[0]);
+    for (size_t i = 0; i < mount_count; ++i) {
+        TEST_ESP_OK( esp_vfs_register(s_mount_prefixes[i], &desc, NULL) );
+    }
+
+    const int iter_count = 5000;
+
+    /* "/log/file1" has to skip the longer "/log/archive" prefix, "/dev/uart/0" must not stop at "/dev" */
+    const char *paths[] = { "/log" FILE1, "/dev/uart/0", "/data" FILE1 };
+    for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); ++p) {
+        ccomp_timer_start();
+        for (int i = 0; i < iter_count; ++i) {
+            const int fd = open(paths[p], 0, 0);
+            TEST_ASSERT_NOT_EQUAL(fd, -1);
+            TEST_ASSERT_NOT_EQUAL(close(fd), -1);
+        }
+        const int64_t time_diff_us = ccomp_timer_stop();
+        printf("open & close of %s with %d mount points: %d ns\n", paths[p], (int) mount_count,
+               (int) (time_diff_us * 1000 / iter_count));
+    }
+
+    const int fd = open("/log" FILE1, 0, 0);
+    TEST_ASSERT_NOT_EQUAL(fd, -1);
+    ccomp_timer_start();
+    for (int i = 0; i < iter_count; ++i) {
+        TEST_ASSERT_EQUAL(1, write(fd, "a", 1));
+    }
+    const int64_t time_diff_us = ccomp_timer_stop();
+    printf("write through FD: %d ns\n", (int) (time_diff_us * 1000 / iter_count));
+    TEST_ASSERT_NOT_EQUAL(close(fd), -1);
+
+    /* The lookup table is rebuilt on unregistration */
+    TEST_ESP_OK( esp_vfs_unregister("/log/archive") );
+    const int fd2 = open("/log/archive" FILE1, 0, 0);
+    TEST_ASSERT_NOT_EQUAL(fd2, -1);
+    TEST_ASSERT_NOT_EQUAL(close(fd2), -1);
+
+    for (size_t i = 0; i < mount_count; ++i) {
+        if (strcmp(s_mount_prefixes[i], "/log/archive") != 0) {
+            TEST_ESP_OK( esp_vfs_unregister(s_mount_prefixes[i]) );
+        }
+    }
+}
+
 static int vfs_overlap_test_open(const char * path, int flags, int mode)
 {
     return 0;
@@ -11,6 +11,9 @@
 #include <errno.h>
 #include <sys/fcntl.h>
 #include <sys/dirent.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_vfs.h"
 #include "unity.h"
 #include "esp_log.h"
@@ -238,6 +241,66 @@ TEST_CASE("vfs unregisters correct nested mount point", "[vfs]")
     TEST_ESP_OK( esp_vfs_unregister("/foo/bar") );
 }
 
+typedef struct {
+    volatile bool stop;
+    int lookups;
+    int failures;
+    SemaphoreHandle_t done;
+} lookup_task_args_t;
+
+static void lookup_task(void *arg)
+{
+    lookup_task_args_t *args = (lookup_task_args_t *) arg;
+    while (!args->stop) {
+        int fd = esp_vfs_open(__getreent(), "/foo/bar/file", O_RDONLY, 0);
+        if (fd < 0) {
+            args->failures++;
+        } else {
+            esp_vfs_close(__getreent(), fd);
+        }
+        args->lookups++;
+    }
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("vfs path lookup while other mount points are registered and unregistered", "[vfs]")
+{
+    dummy_vfs_t inst_foobar = {
+        .match_path = "/file",
+    };
+    esp_vfs_t desc_foobar = DUMMY_VFS();
+    TEST_ESP_OK( esp_vfs_register("/foo/bar", &desc_foobar, &inst_foobar) );
+
+    /* Each register/unregister rebuilds the lookup table, "/foo/bar" must always be found */
+    dummy_vfs_t inst_other = {
+        .match_path = "",
+    };
+    esp_vfs_t desc_other = DUMMY_VFS();
+    lookup_task_args_t args = {
+        .done = xSemaphoreCreateBinary(),
+    };
+    TEST_ASSERT_NOT_NULL(args.done);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(lookup_task, "lookup", 4096, &args, uxTaskPriorityGet(NULL),
+                                                      NULL, portNUM_PROCESSORS - 1));
+    for (int i = 0; i < 1000; i++) {
+        TEST_ESP_OK( esp_vfs_register("/foo", &desc_other, &inst_other) );
+        TEST_ESP_OK( esp_vfs_register("/foo/bar/baz", &desc_other, &inst_other) );
+        TEST_ESP_OK( esp_vfs_unregister("/foo") );
+        TEST_ESP_OK( esp_vfs_unregister("/foo/bar/baz") );
+        if (i % 100 == 0) {
+            vTaskDelay(1);
+        }
+    }
+    args.stop = true;
+    TEST_ASSERT_TRUE(xSemaphoreTake(args.done, pdMS_TO_TICKS(1000)));
+    vSemaphoreDelete(args.done);
+
+    printf("%d lookups\n", args.lookups);
+    TEST_ASSERT_GREATER_THAN(0, args.lookups);
+    TEST_ASSERT_EQUAL(0, args.failures);
+    TEST_ESP_OK( esp_vfs_unregister("/foo/bar") );
+}
 
 void test_vfs_register(const char* prefix, bool expect_success, int line)
 {
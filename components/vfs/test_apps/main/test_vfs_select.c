@@ -15,6 +15,8 @@
 #include "esp_vfs.h"
 #include "esp_vfs_dev.h"
 #include "esp_vfs_fat.h"
+#include "esp_vfs_eventfd.h"
+#include "esp_vfs_poll.h"
 #include "lwip/sockets.h"
 #include "lwip/netdb.h"
 #include "test_utils.h"
@@ -357,6 +359,71 @@ TEST_CASE("socket can do poll()", "[vfs]")
     close(dummy_socket_fd);
 }
 
+static void eventfd_signal_task(void *param)
+{
+    const test_task_param_t *test_task_param = param;
+    vTaskDelay(test_task_param->delay_ms / portTICK_PERIOD_MS);
+    const uint64_t val = 1;
+    write(test_task_param->fd, &val, sizeof(val));
+    xSemaphoreGive(test_task_param->sem);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("socket and eventfd in a poll set", "[vfs]")
+{
+    int uart_fd;
+    int socket_fd;
+    char recv_message[sizeof(message)];
+
+    init(&uart_fd, &socket_fd);
+    const int dummy_socket_fd = open_dummy_socket();
+    esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&config));
+    const int event_fd = eventfd(0, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, event_fd);
+
+    esp_vfs_poll_set_handle_t set;
+    TEST_ESP_OK(esp_vfs_poll_set_create(&set));
+    TEST_ESP_OK(esp_vfs_poll_set_add(set, socket_fd, POLLIN, NULL));
+    TEST_ESP_OK(esp_vfs_poll_set_add(set, dummy_socket_fd, POLLIN, NULL));
+    TEST_ESP_OK(esp_vfs_poll_set_add(set, event_fd, POLLIN, NULL));
+    // UART doesn't implement the poll set interface
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, esp_vfs_poll_set_add(set, uart_fd, POLLIN, NULL));
+
+    esp_vfs_poll_event_t events[3];
+    TEST_ASSERT_EQUAL(0, esp_vfs_poll_set_wait(set, events, 3, 100));
+
+    // a socket becomes ready during the wait
+    test_task_param_t test_task_param = {
+        .fd = socket_fd,
+        .delay_ms = 50,
+        .sem = xSemaphoreCreateBinary(),
+    };
+    TEST_ASSERT_NOT_NULL(test_task_param.sem);
+    start_task(&test_task_param);
+    TEST_ASSERT_EQUAL(1, esp_vfs_poll_set_wait(set, events, 3, 1000));
+    TEST_ASSERT_EQUAL(socket_fd, events[0].fd);
+    TEST_ASSERT_EQUAL(POLLIN, events[0].revents);
+    TEST_ASSERT_EQUAL(sizeof(message), read(socket_fd, recv_message, sizeof(message)));
+    TEST_ASSERT_EQUAL_MEMORY(message, recv_message, sizeof(message));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(test_task_param.sem, 1000 / portTICK_PERIOD_MS));
+
+    // the eventfd wakes up the wait in the socket driver
+    test_task_param.fd = event_fd;
+    xTaskCreate(eventfd_signal_task, "eventfd_signal_task", 4*1024, &test_task_param, 5, NULL);
+    TEST_ASSERT_EQUAL(1, esp_vfs_poll_set_wait(set, events, 3, 1000));
+    TEST_ASSERT_EQUAL(event_fd, events[0].fd);
+    TEST_ASSERT_EQUAL(POLLIN, events[0].revents);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(test_task_param.sem, 1000 / portTICK_PERIOD_MS));
+
+    vSemaphoreDelete(test_task_param.sem);
+    esp_vfs_poll_set_delete(set);
+    TEST_ASSERT_EQUAL(0, close(event_fd));
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+    deinit(uart_fd, socket_fd);
+    close(dummy_socket_fd);
+}
+
 TEST_CASE("select() timeout", "[vfs]")
 {
     int uart_fd;
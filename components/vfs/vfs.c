@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
@@ -17,6 +18,7 @@
 #include <dirent.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "esp_vfs.h"
 #include "esp_vfs_private.h"
 #include "sdkconfig.h"
@@ -60,7 +62,10 @@ typedef struct {
     uint8_t _reserved :5;
     vfs_index_t vfs_index;
     local_fd_t local_fd;
-} fd_table_t;
+    uint8_t _padding;
+} __attribute__((aligned(4))) fd_table_t;
+/* Entries are read and written as a whole with a single 32-bit access, see fd_table_load() */
+_Static_assert(sizeof(fd_table_t) == sizeof(uint32_t), "fd_table_t must fit into a word");
 
 typedef struct {
     bool isset; // none or at least one bit is set in the following 3 fd sets
@@ -72,9 +77,86 @@ typedef struct {
 static vfs_entry_t* s_vfs[VFS_MAX_COUNT] = { 0 };
 static size_t s_vfs_count = 0;
 
+/* VFS entries with a path prefix, sorted by prefix length (longest first) and index.
+ * get_vfs_for_path() returns the first entry which matches. The table is rebuilt into the
+ * inactive copy on every register/unregister and then published by switching s_prefix_table,
+ * so lookups don't need a lock. Lookups count themselves as readers of the copy they walk,
+ * and the rebuild waits until the previous copy has no readers left before it returns, so
+ * the next rebuild never overwrites a copy which is being walked.
+ */
+typedef struct {
+    size_t count;
+    const vfs_entry_t *entries[VFS_MAX_COUNT];
+    uint32_t readers;
+} vfs_prefix_table_t;
+
+static vfs_prefix_table_t s_prefix_tables[2];
+static vfs_prefix_table_t *s_prefix_table = &s_prefix_tables[0];
+static _lock_t s_prefix_table_lock;
+
 static fd_table_t s_fd_table[MAX_FDS] = { [0 ... MAX_FDS-1] = FD_TABLE_ENTRY_UNUSED };
 static _lock_t s_fd_table_lock;
 
+/* Writers hold s_fd_table_lock, readers only need a consistent snapshot of an entry */
+static inline fd_table_t fd_table_load(int fd)
+{
+    fd_table_t entry;
+    __atomic_load(&s_fd_table[fd], &entry, __ATOMIC_ACQUIRE);
+    return entry;
+}
+
+static inline void fd_table_store(int fd, fd_table_t entry)
+{
+    __atomic_store(&s_fd_table[fd], &entry, __ATOMIC_RELEASE);
+}
+
+static void rebuild_prefix_table(void)
+{
+    _lock_acquire(&s_prefix_table_lock);
+    vfs_prefix_table_t *table = (s_prefix_table == &s_prefix_tables[0]) ? &s_prefix_tables[1] : &s_prefix_tables[0];
+    size_t count = 0;
+    for (size_t i = 0; i < s_vfs_count; ++i) {
+        const vfs_entry_t *vfs = s_vfs[i];
+        if (vfs == NULL || vfs->path_prefix_len == LEN_PATH_PREFIX_IGNORED) {
+            continue;
+        }
+        // insertion sort, entries with equal prefix length keep the order of their index
+        size_t pos = count;
+        while (pos > 0 && table->entries[pos - 1]->path_prefix_len < vfs->path_prefix_len) {
+            table->entries[pos] = table->entries[pos - 1];
+            --pos;
+        }
+        table->entries[pos] = vfs;
+        ++count;
+    }
+    table->count = count;
+    vfs_prefix_table_t *old_table = s_prefix_table;
+    __atomic_store_n(&s_prefix_table, table, __ATOMIC_SEQ_CST);
+    // Lookups which still walk the old copy may also use an entry which is about to be freed
+    while (__atomic_load_n(&old_table->readers, __ATOMIC_SEQ_CST) != 0) {
+        vTaskDelay(1);
+    }
+    _lock_release(&s_prefix_table_lock);
+}
+
+static vfs_prefix_table_t *prefix_table_acquire(void)
+{
+    while (true) {
+        vfs_prefix_table_t *table = __atomic_load_n(&s_prefix_table, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&table->readers, 1, __ATOMIC_SEQ_CST);
+        // If the copy was switched out in the meantime, it may be rebuilt already
+        if (table == __atomic_load_n(&s_prefix_table, __ATOMIC_SEQ_CST)) {
+            return table;
+        }
+        __atomic_sub_fetch(&table->readers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void prefix_table_release(vfs_prefix_table_t *table)
+{
+    __atomic_sub_fetch(&table->readers, 1, __ATOMIC_SEQ_CST);
+}
+
 esp_err_t esp_vfs_register_common(const char* base_path, size_t len, const esp_vfs_t* vfs, void* ctx, int *vfs_index)
 {
     if (len != LEN_PATH_PREFIX_IGNORED) {
@@ -114,6 +196,7 @@ esp_err_t esp_vfs_register_common(const char* base_path, size_t len, const esp_v
     entry->path_prefix_len = len;
     entry->ctx = ctx;
     entry->offset = index;
+    rebuild_prefix_table();
 
     if (vfs_index) {
         *vfs_index = index;
@@ -145,16 +228,14 @@ esp_err_t esp_vfs_register_fd_range(const esp_vfs_t *vfs, void *ctx, int min_fd,
                 s_vfs[index] = NULL;
                 for (int j = min_fd; j < i; ++j) {
                     if (s_fd_table[j].vfs_index == index) {
-                        s_fd_table[j] = FD_TABLE_ENTRY_UNUSED;
+                        fd_table_store(j, FD_TABLE_ENTRY_UNUSED);
                     }
                 }
                 _lock_release(&s_fd_table_lock);
                 ESP_LOGD(TAG, "esp_vfs_register_fd_range cannot set fd %d (used by other VFS)", i);
                 return ESP_ERR_INVALID_ARG;
             }
-            s_fd_table[i].permanent = true;
-            s_fd_table[i].vfs_index = index;
-            s_fd_table[i].local_fd = i;
+            fd_table_store(i, (fd_table_t) { .permanent = true, .vfs_index = index, .local_fd = i });
         }
         _lock_release(&s_fd_table_lock);
 
@@ -180,14 +261,15 @@ esp_err_t esp_vfs_unregister_with_id(esp_vfs_id_t vfs_id)
         return ESP_ERR_INVALID_ARG;
     }
     vfs_entry_t* vfs = s_vfs[vfs_id];
-    free(vfs);
     s_vfs[vfs_id] = NULL;
+    rebuild_prefix_table();
+    free(vfs);
 
     _lock_acquire(&s_fd_table_lock);
     // Delete all references from the FD lookup-table
     for (int j = 0; j < VFS_MAX_COUNT; ++j) {
         if (s_fd_table[j].vfs_index == vfs_id) {
-            s_fd_table[j] = FD_TABLE_ENTRY_UNUSED;
+            fd_table_store(j, FD_TABLE_ENTRY_UNUSED);
         }
     }
     _lock_release(&s_fd_table_lock);
@@ -228,13 +310,11 @@ esp_err_t esp_vfs_register_fd_with_local_fd(esp_vfs_id_t vfs_id, int local_fd, b
     _lock_acquire(&s_fd_table_lock);
     for (int i = 0; i < MAX_FDS; ++i) {
         if (s_fd_table[i].vfs_index == -1) {
-            s_fd_table[i].permanent = permanent;
-            s_fd_table[i].vfs_index = vfs_id;
-            if (local_fd >= 0) {
-                s_fd_table[i].local_fd = local_fd;
-            } else {
-                s_fd_table[i].local_fd = i;
-            }
+            fd_table_store(i, (fd_table_t) {
+                .permanent = permanent,
+                .vfs_index = vfs_id,
+                .local_fd = (local_fd >= 0) ? local_fd : i,
+            });
             *fd = i;
             ret = ESP_OK;
             break;
@@ -284,27 +364,23 @@ static inline bool fd_valid(int fd)
     return (fd < MAX_FDS) && (fd >= 0);
 }
 
-static const vfs_entry_t *get_vfs_for_fd(int fd)
+/* Returns the VFS of fd and sets *local_fd. Both come from the same snapshot of the FD table entry,
+ * so no locking is required.
+ */
+const vfs_entry_t *get_vfs_for_fd(int fd, int *local_fd)
 {
     const vfs_entry_t *vfs = NULL;
+    *local_fd = -1;
     if (fd_valid(fd)) {
-        const int index = s_fd_table[fd].vfs_index; // single read -> no locking is required
-        vfs = get_vfs_for_index(index);
+        const fd_table_t entry = fd_table_load(fd);
+        vfs = get_vfs_for_index(entry.vfs_index);
+        if (vfs) {
+            *local_fd = entry.local_fd;
+        }
     }
     return vfs;
 }
 
-static inline int get_local_fd(const vfs_entry_t *vfs, int fd)
-{
-    int local_fd = -1;
-
-    if (vfs && fd_valid(fd)) {
-        local_fd = s_fd_table[fd].local_fd; // single read -> no locking is required
-    }
-
-    return local_fd;
-}
-
 static const char* translate_path(const vfs_entry_t* vfs, const char* src_path)
 {
     assert(strncmp(src_path, vfs->path_prefix, vfs->path_prefix_len) == 0);
@@ -317,42 +393,29 @@ static const char* translate_path(const vfs_entry_t* vfs, const char* src_path)
 
 const vfs_entry_t* get_vfs_for_path(const char* path)
 {
-    const vfs_entry_t* best_match = NULL;
-    ssize_t best_match_prefix_len = -1;
+    vfs_prefix_table_t *table = prefix_table_acquire();
+    const vfs_entry_t* found = NULL;
     size_t len = strlen(path);
-    for (size_t i = 0; i < s_vfs_count; ++i) {
-        const vfs_entry_t* vfs = s_vfs[i];
-        if (!vfs || vfs->path_prefix_len == LEN_PATH_PREFIX_IGNORED) {
-            continue;
-        }
+    // Entries are sorted so that longer prefixes are checked first, i.e. if "/dev" and "/dev/uart"
+    // both match "/dev/uart/1", "/dev/uart" is found first. The default VFS (empty prefix) comes last.
+    for (size_t i = 0; i < table->count; ++i) {
+        const vfs_entry_t* vfs = table->entries[i];
         // match path prefix
         if (len < vfs->path_prefix_len ||
             memcmp(path, vfs->path_prefix, vfs->path_prefix_len) != 0) {
             continue;
         }
-        // this is the default VFS and we don't have a better match yet.
-        if (vfs->path_prefix_len == 0 && !best_match) {
-            best_match = vfs;
-            continue;
-        }
         // if path is not equal to the prefix, expect to see a path separator
         // i.e. don't match "/data" prefix for "/data1/foo.txt" path
-        if (len > vfs->path_prefix_len &&
+        if (vfs->path_prefix_len != 0 && len > vfs->path_prefix_len &&
                 path[vfs->path_prefix_len] != '/') {
             continue;
         }
-        // Out of all matching path prefixes, select the longest one;
-        // i.e. if "/dev" and "/dev/uart" both match, for "/dev/uart/1" path,
-        // choose "/dev/uart",
-        // This causes all s_vfs_count VFS entries to be scanned when opening
-        // a file by name. This can be optimized by introducing a table for
-        // FS search order, sorted so that longer prefixes are checked first.
-        if (best_match_prefix_len < (ssize_t) vfs->path_prefix_len) {
-            best_match_prefix_len = (ssize_t) vfs->path_prefix_len;
-            best_match = vfs;
-        }
+        found = vfs;
+        break;
     }
-    return best_match;
+    prefix_table_release(table);
+    return found;
 }
 
 /*
@@ -415,9 +478,7 @@ int esp_vfs_open(struct _reent *r, const char * path, int flags, int mode)
         _lock_acquire(&s_fd_table_lock);
         for (int i = 0; i < MAX_FDS; ++i) {
             if (s_fd_table[i].vfs_index == -1) {
-                s_fd_table[i].permanent = false;
-                s_fd_table[i].vfs_index = vfs->offset;
-                s_fd_table[i].local_fd = fd_within_vfs;
+                fd_table_store(i, (fd_table_t) { .permanent = false, .vfs_index = vfs->offset, .local_fd = fd_within_vfs });
                 _lock_release(&s_fd_table_lock);
                 return i;
             }
@@ -435,8 +496,8 @@ int esp_vfs_open(struct _reent *r, const char * path, int flags, int mode)
 
 ssize_t esp_vfs_write(struct _reent *r, int fd, const void * data, size_t size)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -448,8 +509,8 @@ ssize_t esp_vfs_write(struct _reent *r, int fd, const void * data, size_t size)
 
 off_t esp_vfs_lseek(struct _reent *r, int fd, off_t size, int mode)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -461,8 +522,8 @@ off_t esp_vfs_lseek(struct _reent *r, int fd, off_t size, int mode)
 
 ssize_t esp_vfs_read(struct _reent *r, int fd, void * dst, size_t size)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -475,8 +536,8 @@ ssize_t esp_vfs_read(struct _reent *r, int fd, void * dst, size_t size)
 ssize_t esp_vfs_pread(int fd, void *dst, size_t size, off_t offset)
 {
     struct _reent *r = __getreent();
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -489,8 +550,8 @@ ssize_t esp_vfs_pread(int fd, void *dst, size_t size, off_t offset)
 ssize_t esp_vfs_pwrite(int fd, const void *src, size_t size, off_t offset)
 {
     struct _reent *r = __getreent();
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -500,10 +561,101 @@ ssize_t esp_vfs_pwrite(int fd, const void *src, size_t size, off_t offset)
     return ret;
 }
 
+#ifndef SSIZE_MAX
+#define SSIZE_MAX ((ssize_t) (SIZE_MAX >> 1))
+#endif
+
+static bool iov_valid(const struct iovec *iov, int iovcnt)
+{
+    if (iovcnt < 0 || (iovcnt > 0 && iov == NULL)) {
+        return false;
+    }
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len > (size_t) SSIZE_MAX - total) {
+            return false;
+        }
+        total += iov[i].iov_len;
+    }
+    return true;
+}
+
+ssize_t esp_vfs_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    struct _reent *r = __getreent();
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
+    if (vfs == NULL || local_fd < 0) {
+        __errno_r(r) = EBADF;
+        return -1;
+    }
+    if (!iov_valid(iov, iovcnt)) {
+        __errno_r(r) = EINVAL;
+        return -1;
+    }
+    ssize_t ret;
+    if (vfs->vfs.readv != NULL) {
+        CHECK_AND_CALL(ret, r, vfs, readv, local_fd, iov, iovcnt);
+        return ret;
+    }
+    // Generic fallback: fill the buffers one by one, stop at the first short read
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        CHECK_AND_CALL(ret, r, vfs, read, local_fd, iov[i].iov_base, iov[i].iov_len);
+        if (ret < 0) {
+            return (total > 0) ? total : ret;
+        }
+        total += ret;
+        if ((size_t) ret < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
+ssize_t esp_vfs_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    struct _reent *r = __getreent();
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
+    if (vfs == NULL || local_fd < 0) {
+        __errno_r(r) = EBADF;
+        return -1;
+    }
+    if (!iov_valid(iov, iovcnt)) {
+        __errno_r(r) = EINVAL;
+        return -1;
+    }
+    ssize_t ret;
+    if (vfs->vfs.writev != NULL) {
+        CHECK_AND_CALL(ret, r, vfs, writev, local_fd, iov, iovcnt);
+        return ret;
+    }
+    // Generic fallback: write the buffers one by one, stop at the first short write
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        CHECK_AND_CALL(ret, r, vfs, write, local_fd, iov[i].iov_base, iov[i].iov_len);
+        if (ret < 0) {
+            return (total > 0) ? total : ret;
+        }
+        total += ret;
+        if ((size_t) ret < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
 int esp_vfs_close(struct _reent *r, int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -512,11 +664,13 @@ int esp_vfs_close(struct _reent *r, int fd)
     CHECK_AND_CALL(ret, r, vfs, close, local_fd);
 
     _lock_acquire(&s_fd_table_lock);
-    if (!s_fd_table[fd].permanent) {
-        if (s_fd_table[fd].has_pending_select) {
-            s_fd_table[fd].has_pending_close = true;
+    fd_table_t entry = s_fd_table[fd];
+    if (!entry.permanent) {
+        if (entry.has_pending_select) {
+            entry.has_pending_close = true;
+            fd_table_store(fd, entry);
         } else {
-            s_fd_table[fd] = FD_TABLE_ENTRY_UNUSED;
+            fd_table_store(fd, FD_TABLE_ENTRY_UNUSED);
         }
     }
     _lock_release(&s_fd_table_lock);
@@ -525,8 +679,8 @@ int esp_vfs_close(struct _reent *r, int fd)
 
 int esp_vfs_fstat(struct _reent *r, int fd, struct stat * st)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -538,8 +692,8 @@ int esp_vfs_fstat(struct _reent *r, int fd, struct stat * st)
 
 int esp_vfs_fcntl_r(struct _reent *r, int fd, int cmd, int arg)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
         return -1;
@@ -551,8 +705,8 @@ int esp_vfs_fcntl_r(struct _reent *r, int fd, int cmd, int arg)
 
 int esp_vfs_ioctl(int fd, int cmd, ...)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -568,8 +722,8 @@ int esp_vfs_ioctl(int fd, int cmd, ...)
 
 int esp_vfs_fsync(int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -803,8 +957,8 @@ int esp_vfs_truncate(const char *path, off_t length)
 
 int esp_vfs_ftruncate(int fd, off_t length)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -846,8 +1000,9 @@ static int set_global_fd_sets(const fds_triple_t *vfs_fds_triple, int size, fd_s
         const fds_triple_t *item = &vfs_fds_triple[i];
         if (item->isset) {
             for (int fd = 0; fd < MAX_FDS; ++fd) {
-                if (s_fd_table[fd].vfs_index == i) {
-                    const int local_fd = s_fd_table[fd].local_fd; // single read -> no locking is required
+                const fd_table_t entry = fd_table_load(fd);
+                if (entry.vfs_index == i) {
+                    const int local_fd = entry.local_fd;
                     if (readfds && esp_vfs_safe_fd_isset(local_fd, &item->readfds)) {
                         ESP_LOGD(TAG, "FD %d in readfds was set from VFS ID %d", fd, i);
                         FD_SET(fd, readfds);
@@ -927,7 +1082,9 @@ int esp_vfs_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *errorfds
         const int vfs_index = s_fd_table[fd].vfs_index;
         const int local_fd = s_fd_table[fd].local_fd;
         if (esp_vfs_safe_fd_isset(fd, errorfds)) {
-            s_fd_table[fd].has_pending_select = true;
+            fd_table_t entry = s_fd_table[fd];
+            entry.has_pending_select = true;
+            fd_table_store(fd, entry);
         }
         _lock_release(&s_fd_table_lock);
 
@@ -1086,7 +1243,7 @@ int esp_vfs_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *errorfds
     _lock_acquire(&s_fd_table_lock);
     for (int fd = 0; fd < nfds; ++fd) {
         if (s_fd_table[fd].has_pending_close) {
-            s_fd_table[fd] = FD_TABLE_ENTRY_UNUSED;
+            fd_table_store(fd, FD_TABLE_ENTRY_UNUSED);
         }
     }
     _lock_release(&s_fd_table_lock);
@@ -1146,8 +1303,8 @@ void esp_vfs_select_triggered_isr(esp_vfs_select_sem_t sem, BaseType_t *woken)
 
 int tcgetattr(int fd, struct termios *p)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1160,8 +1317,8 @@ int tcgetattr(int fd, struct termios *p)
 
 int tcsetattr(int fd, int optional_actions, const struct termios *p)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1174,8 +1331,8 @@ int tcsetattr(int fd, int optional_actions, const struct termios *p)
 
 int tcdrain(int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1188,8 +1345,8 @@ int tcdrain(int fd)
 
 int tcflush(int fd, int select)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1202,8 +1359,8 @@ int tcflush(int fd, int select)
 
 int tcflow(int fd, int action)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1216,8 +1373,8 @@ int tcflow(int fd, int action)
 
 pid_t tcgetsid(int fd)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1230,8 +1387,8 @@ pid_t tcgetsid(int fd)
 
 int tcsendbreak(int fd, int duration)
 {
-    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
-    const int local_fd = get_local_fd(vfs, fd);
+    int local_fd;
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd, &local_fd);
     struct _reent* r = __getreent();
     if (vfs == NULL || local_fd < 0) {
         __errno_r(r) = EBADF;
@@ -1263,6 +1420,10 @@ ssize_t pread(int fd, void *dst, size_t size, off_t offset)
     __attribute__((alias("esp_vfs_pread")));
 ssize_t pwrite(int fd, const void *src, size_t size, off_t offset)
     __attribute__((alias("esp_vfs_pwrite")));
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+    __attribute__((alias("esp_vfs_readv")));
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+    __attribute__((alias("esp_vfs_writev")));
 off_t _lseek_r(struct _reent *r, int fd, off_t size, int mode)
     __attribute__((alias("esp_vfs_lseek")));
 int _fcntl_r(struct _reent *r, int fd, int cmd, int arg)
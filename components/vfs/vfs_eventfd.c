@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/lock.h>
+#include <sys/poll.h>
 #include <sys/select.h>
 #include <sys/types.h>
 
@@ -59,6 +60,8 @@ typedef struct {
     volatile uint64_t       value;
     // a double-linked list for all pending select args with this fd
     event_select_args_t     *select_args;
+    // a double-linked list of the poll sets watching this fd
+    esp_vfs_poll_watch_t    *watches;
     _lock_t                 lock;
     // only for event fds that support ISR.
     portMUX_TYPE            data_spin_lock;
@@ -89,6 +92,26 @@ static void trigger_select_for_event_isr(event_context_t *event, BaseType_t *tas
     }
 }
 
+static void notify_watches(event_context_t *event)
+{
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    for (esp_vfs_poll_watch_t *watch = event->watches; watch != NULL; watch = watch->next) {
+        esp_vfs_poll_watch_notify(watch);
+    }
+#endif
+}
+
+static void notify_watches_isr(event_context_t *event, BaseType_t *task_woken)
+{
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    for (esp_vfs_poll_watch_t *watch = event->watches; watch != NULL; watch = watch->next) {
+        BaseType_t local_woken = pdFALSE;
+        esp_vfs_poll_watch_notify_isr(watch, &local_woken);
+        *task_woken = (local_woken || *task_woken);
+    }
+#endif
+}
+
 #ifdef CONFIG_VFS_SUPPORT_SELECT
 static esp_err_t event_start_select(int                  nfds,
                                     fd_set              *readfds,
@@ -196,7 +219,7 @@ static esp_err_t event_end_select(void *end_select_args)
             next_in_fd->prev_in_fd = prev_in_fd;
         }
         if (prev_in_fd == NULL && next_in_fd == NULL) { // The last pending select
-            if (event->fd == FD_PENDING_SELECT) {
+            if (event->fd == FD_PENDING_SELECT && event->watches == NULL) {
                 event->fd = FD_INVALID;
             }
         }
@@ -212,6 +235,85 @@ static esp_err_t event_end_select(void *end_select_args)
 
     return ESP_OK;
 }
+
+static esp_err_t event_poll_attach(int fd, esp_vfs_poll_watch_t *watch)
+{
+    if (fd >= s_event_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t error = ESP_OK;
+    event_context_t *event = &s_events[fd];
+
+    _lock_acquire_recursive(&event->lock);
+    if (event->support_isr) {
+        portENTER_CRITICAL(&event->data_spin_lock);
+    }
+    if (event->fd == fd) {
+        watch->prev = NULL;
+        watch->next = event->watches;
+        if (event->watches) {
+            event->watches->prev = watch;
+        }
+        event->watches = watch;
+    } else {
+        error = ESP_ERR_INVALID_ARG;
+    }
+    if (event->support_isr) {
+        portEXIT_CRITICAL(&event->data_spin_lock);
+    }
+    _lock_release_recursive(&event->lock);
+    return error;
+}
+
+static void event_poll_detach(int fd, esp_vfs_poll_watch_t *watch)
+{
+    event_context_t *event = &s_events[fd];
+
+    _lock_acquire_recursive(&event->lock);
+    if (event->support_isr) {
+        portENTER_CRITICAL(&event->data_spin_lock);
+    }
+    if (watch->prev != NULL) {
+        watch->prev->next = watch->next;
+    } else {
+        event->watches = watch->next;
+    }
+    if (watch->next != NULL) {
+        watch->next->prev = watch->prev;
+    }
+    watch->prev = NULL;
+    watch->next = NULL;
+    // the fd has been closed while it was watched
+    if (event->fd == FD_PENDING_SELECT && event->watches == NULL && event->select_args == NULL) {
+        event->fd = FD_INVALID;
+    }
+    if (event->support_isr) {
+        portEXIT_CRITICAL(&event->data_spin_lock);
+    }
+    _lock_release_recursive(&event->lock);
+}
+
+static uint32_t event_poll_revents(int fd)
+{
+    event_context_t *event = &s_events[fd];
+    // event fds are always writable
+    uint32_t revents = POLLOUT;
+
+    _lock_acquire_recursive(&event->lock);
+    if (event->support_isr) {
+        portENTER_CRITICAL(&event->data_spin_lock);
+    }
+    if (event->fd != fd) {
+        revents = POLLNVAL;
+    } else if (event->is_set) {
+        revents |= POLLIN;
+    }
+    if (event->support_isr) {
+        portEXIT_CRITICAL(&event->data_spin_lock);
+    }
+    _lock_release_recursive(&event->lock);
+    return revents;
+}
 #endif // CONFIG_VFS_SUPPORT_SELECT
 
 static ssize_t signal_event_fd_from_isr(int fd, const void *data, size_t size)
@@ -226,6 +328,7 @@ static ssize_t signal_event_fd_from_isr(int fd, const void *data, size_t size)
         s_events[fd].is_set = true;
         s_events[fd].value += *val;
         trigger_select_for_event_isr(&s_events[fd], &task_woken);
+        notify_watches_isr(&s_events[fd], &task_woken);
     } else {
         errno = EBADF;
         ret = -1;
@@ -267,6 +370,7 @@ static ssize_t event_write(int fd, const void *data, size_t size)
             s_events[fd].value += *val;
             ret = size;
             trigger_select_for_event(&s_events[fd]);
+            notify_watches(&s_events[fd]);
 
             if (s_events[fd].support_isr) {
                 portEXIT_CRITICAL(&s_events[fd].data_spin_lock);
@@ -328,11 +432,12 @@ static int event_close(int fd)
         if (s_events[fd].support_isr) {
             portENTER_CRITICAL(&s_events[fd].data_spin_lock);
         }
-        if (s_events[fd].select_args == NULL) {
+        if (s_events[fd].select_args == NULL && s_events[fd].watches == NULL) {
             s_events[fd].fd = FD_INVALID;
         } else {
             s_events[fd].fd = FD_PENDING_SELECT;
             trigger_select_for_event(&s_events[fd]);
+            notify_watches(&s_events[fd]);
         }
         s_events[fd].value = 0;
         if (s_events[fd].support_isr) {
@@ -371,6 +476,9 @@ esp_err_t esp_vfs_eventfd_register(const esp_vfs_eventfd_config_t *config)
 #ifdef CONFIG_VFS_SUPPORT_SELECT
         .start_select = &event_start_select,
         .end_select   = &event_end_select,
+        .poll_attach  = &event_poll_attach,
+        .poll_detach  = &event_poll_detach,
+        .poll_revents = &event_poll_revents,
 #endif
     };
     return esp_vfs_register_with_id(&vfs, NULL, &s_eventfd_vfs_id);
@@ -429,6 +537,7 @@ int eventfd(unsigned int initval, int flags)
             s_events[i].is_set = false;
             s_events[i].value = initval;
             s_events[i].select_args = NULL;
+            s_events[i].watches = NULL;
             if (support_isr) {
                 portEXIT_CRITICAL(&s_events[i].data_spin_lock);
             }
@@ -0,0 +1,500 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/lock.h>
+#include <sys/poll.h>
+#include <sys/select.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_vfs.h"
+#include "esp_vfs_poll.h"
+#include "esp_vfs_private.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+
+#define POLL_ALWAYS_REPORTED (POLLERR | POLLHUP | POLLNVAL)
+
+/*
+ * About the two kinds of FDs in a poll set
+ *
+ * FDs of drivers with poll_attach get a watch. The driver calls esp_vfs_poll_watch_notify() when
+ * the FD may have become ready, which queues the watch in the ready list of the set and wakes up
+ * the waiting task. A wait asks the driver with poll_revents only about the FDs in the ready list.
+ * Ready FDs are queued again after they were reported (level-triggered), FDs which are not ready
+ * anymore leave the list until the next notification.
+ *
+ * Sockets are handled by socket_select of the socket driver. The set keeps the fd_sets of its
+ * sockets up to date, so a wait only copies them. While the waiting task is blocked in
+ * socket_select, notifications of watches interrupt it through stop_socket_select.
+ * lwIP has no per-socket hook which could queue a socket like a watch, so a wait still costs
+ * time proportional to the number of sockets in the set: socket_select gets nfds up to the
+ * highest socket of the set, and the results are collected from the list of its sockets.
+ */
+typedef struct poll_set_entry {
+    esp_vfs_poll_watch_t watch; // first member, so that a watch can be converted to its entry
+    int fd;
+    int local_fd;
+    uint32_t events;
+    void *user_data;
+    const vfs_entry_t *vfs;
+    bool is_socket;
+    struct poll_set_entry *next_socket;
+} poll_set_entry_t;
+
+struct esp_vfs_poll_set {
+    _lock_t lock;                       // protects the entries and the socket fd_sets
+    poll_set_entry_t *entries[MAX_FDS]; // indexed by the global FD
+    const vfs_entry_t *socket_vfs;
+    size_t socket_count;
+    poll_set_entry_t *sockets;          // list of the socket entries
+    int socket_nfds;                    // highest local FD of the sockets + 1
+    fd_set socket_readfds;
+    fd_set socket_writefds;
+    fd_set socket_errorfds;
+    portMUX_TYPE spinlock;              // protects the ready list and wait_sem
+    esp_vfs_poll_watch_t *ready_head;
+    esp_vfs_poll_watch_t *ready_tail;
+    esp_vfs_select_sem_t wait_sem;      // .sem is NULL while no task is waiting
+    SemaphoreHandle_t local_sem;
+};
+
+/* Must be called with the spinlock of the set held */
+static void ready_list_push(struct esp_vfs_poll_set *set, esp_vfs_poll_watch_t *watch)
+{
+    if (watch->queued) {
+        return;
+    }
+    watch->queued = true;
+    watch->next_ready = NULL;
+    if (set->ready_tail) {
+        set->ready_tail->next_ready = watch;
+    } else {
+        set->ready_head = watch;
+    }
+    set->ready_tail = watch;
+}
+
+/* Must be called with the spinlock of the set held */
+static void ready_list_remove(struct esp_vfs_poll_set *set, esp_vfs_poll_watch_t *watch)
+{
+    if (!watch->queued) {
+        return;
+    }
+    esp_vfs_poll_watch_t *prev = NULL;
+    for (esp_vfs_poll_watch_t *it = set->ready_head; it != NULL; prev = it, it = it->next_ready) {
+        if (it == watch) {
+            if (prev) {
+                prev->next_ready = it->next_ready;
+            } else {
+                set->ready_head = it->next_ready;
+            }
+            if (set->ready_tail == it) {
+                set->ready_tail = prev;
+            }
+            break;
+        }
+    }
+    watch->queued = false;
+}
+
+void esp_vfs_poll_watch_notify(esp_vfs_poll_watch_t *watch)
+{
+    struct esp_vfs_poll_set *set = (struct esp_vfs_poll_set *) watch->set;
+    portENTER_CRITICAL_SAFE(&set->spinlock);
+    ready_list_push(set, watch);
+    esp_vfs_select_sem_t sem = set->wait_sem;
+    portEXIT_CRITICAL_SAFE(&set->spinlock);
+    if (sem.sem) {
+        esp_vfs_select_triggered(sem);
+    }
+}
+
+void esp_vfs_poll_watch_notify_isr(esp_vfs_poll_watch_t *watch, BaseType_t *woken)
+{
+    struct esp_vfs_poll_set *set = (struct esp_vfs_poll_set *) watch->set;
+    portENTER_CRITICAL_ISR(&set->spinlock);
+    ready_list_push(set, watch);
+    esp_vfs_select_sem_t sem = set->wait_sem;
+    portEXIT_CRITICAL_ISR(&set->spinlock);
+    if (sem.sem) {
+        esp_vfs_select_triggered_isr(sem, woken);
+    }
+}
+
+esp_err_t esp_vfs_poll_set_create(esp_vfs_poll_set_handle_t *out_set)
+{
+    if (out_set == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_vfs_poll_set *set = calloc(1, sizeof(struct esp_vfs_poll_set));
+    if (set == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    set->local_sem = xSemaphoreCreateBinary();
+    if (set->local_sem == NULL) {
+        free(set);
+        return ESP_ERR_NO_MEM;
+    }
+    _lock_init(&set->lock);
+    portMUX_INITIALIZE(&set->spinlock);
+    FD_ZERO(&set->socket_readfds);
+    FD_ZERO(&set->socket_writefds);
+    FD_ZERO(&set->socket_errorfds);
+    *out_set = set;
+    return ESP_OK;
+}
+
+/* Must be called with the lock of the set held */
+static void update_socket_fd_sets(struct esp_vfs_poll_set *set, const poll_set_entry_t *entry, bool add)
+{
+    FD_CLR(entry->local_fd, &set->socket_readfds);
+    FD_CLR(entry->local_fd, &set->socket_writefds);
+    FD_CLR(entry->local_fd, &set->socket_errorfds);
+    if (add) {
+        if (entry->events & POLLIN) {
+            FD_SET(entry->local_fd, &set->socket_readfds);
+        }
+        if (entry->events & POLLOUT) {
+            FD_SET(entry->local_fd, &set->socket_writefds);
+        }
+        FD_SET(entry->local_fd, &set->socket_errorfds);
+    }
+}
+
+esp_err_t esp_vfs_poll_set_add(esp_vfs_poll_set_handle_t set, int fd, uint32_t events, void *user_data)
+{
+    if (set == NULL || fd < 0 || fd >= MAX_FDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int local_fd;
+    const vfs_entry_t *vfs = get_vfs_for_fd(fd, &local_fd);
+    if (vfs == NULL || local_fd < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const bool is_socket = (vfs->vfs.socket_select != NULL);
+    if (!is_socket && (vfs->vfs.poll_attach == NULL || vfs->vfs.poll_detach == NULL || vfs->vfs.poll_revents == NULL)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    poll_set_entry_t *entry = calloc(1, sizeof(poll_set_entry_t));
+    if (entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    entry->watch.set = set;
+    entry->fd = fd;
+    entry->local_fd = local_fd;
+    entry->events = events;
+    entry->user_data = user_data;
+    entry->vfs = vfs;
+    entry->is_socket = is_socket;
+
+    esp_err_t err = ESP_OK;
+    _lock_acquire(&set->lock);
+    if (set->entries[fd] != NULL) {
+        err = ESP_ERR_INVALID_ARG;
+    } else if (is_socket) {
+        set->socket_vfs = vfs;
+        set->socket_count++;
+        entry->next_socket = set->sockets;
+        set->sockets = entry;
+        set->socket_nfds = MAX(set->socket_nfds, local_fd + 1);
+        update_socket_fd_sets(set, entry, true);
+        set->entries[fd] = entry;
+    } else {
+        err = vfs->vfs.poll_attach(local_fd, &entry->watch);
+        if (err == ESP_OK) {
+            set->entries[fd] = entry;
+            // the FD may already be ready
+            esp_vfs_poll_watch_notify(&entry->watch);
+        }
+    }
+    _lock_release(&set->lock);
+    if (err != ESP_OK) {
+        free(entry);
+    }
+    return err;
+}
+
+esp_err_t esp_vfs_poll_set_modify(esp_vfs_poll_set_handle_t set, int fd, uint32_t events, void *user_data)
+{
+    if (set == NULL || fd < 0 || fd >= MAX_FDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    _lock_acquire(&set->lock);
+    poll_set_entry_t *entry = set->entries[fd];
+    if (entry == NULL) {
+        err = ESP_ERR_NOT_FOUND;
+    } else {
+        entry->events = events;
+        entry->user_data = user_data;
+        if (entry->is_socket) {
+            update_socket_fd_sets(set, entry, true);
+        } else {
+            esp_vfs_poll_watch_notify(&entry->watch);
+        }
+    }
+    _lock_release(&set->lock);
+    return err;
+}
+
+/* Must be called with the lock of the set held */
+static void remove_entry(struct esp_vfs_poll_set *set, poll_set_entry_t *entry)
+{
+    if (entry->is_socket) {
+        update_socket_fd_sets(set, entry, false);
+        set->socket_count--;
+        set->socket_nfds = 0;
+        for (poll_set_entry_t **it = &set->sockets; *it != NULL;) {
+            if (*it == entry) {
+                *it = entry->next_socket;
+                continue;
+            }
+            set->socket_nfds = MAX(set->socket_nfds, (*it)->local_fd + 1);
+            it = &(*it)->next_socket;
+        }
+    } else {
+        entry->vfs->vfs.poll_detach(entry->local_fd, &entry->watch);
+        portENTER_CRITICAL(&set->spinlock);
+        ready_list_remove(set, &entry->watch);
+        portEXIT_CRITICAL(&set->spinlock);
+    }
+    set->entries[entry->fd] = NULL;
+    free(entry);
+}
+
+esp_err_t esp_vfs_poll_set_remove(esp_vfs_poll_set_handle_t set, int fd)
+{
+    if (set == NULL || fd < 0 || fd >= MAX_FDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_OK;
+    _lock_acquire(&set->lock);
+    poll_set_entry_t *entry = set->entries[fd];
+    if (entry == NULL) {
+        err = ESP_ERR_NOT_FOUND;
+    } else {
+        remove_entry(set, entry);
+    }
+    _lock_release(&set->lock);
+    return err;
+}
+
+/* Checks the watches in the ready list. Must be called with the lock of the set held. */
+static int collect_watches(struct esp_vfs_poll_set *set, esp_vfs_poll_event_t *events, int max_events)
+{
+    portENTER_CRITICAL(&set->spinlock);
+    esp_vfs_poll_watch_t *watch = set->ready_head;
+    set->ready_head = NULL;
+    set->ready_tail = NULL;
+    for (esp_vfs_poll_watch_t *it = watch; it != NULL; it = it->next_ready) {
+        // notifications arriving from now on queue the watch again
+        it->queued = false;
+    }
+    portEXIT_CRITICAL(&set->spinlock);
+
+    int count = 0;
+    while (watch != NULL) {
+        esp_vfs_poll_watch_t *next = watch->next_ready;
+        poll_set_entry_t *entry = (poll_set_entry_t *) watch;
+        uint32_t revents = entry->vfs->vfs.poll_revents(entry->local_fd) & (entry->events | POLL_ALWAYS_REPORTED);
+        if (revents != 0) {
+            if (count < max_events) {
+                events[count].fd = entry->fd;
+                events[count].revents = revents;
+                events[count].user_data = entry->user_data;
+                count++;
+            }
+            // still ready, check it again in the next wait
+            portENTER_CRITICAL(&set->spinlock);
+            ready_list_push(set, watch);
+            portEXIT_CRITICAL(&set->spinlock);
+        }
+        watch = next;
+    }
+    return count;
+}
+
+/* Converts the results of socket_select. Must be called with the lock of the set held. */
+static int collect_sockets(struct esp_vfs_poll_set *set, const fd_set *readfds, const fd_set *writefds,
+                           const fd_set *errorfds, esp_vfs_poll_event_t *events, int max_events)
+{
+    int count = 0;
+    for (poll_set_entry_t *entry = set->sockets; entry != NULL && count < max_events; entry = entry->next_socket) {
+        uint32_t revents = 0;
+        if (FD_ISSET(entry->local_fd, readfds)) {
+            revents |= POLLIN;
+        }
+        if (FD_ISSET(entry->local_fd, writefds)) {
+            revents |= POLLOUT;
+        }
+        if (FD_ISSET(entry->local_fd, errorfds)) {
+            revents |= POLLERR;
+        }
+        revents &= (entry->events | POLL_ALWAYS_REPORTED);
+        if (revents != 0) {
+            events[count].fd = entry->fd;
+            events[count].revents = revents;
+            events[count].user_data = entry->user_data;
+            count++;
+        }
+    }
+    return count;
+}
+
+/* Publishes the semaphore the task is going to wait on. Returns false if watches are already queued. */
+static bool start_wait(struct esp_vfs_poll_set *set, esp_vfs_select_sem_t sem)
+{
+    portENTER_CRITICAL(&set->spinlock);
+    const bool nothing_queued = (set->ready_head == NULL);
+    if (nothing_queued) {
+        set->wait_sem = sem;
+    }
+    portEXIT_CRITICAL(&set->spinlock);
+    return nothing_queued;
+}
+
+static void end_wait(struct esp_vfs_poll_set *set)
+{
+    portENTER_CRITICAL(&set->spinlock);
+    set->wait_sem.sem = NULL;
+    portEXIT_CRITICAL(&set->spinlock);
+}
+
+int esp_vfs_poll_set_wait(esp_vfs_poll_set_handle_t set, esp_vfs_poll_event_t *events, int max_events, int timeout_ms)
+{
+    if (set == NULL || events == NULL || max_events <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Rounded up and incremented by one like the timeout of select()
+    const TickType_t timeout_ticks = (timeout_ms < 0) ? portMAX_DELAY :
+                                     (timeout_ms == 0) ? 0 : ((timeout_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS) + 1;
+    const TickType_t start = xTaskGetTickCount();
+
+    while (true) {
+        TickType_t ticks_to_wait = 0;
+        if (timeout_ticks == portMAX_DELAY) {
+            ticks_to_wait = portMAX_DELAY;
+        } else {
+            const TickType_t elapsed = xTaskGetTickCount() - start;
+            ticks_to_wait = (elapsed < timeout_ticks) ? timeout_ticks - elapsed : 0;
+        }
+
+        _lock_acquire(&set->lock);
+        int count = collect_watches(set, events, max_events);
+        const vfs_entry_t *socket_vfs = (set->socket_count > 0) ? set->socket_vfs : NULL;
+        const int socket_nfds = set->socket_nfds;
+        fd_set readfds = set->socket_readfds;
+        fd_set writefds = set->socket_writefds;
+        fd_set errorfds = set->socket_errorfds;
+        _lock_release(&set->lock);
+
+        if (socket_vfs && count < max_events) {
+            esp_vfs_select_sem_t sem = {
+                .is_sem_local = false,
+                .sem = socket_vfs->vfs.get_socket_select_semaphore(),
+            };
+            struct timeval tv = { 0 };
+            struct timeval *timeout = &tv;
+            if (count == 0 && start_wait(set, sem)) {
+                if (ticks_to_wait == portMAX_DELAY) {
+                    timeout = NULL;
+                } else {
+                    const uint32_t ms = ticks_to_wait * portTICK_PERIOD_MS;
+                    tv.tv_sec = ms / 1000;
+                    tv.tv_usec = (ms % 1000) * 1000;
+                }
+            }
+            const int ret = socket_vfs->vfs.socket_select(socket_nfds, &readfds, &writefds, &errorfds, timeout);
+            end_wait(set);
+            if (sem.sem) {
+                /* The socket driver may have been interrupted by a watch while sockets became ready,
+                 * clear the semaphore of the calling task like select() does */
+                SemaphoreHandle_t *s = sem.sem;
+                xSemaphoreTake(*s, 0);
+            }
+            if (ret > 0) {
+                _lock_acquire(&set->lock);
+                count += collect_sockets(set, &readfds, &writefds, &errorfds, events + count, max_events - count);
+                _lock_release(&set->lock);
+            } else if (ret < 0 && count == 0) {
+                return -1;
+            }
+        } else if (count == 0 && ticks_to_wait > 0) {
+            esp_vfs_select_sem_t sem = {
+                .is_sem_local = true,
+                .sem = set->local_sem,
+            };
+            if (start_wait(set, sem)) {
+                xSemaphoreTake(set->local_sem, ticks_to_wait);
+                end_wait(set);
+            }
+        }
+
+        if (count > 0 || ticks_to_wait == 0) {
+            return count;
+        }
+        // woken up by a notification of an FD which is not ready anymore, or the socket driver timed out
+    }
+}
+
+void esp_vfs_poll_set_delete(esp_vfs_poll_set_handle_t set)
+{
+    if (set == NULL) {
+        return;
+    }
+    _lock_acquire(&set->lock);
+    for (int fd = 0; fd < MAX_FDS; ++fd) {
+        if (set->entries[fd]) {
+            remove_entry(set, set->entries[fd]);
+        }
+    }
+    _lock_release(&set->lock);
+    _lock_close(&set->lock);
+    vSemaphoreDelete(set->local_sem);
+    free(set);
+}
+
+#else // CONFIG_VFS_SUPPORT_SELECT
+
+esp_err_t esp_vfs_poll_set_create(esp_vfs_poll_set_handle_t *out_set)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_vfs_poll_set_add(esp_vfs_poll_set_handle_t set, int fd, uint32_t events, void *user_data)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_vfs_poll_set_modify(esp_vfs_poll_set_handle_t set, int fd, uint32_t events, void *user_data)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_vfs_poll_set_remove(esp_vfs_poll_set_handle_t set, int fd)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+int esp_vfs_poll_set_wait(esp_vfs_poll_set_handle_t set, esp_vfs_poll_event_t *events, int max_events, int timeout_ms)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+void esp_vfs_poll_set_delete(esp_vfs_poll_set_handle_t set)
+{
+}
+
+#endif // CONFIG_VFS_SUPPORT_SELECT
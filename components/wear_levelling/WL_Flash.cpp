@@ -521,6 +521,30 @@ size_t WL_Flash::calcAddr(size_t addr)
     return result;
 }
 
+// Same mapping as calcAddr(), and additionally returns in run_size how many of the next size bytes
+// are stored contiguously from the returned address. Consecutive pages are contiguous except where
+// they skip the dummy sector and where they wrap around the end of the partition.
+size_t WL_Flash::calcAddrRun(size_t addr, size_t size, size_t *run_size)
+{
+    size_t result = (this->flash_size - this->state.wl_dummy_sec_move_count * this->cfg.wl_page_size + addr) % this->flash_size;
+    size_t dummy_addr = this->state.wl_dummy_sec_pos * this->cfg.wl_page_size;
+    size_t run_end;
+    if (result < dummy_addr) {
+        run_end = dummy_addr;
+    } else {
+        run_end = this->flash_size;
+    }
+    *run_size = run_end - result;
+    if (*run_size > size) {
+        *run_size = size;
+    }
+    if (result >= dummy_addr) {
+        result += this->cfg.wl_page_size;
+    }
+    ESP_LOGV(TAG, "%s - addr= 0x%08x -> result= 0x%08x, run_size= 0x%08x", __func__, (uint32_t) addr, (uint32_t) result, (uint32_t) *run_size);
+    return result;
+}
+
 
 size_t WL_Flash::get_flash_size()
 {
@@ -553,6 +577,24 @@ esp_err_t WL_Flash::erase_sector(size_t sector)
     return result;
 }
 
+// Erases count sectors starting at start_sector without WL accounting. The dummy sector must not move
+// in between, so the caller accounts for the erase cycles beforehand.
+esp_err_t WL_Flash::eraseRun(size_t start_sector, size_t count)
+{
+    esp_err_t result = ESP_OK;
+    size_t addr = start_sector * this->cfg.flash_sector_size;
+    size_t size = count * this->cfg.flash_sector_size;
+    while (size > 0) {
+        size_t run_size;
+        size_t virt_addr = this->calcAddrRun(addr, size, &run_size);
+        result = this->flash_drv->erase_range(this->cfg.wl_partition_start_addr + virt_addr, run_size);
+        WL_RESULT_CHECK(result);
+        addr += run_size;
+        size -= run_size;
+    }
+    return result;
+}
+
 esp_err_t WL_Flash::erase_range(size_t start_address, size_t size)
 {
     esp_err_t result = ESP_OK;
@@ -561,10 +603,30 @@ esp_err_t WL_Flash::erase_range(size_t start_address, size_t size)
     }
     ESP_LOGD(TAG, "%s - start_address= 0x%08x, size= 0x%08x", __func__, (uint32_t) start_address, (uint32_t) size);
     size_t erase_count = (size + this->cfg.flash_sector_size - 1) / this->cfg.flash_sector_size;
-    size_t start_sector = start_address / this->cfg.flash_sector_size;
-    for (size_t i = 0; i < erase_count; i++) {
-        result = this->erase_sector(start_sector + i);
+    size_t sector = start_address / this->cfg.flash_sector_size;
+    while (erase_count > 0) {
+        // The mapping stays the same until updateWL() moves the dummy sector, so the sectors erased
+        // before that are accounted at once and erased with one flash operation per contiguous run.
+        size_t batch = 0;
+        if (this->state.wl_sec_erase_cycle_count + 1 < this->state.wl_max_sec_erase_cycle_count) {
+            batch = this->state.wl_max_sec_erase_cycle_count - this->state.wl_sec_erase_cycle_count - 1;
+        }
+        if (batch == 0) {
+            // Next erase moves the dummy sector
+            result = WL_Flash::erase_sector(sector);
+            WL_RESULT_CHECK(result);
+            sector++;
+            erase_count--;
+            continue;
+        }
+        if (batch > erase_count) {
+            batch = erase_count;
+        }
+        this->state.wl_sec_erase_cycle_count += batch;
+        result = this->eraseRun(sector, batch);
         WL_RESULT_CHECK(result);
+        sector += batch;
+        erase_count -= batch;
     }
     ESP_LOGV(TAG, "%s - result= 0x%08x", __func__, result);
     return result;
@@ -577,15 +639,16 @@ esp_err_t WL_Flash::write(size_t dest_addr, const void *src, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - dest_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) dest_addr, (uint32_t) size);
-    uint32_t count = (size - 1) / this->cfg.wl_page_size;
-    for (size_t i = 0; i < count; i++) {
-        size_t virt_addr = this->calcAddr(dest_addr + i * this->cfg.wl_page_size);
-        result = this->flash_drv->write(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)src)[i * this->cfg.wl_page_size], this->cfg.wl_page_size);
+    const uint8_t *data = (const uint8_t *)src;
+    while (size > 0) {
+        size_t run_size;
+        size_t virt_addr = this->calcAddrRun(dest_addr, size, &run_size);
+        result = this->flash_drv->write(this->cfg.wl_partition_start_addr + virt_addr, data, run_size);
         WL_RESULT_CHECK(result);
+        dest_addr += run_size;
+        data += run_size;
+        size -= run_size;
     }
-    size_t virt_addr_last = this->calcAddr(dest_addr + count * this->cfg.wl_page_size);
-    result = this->flash_drv->write(this->cfg.wl_partition_start_addr + virt_addr_last, &((uint8_t *)src)[count * this->cfg.wl_page_size], size - count * this->cfg.wl_page_size);
-    WL_RESULT_CHECK(result);
     return result;
 }
 
@@ -596,16 +659,17 @@ esp_err_t WL_Flash::read(size_t src_addr, void *dest, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - src_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) src_addr, (uint32_t) size);
-    uint32_t count = (size - 1) / this->cfg.wl_page_size;
-    for (size_t i = 0; i < count; i++) {
-        size_t virt_addr = this->calcAddr(src_addr + i * this->cfg.wl_page_size);
-        ESP_LOGV(TAG, "%s - real_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) (this->cfg.wl_partition_start_addr + virt_addr), (uint32_t) size);
-        result = this->flash_drv->read(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)dest)[i * this->cfg.wl_page_size], this->cfg.wl_page_size);
+    uint8_t *data = (uint8_t *)dest;
+    while (size > 0) {
+        size_t run_size;
+        size_t virt_addr = this->calcAddrRun(src_addr, size, &run_size);
+        ESP_LOGV(TAG, "%s - real_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) (this->cfg.wl_partition_start_addr + virt_addr), (uint32_t) run_size);
+        result = this->flash_drv->read(this->cfg.wl_partition_start_addr + virt_addr, data, run_size);
         WL_RESULT_CHECK(result);
+        src_addr += run_size;
+        data += run_size;
+        size -= run_size;
     }
-    size_t virt_addr_last = this->calcAddr(src_addr + count * this->cfg.wl_page_size);
-    result = this->flash_drv->read(this->cfg.wl_partition_start_addr + virt_addr_last, &((uint8_t *)dest)[count * this->cfg.wl_page_size], size - count * this->cfg.wl_page_size);
-    WL_RESULT_CHECK(result);
     return result;
 }
 
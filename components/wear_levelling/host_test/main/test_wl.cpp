@@ -426,3 +426,60 @@ TEST_CASE("power down between WL status 1 and WL status 2 update", "[wear_levell
 
     free(tmp_state);
 }
+
+TEST_CASE("multi-sector access is coalesced into few flash operations", "[wear_levelling]")
+{
+    esp_err_t result;
+    wl_handle_t wl_handle;
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    result = wl_mount(partition, &wl_handle);
+    REQUIRE(result == ESP_OK);
+
+    size_t size = wl_size(wl_handle);
+    size_t sector_size = wl_sector_size(wl_handle);
+    uint8_t *data = (uint8_t *) malloc(size);
+    uint8_t *read = (uint8_t *) malloc(size);
+    REQUIRE(data != NULL);
+    REQUIRE(read != NULL);
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+        ((uint32_t *) data)[i] = i;
+    }
+
+    // Virtual sectors are physically contiguous except around the dummy sector and the end of the partition,
+    // so a transfer covering the whole partition needs at most 3 flash operations
+    esp_partition_clear_stats();
+    result = wl_erase_range(wl_handle, 0, size);
+    REQUIRE(result == ESP_OK);
+    printf("wl_erase_range of %zu sectors: %zu erased sectors, %zu reads, %zu writes, est. %zu ms\n", size / sector_size,
+           esp_partition_get_erase_ops(), esp_partition_get_read_ops(), esp_partition_get_write_ops(), esp_partition_get_total_time());
+
+    esp_partition_clear_stats();
+    result = wl_write(wl_handle, 0, data, size);
+    REQUIRE(result == ESP_OK);
+    printf("wl_write of %zu sectors: %zu writes, est. %zu ms\n", size / sector_size,
+           esp_partition_get_write_ops(), esp_partition_get_total_time());
+    REQUIRE(esp_partition_get_write_ops() <= 3);
+
+    esp_partition_clear_stats();
+    result = wl_read(wl_handle, 0, read, size);
+    REQUIRE(result == ESP_OK);
+    printf("wl_read of %zu sectors: %zu reads, est. %zu ms\n", size / sector_size,
+           esp_partition_get_read_ops(), esp_partition_get_total_time());
+    REQUIRE(esp_partition_get_read_ops() <= 3);
+    REQUIRE(memcmp(data, read, size) == 0);
+
+    // Unaligned access crossing sector boundaries
+    size_t offset = sector_size / 2 + 3;
+    size_t len = sector_size * 3;
+    result = wl_read(wl_handle, offset, read, len);
+    REQUIRE(result == ESP_OK);
+    REQUIRE(memcmp(data + offset, read, len) == 0);
+
+    result = wl_unmount(wl_handle);
+    REQUIRE(result == ESP_OK);
+
+    free(data);
+    free(read);
+}
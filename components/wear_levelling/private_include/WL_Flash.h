@@ -62,6 +62,8 @@ protected:
     esp_err_t updateWL();
     esp_err_t recoverPos();
     size_t calcAddr(size_t addr);
+    size_t calcAddrRun(size_t addr, size_t size, size_t *run_size);
+    esp_err_t eraseRun(size_t start_sector, size_t count);
 
     esp_err_t updateVersion();
     esp_err_t updateV1_V2();
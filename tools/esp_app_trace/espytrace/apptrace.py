@@ -12,6 +12,7 @@ except ImportError:
 
 import os.path
 import socketserver as SocketServer
+import stat
 import subprocess
 import tempfile
 import threading
@@ -333,6 +334,42 @@ class UDPReader(NetReader, SocketServer.UDPServer):
         NetReader.__init__(self, tmo)
 
 
+class UnixRequestHandler(NetRequestHandler, SocketServer.StreamRequestHandler):
+    """
+        Handler for incoming UNIX socket connections
+    """
+    pass
+
+
+if hasattr(SocketServer, 'UnixStreamServer'):
+    class UnixReader(NetReader, SocketServer.UnixStreamServer):
+        """
+            UNIX socket reader class, used to receive trace data from applications built for Linux target
+        """
+        def __init__(self, path, tmo):
+            """
+                Constructor
+
+                Parameters
+                ----------
+                path : string
+                    path of the socket, an existing socket file is replaced
+                tmo : int
+                    see Reader.__init__()
+            """
+            if os.path.exists(path) and stat.S_ISSOCK(os.stat(path).st_mode):
+                os.unlink(path)
+            SocketServer.UnixStreamServer.__init__(self, path, UnixRequestHandler)
+            NetReader.__init__(self, tmo)
+
+        def cleanup(self):
+            """
+                see Reader.cleanup()
+            """
+            NetReader.cleanup(self)
+            os.unlink(self.server_address)
+
+
 def reader_create(trc_src, tmo):
     """
         Creates trace reader.
@@ -340,7 +377,7 @@ def reader_create(trc_src, tmo):
         Parameters
         ----------
         trc_src : string
-            trace source URL. Supports 'file:///path/to/file' or (tcp|udp)://host:port
+            trace source URL. Supports 'file:///path/to/file', (tcp|udp)://host:port or 'unix:///path/to/socket'
         tmo : int
             read timeout
 
@@ -360,6 +397,8 @@ def reader_create(trc_src, tmo):
         return TCPReader(url.hostname, url.port, tmo)
     if url.scheme == 'udp':
         return UDPReader(url.hostname, url.port, tmo)
+    if url.scheme == 'unix' and hasattr(SocketServer, 'UnixStreamServer'):
+        return UnixReader(url.path, tmo)
     return None
 
 
@@ -1,5 +1,6 @@
 # SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: Apache-2.0
+import importlib.util
 import json
 import os
 import re
@@ -12,6 +13,7 @@ import time
 from base64 import b64decode
 from textwrap import indent
 from threading import Thread
+from types import ModuleType
 from typing import Any, Dict, List, Optional
 
 from click import INT
@@ -133,8 +135,17 @@ def action_extensions(base_actions: Dict, project_path: str) -> Dict:
                 print('Failed to close/kill {}'.format(target))
             processes[target] = None  # to indicate this has ended
 
+    def _load_espcoredump_script() -> ModuleType:
+        # The decompression of core dumps lives in espcoredump.py, next to the code compressing them
+        script = os.path.join(os.environ['IDF_PATH'], 'components', 'espcoredump', 'espcoredump.py')
+        spec = importlib.util.spec_from_file_location('espcoredump', script)
+        module = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(module)  # type: ignore
+        return module
+
     def _get_espcoredump_instance(ctx: Context,
                                   args: PropertyDict,
+                                  temp_core_files: List[str],
                                   gdb_timeout_sec: int = None,
                                   core: str = None,
                                   save_core: str = None) -> CoreDump:
@@ -161,11 +172,18 @@ def action_extensions(base_actions: Dict, project_path: str) -> Dict:
             espcoredump_kwargs['extra_gdbinit_file'] = extra_gdbinit_file
 
         core_format = None
+        compression_config = get_sdkconfig_value(project_desc['config_file'], 'CONFIG_ESP_COREDUMP_COMPRESSION')
+        compression = compression_config.rstrip().endswith('y') if compression_config else False
 
         if core:
-            espcoredump_kwargs['core'] = core
             espcoredump_kwargs['chip'] = get_sdkconfig_value(project_desc['config_file'], 'CONFIG_IDF_TARGET')
             core_format = get_core_file_format(core)
+        elif coredump_to_flash and compression:
+            #  esp-coredump can't read compressed core dumps, so the partition is read here to decompress it first
+            espcoredump_kwargs['chip'] = get_sdkconfig_value(project_desc['config_file'], 'CONFIG_IDF_TARGET')
+            core = _load_espcoredump_script().read_flash_core(args.port, args.baud)
+            temp_core_files.append(core)
+            core_format = 'raw'
         elif coredump_to_flash:
             #  If the core dump is read from flash, we don't need to specify the --core-format argument at all.
             #  The format will be determined automatically
@@ -175,6 +193,15 @@ def action_extensions(base_actions: Dict, project_path: str) -> Dict:
                   "Core dump can't be read from flash since this option is not enabled in menuconfig")
             sys.exit(1)
 
+        if core_format == 'raw':
+            decompressed = _load_espcoredump_script().decompress_raw_core(core)
+            if decompressed:
+                core = decompressed
+                temp_core_files.append(decompressed)
+
+        if core:
+            espcoredump_kwargs['core'] = core
+
         if core_format:
             espcoredump_kwargs['core_format'] = core_format
 
@@ -190,6 +217,8 @@ def action_extensions(base_actions: Dict, project_path: str) -> Dict:
         bin_v2 = 2
         elf_crc32 = 256
         elf_sha256 = 257
+        elf_compressed_crc32 = 512
+        elf_compressed_sha256 = 513
 
         with open(core_file, 'rb') as f:
             coredump_bytes = f.read(16)
@@ -198,8 +227,9 @@ def action_extensions(base_actions: Dict, project_path: str) -> Dict:
                 return 'elf'
 
             core_version = int.from_bytes(coredump_bytes[4:7], 'little')
-            if core_version in [bin_v1, bin_v2, elf_crc32, elf_sha256]:
-                #  esp-coredump will determine automatically the core format (ELF or BIN)
+            if core_version in [bin_v1, bin_v2, elf_crc32, elf_sha256, elf_compressed_crc32, elf_compressed_sha256]:
+                #  esp-coredump will determine automatically the core format (ELF or BIN), compressed core dumps
+                #  are decompressed first
                 return 'raw'
         with open(core_file) as c:
             coredump_str = c.read()
@@ -516,25 +546,41 @@ def action_extensions(base_actions: Dict, project_path: str) -> Dict:
                     # Valid scenario: watch_openocd task won't be in the list if openocd not started from idf.py
                     pass
 
+    def _remove_temp_core_files(temp_core_files: List[str]) -> None:
+        for f in temp_core_files:
+            try:
+                os.remove(f)
+            except OSError:
+                pass
+
     def coredump_info(action: str,
                       ctx: Context,
                       args: PropertyDict,
                       gdb_timeout_sec: int,
                       core: str = None,
                       save_core: str = None) -> None:
-        espcoredump = _get_espcoredump_instance(ctx=ctx, args=args, gdb_timeout_sec=gdb_timeout_sec, core=core,
-                                                save_core=save_core)
+        temp_core_files = []  # type: List[str]
+        try:
+            espcoredump = _get_espcoredump_instance(ctx=ctx, args=args, temp_core_files=temp_core_files,
+                                                    gdb_timeout_sec=gdb_timeout_sec, core=core, save_core=save_core)
 
-        espcoredump.info_corefile()
+            espcoredump.info_corefile()
+        finally:
+            _remove_temp_core_files(temp_core_files)
 
     def coredump_debug(action: str,
                        ctx: Context,
                        args: PropertyDict,
                        core: str = None,
                        save_core: str = None) -> None:
-        espcoredump = _get_espcoredump_instance(ctx=ctx, args=args, core=core, save_core=save_core)
+        temp_core_files = []  # type: List[str]
+        try:
+            espcoredump = _get_espcoredump_instance(ctx=ctx, args=args, temp_core_files=temp_core_files, core=core,
+                                                    save_core=save_core)
 
-        espcoredump.dbg_corefile()
+            espcoredump.dbg_corefile()
+        finally:
+            _remove_temp_core_files(temp_core_files)
 
     coredump_base = [
         {
@@ -0,0 +1,213 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
+#include "freertos/semphr.h"
+#include "unity.h"
+
+/* Real time a test may take while waiting for hours of virtual time */
+#define MAX_REAL_TIME_MS    1000
+
+static uint64_t get_real_time_ms(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000ull + t.tv_nsec / 1000000;
+}
+
+TEST_CASE("vTaskDelay() returns at the exact tick without waiting in real time", "[freertos][virtual_time]")
+{
+    const TickType_t delay = pdMS_TO_TICKS(3600 * 1000);
+    uint64_t start_ms = get_real_time_ms();
+    TickType_t start = xTaskGetTickCount();
+
+    vTaskDelay(delay);
+
+    TEST_ASSERT_EQUAL(delay, xTaskGetTickCount() - start);
+    TEST_ASSERT_LESS_THAN(MAX_REAL_TIME_MS, get_real_time_ms() - start_ms);
+}
+
+TEST_CASE("Queue receive times out at the exact tick without waiting in real time", "[freertos][virtual_time]")
+{
+    const TickType_t timeout = pdMS_TO_TICKS(600 * 1000);
+    QueueHandle_t queue = xQueueCreate(1, sizeof(int));
+    TEST_ASSERT_NOT_NULL(queue);
+    uint64_t start_ms = get_real_time_ms();
+    TickType_t start = xTaskGetTickCount();
+    int item;
+
+    TEST_ASSERT_EQUAL(pdFALSE, xQueueReceive(queue, &item, timeout));
+
+    TEST_ASSERT_EQUAL(timeout, xTaskGetTickCount() - start);
+    TEST_ASSERT_LESS_THAN(MAX_REAL_TIME_MS, get_real_time_ms() - start_ms);
+    vQueueDelete(queue);
+}
+
+static QueueHandle_t s_woken_queue;
+
+static void delayed_task(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+
+    vTaskDelay((index + 1) * 100);
+    xQueueSend(s_woken_queue, &index, 0);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Tasks are unblocked in the order of their timeouts", "[freertos][virtual_time]")
+{
+    const int order[] = {2, 0, 1};
+    const int num = sizeof(order) / sizeof(order[0]);
+    s_woken_queue = xQueueCreate(num, sizeof(int));
+    TEST_ASSERT_NOT_NULL(s_woken_queue);
+    TickType_t start = xTaskGetTickCount();
+
+    for (int i = 0; i < num; i++) {
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(delayed_task, "delayed", 4096, (void *)(intptr_t)order[i],
+                                              uxTaskPriorityGet(NULL) + 1, NULL));
+    }
+
+    for (int i = 0; i < num; i++) {
+        int index;
+        TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(s_woken_queue, &index, portMAX_DELAY));
+        TEST_ASSERT_EQUAL(i, index);
+        TEST_ASSERT_EQUAL((i + 1) * 100, xTaskGetTickCount() - start);
+    }
+
+    vTaskDelay(1); // Let the idle task clean up the deleted tasks
+    vQueueDelete(s_woken_queue);
+}
+
+static void timer_cb(TimerHandle_t timer)
+{
+    *(TickType_t *)pvTimerGetTimerID(timer) = xTaskGetTickCount();
+}
+
+TEST_CASE("Software timer expires at the exact tick", "[freertos][virtual_time]")
+{
+    const TickType_t period = pdMS_TO_TICKS(60 * 1000);
+    TickType_t expiry = 0;
+    TimerHandle_t timer = xTimerCreate("test", period, pdFALSE, &expiry, timer_cb);
+    TEST_ASSERT_NOT_NULL(timer);
+    TickType_t start = xTaskGetTickCount();
+
+    TEST_ASSERT_EQUAL(pdPASS, xTimerStart(timer, 0));
+    vTaskDelay(2 * period);
+
+    TEST_ASSERT_EQUAL(period, expiry - start);
+    TEST_ASSERT_EQUAL(pdPASS, xTimerDelete(timer, portMAX_DELAY));
+}
+
+TEST_CASE("Scheduler trace records the context switches and the jumps of the tick count", "[freertos][virtual_time]")
+{
+    SchedTraceEvent_t events[16];
+    bool jump_found = false;
+    bool switch_found = false;
+
+    /* Drop the events of the previous tests */
+    while (uxPortSchedTraceRead(events, 16) != 0) {
+    }
+
+    vTaskDelay(100);
+
+    UBaseType_t num = uxPortSchedTraceRead(events, 16);
+    for (int i = 0; i < num; i++) {
+        if (events[i].eType == eSchedTraceTickJump) {
+            TEST_ASSERT_EQUAL_STRING("IDLE", events[i].pcTaskName);
+            TEST_ASSERT_GREATER_THAN(0, events[i].xTicks);
+            jump_found = true;
+        } else if (events[i].eType == eSchedTraceSwitchIn && events[i].pvTask == xTaskGetCurrentTaskHandle()) {
+            TEST_ASSERT_EQUAL_STRING(pcTaskGetName(NULL), events[i].pcTaskName);
+            switch_found = true;
+        }
+    }
+    TEST_ASSERT_TRUE(jump_found);
+    TEST_ASSERT_TRUE(switch_found);
+}
+
+static SemaphoreHandle_t s_blocked_sem;
+
+static void give_task(void *arg)
+{
+    vTaskDelay(50);
+    xSemaphoreGive(s_blocked_sem);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Scheduler trace accounts the time blocked on a queue", "[freertos][virtual_time]")
+{
+    SchedTraceTaskStats_t tasks[CONFIG_FREERTOS_LINUX_SCHED_TRACE_MAX_TASKS];
+    SchedTraceQueueStats_t queues[CONFIG_FREERTOS_LINUX_SCHED_TRACE_MAX_QUEUES];
+    SchedTraceTaskStats_t *task = NULL;
+    SchedTraceQueueStats_t *queue = NULL;
+    s_blocked_sem = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(s_blocked_sem);
+
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(give_task, "give", 4096, NULL, uxTaskPriorityGet(NULL), NULL));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s_blocked_sem, portMAX_DELAY));
+
+    UBaseType_t tasks_num = uxPortSchedTraceGetTaskStats(tasks, CONFIG_FREERTOS_LINUX_SCHED_TRACE_MAX_TASKS);
+    for (int i = 0; i < tasks_num; i++) {
+        if (tasks[i].pvTask == xTaskGetCurrentTaskHandle()) {
+            task = &tasks[i];
+        }
+    }
+    TEST_ASSERT_NOT_NULL(task);
+    TEST_ASSERT_GREATER_THAN(0, task->ulSwitchIns);
+    TEST_ASSERT_GREATER_THAN(0, task->ullRunTimeNs);
+    TEST_ASSERT_GREATER_THAN(0, task->ullBlockedTimeNs);
+
+    UBaseType_t queues_num = uxPortSchedTraceGetQueueStats(queues, CONFIG_FREERTOS_LINUX_SCHED_TRACE_MAX_QUEUES);
+    for (int i = 0; i < queues_num; i++) {
+        if (queues[i].pvQueue == s_blocked_sem) {
+            queue = &queues[i];
+        }
+    }
+    TEST_ASSERT_NOT_NULL(queue);
+    TEST_ASSERT_EQUAL(queueQUEUE_TYPE_BINARY_SEMAPHORE, queue->ucQueueType);
+    TEST_ASSERT_EQUAL(1, queue->ulBlocks);
+    TEST_ASSERT_GREATER_THAN(0, queue->ullMaxBlockedTimeNs);
+
+    vTaskDelay(1); // Let the idle task clean up the deleted task
+    vSemaphoreDelete(s_blocked_sem);
+}
+
+static void named_task(void *arg)
+{
+    vTaskDelay(1);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Scheduler trace writes the task names as JSON strings", "[freertos][virtual_time]")
+{
+    char *json;
+    size_t len;
+    FILE *file = open_memstream(&json, &len);
+    TEST_ASSERT_NOT_NULL(file);
+
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(named_task, "a\"b\\c\td", 4096, NULL, uxTaskPriorityGet(NULL) + 1, NULL));
+    vTaskDelay(2);
+    vPortSchedTraceWriteJson(file);
+    fclose(file);
+
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"name\":\"a\\\"b\\\\c\\u0009d\""));
+    /* Parsed by the pytest script */
+    printf("Scheduler trace JSON:\n%s\nEnd of scheduler trace JSON\n", json);
+    free(json);
+}
+
+void app_main(void)
+{
+    unity_run_menu();
+}
@@ -0,0 +1,21 @@
+# SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+import json
+import re
+
+import pytest
+from pytest_embedded import Dut
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_linux_freertos_virtual_time(dut: Dut) -> None:
+    dut.expect_exact('Press ENTER to see the list of tests.')
+    dut.write('*')
+    # The trace written by vPortSchedTraceWriteJson() must be valid JSON, whatever the task names
+    match = dut.expect(re.compile(rb'Scheduler trace JSON:\r?\n(.*?)\r?\nEnd of scheduler trace JSON', re.DOTALL), timeout=30)
+    trace = json.loads(match.group(1).decode())
+    assert 'a"b\\c\td' in [task['name'] for task in trace['freertosStats']['tasks']]
+    assert any(event.get('args', {}).get('name') == 'a"b\\c\td' for event in trace['traceEvents'])
+    # The tests wait for several hours of virtual time
+    dut.expect(r'\d+ Tests 0 Failures 0 Ignored', timeout=30)